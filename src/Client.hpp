@@ -1,6 +1,7 @@
 #pragma once
 #include "app.hh"
 #include "networking.hh"
+#include "v4d/game/Game.h"
 
 namespace app {
 	using namespace zapdata;
@@ -109,6 +110,8 @@ namespace app {
 		}
 		
 		virtual void Run(v4d::io::SocketPtr socket) override {
+			GameConfig::interpolationDelay = app::settings->bursts_client_interpolation_delay;
+			GameConfig::maxExtrapolation = app::settings->bursts_client_max_extrapolation;
 			actionsThread = new std::thread([this, socket](){
 				THREAD_BEGIN("Client SendActions", 1) {
 					
@@ -125,7 +128,7 @@ namespace app {
 								};
 								socket->End = [this, socket, mod](){
 									DEBUG_ASSERT_WARN(socket->GetWriteBufferSize() <= APP_NETWORKING_ACTION_BUFFER_SIZE, "V4D_Mod::ClientSendActions for module " << mod->ModuleName() << " stream size was " << socket->GetWriteBufferSize() << " bytes, but should be at most " << APP_NETWORKING_ACTION_BUFFER_SIZE << " bytes")
-									socket->Flush();
+									FlushActionFrame(socket);
 								};
 								mod->ClientSendActions(socket);
 								socket->UnlockWrite();
@@ -190,9 +193,12 @@ namespace app {
 				
 				if (socket->IsTCP()) {
 					*socket << ACTION::BURST;
+					*socket << BURST_ACTION::INIT;
+					FlushActionFrame(socket);
+				} else {
+					*socket << BURST_ACTION::INIT;
+					socket->Flush();
 				}
-				*socket << BURST_ACTION::INIT;
-				socket->Flush();
 				
 				// Send Bursts
 				burstsSendThread = new std::thread([this, host, port, clientType](){
@@ -217,7 +223,11 @@ namespace app {
 									};
 									socket->End = [this, mod](){
 										DEBUG_ASSERT_WARN(socket->GetWriteBufferSize() <= APP_NETWORKING_BURST_BUFFER_MAXIMUM_SIZE, "V4D_Mod::ClientSendBursts for module " << mod->ModuleName() << " stream size was " << socket->GetWriteBufferSize() << " bytes, but should be at most " << APP_NETWORKING_BURST_BUFFER_MAXIMUM_SIZE << " bytes")
-										socket->Flush();
+										if (socket->IsTCP()) {
+											FlushActionFrame(socket);
+										} else {
+											socket->Flush();
+										}
 									};
 									mod->ClientSendBursts(socket);
 									socket->UnlockWrite();
@@ -0,0 +1,280 @@
+#pragma once
+#include <v4d.h>
+#include "utilities/io/Logger.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#define APP_NETWORKING_REACTOR_TICK_MS 5 // resolution of the timer wheels
+#define APP_NETWORKING_REACTOR_WHEEL_SLOTS 256 // one round of a wheel is 1.28 seconds, longer intervals simply wait for more rounds
+#define APP_NETWORKING_REACTOR_MAX_EVENTS 64 // per call to epoll_wait
+
+namespace app::networking {
+
+	// Hashed timer wheel, each timer sits in the slot of the tick it is due at, so that advancing by one tick only looks at one slot.
+	// It is not thread-safe, it belongs to a single reactor loop.
+	class TimerWheel {
+		struct Timer {
+			uint64_t dueTick;
+			uint64_t intervalTicks;
+			std::function<bool()> func; // returns false to stop repeating
+		};
+
+		std::vector<std::vector<Timer>> slots = std::vector<std::vector<Timer>>(APP_NETWORKING_REACTOR_WHEEL_SLOTS);
+		std::vector<Timer> due {};
+		uint64_t currentTick = 0;
+		size_t count = 0;
+
+		void Insert(Timer&& timer) {
+			slots[timer.dueTick % APP_NETWORKING_REACTOR_WHEEL_SLOTS].push_back(std::move(timer));
+			++count;
+		}
+
+	public:
+		// Calls func every intervalTicks, the first time after delayTicks, until it returns false
+		void Schedule(uint64_t delayTicks, uint64_t intervalTicks, std::function<bool()>&& func) {
+			Insert({currentTick + std::max<uint64_t>(1, delayTicks), std::max<uint64_t>(1, intervalTicks), std::move(func)});
+		}
+
+		// Runs the timers that are due within the given number of ticks, in the order they were due.
+		// A timer that missed several of its intervals (when the loop has stalled) only runs once, so that clients do not get a flood of catch-up streams.
+		void Advance(uint64_t ticks) {
+			if (ticks == 0) return;
+			const uint64_t targetTick = currentTick + ticks;
+			const uint64_t slotsToVisit = std::min<uint64_t>(ticks, APP_NETWORKING_REACTOR_WHEEL_SLOTS);
+			due.clear();
+			for (uint64_t t = 1; t <= slotsToVisit; ++t) {
+				auto& slot = slots[(currentTick + t) % APP_NETWORKING_REACTOR_WHEEL_SLOTS];
+				for (size_t i = 0; i < slot.size(); ) {
+					if (slot[i].dueTick <= targetTick) {
+						due.push_back(std::move(slot[i]));
+						if (i + 1 < slot.size()) slot[i] = std::move(slot.back());
+						slot.pop_back();
+						--count;
+					} else {
+						++i;
+					}
+				}
+			}
+			currentTick = targetTick;
+			std::stable_sort(due.begin(), due.end(), [](const Timer& a, const Timer& b){return a.dueTick < b.dueTick;});
+			for (auto& timer : due) {
+				if (timer.func()) {
+					timer.dueTick = currentTick + timer.intervalTicks;
+					Insert(std::move(timer));
+				}
+			}
+			due.clear();
+		}
+
+		size_t Count() const {return count;}
+		uint64_t GetCurrentTick() const {return currentTick;}
+
+		static uint64_t SecondsToTicks(double seconds) {
+			return std::max<uint64_t>(1, uint64_t(seconds * 1000.0 / APP_NETWORKING_REACTOR_TICK_MS + 0.5));
+		}
+	};
+
+	// Fixed pool of I/O threads, each running its own epoll loop and timer wheel.
+	// A file descriptor is bound to one loop along with the timers that go with it, so that its callbacks never run concurrently with each other.
+	class NetworkReactor {
+		struct Handler {
+			std::function<bool()> onReadable; // returns false to close
+			std::function<void()> onClosed;
+		};
+
+		struct Loop {
+			int epollFd = -1;
+			int timerFd = -1;
+			int wakeFd = -1;
+			std::thread thread;
+			std::mutex tasksMutex;
+			std::vector<std::function<void()>> tasks {};
+			bool stopped = false;
+			// Only accessed by the loop thread
+			std::unordered_map<int, Handler> handlers {};
+			TimerWheel timers {};
+		};
+
+		std::vector<std::unique_ptr<Loop>> loops {};
+		std::atomic<bool> running = false;
+
+		// Runs func on the thread of the loop, returns false if the loop has already stopped
+		bool Post(Loop& loop, std::function<void()>&& func) {
+			{std::lock_guard lock(loop.tasksMutex);
+				if (loop.stopped) return false;
+				loop.tasks.push_back(std::move(func));
+			}
+			uint64_t one = 1;
+			if (write(loop.wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+				LOG_ERROR("NetworkReactor failed to wake up loop: " << strerror(errno))
+			}
+			return true;
+		}
+
+		void RunTasks(Loop& loop) {
+			std::vector<std::function<void()>> tasks {};
+			{std::lock_guard lock(loop.tasksMutex);
+				tasks.swap(loop.tasks);
+			}
+			for (auto& task : tasks) task();
+		}
+
+		void Close(Loop& loop, int fd) {
+			auto it = loop.handlers.find(fd);
+			if (it == loop.handlers.end()) return;
+			Handler handler = std::move(it->second);
+			loop.handlers.erase(it);
+			epoll_ctl(loop.epollFd, EPOLL_CTL_DEL, fd, nullptr); // may fail if the fd was already closed, which removes it from epoll anyway
+			if (handler.onClosed) handler.onClosed();
+		}
+
+		void Register(Loop& loop, int fd, Handler&& handler, bool edgeTriggered) {
+			// A closed fd number may have been reused by a new socket before the loop noticed
+			Close(loop, fd);
+			epoll_event event {};
+			event.events = edgeTriggered? (EPOLLIN | EPOLLET) : EPOLLIN;
+			event.data.fd = fd;
+			if (epoll_ctl(loop.epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+				LOG_ERROR("NetworkReactor failed to add fd " << fd << ": " << strerror(errno))
+				if (handler.onClosed) handler.onClosed();
+				return;
+			}
+			loop.handlers.emplace(fd, std::move(handler));
+		}
+
+		void Run(Loop& loop) {
+			epoll_event events[APP_NETWORKING_REACTOR_MAX_EVENTS];
+			while (running) {
+				const int n = epoll_wait(loop.epollFd, events, APP_NETWORKING_REACTOR_MAX_EVENTS, -1);
+				if (n < 0) {
+					if (errno == EINTR) continue;
+					LOG_ERROR("NetworkReactor epoll_wait failed: " << strerror(errno))
+					break;
+				}
+				for (int i = 0; i < n; ++i) {
+					const int fd = events[i].data.fd;
+					if (fd == loop.timerFd) {
+						uint64_t expirations = 0;
+						if (read(loop.timerFd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+							loop.timers.Advance(expirations);
+						}
+					} else if (fd == loop.wakeFd) {
+						uint64_t value;
+						if (read(loop.wakeFd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+							LOG_ERROR("NetworkReactor failed to read wake event: " << strerror(errno))
+						}
+						RunTasks(loop);
+					} else {
+						auto it = loop.handlers.find(fd);
+						if (it == loop.handlers.end()) continue; // closed by an earlier event of this batch
+						bool keep = !(events[i].events & EPOLLERR);
+						// A peer that has hung up still has to be read until the end of its stream, which then returns false
+						if (keep && (events[i].events & (EPOLLIN | EPOLLHUP))) keep = it->second.onReadable();
+						if (!keep) Close(loop, fd);
+					}
+				}
+			}
+			// Everything that is still registered gets closed, so that its owner does not wait forever
+			{std::lock_guard lock(loop.tasksMutex);
+				loop.stopped = true;
+			}
+			RunTasks(loop);
+			while (!loop.handlers.empty()) {
+				Close(loop, loop.handlers.begin()->first);
+			}
+		}
+
+	public:
+		NetworkReactor(int threadCount) {
+			running = true;
+			for (int i = 0; i < std::max(1, threadCount); ++i) {
+				auto loop = std::make_unique<Loop>();
+				loop->epollFd = epoll_create1(EPOLL_CLOEXEC);
+				loop->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+				loop->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+				if (loop->epollFd < 0 || loop->timerFd < 0 || loop->wakeFd < 0) {
+					LOG_ERROR("NetworkReactor failed to create loop: " << strerror(errno))
+				}
+				itimerspec tick {};
+				tick.it_interval.tv_nsec = APP_NETWORKING_REACTOR_TICK_MS * 1'000'000L;
+				tick.it_value = tick.it_interval;
+				timerfd_settime(loop->timerFd, 0, &tick, nullptr);
+				for (int fd : {loop->timerFd, loop->wakeFd}) {
+					epoll_event event {};
+					event.events = EPOLLIN;
+					event.data.fd = fd;
+					epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, fd, &event);
+				}
+				loop->thread = std::thread([this, loop = loop.get()](){Run(*loop);});
+				loops.push_back(std::move(loop));
+			}
+		}
+
+		~NetworkReactor() {
+			Stop();
+		}
+
+		// Closes everything that is still registered, then joins the threads
+		void Stop() {
+			if (!running.exchange(false)) return;
+			for (auto& loop : loops) {
+				uint64_t one = 1;
+				if (write(loop->wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+					LOG_ERROR("NetworkReactor failed to wake up loop: " << strerror(errno))
+				}
+			}
+			for (auto& loop : loops) {
+				if (loop->thread.joinable()) loop->thread.join();
+				close(loop->epollFd);
+				close(loop->timerFd);
+				close(loop->wakeFd);
+			}
+			loops.clear();
+		}
+
+		int GetThreadCount() const {
+			return int(loops.size());
+		}
+
+		// Everything registered with the same key runs on the same loop
+		int GetLoopIndex(uint64_t key) const {
+			return loops.size() > 0 ? int(key % loops.size()) : -1;
+		}
+
+		// onReadable is called on the loop thread every time the fd has data (or has hung up) and returns false to close it.
+		// When edgeTriggered, it is only called again once more data arrives, so it may leave an incomplete message in the fd but must not leave a complete one.
+		// onClosed is called exactly once, when onReadable returns false, on errors, or when the reactor stops, even if it had already stopped.
+		// The fd itself is not closed by the reactor, it still belongs to the caller.
+		void Add(int loopIndex, int fd, std::function<bool()> onReadable, std::function<void()> onClosed, bool edgeTriggered = false) {
+			if (loopIndex < 0 || loopIndex >= int(loops.size()) || !Post(*loops[loopIndex], [this, loop = loops[loopIndex].get(), fd, onReadable, onClosed, edgeTriggered]() mutable {
+				Register(*loop, fd, {std::move(onReadable), std::move(onClosed)}, edgeTriggered);
+			})) {
+				if (onClosed) onClosed();
+			}
+		}
+
+		// Calls func on the loop thread every intervalSeconds (rounded to the tick of the wheel), until it returns false
+		bool SchedulePeriodic(int loopIndex, double intervalSeconds, std::function<bool()> func) {
+			if (loopIndex < 0 || loopIndex >= int(loops.size())) return false;
+			return Post(*loops[loopIndex], [loop = loops[loopIndex].get(), intervalSeconds, func]() mutable {
+				const uint64_t ticks = TimerWheel::SecondsToTicks(intervalSeconds);
+				loop->timers.Schedule(ticks, ticks, std::move(func));
+			});
+		}
+	};
+
+}
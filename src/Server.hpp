@@ -1,6 +1,11 @@
 #pragma once
 #include "app.hh"
 #include "networking.hh"
+#include "NetworkReactor.hpp"
+#include "v4d/game/Game.h"
+
+#include <sys/ioctl.h>
+#include <sys/socket.h>
 
 namespace app {
 	using namespace zapdata;
@@ -17,12 +22,26 @@ namespace app {
 		};
 	#endif
 	
+	// Bytes written to each client since it connected, including the headers of each stream
+	struct ClientTraffic {
+		std::atomic<uint64_t> actionBytes = 0;
+		std::atomic<uint64_t> burstBytes = 0;
+		std::atomic<uint64_t> burstStreams = 0;
+	};
+	
 	// This must only be instanciated ONCE, Otherwise we need to fix the clearing of BurstCache in the Stop() method.
 	class Server : public v4d::networking::ListeningServer {
 		std::atomic<uint64_t> nextClientId = 1;
 		
 		std::mutex clientsMutex;
 		std::unordered_map<uint64_t /* clientID */, std::thread> actionThreads {};
+		
+		// When server_reactor_threads is set, all client sockets and send timers are multiplexed on this pool instead of having their own threads.
+		// It is reset when the server stops, a client that still got the stopped one is closed as soon as it is added to it.
+		static inline std::shared_ptr<NetworkReactor> reactor = nullptr;
+		
+		static inline std::mutex trafficMutex;
+		static inline std::unordered_map<uint64_t /* clientID */, std::shared_ptr<ClientTraffic>> trafficPerClient {};
 	public:
 		using ListeningServer::ListeningServer;
 		
@@ -32,10 +51,21 @@ namespace app {
 		}
 		
 		virtual void Start(uint16_t port) override {
+			GameConfig::burstBytesPerFrame = app::settings->bursts_server_bytes_per_frame;
+			if (app::settings->server_reactor_threads > 0 && !std::atomic_load(&reactor)) {
+				auto newReactor = std::make_shared<NetworkReactor>(app::settings->server_reactor_threads);
+				LOG("Server is multiplexing clients on " << newReactor->GetThreadCount() << " reactor threads")
+				std::atomic_store(&reactor, newReactor);
+			}
 			ListeningServer::Start(port);
 		}
 		
 		virtual void Stop() {
+			// Closes all the clients that are on the reactor, a new one is created if the server starts again
+			if (auto stoppingReactor = std::atomic_exchange(&reactor, std::shared_ptr<NetworkReactor>(nullptr))) {
+				stoppingReactor->Stop();
+			}
+			
 			v4d::networking::ListeningServer::Stop();
 			
 			for (auto&[id, t] : actionThreads) {
@@ -56,6 +86,22 @@ namespace app {
 				BurstCache::burstSockets.clear();
 				BurstCache::burstThreads.clear();
 			#endif
+			
+			{std::lock_guard lock(trafficMutex);
+				trafficPerClient.clear();
+			}
+		}
+		
+		static std::shared_ptr<ClientTraffic> GetClientTraffic(uint64_t clientId) {
+			std::lock_guard lock(trafficMutex);
+			auto& traffic = trafficPerClient[clientId];
+			if (!traffic) traffic = std::make_shared<ClientTraffic>();
+			return traffic;
+		}
+		
+		static void ForEachClientTraffic(std::function<void(uint64_t /* clientID */, const ClientTraffic&)>&& func) {
+			std::lock_guard lock(trafficMutex);
+			for (auto&[id, traffic] : trafficPerClient) func(id, *traffic);
 		}
 
 		uint64_t GetAppName() const override {
@@ -108,7 +154,67 @@ namespace app {
 				return true;
 			}
 				
+			static void SendBursts(v4d::io::SocketPtr socket, v4d::io::SocketPtr burstSocket, v4d::networking::IncomingClientPtr client, uint64_t frame) {
+				v4d::io::SocketPtr currentBurstSocket;
+				{std::lock_guard lock(BurstCache::burstMutex);
+					currentBurstSocket = (BurstCache::burstClientSocketTypes[client->id] == v4d::io::UDP ? burstSocket : socket);
+				}
+				auto traffic = GetClientTraffic(client->id);
+				V4D_Mod::ForEachSortedModule([client, currentBurstSocket, frame, &traffic](auto* mod){
+					ModuleID moduleID(mod->ModuleName());
+					if (mod->ServerSendBursts) {
+						currentBurstSocket->LockWrite();
+						currentBurstSocket->Begin = [currentBurstSocket, mod, client](){
+							ModuleID moduleID(mod->ModuleName());
+							if (currentBurstSocket->GetSocketType() == v4d::io::UDP) {
+								
+								//TODO Protection against attackers pretending to be the server over UDP... 
+									// currentBurstSocket->WriteEncrypted<std::string>(&client->aes, client->token);
+									// currentBurstSocket->WriteEncrypted<uint64_t>(&client->aes, ++BurstCache::burstIncrementsFromServer[client->id]);
+							
+							} else {
+								*currentBurstSocket << ACTION::BURST;
+							}
+							*currentBurstSocket << BURST_ACTION::MODULE;
+							*currentBurstSocket << moduleID.vendor;
+							*currentBurstSocket << moduleID.module;
+						};
+						currentBurstSocket->End = [currentBurstSocket, mod, client, traffic](){
+							DEBUG_ASSERT_WARN(currentBurstSocket->GetWriteBufferSize() <= APP_NETWORKING_BURST_BUFFER_MAXIMUM_SIZE, "V4D_Mod::ServerSendBursts for module " << mod->ModuleName() << " stream size was " << currentBurstSocket->GetWriteBufferSize() << " bytes, but should be at most " << APP_NETWORKING_BURST_BUFFER_MAXIMUM_SIZE << " bytes")
+							traffic->burstBytes += currentBurstSocket->GetWriteBufferSize();
+							++traffic->burstStreams;
+							currentBurstSocket->Flush();
+						};
+						mod->ServerSendBursts(currentBurstSocket, client, frame);
+						currentBurstSocket->UnlockWrite();
+					}
+				});
+			}
+			
+			// Must be called with burstMutex locked
 			static void StartBurstSenderThread(v4d::io::SocketPtr socket, v4d::networking::IncomingClientPtr client) {
+				if (const auto reactor = std::atomic_load(&Server::reactor)) {
+					if (BurstCache::burstSockets.count(client->id) == 0) {
+						LOG("Starting burst sender timer for client " << client->id << " sending to " << socket->GetIncomingIP()<<":"<<socket->GetIncomingPort())
+						BurstCache::burstIncrementsFromServer[client->id] = 0;
+						v4d::io::SocketPtr burstSocket = std::make_shared<v4d::io::Socket>(socket->GetFd(), socket->GetIncomingAddr(), v4d::io::UDP, socket->GetProtocol());
+						burstSocket->Connect();
+						BurstCache::burstSockets[client->id] = burstSocket;
+						if (BurstCache::burstClientSocketTypes[client->id] == v4d::io::UDP) {
+							*burstSocket << BURST_ACTION::INIT;
+							burstSocket->Flush();
+						}
+						reactor->SchedulePeriodic(reactor->GetLoopIndex(client->id), 1.0 / std::min(app::settings->bursts_server_max_send_fps, (double)APP_NETWORKING_SERVER_SEND_MAX_BURST_STREAMS_PER_SECOND), [client, socket, burstSocket, frame = uint64_t(0)]() mutable {
+							if (!burstSocket->IsConnected()) {
+								LOG_ERROR("Server SendBursts timer STOPPED for client " << client->id)
+								return false;
+							}
+							SendBursts(socket, burstSocket, client, frame++);
+							return true;
+						});
+					}
+					return;
+				}
 				if (BurstCache::burstThreads.count(client->id) == 0) {
 					auto remoteAddr = socket->GetIncomingAddr();
 					auto remoteIP = socket->GetIncomingIP();
@@ -134,37 +240,7 @@ namespace app {
 							while(burstSocket->IsConnected()) {
 								THREAD_TICK
 								
-								v4d::io::SocketPtr currentBurstSocket;
-								{std::lock_guard lock(BurstCache::burstMutex);
-									currentBurstSocket = (BurstCache::burstClientSocketTypes[client->id] == v4d::io::UDP ? burstSocket : socket);
-								}
-								V4D_Mod::ForEachSortedModule([client, currentBurstSocket, frame](auto* mod){
-									ModuleID moduleID(mod->ModuleName());
-									if (mod->ServerSendBursts) {
-										currentBurstSocket->LockWrite();
-										currentBurstSocket->Begin = [currentBurstSocket, mod, client](){
-											ModuleID moduleID(mod->ModuleName());
-											if (currentBurstSocket->GetSocketType() == v4d::io::UDP) {
-												
-												//TODO Protection against attackers pretending to be the server over UDP... 
-													// currentBurstSocket->WriteEncrypted<std::string>(&client->aes, client->token);
-													// currentBurstSocket->WriteEncrypted<uint64_t>(&client->aes, ++BurstCache::burstIncrementsFromServer[client->id]);
-											
-											} else {
-												*currentBurstSocket << ACTION::BURST;
-											}
-											*currentBurstSocket << BURST_ACTION::MODULE;
-											*currentBurstSocket << moduleID.vendor;
-											*currentBurstSocket << moduleID.module;
-										};
-										currentBurstSocket->End = [currentBurstSocket, mod, client](){
-											DEBUG_ASSERT_WARN(currentBurstSocket->GetWriteBufferSize() <= APP_NETWORKING_BURST_BUFFER_MAXIMUM_SIZE, "V4D_Mod::ServerSendBursts for module " << mod->ModuleName() << " stream size was " << currentBurstSocket->GetWriteBufferSize() << " bytes, but should be at most " << APP_NETWORKING_BURST_BUFFER_MAXIMUM_SIZE << " bytes")
-											currentBurstSocket->Flush();
-										};
-										mod->ServerSendBursts(currentBurstSocket, client, frame);
-										currentBurstSocket->UnlockWrite();
-									}
-								});
+								SendBursts(socket, burstSocket, client, frame);
 								
 								++frame;
 								
@@ -182,6 +258,7 @@ namespace app {
 		
 		static bool HandleIncomingAction(v4d::io::SocketPtr socket, v4d::networking::IncomingClientPtr client, byte clientType) {
 			try {
+				socket->Read<ActionFrameSize>(); // only the reactor needs it, to know when the whole frame has arrived
 				ACTION action = socket->Read<ACTION>();
 				switch (action) {
 					case ACTION::QUIT: return false;
@@ -215,7 +292,70 @@ namespace app {
 			}
 		}
 		
+		// Handles every action frame that has completely arrived, without blocking the reactor loop.
+		// A partial frame is only peeked and left in the socket, the edge-triggered loop calls this again when more of it arrives.
+		// A frame that cannot fit in the receive buffer of the socket would never complete, it is handled as soon as it starts arriving instead.
+		static bool HandleIncomingActionFrames(v4d::io::SocketPtr socket, v4d::networking::IncomingClientPtr client, byte clientType, size_t maxBufferedFrameSize) {
+			const int fd = socket->GetFd();
+			while (socket->IsConnected()) {
+				ActionFrameSize frameSize = 0;
+				const ssize_t peeked = ::recv(fd, &frameSize, sizeof(frameSize), MSG_PEEK | MSG_DONTWAIT);
+				if (peeked == 0) return false; // the client has closed the connection
+				if (peeked < 0) {
+					if (errno == EINTR) continue;
+					return errno == EAGAIN || errno == EWOULDBLOCK;
+				}
+				if (peeked < ssize_t(sizeof(frameSize))) return true;
+				int available = 0;
+				if (::ioctl(fd, FIONREAD, &available) != 0) return false;
+				const size_t totalSize = sizeof(frameSize) + frameSize;
+				if (totalSize > size_t(available)) {
+					if (totalSize <= maxBufferedFrameSize) return true;
+					LOG_WARN("Server : action frame of " << frameSize << " bytes from client " << client->id << " does not fit in the receive buffer, reading it on the reactor loop")
+				}
+				if (!HandleIncomingAction(socket, client, clientType)) return false;
+			}
+			return false;
+		}
+		
+		static void SendActions(v4d::io::SocketPtr socket, v4d::networking::IncomingClientPtr client) {
+			auto traffic = GetClientTraffic(client->id);
+			V4D_Mod::ForEachSortedModule([client, socket, &traffic](auto* mod){
+				if (mod->ServerSendActions) {
+					socket->LockWrite();
+					socket->Begin = [socket, mod](){
+						ModuleID moduleID(mod->ModuleName());
+						*socket << ACTION::MODULE;
+						*socket << moduleID.vendor;
+						*socket << moduleID.module;
+					};
+					socket->End = [socket, mod, traffic](){
+						DEBUG_ASSERT_WARN(socket->GetWriteBufferSize() <= APP_NETWORKING_ACTION_BUFFER_SIZE, "V4D_Mod::ServerSendActions for module '" << mod->ModuleName() << "' stream size was " << socket->GetWriteBufferSize() << " bytes, but should be at most " << APP_NETWORKING_ACTION_BUFFER_SIZE << " bytes")
+						traffic->actionBytes += socket->GetWriteBufferSize();
+						socket->Flush();
+					};
+					mod->ServerSendActions(socket, client);
+					socket->UnlockWrite();
+				}
+			});
+		}
+		
+		static void ClientDisconnected(v4d::io::SocketPtr socket, v4d::networking::IncomingClientPtr client) {
+			socket->SetConnected(false);
+			std::scoped_lock lock(BurstCache::burstMutex);
+			try {
+				if (BurstCache::burstSockets.at(client->id)) {
+					BurstCache::burstSockets[client->id]->SetConnected(false);
+					BurstCache::burstSockets[client->id] = nullptr;
+				}
+			} catch (...) {} // No error here, maybe burstSockets has been cleared or burstSockets[client->id] has already been nulled and it's all right
+			std::lock_guard trafficLock(trafficMutex);
+			trafficPerClient.erase(client->id);
+		}
+		
 		virtual void RunClient(v4d::io::SocketPtr socket, v4d::networking::IncomingClientPtr client, byte clientType) override {
+			const auto reactor = std::atomic_load(&Server::reactor);
+			
 			if (clientType == CLIENT_TYPE::INITIAL) {
 				
 				// IncomingClient
@@ -228,7 +368,13 @@ namespace app {
 				{std::lock_guard lock(clientsMutex);
 					
 					// Actions
-					try {
+					if (reactor) {
+						reactor->SchedulePeriodic(reactor->GetLoopIndex(client->id), 1.0 / APP_NETWORKING_MAX_ACTION_STREAMS_PER_SECOND, [client, socket](){
+							if (!socket->IsConnected()) return false;
+							SendActions(socket, client);
+							return true;
+						});
+					} else try {
 						actionThreads.at(client->id);
 					} catch(...) {
 						actionThreads[client->id] = std::thread([this, client, socket](){
@@ -237,23 +383,7 @@ namespace app {
 								while(socket->IsConnected()) {
 									THREAD_TICK
 									
-									V4D_Mod::ForEachSortedModule([this, client, socket](auto* mod){
-										if (mod->ServerSendActions) {
-											socket->LockWrite();
-											socket->Begin = [this, socket, mod](){
-												ModuleID moduleID(mod->ModuleName());
-												*socket << ACTION::MODULE;
-												*socket << moduleID.vendor;
-												*socket << moduleID.module;
-											};
-											socket->End = [this, socket, mod](){
-												DEBUG_ASSERT_WARN(socket->GetWriteBufferSize() <= APP_NETWORKING_ACTION_BUFFER_SIZE, "V4D_Mod::ServerSendActions for module '" << mod->ModuleName() << "' stream size was " << socket->GetWriteBufferSize() << " bytes, but should be at most " << APP_NETWORKING_ACTION_BUFFER_SIZE << " bytes")
-												socket->Flush();
-											};
-											mod->ServerSendActions(socket, client);
-											socket->UnlockWrite();
-										}
-									});
+									SendActions(socket, client);
 									
 									LIMIT_FRAMERATE(APP_NETWORKING_MAX_ACTION_STREAMS_PER_SECOND)
 								}
@@ -273,6 +403,23 @@ namespace app {
 				}
 			#endif
 			
+			if (reactor) {
+				// The reactor receives the actions from now on, the socket stays alive with its handlers until the client disconnects
+				const int fd = socket->GetFd();
+				int receiveBufferSize = int(sizeof(ActionFrameSize)) + APP_NETWORKING_ACTION_BUFFER_SIZE;
+				socklen_t optionSize = sizeof(receiveBufferSize);
+				setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize, optionSize);
+				getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize, &optionSize);
+				// The kernel doubles the requested size for its own bookkeeping, and caps it to net.core.rmem_max
+				const size_t maxBufferedFrameSize = size_t(std::max(0, receiveBufferSize / 2));
+				reactor->Add(reactor->GetLoopIndex(client->id), fd, [socket, client, clientType, maxBufferedFrameSize](){
+					return HandleIncomingActionFrames(socket, client, clientType, maxBufferedFrameSize);
+				}, [socket, client](){
+					ClientDisconnected(socket, client);
+				}, true);
+				return;
+			}
+			
 			THREAD_BEGIN("Server ReceiveActions client(" + std::to_string(client->id) + ") type(" + std::to_string(clientType) + ")", 1) {
 			
 				while (socket->IsConnected()) {
@@ -283,14 +430,7 @@ namespace app {
 					if (polled == -1) break; // Disconnected (or error, either way we must disconnect)
 					if (!HandleIncomingAction(socket, client, clientType)) break;
 				}
-				socket->SetConnected(false);
-				std::scoped_lock lock(BurstCache::burstMutex);
-				try {
-					if (BurstCache::burstSockets.at(client->id)) {
-						BurstCache::burstSockets[client->id]->SetConnected(false);
-						BurstCache::burstSockets[client->id] = nullptr;
-					}
-				} catch (...) {} // No error here, maybe burstSockets has been cleared or burstSockets[client->id] has already been nulled and it's all right
+				ClientDisconnected(socket, client);
 				
 			}THREAD_END(app::isClient)
 		}
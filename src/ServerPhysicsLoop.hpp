@@ -1,5 +1,6 @@
 #pragma once
 #include "app.hh"
+#include "v4d/game/Game.h"
 
 namespace app {
 
@@ -12,6 +13,17 @@ namespace app {
 				THREAD_BEGIN("Server Physics", 1) {
 					if (!app::isServer) return;
 					// SET_CPU_AFFINITY(...)
+					
+					GameConfig::physicsDeterministic = settings->physics_deterministic;
+					GameConfig::physicsFixedTimestep = settings->physics_fixed_timestep;
+					GameConfig::physicsReplayRecordFile = settings->physics_replay_record_file;
+					GameConfig::physicsThreads = settings->physics_threads;
+					// A deterministic simulation must always advance by the same amount of time per tick
+					if (GameConfig::physicsDeterministic && GameConfig::physicsFixedTimestep <= 0) {
+						GameConfig::physicsFixedTimestep = 1.0 / (settings->framerate_limit_physics > 0 ? settings->framerate_limit_physics : 200);
+					}
+					double accumulatedTime = 0;
+					
 					while (loopCheckRunning()) {
 						THREAD_TICK
 						
@@ -20,9 +32,20 @@ namespace app {
 						CALCULATE_DELTATIME(deltaTime)
 						
 						// Run Server-side physics
-						V4D_Mod::ForEachSortedModule([](auto* mod){
-							if (mod->ServerPhysicsUpdate) mod->ServerPhysicsUpdate(deltaTime);
-						});
+						if (GameConfig::physicsFixedTimestep > 0) {
+							const double timestep = GameConfig::physicsFixedTimestep;
+							accumulatedTime = glm::min(accumulatedTime + deltaTime, timestep * APP_PHYSICS_MAX_TICKS_PER_FRAME);
+							while (accumulatedTime >= timestep) {
+								accumulatedTime -= timestep;
+								V4D_Mod::ForEachSortedModule([timestep](auto* mod){
+									if (mod->ServerPhysicsUpdate) mod->ServerPhysicsUpdate(timestep);
+								});
+							}
+						} else {
+							V4D_Mod::ForEachSortedModule([](auto* mod){
+								if (mod->ServerPhysicsUpdate) mod->ServerPhysicsUpdate(deltaTime);
+							});
+						}
 						
 						if (settings->framerate_limit_physics) LIMIT_FRAMERATE_FRAMETIME(settings->framerate_limit_physics, app::secondaryFrameTime)
 					}
@@ -25,3 +25,6 @@
 
 // Renderer
 	#define APP_RENDER_SECONDARY_IN_ANOTHER_THREAD
+
+// Physics
+	#define APP_PHYSICS_MAX_TICKS_PER_FRAME 8 // with a fixed timestep, remaining accumulated time is dropped past this many ticks in one frame, so that a slow server doesn't fall further and further behind
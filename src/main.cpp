@@ -16,6 +16,7 @@
 #include "vulkan.hpp"
 #include "graphics.hpp"
 #include "ServerPhysicsLoop.hpp"
+#include "v4d/game/RigidbodyPool.hpp"
 #include "GameLoop.hpp"
 #include "SlowGameLoop.hpp"
 #include "RenderingLoop.hpp"
@@ -103,6 +104,12 @@ int main(const int argc, const char** argv) {
 	// Load V4D Core
 	if (!v4d::Init()) return -1;
 	
+	// Builds with ENABLE_AVX crash on older CPUs as soon as the physics integrator runs
+	if (!RigidbodyPool::IsSupportedByCpu()) {
+		LOG_ERROR("This build was compiled with ENABLE_AVX and requires a CPU that supports AVX")
+		return -1;
+	}
+	
 	app::Start();
 	app::Run();
 	app::Stop();
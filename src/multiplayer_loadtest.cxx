@@ -0,0 +1,554 @@
+// Project Config
+#include "config.hh"
+
+#define LOGGER_PREFIX " [loadtest] "
+
+#include <v4d.h>
+#include "app.hh"
+#include "networking.hh"
+#include "Server.hpp"
+#include "modules.hpp"
+#include "v4d/game/Game.h"
+#include "v4d/game/ServerSidePlayer.hpp"
+#include "v4d/modules/V4D_multiplayer/common.hh"
+#include "v4d/modules/V4D_multiplayer/actions.hh"
+#include "v4d/modules/V4D_multiplayer/DeltaSnapshot.hpp"
+
+#include <sys/socket.h>
+#include <cerrno>
+#include <map>
+#include <random>
+#include <sstream>
+#include <unordered_set>
+
+#define LOADTEST_ANDROMEDA_SYNC_PLAYER_MOTION 1 // networking::action::SYNC_PLAYER_MOTION of V4D_andromeda
+#define LOADTEST_MOTION_PHASE_DURATION 2.0 // in seconds, bots alternate between thrusting and braking for this long
+#define LOADTEST_MOTION_IMPULSE 2.0 // per burst, while thrusting
+#define LOADTEST_MOTION_TURN_RATE 0.2 // in radians/second
+#define LOADTEST_MOVED_THRESHOLD 0.01 // in meters, the first burst whose base position moved this much since a bot started thrusting is the server's response to it
+#define LOADTEST_SAMPLE_INTERVAL 0.1 // in seconds, between samples of the action queue depths
+#define LOADTEST_CONNECT_TIMEOUT 5.0 // in seconds, for the server to create the player entity of a bot
+
+// Headless load generator for app::Server and the multiplayer module.
+// The server modules run in-process and bots connect to them over loopback like real clients would, without running any client module.
+// Each bot sends scripted SYNC_PLAYER_MOTION bursts, acknowledges the grouped transform bursts it receives, and counts the bytes of its action stream.
+namespace app::loadtest {
+
+	// Local packet-loss/latency shim, values go in one end and come out of the other once their latency has elapsed, unless they were dropped
+	template<typename T>
+	class SimulatedLink {
+		std::mutex mu;
+		std::multimap<double /* arrival timestamp */, T> inFlight {};
+		std::mt19937 random;
+		const double loss;
+		const double latency;
+		const double jitter;
+	public:
+		SimulatedLink(double loss, double latency, double jitter, uint32_t seed) : random(seed), loss(loss), latency(latency), jitter(jitter) {}
+
+		void Send(T&& value, double now) {
+			std::lock_guard lock(mu);
+			if (loss > 0 && std::uniform_real_distribution<double>(0, 1)(random) < loss) return;
+			const double delay = latency + (jitter > 0? std::uniform_real_distribution<double>(0, jitter)(random) : 0);
+			inFlight.emplace(now + delay, std::move(value));
+		}
+
+		// Calls func for each value that has arrived by now, in order of arrival
+		template<typename F>
+		void Receive(double now, F&& func) {
+			std::vector<T> arrived {};
+			{std::lock_guard lock(mu);
+				while (!inFlight.empty() && inFlight.begin()->first <= now) {
+					arrived.push_back(std::move(inFlight.begin()->second));
+					inFlight.erase(inFlight.begin());
+				}
+			}
+			for (auto& value : arrived) func(value);
+		}
+	};
+
+	struct ModuleHeader {
+		typeof ModuleID::vendor vendor;
+		typeof ModuleID::module module;
+		ModuleHeader(V4D_Mod* mod) {
+			ModuleID moduleID(mod->ModuleName());
+			vendor = moduleID.vendor;
+			module = moduleID.module;
+		}
+	};
+
+	struct BotMotion {
+		Entity::Orientation orientation;
+		glm::dvec3 acceleration;
+		bool brakes;
+	};
+
+	struct BotAck {
+		uint32_t latest;
+		uint32_t mask;
+	};
+
+	struct BotSnapshot {
+		uint32_t sequence;
+		glm::dvec3 basePosition;
+	};
+
+	struct Bot {
+		const int index;
+		const std::string name;
+		const double phaseOffset;
+		const double heading;
+		uint64_t clientId = 0;
+		Entity::Id entityId = -1;
+
+		SimulatedLink<BotMotion> motionLink;
+		SimulatedLink<BotAck> ackLink;
+		SimulatedLink<BotSnapshot> snapshotLink;
+		::networking::snapshot::DeltaAcks deltaAcks {};
+
+		// Stats
+		std::atomic<uint64_t> actionBytesReceived = 0;
+		std::atomic<uint64_t> snapshotsReceived = 0;
+		std::atomic<uint64_t> unansweredMotions = 0;
+		std::mutex latenciesMutex;
+		std::vector<double> latencies {}; // in seconds
+
+		// Set by the send thread when the bot starts thrusting, cleared by the receive thread once the server has moved it
+		std::atomic<double> thrustStartedAt = 0;
+
+		// Only accessed by the receive thread
+		glm::dvec3 lastBasePosition {0};
+		bool hasBasePosition = false;
+		double referenceThrust = 0;
+		glm::dvec3 referencePosition {0};
+
+		Bot(int index, int count, double loss, double latency, double jitter)
+		: index(index)
+		, name("bot" + std::to_string(index))
+		, phaseOffset(2.0 * LOADTEST_MOTION_PHASE_DURATION * index / count)
+		, heading(glm::two_pi<double>() * index / count)
+		, motionLink(loss, latency, jitter, 3*index+1)
+		, ackLink(loss, latency, jitter, 3*index+2)
+		, snapshotLink(loss, latency, jitter, 3*index+3)
+		{}
+
+		// Scripted movement, bots thrust in the direction they are facing then brake, while slowly turning, each one a bit out of phase with the others
+		BotMotion GetMotion(double time) const {
+			const bool thrusting = std::fmod(time + phaseOffset, 2.0 * LOADTEST_MOTION_PHASE_DURATION) < LOADTEST_MOTION_PHASE_DURATION;
+			const Entity::Orientation orientation = glm::angleAxis(heading + time * LOADTEST_MOTION_TURN_RATE, glm::dvec3(0,1,0));
+			return {orientation, thrusting? orientation * glm::dvec3(0,0,-LOADTEST_MOTION_IMPULSE) : glm::dvec3(0), !thrusting};
+		}
+
+		void ReceivedSnapshot(const BotSnapshot& snapshot, double now) {
+			deltaAcks.Received(snapshot.sequence);
+			++snapshotsReceived;
+			double thrust = thrustStartedAt;
+			if (thrust > 0 && hasBasePosition) {
+				if (referenceThrust != thrust) {
+					referenceThrust = thrust;
+					referencePosition = lastBasePosition;
+				}
+				if (glm::distance(snapshot.basePosition, referencePosition) > LOADTEST_MOVED_THRESHOLD && thrustStartedAt.compare_exchange_strong(thrust, 0)) {
+					std::lock_guard lock(latenciesMutex);
+					latencies.push_back(now - thrust);
+				}
+			}
+			lastBasePosition = snapshot.basePosition;
+			hasBasePosition = true;
+		}
+	};
+
+	// Action stream of a bot, which can only be parsed by the modules that wrote it, so it is only counted
+	class BotConnection : public v4d::networking::OutgoingConnection {
+	public:
+		using OutgoingConnection::OutgoingConnection;
+		std::shared_ptr<Bot> bot = nullptr;
+
+		virtual ~BotConnection() {
+			Disconnect();
+		}
+
+		uint64_t GetAppName() const override {
+			return v4d::BaseN::EncodeStringToUInt64(APP_NETWORKING_APPNAME, v4d::BASE40_UPPER_CHARS);
+		}
+		uint16_t GetVersion() const override {
+			return APP_NETWORKING_VERSION;
+		}
+
+		virtual void Authenticate(v4d::data::Stream* authStream) override {
+			*authStream << bot->name;
+		}
+
+		virtual void Run(v4d::io::SocketPtr socket) override {
+			byte buffer[4096];
+			while (socket->IsConnected()) {
+				int polled = socket->Poll(APP_NETWORKING_POLL_TIMEOUT_MS);
+				if (polled == 0) continue; // timeout, no data yet, stay in the loop
+				if (polled == -1) break; // Disconnected (or error, either way we must disconnect)
+				ssize_t received = recv(socket->GetFd(), buffer, sizeof(buffer), MSG_DONTWAIT);
+				if (received == 0) break;
+				if (received < 0) {
+					if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+					break;
+				}
+				bot->actionBytesReceived += received;
+			}
+			socket->SetConnected(false);
+		}
+	};
+
+	// Burst socket of a bot, both directions go through the bot's simulated links
+	class BotBursts : public v4d::networking::OutgoingConnection {
+		std::thread* sendThread = nullptr;
+		std::thread* receiveThread = nullptr;
+
+		template<typename F>
+		void SendBurst(const ModuleHeader& header, F&& write) {
+			socket->LockWrite();
+			Connect("", 0, CLIENT_TYPE::BURST);
+			*socket << BURST_ACTION::MODULE;
+			*socket << header.vendor;
+			*socket << header.module;
+			write();
+			socket->Flush();
+			socket->UnlockWrite();
+		}
+
+	public:
+		using OutgoingConnection::OutgoingConnection;
+
+		~BotBursts() {
+			Stop();
+		}
+
+		uint64_t GetAppName() const override {
+			return v4d::BaseN::EncodeStringToUInt64(APP_NETWORKING_APPNAME, v4d::BASE40_UPPER_CHARS);
+		}
+		uint16_t GetVersion() const override {
+			return APP_NETWORKING_VERSION;
+		}
+
+		virtual void Authenticate(v4d::data::Stream* authStream) override {} // No authentication should be used for bursts
+		virtual void Run(v4d::io::SocketPtr socket) override {}
+
+		bool Start(std::shared_ptr<Bot> bot, ModuleHeader andromeda, ModuleHeader multiplayer, double sendFps) {
+			if (!Connect("", 0, CLIENT_TYPE::BURST)) return false;
+			*socket << BURST_ACTION::INIT;
+			socket->Flush();
+
+			// Send Bursts
+			sendThread = new std::thread([this, bot, andromeda, multiplayer, sendFps](){
+				double nextFrame = 0;
+				bool thrusting = false;
+				while (socket->IsConnected()) {
+					const double now = v4d::Timer::GetCurrentTimestamp();
+					if (now >= nextFrame) {
+						nextFrame = std::max(nextFrame + 1.0 / sendFps, now);
+						BotMotion motion = bot->GetMotion(now);
+						const bool thrust = !motion.brakes;
+						if (thrust && !thrusting) {
+							if (bot->thrustStartedAt.exchange(now) > 0) ++bot->unansweredMotions;
+						}
+						thrusting = thrust;
+						bot->motionLink.Send(std::move(motion), now);
+						uint32_t latest, mask;
+						if (bot->deltaAcks.Get(latest, mask)) {
+							bot->ackLink.Send({latest, mask}, now);
+						}
+					}
+					bot->motionLink.Receive(now, [&](const BotMotion& motion){
+						SendBurst(andromeda, [&](){
+							*socket << ::networking::action::Action(LOADTEST_ANDROMEDA_SYNC_PLAYER_MOTION);
+							*socket << bot->entityId;
+							*socket << motion.orientation;
+							*socket << motion.acceleration;
+							*socket << motion.brakes;
+						});
+					});
+					bot->ackLink.Receive(now, [&](const BotAck& ack){
+						SendBurst(multiplayer, [&](){
+							*socket << ::networking::action::SNAPSHOT_ACK;
+							*socket << ack.latest;
+							*socket << ack.mask;
+						});
+					});
+					SLEEP(1ms)
+				}
+			});
+
+			// Receive Bursts
+			receiveThread = new std::thread([this, bot, multiplayer](){
+				while (socket->IsConnected()) {
+					int polled = socket->Poll(1);
+					if (polled == -1) break; // Disconnected (or error, either way we must disconnect)
+					if (polled > 0) try {
+						socket->ResetReadBuffer();
+						if (socket->Read<BURST_ACTION>() == BURST_ACTION::MODULE) {
+							auto vendor = socket->Read<typeof ModuleID::vendor>();
+							auto module = socket->Read<typeof ModuleID::module>();
+							if (vendor == multiplayer.vendor && module == multiplayer.module && socket->Read<::networking::action::Action>() == ::networking::action::SYNC_GROUPED_ENTITIES_POSITIONS_ROTATIONS) {
+								BotSnapshot snapshot {};
+								snapshot.sequence = socket->Read<uint32_t>();
+								snapshot.basePosition = socket->Read<glm::dvec3>();
+								bot->snapshotLink.Send(std::move(snapshot), v4d::Timer::GetCurrentTimestamp());
+							}
+						}
+					} catch (v4d::io::Socket::disconnected_error&) {
+						break;
+					}
+					const double now = v4d::Timer::GetCurrentTimestamp();
+					bot->snapshotLink.Receive(now, [&](const BotSnapshot& snapshot){
+						bot->ReceivedSnapshot(snapshot, now);
+					});
+				}
+				socket->Unbind();
+				socket->SetConnected(false);
+			});
+			return true;
+		}
+
+		void Stop() {
+			Disconnect();
+			for (auto** thread : {&sendThread, &receiveThread}) {
+				if (*thread) {
+					if ((*thread)->joinable()) (*thread)->join();
+					delete *thread;
+					*thread = nullptr;
+				}
+			}
+		}
+	};
+
+	// Returns the client and entity ids of the player that the server created for a bot that has just connected
+	bool FindNewPlayer(const std::unordered_set<uint64_t>& knownClients, uint64_t& clientId, Entity::Id& entityId) {
+		v4d::Timer t(true);
+		while (t.GetElapsedSeconds() < LOADTEST_CONNECT_TIMEOUT) {
+			bool found = false;
+			ServerSidePlayer::ForEach([&](ServerSidePlayer::Ptr player){
+				if (!found && knownClients.count(player->GetID()) == 0 && player->parentEntityId >= 0) {
+					clientId = player->GetID();
+					entityId = player->parentEntityId;
+					found = true;
+				}
+			});
+			if (found) return true;
+			SLEEP(5ms)
+		}
+		return false;
+	}
+
+	std::string DistributionJson(std::vector<double> values, double scale, const std::string& indent) {
+		std::sort(values.begin(), values.end());
+		double sum = 0;
+		for (double v : values) sum += v;
+		auto percentile = [&values](double p){
+			return values.size() > 0? values[std::min(values.size()-1, size_t(p * values.size()))] : 0.0;
+		};
+		std::stringstream json;
+		json << "{\n"
+			<< indent << "\t\"samples\": " << values.size() << ",\n"
+			<< indent << "\t\"avg\": " << (values.size() > 0? sum / values.size() * scale : 0.0) << ",\n"
+			<< indent << "\t\"p50\": " << percentile(0.50) * scale << ",\n"
+			<< indent << "\t\"p99\": " << percentile(0.99) * scale << ",\n"
+			<< indent << "\t\"max\": " << (values.size() > 0? values.back() * scale : 0.0) << "\n"
+			<< indent << "}";
+		return json.str();
+	}
+
+	int Run(int botCount, double duration, double loss, double latency, double jitter, uint16_t port) {
+		auto multiplayerModule = V4D_Mod::GetModule(APP_MAIN_MULTIPLAYER_MODULE);
+		auto andromedaModule = V4D_Mod::GetModule("V4D_andromeda");
+		if (!multiplayerModule || !andromedaModule) {
+			LOG_ERROR("Load test requires modules " << APP_MAIN_MULTIPLAYER_MODULE << " and V4D_andromeda")
+			return -1;
+		}
+		ServerActionQueues* actionQueues = multiplayerModule->ModuleGetCustomPtr? (ServerActionQueues*)multiplayerModule->ModuleGetCustomPtr(CUSTOM_PTR_SERVER_ACTION_QUEUES) : nullptr;
+
+		// Server
+		networking::server = std::make_shared<app::Server>(v4d::io::TCP, nullptr);
+		modules::InitServer(networking::server);
+		networking::server->Start(port);
+		networking::burstServer = std::make_shared<app::BurstServer>(v4d::io::UDP, *networking::server);
+		networking::burstServer->Start(port);
+
+		// Server loops, the physics one records the time of each tick
+		std::mutex tickTimesMutex;
+		std::vector<double> tickTimes {};
+		std::thread physicsThread([&tickTimesMutex, &tickTimes](){
+			GameConfig::physicsDeterministic = settings->physics_deterministic;
+			GameConfig::physicsFixedTimestep = settings->physics_fixed_timestep;
+			GameConfig::physicsThreads = settings->physics_threads;
+			const double timestep = GameConfig::physicsFixedTimestep > 0? GameConfig::physicsFixedTimestep : 1.0 / (settings->framerate_limit_physics > 0 ? settings->framerate_limit_physics : 200);
+			v4d::Timer tickTimer;
+			while (app::isRunning) {
+				tickTimer.Reset();
+				V4D_Mod::ForEachSortedModule([timestep](auto* mod){
+					if (mod->ServerPhysicsUpdate) mod->ServerPhysicsUpdate(timestep);
+				});
+				const double tickTime = tickTimer.GetElapsedSeconds();
+				{std::lock_guard lock(tickTimesMutex);
+					tickTimes.push_back(tickTime);
+				}
+				LIMIT_FRAMERATE(1.0 / timestep)
+			}
+		});
+		std::thread slowThread([](){
+			while (app::isRunning) {
+				V4D_Mod::ForEachSortedModule([](auto* mod){
+					if (mod->SlowLoopUpdate) mod->SlowLoopUpdate(0.25);
+				});
+				LIMIT_FRAMERATE(4)
+			}
+		});
+
+		// Bots
+		const double sendFps = std::min(settings->bursts_client_max_send_fps, (double)APP_NETWORKING_CLIENT_SEND_MAX_BURST_STREAMS_PER_SECOND);
+		std::vector<std::shared_ptr<Bot>> bots {};
+		std::vector<std::shared_ptr<BotConnection>> connections {};
+		std::vector<std::shared_ptr<BotBursts>> bursts {};
+		std::unordered_set<uint64_t> knownClients {};
+		for (int i = 0; i < botCount; ++i) {
+			auto bot = std::make_shared<Bot>(i, botCount, loss, latency, jitter);
+			auto connection = std::make_shared<BotConnection>(v4d::io::TCP, nullptr);
+			connection->bot = bot;
+			if (!connection->ConnectRunAsync("127.0.0.1", port, CLIENT_TYPE::INITIAL) || !FindNewPlayer(knownClients, bot->clientId, bot->entityId)) {
+				LOG_ERROR("Bot " << i << " failed to connect")
+				continue;
+			}
+			knownClients.insert(bot->clientId);
+			auto burst = std::make_shared<BotBursts>(v4d::io::UDP, *connection);
+			if (!burst->Start(bot, ModuleHeader(andromedaModule), ModuleHeader(multiplayerModule), sendFps)) {
+				LOG_ERROR("Bot " << i << " failed to connect its bursts socket")
+			}
+			bots.push_back(bot);
+			connections.push_back(connection);
+			bursts.push_back(burst);
+		}
+
+		// Measure
+		struct Traffic {uint64_t actionBytes = 0; uint64_t burstBytes = 0; uint64_t burstStreams = 0;};
+		auto getTraffic = [](){
+			std::unordered_map<uint64_t, Traffic> traffic {};
+			Server::ForEachClientTraffic([&traffic](uint64_t clientId, const ClientTraffic& t){
+				traffic[clientId] = {t.actionBytes, t.burstBytes, t.burstStreams};
+			});
+			return traffic;
+		};
+		std::vector<uint64_t> actionBytesAtStart {};
+		for (auto& bot : bots) actionBytesAtStart.push_back(bot->actionBytesReceived);
+		{std::lock_guard lock(tickTimesMutex);
+			tickTimes.clear();
+		}
+		auto trafficAtStart = getTraffic();
+		const uint64_t packetsAcquiredAtStart = actionQueues? actionQueues->pool.GetStats().acquired.load() : 0;
+		const uint64_t slabAllocationsAtStart = actionQueues? actionQueues->pool.GetStats().slabAllocations.load() : 0;
+		std::vector<double> queueDepths {};
+		v4d::Timer t(true);
+		while (t.GetElapsedSeconds() < duration) {
+			if (actionQueues) {
+				for (auto& bot : bots) {
+					queueDepths.push_back(double(actionQueues->queues.Size(bot->clientId)));
+				}
+			}
+			SLEEP(1.0s * LOADTEST_SAMPLE_INTERVAL)
+		}
+		const double elapsed = t.GetElapsedSeconds();
+		auto trafficAtEnd = getTraffic();
+		const uint64_t packetsAcquired = actionQueues? actionQueues->pool.GetStats().acquired.load() - packetsAcquiredAtStart : 0;
+		const uint64_t slabAllocations = actionQueues? actionQueues->pool.GetStats().slabAllocations.load() - slabAllocationsAtStart : 0;
+		const uint64_t pooledPackets = actionQueues? actionQueues->pool.GetStats().packets.load() : 0;
+		std::vector<double> serverTickTimes;
+		{std::lock_guard lock(tickTimesMutex);
+			serverTickTimes = tickTimes;
+		}
+
+		// Stop
+		for (auto& burst : bursts) burst->Stop();
+		for (auto& connection : connections) connection->Disconnect();
+		app::isRunning = false;
+		physicsThread.join();
+		slowThread.join();
+		networking::burstServer->Stop();
+		networking::burstServer = nullptr;
+		networking::server->Stop();
+		networking::server = nullptr;
+
+		// Results
+		std::vector<double> actionBytesPerSecond {}, burstBytesPerSecond {}, burstsPerSecond {}, receivedActionBytesPerSecond {}, latencies {};
+		uint64_t snapshotsReceived = 0, unansweredMotions = 0;
+		for (size_t i = 0; i < bots.size(); ++i) {
+			auto& bot = bots[i];
+			const Traffic start = trafficAtStart[bot->clientId];
+			const Traffic end = trafficAtEnd[bot->clientId];
+			actionBytesPerSecond.push_back((end.actionBytes - start.actionBytes) / elapsed);
+			burstBytesPerSecond.push_back((end.burstBytes - start.burstBytes) / elapsed);
+			burstsPerSecond.push_back((end.burstStreams - start.burstStreams) / elapsed);
+			receivedActionBytesPerSecond.push_back((bot->actionBytesReceived - actionBytesAtStart[i]) / elapsed);
+			snapshotsReceived += bot->snapshotsReceived;
+			unansweredMotions += bot->unansweredMotions;
+			std::lock_guard lock(bot->latenciesMutex);
+			latencies.insert(latencies.end(), bot->latencies.begin(), bot->latencies.end());
+		}
+		std::cout << "{\n"
+			<< "\t\"bots\": " << bots.size() << ",\n"
+			<< "\t\"duration\": " << elapsed << ",\n"
+			<< "\t\"loss\": " << loss << ",\n"
+			<< "\t\"latency_ms\": " << (latency * 1000) << ",\n"
+			<< "\t\"jitter_ms\": " << (jitter * 1000) << ",\n"
+			<< "\t\"reactor_threads\": " << settings->server_reactor_threads << ",\n"
+			<< "\t\"server_ticks_per_second\": " << (serverTickTimes.size() / elapsed) << ",\n"
+			<< "\t\"server_tick_ms\": " << DistributionJson(serverTickTimes, 1000, "\t") << ",\n"
+			<< "\t\"sent_action_bytes_per_second_per_client\": " << DistributionJson(actionBytesPerSecond, 1, "\t") << ",\n"
+			<< "\t\"sent_burst_bytes_per_second_per_client\": " << DistributionJson(burstBytesPerSecond, 1, "\t") << ",\n"
+			<< "\t\"sent_bursts_per_second_per_client\": " << DistributionJson(burstsPerSecond, 1, "\t") << ",\n"
+			<< "\t\"received_action_bytes_per_second_per_client\": " << DistributionJson(receivedActionBytesPerSecond, 1, "\t") << ",\n"
+			<< "\t\"action_queue_depth\": " << DistributionJson(queueDepths, 1, "\t") << ",\n"
+			<< "\t\"action_packets\": {\n"
+			<< "\t\t\"acquired_per_tick\": " << (double(packetsAcquired) / std::max<size_t>(1, serverTickTimes.size())) << ",\n"
+			<< "\t\t\"slab_allocations_per_tick\": " << (double(slabAllocations) / std::max<size_t>(1, serverTickTimes.size())) << ",\n"
+			<< "\t\t\"slab_allocations\": " << slabAllocations << ",\n"
+			<< "\t\t\"pooled_packets\": " << pooledPackets << "\n"
+			<< "\t},\n"
+			<< "\t\"update_latency_ms\": " << DistributionJson(latencies, 1000, "\t") << ",\n"
+			<< "\t\"unanswered_motions\": " << unansweredMotions << ",\n"
+			<< "\t\"grouped_bursts_received\": " << snapshotsReceived << "\n"
+			<< "}" << std::endl;
+		return bots.size() == size_t(botCount)? 0 : -1;
+	}
+}
+
+int main(const int argc, const char** argv) {
+	if (argc > 8 || (argc > 1 && (std::string("-h") == argv[1] || std::string("--help") == argv[1]))) {
+		std::cout << "Runs the server modules in-process with bot clients connected over loopback, each sending scripted player motion, and reports the server tick times, the bytes sent per client, the action queue depths and packet allocations, and the end-to-end update latency as JSON.\n\nUsage:\n ./multiplayer_loadtest [bots=16] [duration=30 (seconds)] [loss=0 (0-1, each way)] [latency=0 (ms, each way)] [jitter=0 (ms)] [port=" << (APP_NETWORKING_DEFAULT_PORT+1) << "] [reactor_threads=-1 (from settings.ini)]\n\n" << std::endl;
+		return -1;
+	}
+	const int bots = argc > 1? atoi(argv[1]) : 16;
+	const double duration = argc > 2? atof(argv[2]) : 30;
+	const double loss = argc > 3? atof(argv[3]) : 0;
+	const double latency = argc > 4? atof(argv[4]) / 1000.0 : 0;
+	const double jitter = argc > 5? atof(argv[5]) / 1000.0 : 0;
+	const uint16_t port = argc > 6? atoi(argv[6]) : APP_NETWORKING_DEFAULT_PORT+1;
+	const int reactorThreads = argc > 7? atoi(argv[7]) : -1;
+
+	app::isServer = true;
+	app::isClient = false;
+	app::hasGraphics = false;
+	app::settings->Load();
+	if (reactorThreads >= 0) app::settings->server_reactor_threads = reactorThreads;
+
+	// Load V4D Core
+	if (!v4d::Init()) return -1;
+
+	// Only the server modules, without rendering
+	app::modulesList = {APP_MAIN_MULTIPLAYER_MODULE, "V4D_andromeda"};
+	app::modules::Load();
+	app::scene = new v4d::scene::Scene;
+	app::modules::LoadScene();
+
+	int ret = app::loadtest::Run(bots, duration, loss, latency, jitter, port);
+
+	app::modules::UnloadScene();
+	delete app::scene;
+	app::modules::Unload();
+	return ret;
+}
@@ -0,0 +1,131 @@
+#include "NetworkReactor.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <condition_variable>
+
+namespace app::tests {
+	// TCP and UDP sockets over loopback registered with a reactor, plus a timer at the action stream rate.
+	// Everything is checked by counting what the loops did, the deadline of the waits only keeps a broken reactor from hanging the tests.
+	int NETWORK_REACTOR_LOOPBACK() {
+		using namespace app::networking;
+		
+		std::mutex eventsMutex;
+		std::condition_variable eventsChanged;
+		int tcpBytes = 0;
+		int udpDatagrams = 0;
+		int closed = 0;
+		int timerCalls = 0;
+		int sentinelCalls = 0;
+		auto count = [&](int& counter, int n = 1){
+			{std::lock_guard lock(eventsMutex);
+				counter += n;
+			}
+			eventsChanged.notify_all();
+		};
+		auto waitFor = [&](auto&& condition){
+			std::unique_lock lock(eventsMutex);
+			return eventsChanged.wait_for(lock, std::chrono::seconds(10), condition);
+		};
+		auto get = [&](const int& counter){
+			std::lock_guard lock(eventsMutex);
+			return counter;
+		};
+		
+		sockaddr_in addr {};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = 0;
+		socklen_t addrLen = sizeof(addr);
+		
+		int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+		if (listenFd < 0 || bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 1) != 0) return 1;
+		getsockname(listenFd, (sockaddr*)&addr, &addrLen);
+		int clientFd = socket(AF_INET, SOCK_STREAM, 0);
+		if (connect(clientFd, (sockaddr*)&addr, sizeof(addr)) != 0) return 2;
+		int serverFd = accept(listenFd, nullptr, nullptr);
+		if (serverFd < 0) return 3;
+		
+		sockaddr_in udpAddr {};
+		udpAddr.sin_family = AF_INET;
+		udpAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t udpAddrLen = sizeof(udpAddr);
+		int udpServerFd = socket(AF_INET, SOCK_DGRAM, 0);
+		if (udpServerFd < 0 || bind(udpServerFd, (sockaddr*)&udpAddr, sizeof(udpAddr)) != 0) return 4;
+		getsockname(udpServerFd, (sockaddr*)&udpAddr, &udpAddrLen);
+		int udpClientFd = socket(AF_INET, SOCK_DGRAM, 0);
+		
+		{
+			NetworkReactor reactor(2);
+			if (reactor.GetThreadCount() != 2) return 5;
+			const int tcpLoop = reactor.GetLoopIndex(1);
+			const int udpLoop = reactor.GetLoopIndex(2);
+			if (tcpLoop == udpLoop) return 6;
+			
+			reactor.Add(tcpLoop, serverFd, [&](){
+				char buffer[64];
+				const ssize_t n = read(serverFd, buffer, sizeof(buffer));
+				if (n <= 0) return false;
+				count(tcpBytes, int(n));
+				return true;
+			}, [&](){count(closed);});
+			reactor.Add(udpLoop, udpServerFd, [&](){
+				char buffer[64];
+				if (recv(udpServerFd, buffer, sizeof(buffer), 0) > 0) count(udpDatagrams);
+				return true;
+			}, [&](){count(closed);});
+			
+			for (int i = 0; i < 3; ++i) {
+				if (write(clientFd, "action", 6) != 6) return 7;
+				if (sendto(udpClientFd, "burst", 5, 0, (sockaddr*)&udpAddr, sizeof(udpAddr)) != 5) return 8;
+			}
+			if (!waitFor([&]{return tcpBytes == 18;})) {
+				LOG_ERROR("Reactor received " << get(tcpBytes) << " TCP bytes instead of 18")
+				return 9;
+			}
+			if (!waitFor([&]{return udpDatagrams == 3;})) {
+				LOG_ERROR("Reactor received " << get(udpDatagrams) << " UDP datagrams instead of 3")
+				return 10;
+			}
+			
+			// Action stream cadence, a timer never runs before it is due so the calls cannot take less than their intervals
+			v4d::Timer timer(true);
+			reactor.SchedulePeriodic(tcpLoop, 1.0/APP_NETWORKING_MAX_ACTION_STREAMS_PER_SECOND, [&](){
+				count(timerCalls);
+				return get(timerCalls) < APP_NETWORKING_MAX_ACTION_STREAMS_PER_SECOND;
+			});
+			// Runs on the same ticks of the same loop, once it has run two more times the first timer would have too if it had not stopped
+			reactor.SchedulePeriodic(tcpLoop, 1.0/APP_NETWORKING_MAX_ACTION_STREAMS_PER_SECOND, [&](){
+				count(sentinelCalls);
+				return get(sentinelCalls) < APP_NETWORKING_MAX_ACTION_STREAMS_PER_SECOND + 2;
+			});
+			if (!waitFor([&]{return timerCalls == APP_NETWORKING_MAX_ACTION_STREAMS_PER_SECOND;})) return 11;
+			const double elapsed = timer.GetElapsedSeconds();
+			if (elapsed < 0.9) {
+				LOG_ERROR("Reactor timer ran " << APP_NETWORKING_MAX_ACTION_STREAMS_PER_SECOND << " times in " << elapsed << " seconds instead of 1")
+				return 12;
+			}
+			if (!waitFor([&]{return sentinelCalls == APP_NETWORKING_MAX_ACTION_STREAMS_PER_SECOND + 2;})) return 13;
+			if (get(timerCalls) != APP_NETWORKING_MAX_ACTION_STREAMS_PER_SECOND) {
+				LOG_ERROR("Reactor timer ran " << get(timerCalls) << " times after returning false")
+				return 14;
+			}
+			
+			// The peer hanging up closes the TCP handler, stopping the reactor closes the UDP one
+			close(clientFd);
+			if (!waitFor([&]{return closed == 1;})) return 15;
+			reactor.Stop();
+			if (get(closed) != 2) return 16;
+			
+			// Registering after the reactor has stopped closes right away
+			reactor.Add(0, udpServerFd, []{return true;}, [&](){count(closed);});
+			if (get(closed) != 3) return 17;
+		}
+		
+		close(serverFd);
+		close(listenFd);
+		close(udpServerFd);
+		close(udpClientFd);
+		return 0;
+	}
+}
@@ -2,6 +2,7 @@
 #include <v4d.h>
 #include "utilities/crypto/RSA.h"
 #include <memory>
+#include <sys/socket.h>
 
 #define APP_NETWORKING_APPNAME "V4D_TESTING" // maximum of 11 characters including UPPERCASE(A-Z), numbers(0-9), underscores(_), dash(-), dot(.), space( )
 #define APP_NETWORKING_VERSION 0 // short unsigned int (0 - 65535)
@@ -43,4 +44,16 @@ namespace app::networking {
 		byte BURST = 2;
 	}
 	
+	// Streams sent to the server over TCP are preceded by their size, so that it can leave a partial stream in the socket until the rest of it has arrived instead of blocking on it
+	using ActionFrameSize = uint32_t;
+	
+	// Flushes what has been written to the socket since the last flush as one frame, the write lock of the socket must be held
+	inline void FlushActionFrame(v4d::io::SocketPtr socket) {
+		const ActionFrameSize size = ActionFrameSize(socket->GetWriteBufferSize());
+		if (::send(socket->GetFd(), &size, sizeof(size), MSG_NOSIGNAL) != sizeof(size)) {
+			LOG_ERROR_VERBOSE("FlushActionFrame : failed to send the size of the frame")
+		}
+		socket->Flush();
+	}
+	
 }
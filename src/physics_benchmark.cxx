@@ -0,0 +1,26 @@
+#include <v4d.h>
+#include <V4D_Mod.h>
+
+// Headless server physics benchmark, only loads V4D_andromeda (no rendering nor multiplayer modules) and outputs its results as JSON
+int main(const int argc, const char** argv) {
+	int ret = 0;
+	std::vector<const char*> args {"benchmark"};
+	for (int i = 1; i < argc; ++i) args.push_back(argv[i]);
+	if (args.size() > 6 || (argc > 1 && (std::string("-h") == argv[1] || std::string("--help") == argv[1]))) {
+		std::cout << "Steps generated scenes with the V4D_andromeda server physics and reports the time per tick of each stage as JSON.\n\nUsage:\n ./physics_benchmark [scene=all (pile|tower|swarm|all)] [bodies=1000] [ticks=1000] [timestep=0.005] [threads=0 (half of the hardware threads)]\n\n" << std::endl;
+		return -1;
+	}
+	if (auto andromeda = V4D_Mod::LoadModule("V4D_andromeda"); andromeda) {
+		if (andromeda->RunFromConsole) {
+			ret = andromeda->RunFromConsole(int(args.size()), args.data());
+		} else {
+			std::cout << "Function RunFromConsole() was not found in module V4D_andromeda" << std::endl;
+			ret = -1;
+		}
+		V4D_Mod::UnloadModule("V4D_andromeda");
+	} else {
+		std::cout << "Failed to load module V4D_andromeda" << std::endl;
+		ret = -1;
+	}
+	return ret;
+}
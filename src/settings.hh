@@ -20,9 +20,17 @@ struct ProjectSettings : public v4d::io::ConfigFile {
 	bool bursts_force_tcp = false;
 	double bursts_server_max_send_fps = 15;
 	double bursts_client_max_send_fps = 25;
+	int bursts_server_bytes_per_frame = 1308; // bit-packed entity transforms sent to each client per burst frame, the entities that waited the longest relative to their distance, speed and view direction go first
+	double bursts_client_interpolation_delay = 0.1; // seconds behind the server at which entities are rendered, should cover about one and a half server burst intervals plus the network jitter
+	double bursts_client_max_extrapolation = 0.25; // seconds for which an entity keeps moving with its latest velocity when the next burst is late
+	int server_reactor_threads = 0; // I/O threads multiplexing all client sockets and send timers with epoll, 0 for dedicated receive and send threads per client
 	
 	// Physics
 	int framerate_limit_physics = 200;
+	bool physics_deterministic = false; // fixed timestep, stable iteration order and seeded collision rays, so that a recorded session can be replayed exactly
+	double physics_fixed_timestep = 0; // seconds per tick, 0 uses the measured frame time (or 1/framerate_limit_physics when deterministic)
+	std::string physics_replay_record_file = ""; // records server-received player inputs for replay with the console when not empty
+	int physics_threads = 0; // threads used by the narrowphase and collision solver, including the physics thread itself, 0 for half of the hardware threads
 	
 private:
 	void ReadConfig() override {
@@ -42,10 +50,18 @@ private:
 			, bursts_force_tcp
 			, bursts_server_max_send_fps
 			, bursts_client_max_send_fps
+			, bursts_server_bytes_per_frame
+			, bursts_client_interpolation_delay
+			, bursts_client_max_extrapolation
+			, server_reactor_threads
 		)
 		CONFIGFILE_READ_FROM_INI_WRITE(
 			"physics"
 			, framerate_limit_physics
+			, physics_deterministic
+			, physics_fixed_timestep
+			, physics_replay_record_file
+			, physics_threads
 		)
 		
 		LOGGER_INSTANCE->SetVerbose(log_verbose);
@@ -67,10 +83,18 @@ private:
 			, bursts_force_tcp
 			, bursts_server_max_send_fps
 			, bursts_client_max_send_fps
+			, bursts_server_bytes_per_frame
+			, bursts_client_interpolation_delay
+			, bursts_client_max_extrapolation
+			, server_reactor_threads
 		)
 		CONFIGFILE_WRITE_TO_INI(
 			"physics"
 			, framerate_limit_physics
+			, physics_deterministic
+			, physics_fixed_timestep
+			, physics_replay_record_file
+			, physics_threads
 		)
 	}
 };
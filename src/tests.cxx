@@ -9,6 +9,12 @@
 // Other tests
 #include "v4d/core/tests.cxx"
 #include "v4d/modules/V4D_test/tests.cxx"
+#include "v4d/modules/V4D_multiplayer/tests.cxx"
+#include "v4d/modules/V4D_buildsystem/tests.cxx"
+#include "v4d/modules/V4D_andromeda/tests.cxx"
+
+// Project tests
+#include "network_reactor_tests.cxx"
 
 namespace MyProject {
 	int MyUnitTest1() {
@@ -25,6 +31,22 @@ START_UNIT_TESTS
 
 	RUN_UNIT_TESTS( V4D_CORE )
 	RUN_UNIT_TESTS( MODULES_TEST_1 )
+	RUN_UNIT_TESTS( MULTIPLAYER_BITPACKING )
+	RUN_UNIT_TESTS( MULTIPLAYER_SNAPSHOT_POSITIONS )
+	RUN_UNIT_TESTS( MULTIPLAYER_SNAPSHOT_ROTATIONS )
+	RUN_UNIT_TESTS( MULTIPLAYER_DELTA_SNAPSHOT_LOOPBACK )
+	RUN_UNIT_TESTS( MULTIPLAYER_BURST_PRIORITY )
+	RUN_UNIT_TESTS( MULTIPLAYER_PACKET_POOL )
+	RUN_UNIT_TESTS( MULTIPLAYER_SNAPSHOT_INTERPOLATION )
+	RUN_UNIT_TESTS( BUILDSYSTEM_FILE_COMPRESSION )
+	RUN_UNIT_TESTS( BUILDSYSTEM_FILE_ROUND_TRIP )
+	RUN_UNIT_TESTS( BUILDSYSTEM_FILE_CORRUPTION )
+	RUN_UNIT_TESTS( BUILDSYSTEM_COLLIDER_PRIMITIVES )
+	RUN_UNIT_TESTS( BUILDSYSTEM_COLLIDER_UPDATES )
+	RUN_UNIT_TESTS( BUILDSYSTEM_COLLIDER_TREE )
+	RUN_UNIT_TESTS( ANDROMEDA_TERRAIN_HEIGHT_CACHE )
+	RUN_UNIT_TESTS( ANDROMEDA_PHYSICS_SLEEP_ON_KINEMATIC )
+	RUN_UNIT_TESTS( app::tests::NETWORK_REACTOR_LOOPBACK )
 	RUN_UNIT_TESTS( MyProject::MyUnitTest1 )
 
 
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <v4d.h>
+#include <vector>
+#include <unordered_map>
+
+#include "Entity.h"
+#include "physics.hh"
+
+#define BROADPHASE_DEFAULT_CELL_SIZE 4.0 // in meters, should be around the diameter of the most common dynamic objects
+#define BROADPHASE_MAX_CELLS_PER_PROXY 64 // proxies spanning more cells than this are tested against every other proxy of their reference frame instead
+
+// Uniform spatial hash grid, one per reference frame, updated incrementally as bodies move.
+// A proxy is inserted in every cell overlapped by its bounding box, and a pair is only reported from the first cell both proxies share, so that each overlapping pair is reported exactly once.
+class Broadphase {
+public:
+	using ProxyIndex = int32_t;
+
+private:
+	struct Proxy {
+		BroadphaseCollider collider;
+		Entity::ReferenceFrame referenceFrame;
+		glm::i64vec3 cellMin;
+		glm::i64vec3 cellMax;
+		size_t indexInFrame;
+		bool oversized;
+		bool active;
+		bool sleeping;
+		bool immovable;
+		Proxy(const BroadphaseCollider& collider, Entity::ReferenceFrame referenceFrame)
+		 : collider(collider)
+		 , referenceFrame(referenceFrame)
+		 , cellMin(0)
+		 , cellMax(0)
+		 , indexInFrame(0)
+		 , oversized(false)
+		 , active(true)
+		 , sleeping(false)
+		 , immovable(false)
+		{}
+	};
+
+	struct Frame {
+		std::unordered_map<uint64_t, std::vector<ProxyIndex>> cells {};
+		std::vector<ProxyIndex> proxies {};
+		std::vector<ProxyIndex> oversizedProxies {};
+	};
+
+	double cellSize;
+	double invCellSize;
+	std::vector<Proxy> proxies {};
+	std::vector<ProxyIndex> freeProxies {};
+	std::unordered_map<Entity::ReferenceFrame, Frame> frames {};
+
+	static inline uint64_t CellKey(const glm::i64vec3& cell) {
+		return (uint64_t(cell.x) * 73856093ull) ^ (uint64_t(cell.y) * 19349663ull) ^ (uint64_t(cell.z) * 83492791ull);
+	}
+
+	inline glm::i64vec3 Cell(const glm::dvec3& position) const {
+		return glm::i64vec3(glm::floor(position * invCellSize));
+	}
+
+	static inline bool RangeContains(const Proxy& proxy, const glm::i64vec3& cell) {
+		return cell.x >= proxy.cellMin.x && cell.x <= proxy.cellMax.x
+			&& cell.y >= proxy.cellMin.y && cell.y <= proxy.cellMax.y
+			&& cell.z >= proxy.cellMin.z && cell.z <= proxy.cellMax.z;
+	}
+
+	static inline bool Overlaps(const BroadphaseCollider& a, const BroadphaseCollider& b) {
+		// Same test as the original O(n²) broadphase, so that both produce the same candidate pairs
+		const float radiusSum = a.radius + b.radius;
+		const glm::vec3 d = b.position - a.position;
+		return glm::dot(d,d) < radiusSum*radiusSum;
+	}
+
+	// A collision response can only move a body that is awake and has a non-zero inverse mass, pairs without one are never reported
+	// A sleeping body resting on an immovable one (such as a kinematic build, which never sleeps) would otherwise be woken up by its contact every tick
+	static inline bool CanRespond(const Proxy& a, const Proxy& b) {
+		return (!a.sleeping && !a.immovable) || (!b.sleeping && !b.immovable);
+	}
+
+	void ComputeCellRange(Proxy& proxy) const {
+		proxy.cellMin = Cell(proxy.collider.position - proxy.collider.radius);
+		proxy.cellMax = Cell(proxy.collider.position + proxy.collider.radius);
+		const glm::i64vec3 span = proxy.cellMax - proxy.cellMin + glm::i64vec3(1);
+		proxy.oversized = (span.x * span.y * span.z) > BROADPHASE_MAX_CELLS_PER_PROXY;
+	}
+
+	void AddToCells(ProxyIndex index) {
+		Proxy& proxy = proxies[index];
+		Frame& frame = frames[proxy.referenceFrame];
+		if (proxy.oversized) {
+			frame.oversizedProxies.push_back(index);
+			return;
+		}
+		for (int64_t x = proxy.cellMin.x; x <= proxy.cellMax.x; ++x)
+		for (int64_t y = proxy.cellMin.y; y <= proxy.cellMax.y; ++y)
+		for (int64_t z = proxy.cellMin.z; z <= proxy.cellMax.z; ++z) {
+			auto& cell = frame.cells[CellKey({x,y,z})];
+			// two cells of the same proxy may hash to the same key
+			if (cell.size() == 0 || cell.back() != index) cell.push_back(index);
+		}
+	}
+
+	static void EraseFrom(std::vector<ProxyIndex>& list, ProxyIndex index) {
+		for (size_t i = 0; i < list.size(); ++i) {
+			if (list[i] == index) {
+				list[i] = list.back();
+				list.pop_back();
+				return;
+			}
+		}
+	}
+
+	void RemoveFromCells(ProxyIndex index) {
+		Proxy& proxy = proxies[index];
+		Frame& frame = frames[proxy.referenceFrame];
+		if (proxy.oversized) {
+			EraseFrom(frame.oversizedProxies, index);
+			return;
+		}
+		for (int64_t x = proxy.cellMin.x; x <= proxy.cellMax.x; ++x)
+		for (int64_t y = proxy.cellMin.y; y <= proxy.cellMax.y; ++y)
+		for (int64_t z = proxy.cellMin.z; z <= proxy.cellMax.z; ++z) {
+			auto it = frame.cells.find(CellKey({x,y,z}));
+			if (it != frame.cells.end()) {
+				EraseFrom(it->second, index);
+				if (it->second.size() == 0) frame.cells.erase(it);
+			}
+		}
+	}
+
+public:
+	Broadphase(double cellSize = BROADPHASE_DEFAULT_CELL_SIZE)
+	 : cellSize(cellSize)
+	 , invCellSize(1.0 / cellSize)
+	{}
+
+	double GetCellSize() const {return cellSize;}
+
+	size_t Count() const {
+		return proxies.size() - freeProxies.size();
+	}
+
+	void Clear() {
+		proxies.clear();
+		freeProxies.clear();
+		frames.clear();
+	}
+
+	ProxyIndex Insert(Entity::ReferenceFrame referenceFrame, const BroadphaseCollider& collider) {
+		ProxyIndex index;
+		if (freeProxies.size() > 0) {
+			index = freeProxies.back();
+			freeProxies.pop_back();
+			proxies[index] = Proxy(collider, referenceFrame);
+		} else {
+			index = ProxyIndex(proxies.size());
+			proxies.emplace_back(collider, referenceFrame);
+		}
+		Proxy& proxy = proxies[index];
+		ComputeCellRange(proxy);
+		Frame& frame = frames[referenceFrame];
+		proxy.indexInFrame = frame.proxies.size();
+		frame.proxies.push_back(index);
+		AddToCells(index);
+		return index;
+	}
+
+	void Remove(ProxyIndex index) {
+		if (index < 0 || index >= ProxyIndex(proxies.size()) || !proxies[index].active) return;
+		RemoveFromCells(index);
+		Proxy& proxy = proxies[index];
+		Frame& frame = frames[proxy.referenceFrame];
+		ProxyIndex last = frame.proxies.back();
+		frame.proxies[proxy.indexInFrame] = last;
+		proxies[last].indexInFrame = proxy.indexInFrame;
+		frame.proxies.pop_back();
+		proxy.active = false;
+		freeProxies.push_back(index);
+	}
+
+	// Only touches the hash grid when the proxy's bounding box moved into a different set of cells
+	void Update(ProxyIndex index, const glm::dvec3& position) {
+		if (index < 0 || index >= ProxyIndex(proxies.size())) return;
+		Proxy& proxy = proxies[index];
+		if (!proxy.active) return;
+		proxy.collider.position = position;
+		const glm::i64vec3 cellMin = Cell(position - proxy.collider.radius);
+		const glm::i64vec3 cellMax = Cell(position + proxy.collider.radius);
+		if (cellMin != proxy.cellMin || cellMax != proxy.cellMax) {
+			RemoveFromCells(index);
+			ComputeCellRange(proxy);
+			AddToCells(index);
+		}
+	}
+
+	// Pairs of two sleeping proxies are not reported, and sleeping proxies are only visited through their awake neighbours
+	void SetSleeping(ProxyIndex index, bool sleeping) {
+		if (index < 0 || index >= ProxyIndex(proxies.size())) return;
+		proxies[index].sleeping = sleeping;
+	}
+
+	// Pairs of an immovable proxy (bodies with a zero inverse mass, such as kinematic builds) with another immovable or sleeping proxy are not reported, since no collision response can move either of them
+	void SetImmovable(ProxyIndex index, bool immovable) {
+		if (index < 0 || index >= ProxyIndex(proxies.size())) return;
+		proxies[index].immovable = immovable;
+	}
+
+	bool IsImmovable(ProxyIndex index) const {
+		return index >= 0 && index < ProxyIndex(proxies.size()) && proxies[index].immovable;
+	}
+
+	const BroadphaseCollider& GetCollider(ProxyIndex index) const {
+		return proxies[index].collider;
+	}
+
+	// Calls func(const BroadphaseCollider& a, const BroadphaseCollider& b) once for each pair of overlapping bounding spheres within the same reference frame, unless neither of them is both awake and movable
+	template<typename F>
+	void ForEachPair(F&& func) const {
+		for (const auto&[referenceFrame, frame] : frames) {
+			for (ProxyIndex indexA : frame.proxies) {
+				const Proxy& a = proxies[indexA];
+				if (a.sleeping) continue;
+				if (a.oversized) {
+					// Oversized proxies are tested against everything, skipping pairs with another awake oversized proxy of lower index which already tested against this one
+					for (ProxyIndex indexB : frame.proxies) if (indexB != indexA) {
+						const Proxy& b = proxies[indexB];
+						if (b.oversized && !b.sleeping && indexB < indexA) continue;
+						if (!CanRespond(a, b)) continue;
+						if (Overlaps(a.collider, b.collider)) func(a.collider, b.collider);
+					}
+					continue;
+				}
+				// Sleeping oversized proxies are not visited by the outer loop
+				for (ProxyIndex indexB : frame.oversizedProxies) {
+					const Proxy& b = proxies[indexB];
+					if (b.sleeping && CanRespond(a, b) && Overlaps(a.collider, b.collider)) func(a.collider, b.collider);
+				}
+				for (int64_t x = a.cellMin.x; x <= a.cellMax.x; ++x)
+				for (int64_t y = a.cellMin.y; y <= a.cellMax.y; ++y)
+				for (int64_t z = a.cellMin.z; z <= a.cellMax.z; ++z) {
+					const glm::i64vec3 cell {x,y,z};
+					auto it = frame.cells.find(CellKey(cell));
+					if (it == frame.cells.end()) continue;
+					for (ProxyIndex indexB : it->second) if (indexB != indexA) {
+						const Proxy& b = proxies[indexB];
+						// Pairs of two awake proxies are reported from the lowest index, pairs with a sleeping proxy from the awake one
+						if (!b.sleeping && indexB < indexA) continue;
+						if (!CanRespond(a, b)) continue;
+						// Hash collisions may put proxies of other cells in this bucket
+						if (!RangeContains(b, cell)) continue;
+						// Only report the pair from the first cell that both proxies share
+						if (cell != glm::max(a.cellMin, b.cellMin)) continue;
+						if (Overlaps(a.collider, b.collider)) func(a.collider, b.collider);
+					}
+				}
+			}
+		}
+	}
+
+};
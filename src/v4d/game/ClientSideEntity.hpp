@@ -3,6 +3,7 @@
 #include <v4d.h>
 
 #include "Entity.h"
+#include "SnapshotInterpolation.hpp"
 
 struct V4DGAME ClientSideEntity : Entity {
 	V4D_ENTITY_DECLARE_CLASS_MAP(ClientSideEntity)
@@ -10,21 +11,16 @@ struct V4DGAME ClientSideEntity : Entity {
 	
 	Iteration iteration {0};
 
-	bool posInit = false;
-	Position targetPosition {0};
-	Orientation targetOrientation {1,0,0,0};
+	// Transforms received from the server, the rendered position and orientation are sampled from it a little in the past
+	SnapshotInterpolation snapshots {};
 	
 	inline void operator()(v4d::modular::ModuleID moduleID, Type type, ReferenceFrame referenceFrame, Position position, Orientation orientation = {1,0,0,0}) {
 		Entity::operator()(moduleID, type, referenceFrame, position, orientation);
-		this->targetPosition = position;
-		this->targetOrientation = orientation;
-		this->posInit = true;
+		this->snapshots.Reset(position, orientation);
 	}
 	inline void operator()(v4d::modular::ModuleID moduleID, Type type, ReferenceFrame referenceFrame, ReferenceFrameExtra referenceFrameExtra, Position position, Orientation orientation = {1,0,0,0}) {
 		Entity::operator()(moduleID, type, referenceFrame, referenceFrameExtra, position, orientation);
-		this->targetPosition = position;
-		this->targetOrientation = orientation;
-		this->posInit = true;
+		this->snapshots.Reset(position, orientation);
 	}
 	inline void operator()(v4d::modular::ModuleID moduleID, Type type, ReferenceFrame referenceFrame, ReferenceFrameExtra referenceFrameExtra, Position position, Orientation orientation, Iteration iteration) {
 		operator()(moduleID, type, referenceFrame, referenceFrameExtra, position, orientation);
@@ -3,6 +3,19 @@
 #include "Entity.h"
 #include "physics.hh"
 
+enum class ColliderType : uint8_t {
+	Sphere,
+	Box,
+	Capsule,
+	Cylinder,
+	Cone,
+	Ring,
+	Triangle,
+	Wedge,
+	Compound,
+	COUNT
+};
+
 struct Collider {
 	
 	glm::dvec3 position;
@@ -15,6 +28,18 @@ struct Collider {
 	
 	virtual ~Collider() = default;
 	
+	inline glm::dvec3 GetWorldPosition(const Entity* entity) const {
+		return entity->position + glm::mat3_cast(entity->orientation) * this->position;
+	}
+	inline glm::dmat3 GetWorldRotation(const Entity* entity) const {
+		return glm::mat3_cast(entity->orientation) * this->rotation;
+	}
+	
+	virtual ColliderType GetType() const = 0;
+	
+	// Returns the furthest point of the collider in the given world-space direction (world space), used by GJK/EPA
+	virtual glm::dvec3 Support(const Entity*, const glm::dvec3& direction) const = 0;
+	
 	virtual bool RayCollision(const Ray&, Entity*, CollisionInfo&) = 0;
 	virtual bool TerrainCollision(const std::function<double(const glm::dvec3&)>&, Entity*, TerrainCollisionInfo&) = 0;
 	virtual void GenerateCollisionRays(Entity*, const v4d::TextID&, std::vector<Ray>&, uint& randomSeed) = 0;
@@ -30,3 +55,5 @@ struct Collider {
 #include "colliders/RingCollider.hpp"
 #include "colliders/TriangleCollider.hpp"
 #include "colliders/ConeCollider.hpp"
+#include "colliders/WedgeCollider.hpp"
+#include "colliders/CompoundCollider.hpp"
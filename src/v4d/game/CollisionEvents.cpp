@@ -0,0 +1,42 @@
+#include "CollisionEvents.h"
+
+std::mutex CollisionEvents::handlersMutex {};
+std::vector<CollisionEvents::Handler> CollisionEvents::handlers {};
+std::atomic<uint64_t> CollisionEvents::generation {0};
+
+static inline bool SameModule(const v4d::modular::ModuleID& a, const v4d::modular::ModuleID& b) {
+	return a.vendor == b.vendor && a.module == b.module;
+}
+
+void CollisionEvents::RegisterBatchHandler(const v4d::modular::ModuleID& moduleID, BatchHandler handler) {
+	std::lock_guard lock(handlersMutex);
+	for (auto& h : handlers) {
+		if (SameModule(h.moduleID, moduleID)) {
+			h.handler = handler;
+			++generation;
+			return;
+		}
+	}
+	handlers.push_back({moduleID, handler});
+	++generation;
+}
+
+void CollisionEvents::UnregisterBatchHandler(const v4d::modular::ModuleID& moduleID) {
+	std::lock_guard lock(handlersMutex);
+	for (size_t i = 0; i < handlers.size(); ++i) {
+		if (SameModule(handlers[i].moduleID, moduleID)) {
+			handlers[i] = handlers.back();
+			handlers.pop_back();
+			++generation;
+			return;
+		}
+	}
+}
+
+CollisionEvents::BatchHandler CollisionEvents::GetBatchHandler(const v4d::modular::ModuleID& moduleID) {
+	std::lock_guard lock(handlersMutex);
+	for (const auto& h : handlers) {
+		if (SameModule(h.moduleID, moduleID)) return h.handler;
+	}
+	return nullptr;
+}
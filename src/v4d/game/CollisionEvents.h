@@ -0,0 +1,37 @@
+#pragma once
+
+#include <v4d.h>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+#include "Entity.h"
+
+struct CollisionHit {
+	Entity::Id id;
+	Entity::Type type;
+	glm::dvec3 contactPoint; // in entity space
+	double contactSpeed;
+};
+
+// Modules may register a batch handler to receive all of their collision hits of a physics tick in a single call, instead of one OnCollisionHit call per hit.
+// Handlers are called from the server physics thread, at the end of the tick.
+struct V4DGAME CollisionEvents {
+	using BatchHandler = void(*)(const CollisionHit* hits, size_t count);
+	
+	static void RegisterBatchHandler(const v4d::modular::ModuleID& moduleID, BatchHandler handler);
+	static void UnregisterBatchHandler(const v4d::modular::ModuleID& moduleID);
+	static BatchHandler GetBatchHandler(const v4d::modular::ModuleID& moduleID);
+	
+	// Incremented each time a handler is registered or unregistered, so that dispatch tables know when to be rebuilt
+	static uint64_t GetGeneration() {return generation;}
+	
+private:
+	struct Handler {
+		v4d::modular::ModuleID moduleID;
+		BatchHandler handler;
+	};
+	static std::mutex handlersMutex;
+	static std::vector<Handler> handlers;
+	static std::atomic<uint64_t> generation;
+};
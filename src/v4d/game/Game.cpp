@@ -1 +1,9 @@
 #include "Game.h"
+
+bool GameConfig::physicsDeterministic = false;
+double GameConfig::physicsFixedTimestep = 0;
+std::string GameConfig::physicsReplayRecordFile = "";
+int GameConfig::physicsThreads = 0;
+int GameConfig::burstBytesPerFrame = 1308;
+double GameConfig::interpolationDelay = 0.1;
+double GameConfig::maxExtrapolation = 0.25;
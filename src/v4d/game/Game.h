@@ -1,2 +1,25 @@
 #pragma once
 #include <v4d.h>
+#include <string>
+#include <thread>
+
+// Game-wide configuration shared between the application and the modules, set by the application from its settings before the simulation starts
+struct V4DGAME GameConfig {
+	
+	// Physics
+	static bool physicsDeterministic; // Stable iteration order and collision rays seeded from the tick number, to be used with a fixed timestep
+	static double physicsFixedTimestep; // Seconds per physics tick, 0 to use the measured frame time
+	static std::string physicsReplayRecordFile; // Server-received player inputs are recorded into this file when not empty
+	static int physicsThreads; // Threads used by the narrowphase and collision solver including the physics thread, 0 for half of the hardware threads
+	
+	// Networking
+	static int burstBytesPerFrame; // Bit-packed entity transforms sent to each client per burst frame, picked by accumulated priority
+	static double interpolationDelay; // Seconds behind the server at which clients render entities, so that they have the bursts on both sides of that time despite jitter and lower burst rates
+	static double maxExtrapolation; // Seconds for which clients keep moving an entity with its latest velocity when no newer burst arrived in time
+	
+	static int GetPhysicsThreadCount() {
+		if (physicsThreads > 0) return physicsThreads;
+		return std::max(1, int(std::thread::hardware_concurrency()) / 2);
+	}
+	
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <v4d.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Fixed set of worker threads running parallel loops on behalf of a single owner thread (typically the server physics thread).
+// The owner thread takes part in the work, so a job system of N threads only starts N-1 workers.
+class JobSystem {
+	std::vector<std::thread> workers {};
+	std::mutex mu;
+	std::condition_variable wakeEventVar;
+	std::condition_variable doneEventVar;
+	bool running = true;
+	uint64_t generation = 0;
+	size_t finishedWorkers = 0;
+
+	std::function<void(size_t batch, int threadIndex)> job = nullptr;
+	size_t batchCount = 0;
+	std::atomic<size_t> nextBatch {0};
+
+	void RunBatches(int threadIndex) {
+		for (size_t batch; (batch = nextBatch++) < batchCount;) {
+			job(batch, threadIndex);
+		}
+	}
+
+public:
+	JobSystem(int threadCount) {
+		threadCount = std::max(1, threadCount);
+		workers.reserve(threadCount - 1);
+		for (int i = 1; i < threadCount; ++i) {
+			workers.emplace_back([this, threadIndex=i](){
+				uint64_t lastGeneration = 0;
+				for (;;) {
+					{
+						std::unique_lock lock(mu);
+						wakeEventVar.wait(lock, [this, lastGeneration]{
+							return !running || generation != lastGeneration;
+						});
+						if (!running) return;
+						lastGeneration = generation;
+					}
+					RunBatches(threadIndex);
+					{
+						std::lock_guard lock(mu);
+						++finishedWorkers;
+					}
+					doneEventVar.notify_one();
+				}
+			});
+		}
+	}
+
+	~JobSystem() {
+		{
+			std::lock_guard lock(mu);
+			running = false;
+		}
+		wakeEventVar.notify_all();
+		for (auto& worker : workers) {
+			if (worker.joinable()) worker.join();
+		}
+	}
+
+	int GetThreadCount() const {
+		return int(workers.size()) + 1;
+	}
+
+	// Calls func(size_t begin, size_t end, int threadIndex) for consecutive ranges of at most batchSize items, and returns once all of them are done.
+	// threadIndex is in [0, GetThreadCount()), it is 0 for the calling thread.
+	template<typename F>
+	void ParallelFor(size_t count, size_t batchSize, F&& func) {
+		if (count == 0) return;
+		batchSize = std::max(size_t(1), batchSize);
+		const size_t batches = (count + batchSize - 1) / batchSize;
+		if (workers.size() == 0 || batches == 1) {
+			func(size_t(0), count, 0);
+			return;
+		}
+		{
+			std::lock_guard lock(mu);
+			job = [&func, count, batchSize](size_t batch, int threadIndex){
+				const size_t begin = batch * batchSize;
+				func(begin, std::min(begin + batchSize, count), threadIndex);
+			};
+			batchCount = batches;
+			nextBatch = 0;
+			finishedWorkers = 0;
+			++generation;
+		}
+		wakeEventVar.notify_all();
+		RunBatches(0);
+		std::unique_lock lock(mu);
+		doneEventVar.wait(lock, [this]{
+			return finishedWorkers == workers.size();
+		});
+		job = nullptr;
+	}
+
+};
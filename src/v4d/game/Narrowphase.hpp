@@ -0,0 +1,537 @@
+#pragma once
+
+#include <v4d.h>
+#include <array>
+#include <vector>
+#include <algorithm>
+
+#include "Entity.h"
+#include "physics.hh"
+#include "Collider.hpp"
+
+#define NARROWPHASE_GJK_MAX_ITERATIONS 32
+#define NARROWPHASE_EPA_MAX_ITERATIONS 32
+#define NARROWPHASE_EPA_TOLERANCE 0.0001
+
+// Closed-form contact generators for pairs of primitive colliders, with a GJK/EPA fallback for the other convex pairs.
+// All generators fill CollisionInfo with the same conventions as the ray-based path: normal goes from A to B, contacts are in world space.
+namespace Narrowphase {
+
+	using ContactGenerator = bool(*)(const Collider* colliderA, const Entity* entityA, const Collider* colliderB, const Entity* entityB, CollisionInfo& collision);
+
+	#pragma region Helpers
+
+	// Fills the collision between two spheres, also used for sphere-capsule and capsule-capsule once the closest points on their segments are known
+	inline bool SphereSphere(const glm::dvec3& positionA, double radiusA, const glm::dvec3& positionB, double radiusB, CollisionInfo& collision) {
+		const glm::dvec3 d = positionB - positionA;
+		const double distSqr = glm::dot(d,d);
+		const double radiusSum = radiusA + radiusB;
+		if (distSqr >= radiusSum*radiusSum) return false;
+		const double dist = glm::sqrt(distSqr);
+		const glm::dvec3 normal = dist > DOUBLE_EPSILON ? d / dist : glm::dvec3{0,0,1};
+		collision.normal = normal;
+		collision.penetration = float(radiusSum - dist);
+		collision.contactA = positionA + normal * radiusA;
+		collision.contactB = positionB - normal * radiusB;
+		return true;
+	}
+
+	inline glm::dvec3 ClosestPointOnSegment(const glm::dvec3& p, const glm::dvec3& a, const glm::dvec3& b) {
+		const glm::dvec3 ab = b - a;
+		const double lengthSqr = glm::dot(ab, ab);
+		if (lengthSqr < DOUBLE_EPSILON) return a;
+		return a + ab * glm::clamp(glm::dot(p - a, ab) / lengthSqr, 0.0, 1.0);
+	}
+
+	// Closest points between segments p1-q1 and p2-q2 (Real-Time Collision Detection, Ericson, 5.1.9)
+	inline void ClosestPointsBetweenSegments(const glm::dvec3& p1, const glm::dvec3& q1, const glm::dvec3& p2, const glm::dvec3& q2, glm::dvec3& c1, glm::dvec3& c2) {
+		const glm::dvec3 d1 = q1 - p1;
+		const glm::dvec3 d2 = q2 - p2;
+		const glm::dvec3 r = p1 - p2;
+		const double a = glm::dot(d1, d1);
+		const double e = glm::dot(d2, d2);
+		const double f = glm::dot(d2, r);
+		double s, t;
+		if (a <= DOUBLE_EPSILON && e <= DOUBLE_EPSILON) {
+			s = t = 0;
+		} else if (a <= DOUBLE_EPSILON) {
+			s = 0;
+			t = glm::clamp(f / e, 0.0, 1.0);
+		} else {
+			const double c = glm::dot(d1, r);
+			if (e <= DOUBLE_EPSILON) {
+				t = 0;
+				s = glm::clamp(-c / a, 0.0, 1.0);
+			} else {
+				const double b = glm::dot(d1, d2);
+				const double denom = a*e - b*b;
+				s = denom > DOUBLE_EPSILON ? glm::clamp((b*f - c*e) / denom, 0.0, 1.0) : 0.0;
+				t = (b*s + f) / e;
+				if (t < 0) {
+					t = 0;
+					s = glm::clamp(-c / a, 0.0, 1.0);
+				} else if (t > 1) {
+					t = 1;
+					s = glm::clamp((b - c) / a, 0.0, 1.0);
+				}
+			}
+		}
+		c1 = p1 + d1 * s;
+		c2 = p2 + d2 * t;
+	}
+
+	// Capsules are aligned with their local Z axis
+	inline void GetCapsuleSegment(const CapsuleCollider* capsule, const Entity* entity, glm::dvec3& a, glm::dvec3& b) {
+		const glm::dvec3 position = capsule->GetWorldPosition(entity);
+		const glm::dvec3 axis = capsule->GetWorldRotation(entity) * glm::dvec3(0, 0, capsule->length/2);
+		a = position - axis;
+		b = position + axis;
+	}
+
+	// Swaps A and B of a collision generated with the colliders in the reverse order
+	inline void FlipCollision(CollisionInfo& collision) {
+		collision.normal = -collision.normal;
+		std::swap(collision.contactA, collision.contactB);
+	}
+
+	#pragma endregion
+
+	#pragma region GJK/EPA
+
+	struct SupportPoint {
+		glm::dvec3 v; // point on the Minkowski difference A-B
+		glm::dvec3 a; // corresponding point on A
+		glm::dvec3 b; // corresponding point on B
+	};
+
+	inline SupportPoint MinkowskiSupport(const Collider* colliderA, const Entity* entityA, const Collider* colliderB, const Entity* entityB, const glm::dvec3& direction) {
+		const glm::dvec3 a = colliderA->Support(entityA, direction);
+		const glm::dvec3 b = colliderB->Support(entityB, -direction);
+		return {a - b, a, b};
+	}
+
+	// Updates the simplex to its sub-simplex closest to the origin and sets the next search direction. Returns true when the simplex contains the origin.
+	inline bool GjkDoSimplex(std::array<SupportPoint, 4>& simplex, int& size, glm::dvec3& direction) {
+		auto sameDirection = [](const glm::dvec3& a, const glm::dvec3& b){return glm::dot(a, b) > 0;};
+		switch (size) {
+			case 2: {
+				const glm::dvec3 a = simplex[1].v, b = simplex[0].v;
+				const glm::dvec3 ab = b - a, ao = -a;
+				if (sameDirection(ab, ao)) {
+					direction = glm::cross(glm::cross(ab, ao), ab);
+				} else {
+					simplex[0] = simplex[1];
+					size = 1;
+					direction = ao;
+				}
+				return false;
+			}
+			case 3: {
+				const glm::dvec3 a = simplex[2].v, b = simplex[1].v, c = simplex[0].v;
+				const glm::dvec3 ab = b - a, ac = c - a, ao = -a;
+				const glm::dvec3 abc = glm::cross(ab, ac);
+				if (sameDirection(glm::cross(abc, ac), ao)) {
+					if (sameDirection(ac, ao)) {
+						simplex = {simplex[0], simplex[2]};
+						size = 2;
+						direction = glm::cross(glm::cross(ac, ao), ac);
+					} else {
+						simplex = {simplex[1], simplex[2]};
+						size = 2;
+						return GjkDoSimplex(simplex, size, direction);
+					}
+				} else if (sameDirection(glm::cross(ab, abc), ao)) {
+					simplex = {simplex[1], simplex[2]};
+					size = 2;
+					return GjkDoSimplex(simplex, size, direction);
+				} else if (sameDirection(abc, ao)) {
+					direction = abc;
+				} else {
+					std::swap(simplex[0], simplex[1]);
+					direction = -abc;
+				}
+				return false;
+			}
+			case 4: {
+				const glm::dvec3 a = simplex[3].v, b = simplex[2].v, c = simplex[1].v, d = simplex[0].v;
+				const glm::dvec3 ab = b - a, ac = c - a, ad = d - a, ao = -a;
+				const glm::dvec3 abc = glm::cross(ab, ac);
+				const glm::dvec3 acd = glm::cross(ac, ad);
+				const glm::dvec3 adb = glm::cross(ad, ab);
+				if (sameDirection(abc, ao)) {
+					simplex = {simplex[1], simplex[2], simplex[3]};
+					size = 3;
+					return GjkDoSimplex(simplex, size, direction);
+				}
+				if (sameDirection(acd, ao)) {
+					simplex = {simplex[0], simplex[1], simplex[3]};
+					size = 3;
+					return GjkDoSimplex(simplex, size, direction);
+				}
+				if (sameDirection(adb, ao)) {
+					simplex = {simplex[2], simplex[0], simplex[3]};
+					size = 3;
+					return GjkDoSimplex(simplex, size, direction);
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Returns true and a tetrahedron enclosing the origin if the two convex colliders intersect
+	inline bool Gjk(const Collider* colliderA, const Entity* entityA, const Collider* colliderB, const Entity* entityB, std::array<SupportPoint, 4>& simplex) {
+		glm::dvec3 direction = colliderB->GetWorldPosition(entityB) - colliderA->GetWorldPosition(entityA);
+		if (glm::dot(direction, direction) < DOUBLE_EPSILON) direction = {1,0,0};
+		int size = 0;
+		simplex[size++] = MinkowskiSupport(colliderA, entityA, colliderB, entityB, direction);
+		direction = -simplex[0].v;
+		for (int i = 0; i < NARROWPHASE_GJK_MAX_ITERATIONS; ++i) {
+			if (glm::dot(direction, direction) < DOUBLE_EPSILON) return false; // touching, no penetration
+			const SupportPoint p = MinkowskiSupport(colliderA, entityA, colliderB, entityB, direction);
+			if (glm::dot(p.v, direction) <= 0) return false;
+			simplex[size++] = p;
+			if (GjkDoSimplex(simplex, size, direction)) return true;
+		}
+		return false;
+	}
+
+	// Expands the GJK tetrahedron to find the penetration normal and depth
+	inline bool Epa(const Collider* colliderA, const Entity* entityA, const Collider* colliderB, const Entity* entityB, const std::array<SupportPoint, 4>& simplex, CollisionInfo& collision) {
+		struct Face {
+			int a, b, c;
+			glm::dvec3 normal;
+			double distance;
+		};
+		std::vector<SupportPoint> vertices(simplex.begin(), simplex.end());
+		std::vector<Face> faces {};
+		std::vector<std::pair<int,int>> edges {};
+
+		auto addFace = [&vertices, &faces](int a, int b, int c) -> bool {
+			glm::dvec3 normal = glm::cross(vertices[b].v - vertices[a].v, vertices[c].v - vertices[a].v);
+			const double length = glm::length(normal);
+			if (length < DOUBLE_EPSILON) return false;
+			normal /= length;
+			double distance = glm::dot(normal, vertices[a].v);
+			if (distance < 0) {
+				std::swap(b, c);
+				normal = -normal;
+				distance = -distance;
+			}
+			faces.push_back({a, b, c, normal, distance});
+			return true;
+		};
+		if (!addFace(0,1,2) || !addFace(0,3,1) || !addFace(0,2,3) || !addFace(1,3,2)) return false;
+
+		for (int i = 0; i < NARROWPHASE_EPA_MAX_ITERATIONS; ++i) {
+			size_t closest = 0;
+			for (size_t f = 1; f < faces.size(); ++f) {
+				if (faces[f].distance < faces[closest].distance) closest = f;
+			}
+			const Face face = faces[closest];
+			const SupportPoint p = MinkowskiSupport(colliderA, entityA, colliderB, entityB, face.normal);
+
+			if (glm::dot(p.v, face.normal) - face.distance < NARROWPHASE_EPA_TOLERANCE || i == NARROWPHASE_EPA_MAX_ITERATIONS-1) {
+				// Project the origin on the closest face to interpolate the contact points on A and B
+				const glm::dvec3 point = face.normal * face.distance;
+				const glm::dvec3 v0 = vertices[face.b].v - vertices[face.a].v;
+				const glm::dvec3 v1 = vertices[face.c].v - vertices[face.a].v;
+				const glm::dvec3 v2 = point - vertices[face.a].v;
+				const double d00 = glm::dot(v0, v0), d01 = glm::dot(v0, v1), d11 = glm::dot(v1, v1), d20 = glm::dot(v2, v0), d21 = glm::dot(v2, v1);
+				const double denom = d00 * d11 - d01 * d01;
+				double v = 0, w = 0;
+				if (glm::abs(denom) > DOUBLE_EPSILON) {
+					v = (d11 * d20 - d01 * d21) / denom;
+					w = (d00 * d21 - d01 * d20) / denom;
+				}
+				const double u = 1.0 - v - w;
+				collision.normal = face.normal;
+				collision.penetration = float(face.distance);
+				collision.contactA = vertices[face.a].a * u + vertices[face.b].a * v + vertices[face.c].a * w;
+				collision.contactB = vertices[face.a].b * u + vertices[face.b].b * v + vertices[face.c].b * w;
+				return face.distance > 0;
+			}
+
+			// Remove all faces visible from the new point, keeping the edges of the hole
+			edges.clear();
+			const int index = int(vertices.size());
+			vertices.push_back(p);
+			for (size_t f = 0; f < faces.size();) {
+				if (glm::dot(faces[f].normal, p.v - vertices[faces[f].a].v) > 0) {
+					for (auto [e1, e2] : {std::pair{faces[f].a, faces[f].b}, std::pair{faces[f].b, faces[f].c}, std::pair{faces[f].c, faces[f].a}}) {
+						// An edge shared by two removed faces is not on the border of the hole
+						auto shared = std::find(edges.begin(), edges.end(), std::pair{e2, e1});
+						if (shared != edges.end()) {
+							*shared = edges.back();
+							edges.pop_back();
+						} else {
+							edges.emplace_back(e1, e2);
+						}
+					}
+					faces[f] = faces.back();
+					faces.pop_back();
+				} else {
+					++f;
+				}
+			}
+			for (auto [e1, e2] : edges) {
+				addFace(e1, e2, index);
+			}
+			if (faces.size() == 0) return false;
+		}
+		return false;
+	}
+
+	inline bool GjkEpa(const Collider* colliderA, const Entity* entityA, const Collider* colliderB, const Entity* entityB, CollisionInfo& collision) {
+		std::array<SupportPoint, 4> simplex;
+		if (!Gjk(colliderA, entityA, colliderB, entityB, simplex)) return false;
+		return Epa(colliderA, entityA, colliderB, entityB, simplex, collision);
+	}
+
+	#pragma endregion
+
+	#pragma region Closed-form generators
+
+	inline bool SphereVsSphere(const Collider* colliderA, const Entity* entityA, const Collider* colliderB, const Entity* entityB, CollisionInfo& collision) {
+		const auto* a = (const SphereCollider*)colliderA;
+		const auto* b = (const SphereCollider*)colliderB;
+		return SphereSphere(a->GetWorldPosition(entityA), a->radius, b->GetWorldPosition(entityB), b->radius, collision);
+	}
+
+	inline bool SphereVsBox(const Collider* colliderA, const Entity* entityA, const Collider* colliderB, const Entity* entityB, CollisionInfo& collision) {
+		const auto* sphere = (const SphereCollider*)colliderA;
+		const auto* box = (const BoxCollider*)colliderB;
+		const glm::dvec3 spherePosition = sphere->GetWorldPosition(entityA);
+		const glm::dvec3 boxPosition = box->GetWorldPosition(entityB);
+		const glm::dmat3 boxRotation = box->GetWorldRotation(entityB);
+		const glm::dvec3 halfSize = box->halfSize;
+		const glm::dvec3 local = glm::transpose(boxRotation) * (spherePosition - boxPosition);
+		glm::dvec3 closest = glm::clamp(local, -halfSize, halfSize);
+
+		if (closest == local) {
+			// Sphere center is inside the box, push it out through the nearest face
+			const glm::dvec3 faceDistance = halfSize - glm::abs(local);
+			int axis = 0;
+			if (faceDistance.y < faceDistance[axis]) axis = 1;
+			if (faceDistance.z < faceDistance[axis]) axis = 2;
+			glm::dvec3 faceNormal {0};
+			faceNormal[axis] = local[axis] < 0 ? -1.0 : 1.0;
+			closest[axis] = faceNormal[axis] * halfSize[axis];
+			const glm::dvec3 normal = -(boxRotation * faceNormal);
+			collision.normal = normal;
+			collision.penetration = float(sphere->radius + faceDistance[axis]);
+			collision.contactA = spherePosition + normal * double(sphere->radius);
+			collision.contactB = boxPosition + boxRotation * closest;
+			return true;
+		}
+
+		const glm::dvec3 diff = local - closest;
+		const double distSqr = glm::dot(diff, diff);
+		if (distSqr >= double(sphere->radius) * double(sphere->radius)) return false;
+		const double dist = glm::sqrt(distSqr);
+		const glm::dvec3 normal = -(boxRotation * (diff / dist));
+		collision.normal = normal;
+		collision.penetration = float(sphere->radius - dist);
+		collision.contactA = spherePosition + normal * double(sphere->radius);
+		collision.contactB = boxPosition + boxRotation * closest;
+		return true;
+	}
+
+	inline bool SphereVsCapsule(const Collider* colliderA, const Entity* entityA, const Collider* colliderB, const Entity* entityB, CollisionInfo& collision) {
+		const auto* sphere = (const SphereCollider*)colliderA;
+		const auto* capsule = (const CapsuleCollider*)colliderB;
+		const glm::dvec3 spherePosition = sphere->GetWorldPosition(entityA);
+		glm::dvec3 p, q;
+		GetCapsuleSegment(capsule, entityB, p, q);
+		return SphereSphere(spherePosition, sphere->radius, ClosestPointOnSegment(spherePosition, p, q), capsule->radius, collision);
+	}
+
+	inline bool CapsuleVsCapsule(const Collider* colliderA, const Entity* entityA, const Collider* colliderB, const Entity* entityB, CollisionInfo& collision) {
+		const auto* a = (const CapsuleCollider*)colliderA;
+		const auto* b = (const CapsuleCollider*)colliderB;
+		glm::dvec3 p1, q1, p2, q2, c1, c2;
+		GetCapsuleSegment(a, entityA, p1, q1);
+		GetCapsuleSegment(b, entityB, p2, q2);
+		ClosestPointsBetweenSegments(p1, q1, p2, q2, c1, c2);
+		return SphereSphere(c1, a->radius, c2, b->radius, collision);
+	}
+
+	// Separating Axis Theorem on the 15 candidate axes, single contact point
+	inline bool BoxVsBox(const Collider* colliderA, const Entity* entityA, const Collider* colliderB, const Entity* entityB, CollisionInfo& collision) {
+		const auto* boxA = (const BoxCollider*)colliderA;
+		const auto* boxB = (const BoxCollider*)colliderB;
+		const glm::dvec3 positionA = boxA->GetWorldPosition(entityA);
+		const glm::dvec3 positionB = boxB->GetWorldPosition(entityB);
+		const glm::dmat3 rotationA = boxA->GetWorldRotation(entityA);
+		const glm::dmat3 rotationB = boxB->GetWorldRotation(entityB);
+		const glm::dvec3 halfSizeA = boxA->halfSize;
+		const glm::dvec3 halfSizeB = boxB->halfSize;
+		const glm::dvec3 d = positionB - positionA;
+
+		auto projectedRadius = [](const glm::dmat3& rotation, const glm::dvec3& halfSize, const glm::dvec3& axis){
+			return halfSize.x * glm::abs(glm::dot(rotation[0], axis))
+				 + halfSize.y * glm::abs(glm::dot(rotation[1], axis))
+				 + halfSize.z * glm::abs(glm::dot(rotation[2], axis));
+		};
+
+		double minOverlap = std::numeric_limits<double>::max();
+		glm::dvec3 bestAxis {0};
+		int bestAxisIndex = -1;
+		auto testAxis = [&](glm::dvec3 axis, int index) -> bool {
+			const double length = glm::length(axis);
+			if (length < 1e-6) return true; // parallel edges, axis already covered by face axes
+			axis /= length;
+			const double overlap = projectedRadius(rotationA, halfSizeA, axis) + projectedRadius(rotationB, halfSizeB, axis) - glm::abs(glm::dot(d, axis));
+			if (overlap <= 0) return false;
+			// Slightly favor face axes over edge axes for stability
+			if (overlap < minOverlap * (index < 6 ? 1.0 : 0.95)) {
+				minOverlap = overlap;
+				bestAxis = glm::dot(d, axis) < 0 ? -axis : axis;
+				bestAxisIndex = index;
+			}
+			return true;
+		};
+
+		for (int i = 0; i < 3; ++i) if (!testAxis(rotationA[i], i)) return false;
+		for (int i = 0; i < 3; ++i) if (!testAxis(rotationB[i], 3 + i)) return false;
+		for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) {
+			if (!testAxis(glm::cross(rotationA[i], rotationB[j]), 6 + i*3 + j)) return false;
+		}
+
+		const glm::dvec3 normal = bestAxis;
+		collision.normal = normal;
+		collision.penetration = float(minOverlap);
+		if (bestAxisIndex < 3) {
+			// Face of A, deepest vertex of B
+			collision.contactB = boxB->Support(entityB, -normal);
+			collision.contactA = collision.contactB + normal * minOverlap;
+		} else if (bestAxisIndex < 6) {
+			// Face of B, deepest vertex of A
+			collision.contactA = boxA->Support(entityA, normal);
+			collision.contactB = collision.contactA - normal * minOverlap;
+		} else {
+			// Edge-Edge, closest points between the two supporting edges
+			const int i = (bestAxisIndex - 6) / 3;
+			const int j = (bestAxisIndex - 6) % 3;
+			glm::dvec3 edgeCenterA = positionA;
+			glm::dvec3 edgeCenterB = positionB;
+			for (int k = 0; k < 3; ++k) {
+				if (k != i) edgeCenterA += rotationA[k] * (halfSizeA[k] * (glm::dot(rotationA[k], normal) > 0 ? 1.0 : -1.0));
+				if (k != j) edgeCenterB += rotationB[k] * (halfSizeB[k] * (glm::dot(rotationB[k], normal) < 0 ? 1.0 : -1.0));
+			}
+			ClosestPointsBetweenSegments(
+				edgeCenterA - rotationA[i] * halfSizeA[i], edgeCenterA + rotationA[i] * halfSizeA[i],
+				edgeCenterB - rotationB[j] * halfSizeB[j], edgeCenterB + rotationB[j] * halfSizeB[j],
+				collision.contactA, collision.contactB
+			);
+		}
+		return true;
+	}
+
+	#pragma endregion
+
+	#pragma region Compound colliders
+
+	inline ContactGenerator GetContactGenerator(ColliderType a, ColliderType b);
+
+	// Bounds of a collider in the space of the entity of a compound collider, from its support points along the axes of that entity
+	inline CompoundCollider::Bounds GetBoundsInEntitySpace(const Collider* collider, const Entity* entity, const Entity* compoundEntity) {
+		const glm::dmat3 rotation = glm::mat3_cast(compoundEntity->orientation);
+		CompoundCollider::Bounds bounds;
+		for (int i = 0; i < 3; ++i) {
+			bounds.min[i] = glm::dot(collider->Support(entity, -rotation[i]) - compoundEntity->position, rotation[i]);
+			bounds.max[i] = glm::dot(collider->Support(entity, rotation[i]) - compoundEntity->position, rotation[i]);
+		}
+		return bounds;
+	}
+
+	// Only the children of the compound near the other collider are tested, the deepest contact is kept
+	inline bool CompoundVsAny(const Collider* colliderA, const Entity* entityA, const Collider* colliderB, const Entity* entityB, CollisionInfo& collision) {
+		const auto* compound = (const CompoundCollider*)colliderA;
+		bool collided = false;
+		CollisionInfo childCollision;
+		compound->ForEachOverlapping(GetBoundsInEntitySpace(colliderB, entityB, entityA), [&](const Collider* child){
+			if (auto contactGenerator = GetContactGenerator(child->GetType(), colliderB->GetType()); contactGenerator) {
+				if (contactGenerator(child, entityA, colliderB, entityB, childCollision)) {
+					if (!collided || childCollision.penetration > collision.penetration) collision = childCollision;
+					collided = true;
+				}
+			}
+		});
+		return collided;
+	}
+
+	// Children of B near the bounds of A, each against the children of A near it
+	inline bool CompoundVsCompound(const Collider* colliderA, const Entity* entityA, const Collider* colliderB, const Entity* entityB, CollisionInfo& collision) {
+		const auto* compoundA = (const CompoundCollider*)colliderA;
+		const auto* compoundB = (const CompoundCollider*)colliderB;
+		const CompoundCollider::Bounds boundsA = compoundA->GetBounds();
+		const glm::dmat3 rotationA = glm::mat3_cast(entityA->orientation);
+		const glm::dmat3 toB = glm::transpose(glm::mat3_cast(entityB->orientation));
+		CompoundCollider::Bounds boundsAInB {glm::dvec3(std::numeric_limits<double>::max()), glm::dvec3(std::numeric_limits<double>::lowest())};
+		for (int i = 0; i < 8; ++i) {
+			const glm::dvec3 corner {i&1? boundsA.max.x : boundsA.min.x, i&2? boundsA.max.y : boundsA.min.y, i&4? boundsA.max.z : boundsA.min.z};
+			const glm::dvec3 cornerInB = toB * (entityA->position + rotationA * corner - entityB->position);
+			boundsAInB.min = glm::min(boundsAInB.min, cornerInB);
+			boundsAInB.max = glm::max(boundsAInB.max, cornerInB);
+		}
+		bool collided = false;
+		CollisionInfo childCollision;
+		compoundB->ForEachOverlapping(boundsAInB, [&](const Collider* childB){
+			if (CompoundVsAny(compoundA, entityA, childB, entityB, childCollision)) {
+				if (!collided || childCollision.penetration > collision.penetration) collision = childCollision;
+				collided = true;
+			}
+		});
+		return collided;
+	}
+
+	#pragma endregion
+
+	#pragma region Dispatch
+
+	template<ContactGenerator generator>
+	inline bool Flipped(const Collider* colliderA, const Entity* entityA, const Collider* colliderB, const Entity* entityB, CollisionInfo& collision) {
+		if (generator(colliderB, entityB, colliderA, entityA, collision)) {
+			FlipCollision(collision);
+			return true;
+		}
+		return false;
+	}
+
+	using DispatchTable = std::array<std::array<ContactGenerator, size_t(ColliderType::COUNT)>, size_t(ColliderType::COUNT)>;
+
+	inline const DispatchTable& GetDispatchTable() {
+		static const DispatchTable table = []{
+			DispatchTable t {};
+			constexpr ColliderType convex[] {ColliderType::Sphere, ColliderType::Box, ColliderType::Capsule, ColliderType::Cylinder, ColliderType::Cone, ColliderType::Triangle, ColliderType::Wedge};
+			for (auto a : convex) for (auto b : convex) {
+				t[size_t(a)][size_t(b)] = GjkEpa;
+			}
+			// Compound colliders dispatch each of their children near the other collider
+			for (auto a : convex) {
+				t[size_t(ColliderType::Compound)][size_t(a)] = CompoundVsAny;
+				t[size_t(a)][size_t(ColliderType::Compound)] = Flipped<CompoundVsAny>;
+			}
+			t[size_t(ColliderType::Compound)][size_t(ColliderType::Compound)] = CompoundVsCompound;
+			// Two flat triangles have no volume for EPA to expand, and rings are not convex; those pairs fall back to collision rays
+			t[size_t(ColliderType::Triangle)][size_t(ColliderType::Triangle)] = nullptr;
+			t[size_t(ColliderType::Sphere)][size_t(ColliderType::Sphere)] = SphereVsSphere;
+			t[size_t(ColliderType::Sphere)][size_t(ColliderType::Box)] = SphereVsBox;
+			t[size_t(ColliderType::Box)][size_t(ColliderType::Sphere)] = Flipped<SphereVsBox>;
+			t[size_t(ColliderType::Sphere)][size_t(ColliderType::Capsule)] = SphereVsCapsule;
+			t[size_t(ColliderType::Capsule)][size_t(ColliderType::Sphere)] = Flipped<SphereVsCapsule>;
+			t[size_t(ColliderType::Capsule)][size_t(ColliderType::Capsule)] = CapsuleVsCapsule;
+			t[size_t(ColliderType::Box)][size_t(ColliderType::Box)] = BoxVsBox;
+			return t;
+		}();
+		return table;
+	}
+
+	// Returns nullptr when there is no contact generator for this pair, in which case collision rays should be used
+	inline ContactGenerator GetContactGenerator(ColliderType a, ColliderType b) {
+		return GetDispatchTable()[size_t(a)][size_t(b)];
+	}
+
+	#pragma endregion
+}
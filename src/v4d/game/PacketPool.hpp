@@ -0,0 +1,247 @@
+#pragma once
+
+#include <v4d.h>
+#include "utilities/io/Logger.h"
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#define PACKET_POOL_MAX_SLABS 4096 // a pool never grows beyond this many slabs of packets
+
+// Slab allocator of reusable packet buffers, handed out as reference-counted handles.
+// A packet goes back to the free list of its pool when its last handle is dropped, with its buffer cleared but not deallocated, so that a steady flow of packets does not allocate anything.
+// The free list is lock-free, a lock is only taken to allocate a new slab.
+// Buffer must be constructible from an initial capacity and have a ClearWriteBuffer() method (like v4d::data::WriteOnlyStream).
+// The pool must outlive all of its handles.
+template<typename Buffer>
+class PacketPool {
+	static constexpr uint32_t NO_PACKET = ~uint32_t(0);
+
+	struct Packet {
+		Buffer buffer;
+		std::atomic<uint32_t> references {0};
+		PacketPool* pool;
+		const uint32_t index; // in the pool, across all slabs
+		std::atomic<uint32_t> nextFree {NO_PACKET}; // may be read by a pop that is about to fail while the packet is in use
+		Packet(PacketPool* pool, size_t capacity, uint32_t index) : buffer(capacity), pool(pool), index(index) {}
+	};
+
+public:
+	// Same packet, shared by all copies of the handle, without copying its buffer
+	class Ref {
+		Packet* packet = nullptr;
+		void Release() {
+			if (packet && --packet->references == 0) packet->pool->Recycle(packet);
+			packet = nullptr;
+		}
+		explicit Ref(Packet* packet) : packet(packet) {
+			++packet->references;
+		}
+		friend class PacketPool;
+	public:
+		Ref() = default;
+		Ref(const Ref& other) : packet(other.packet) {
+			if (packet) ++packet->references;
+		}
+		Ref(Ref&& other) : packet(other.packet) {
+			other.packet = nullptr;
+		}
+		Ref& operator=(const Ref& other) {
+			if (other.packet) ++other.packet->references;
+			Release();
+			packet = other.packet;
+			return *this;
+		}
+		Ref& operator=(Ref&& other) {
+			if (this != &other) {
+				Release();
+				packet = other.packet;
+				other.packet = nullptr;
+			}
+			return *this;
+		}
+		~Ref() {
+			Release();
+		}
+		Buffer& operator*() const {return packet->buffer;}
+		Buffer* operator->() const {return &packet->buffer;}
+		operator bool() const {return packet != nullptr;}
+		uint32_t UseCount() const {return packet? packet->references.load() : 0;}
+	};
+
+	struct Stats {
+		std::atomic<uint64_t> acquired {0};
+		std::atomic<uint64_t> recycled {0};
+		std::atomic<uint64_t> slabAllocations {0}; // the only time the pool allocates memory
+		std::atomic<uint64_t> packets {0}; // total number of packets in all slabs
+	};
+
+private:
+	const size_t bufferCapacity;
+	const size_t slabSize;
+	std::mutex slabMutex; // only locked to allocate a new slab
+	std::array<std::unique_ptr<std::deque<Packet>>, PACKET_POOL_MAX_SLABS> slabs {}; // a slab is never modified once its packets are in the free list
+	uint32_t slabCount = 0;
+	// Index of the first free packet in the low 32 bits, and a counter in the high 32 bits that changes on every push and pop,
+	// so that a pop cannot succeed with a head that was popped and pushed back by another thread in the meantime (ABA)
+	std::atomic<uint64_t> freeHead {NO_PACKET};
+	Stats stats {};
+
+	static uint64_t Head(uint32_t index, uint64_t previousHead) {
+		return ((previousHead >> 32) + 1) << 32 | index;
+	}
+
+	Packet& GetPacket(uint32_t index) const {
+		return (*slabs[index / slabSize])[index % slabSize];
+	}
+
+	// Pushes a chain of packets linked by nextFree, from first to last
+	void PushFree(Packet& first, Packet& last) {
+		uint64_t head = freeHead.load(std::memory_order_relaxed);
+		do {
+			last.nextFree.store(uint32_t(head), std::memory_order_relaxed);
+		} while (!freeHead.compare_exchange_weak(head, Head(first.index, head), std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	Packet* PopFree() {
+		uint64_t head = freeHead.load(std::memory_order_acquire);
+		for (;;) {
+			const uint32_t index = uint32_t(head);
+			if (index == NO_PACKET) return nullptr;
+			Packet& packet = GetPacket(index);
+			const uint32_t next = packet.nextFree.load(std::memory_order_relaxed);
+			if (freeHead.compare_exchange_weak(head, Head(next, head), std::memory_order_acquire, std::memory_order_acquire)) return &packet;
+		}
+	}
+
+	void Recycle(Packet* packet) {
+		packet->buffer.ClearWriteBuffer();
+		++stats.recycled;
+		PushFree(*packet, *packet);
+	}
+
+	void AllocateSlab() {
+		std::lock_guard lock(slabMutex);
+		// Another thread may have allocated one while this one was waiting for the lock
+		if (uint32_t(freeHead.load(std::memory_order_acquire)) != NO_PACKET) return;
+		if (slabCount == PACKET_POOL_MAX_SLABS) throw std::bad_alloc();
+		auto slab = std::make_unique<std::deque<Packet>>();
+		const uint32_t firstIndex = uint32_t(slabCount * slabSize);
+		for (size_t i = 0; i < slabSize; ++i) {
+			Packet& packet = slab->emplace_back(this, bufferCapacity, uint32_t(firstIndex + i));
+			if (i > 0) (*slab)[i - 1].nextFree.store(packet.index, std::memory_order_relaxed);
+		}
+		Packet& first = slab->front();
+		Packet& last = slab->back();
+		slabs[slabCount++] = std::move(slab);
+		PushFree(first, last);
+		++stats.slabAllocations;
+		stats.packets += slabSize;
+	}
+
+public:
+	PacketPool(size_t bufferCapacity, size_t slabSize = 64) : bufferCapacity(bufferCapacity), slabSize(std::max<size_t>(1, slabSize)) {}
+
+	~PacketPool() {
+		DEBUG_ASSERT_WARN(stats.acquired == stats.recycled, "PacketPool destroyed while " << (stats.acquired - stats.recycled) << " packets are still referenced")
+	}
+
+	PacketPool(const PacketPool&) = delete;
+	PacketPool& operator=(const PacketPool&) = delete;
+
+	// Returns an empty packet, allocating a new slab of packets only when all of them are in use
+	Ref Acquire() {
+		++stats.acquired;
+		Packet* packet;
+		while (!(packet = PopFree())) AllocateSlab();
+		return Ref(packet);
+	}
+
+	const Stats& GetStats() const {return stats;}
+};
+
+// Per-client queues of packets waiting to be sent.
+// Each client has its own lock, only adding or removing a client locks the whole map, so that clients never wait for each other's sender.
+template<typename Buffer>
+class PacketQueues {
+	using Ref = typename PacketPool<Buffer>::Ref;
+	struct Queue {
+		std::mutex mu;
+		std::vector<Ref> pending {};
+		std::vector<Ref> sending {}; // only used by the sender of this client, keeps its capacity between sends
+	};
+	mutable std::shared_mutex mapMutex;
+	std::unordered_map<uint64_t /* clientID */, std::shared_ptr<Queue>> queues {};
+
+	std::shared_ptr<Queue> Get(uint64_t clientId) const {
+		std::shared_lock lock(mapMutex);
+		if (auto it = queues.find(clientId); it != queues.end()) return it->second;
+		return nullptr;
+	}
+
+	std::shared_ptr<Queue> GetOrCreate(uint64_t clientId) {
+		if (auto queue = Get(clientId); queue) return queue;
+		std::unique_lock lock(mapMutex);
+		auto& queue = queues[clientId];
+		if (!queue) queue = std::make_shared<Queue>();
+		return queue;
+	}
+
+public:
+	// The same packet may be pushed to several clients, they all share it
+	void Push(uint64_t clientId, const Ref& packet) {
+		auto queue = GetOrCreate(clientId);
+		std::lock_guard lock(queue->mu);
+		queue->pending.push_back(packet);
+	}
+
+	// Calls func(Buffer&) for each packet queued for the client, in order, without holding any lock while it runs.
+	// Must not be called concurrently for the same client.
+	template<typename F>
+	void Drain(uint64_t clientId, F&& func) {
+		auto queue = Get(clientId);
+		if (!queue) return;
+		{std::lock_guard lock(queue->mu);
+			if (queue->pending.empty()) return;
+			queue->sending.swap(queue->pending);
+		}
+		for (auto& packet : queue->sending) func(*packet);
+		queue->sending.clear();
+	}
+
+	size_t Size(uint64_t clientId) const {
+		auto queue = Get(clientId);
+		if (!queue) return 0;
+		std::lock_guard lock(queue->mu);
+		return queue->pending.size();
+	}
+
+	// Forgets the queues of the clients for which pred(clientId) returns true
+	template<typename F>
+	void EraseIf(F&& pred) {
+		std::unique_lock lock(mapMutex);
+		for (auto it = queues.begin(); it != queues.end(); ) {
+			if (pred(it->first)) {
+				it = queues.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+	
+	void Erase(uint64_t clientId) {
+		std::unique_lock lock(mapMutex);
+		queues.erase(clientId);
+	}
+
+	void Clear() {
+		std::unique_lock lock(mapMutex);
+		queues.clear();
+	}
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <v4d.h>
+#include "physics.hh"
 
 struct Rigidbody {
 	// Initial information
@@ -18,7 +19,8 @@ struct Rigidbody {
 	glm::dvec3 linearAcceleration {0,0,0};
 	glm::dvec3 linearVelocity {0,0,0};
 	glm::dvec3 position {0,0,0};
-	bool atRest = false;
+	bool atRest = false; // sleeping, not integrated nor tested against other sleeping bodies until woken up by a contact or an impulse
+	double sleepTimer = 0; // seconds spent below sleep thresholds
 	
 	// Angular physics
 	glm::dmat3 invInertiaTensorWorld;
@@ -49,6 +51,21 @@ struct Rigidbody {
 	inline bool IsOrientationLocked() const {
 		return isOrientationLocked;
 	}
+	inline bool IsSleeping() const {
+		return atRest;
+	}
+	inline void Sleep() {
+		atRest = true;
+		linearVelocity = {0,0,0};
+		angularVelocity = {0,0,0};
+		linearAcceleration = {0,0,0};
+		angularAcceleration = {0,0,0};
+	}
+	// The sleep timer starts over, otherwise a body woken up by an impulse would go back to sleep on the next sleep pass
+	inline void Wake() {
+		atRest = false;
+		sleepTimer = 0;
+	}
 	
 	#pragma region Constructor
 	Rigidbody(float mass, glm::vec3 localInertiaVector = glm::vec3{1})
@@ -154,18 +171,25 @@ struct Rigidbody {
 		if (!isOrientationLocked && (point.x != 0 || point.y != 0 || point.z != 0)) {
 			this->torque += glm::cross(point, force);
 		}
-		this->atRest = false;
+		if (this->atRest) Wake();
 	}
 	void ApplyAcceleration(glm::dvec3 acceleration) {
 		this->linearAcceleration += acceleration;
-		this->atRest = false;
+		if (this->atRest) Wake();
 	}
+	// A sleeping body ignores impulses that would not bring it above the sleep thresholds, such as the ones from the contacts it is resting on
 	void ApplyImpulse(glm::dvec3 impulse, glm::dvec3 point = {0,0,0}) {
-		this->linearVelocity += this->invMass * impulse;
+		const glm::dvec3 linearVelocityChange = this->invMass * impulse;
+		glm::dvec3 angularVelocityChange {0,0,0};
 		if (!isOrientationLocked && (point.x != 0 || point.y != 0 || point.z != 0)) {
-			this->angularVelocity += this->invInertiaTensorWorld * glm::cross(point, impulse);
+			angularVelocityChange = this->invInertiaTensorWorld * glm::cross(point, impulse);
+		}
+		if (this->atRest) {
+			if (glm::length(linearVelocityChange) < PHYSICS_SLEEP_SPEED_THRESHOLD && glm::length(angularVelocityChange) < PHYSICS_SLEEP_ANGULAR_SPEED_THRESHOLD) return;
+			Wake();
 		}
-		this->atRest = false;
+		this->linearVelocity += linearVelocityChange;
+		this->angularVelocity += angularVelocityChange;
 	}
 	#pragma endregion
 };
@@ -0,0 +1,315 @@
+#pragma once
+
+#include <v4d.h>
+#include <vector>
+#include <array>
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+#elif defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+
+#include "Rigidbody.hpp"
+
+// Structure-of-arrays copy of the simulation state of rigidbodies, integrated in batches with SIMD (SSE2 on any x86-64 CPU, AVX when compiled with ENABLE_AVX).
+// Rigidbody remains the state used by modules and collision responses, which lock it from other threads. Physics gathers bodies into the pool in the pass that updates their sleep timers,
+// and scatters them back in the pass that updates their entity, so that integration does not add any pass over the entities.
+// Handles are stable for the lifetime of a body, while the arrays themselves stay densely packed (removing a body moves the last one in its place).
+class RigidbodyPool {
+public:
+	struct Handle {
+		uint32_t index = 0;
+		uint32_t generation = 0; // generation 0 is never valid
+		inline bool IsValid() const {return generation != 0;}
+	};
+
+	enum Field {
+		POSITION_X, POSITION_Y, POSITION_Z,
+		VELOCITY_X, VELOCITY_Y, VELOCITY_Z,
+		ACCELERATION_X, ACCELERATION_Y, ACCELERATION_Z,
+		FORCE_X, FORCE_Y, FORCE_Z,
+		INV_MASS,
+		ORIENTATION_W, ORIENTATION_X, ORIENTATION_Y, ORIENTATION_Z,
+		ANGULAR_VELOCITY_X, ANGULAR_VELOCITY_Y, ANGULAR_VELOCITY_Z,
+		ANGULAR_ACCELERATION_X, ANGULAR_ACCELERATION_Y, ANGULAR_ACCELERATION_Z,
+		TORQUE_X, TORQUE_Y, TORQUE_Z,
+		INV_INERTIA_00, INV_INERTIA_01, INV_INERTIA_02, // column-major, same as glm::dmat3
+		INV_INERTIA_10, INV_INERTIA_11, INV_INERTIA_12,
+		INV_INERTIA_20, INV_INERTIA_21, INV_INERTIA_22,
+		LINEAR_MASK, // 1.0 when the body must be integrated, 0.0 when sleeping or kinematic
+		ANGULAR_MASK, // 1.0 when the body must be rotated, 0.0 when sleeping, kinematic or with a locked orientation
+		FIELD_COUNT
+	};
+
+private:
+	std::array<std::vector<double>, FIELD_COUNT> fields {};
+	std::vector<uint32_t> denseToSlot {};
+	std::vector<uint32_t> slotToDense {};
+	std::vector<uint32_t> slotGenerations {};
+	std::vector<bool> slotMarks {};
+	std::vector<uint32_t> freeSlots {};
+
+	#pragma region SIMD lanes
+		// Minimal wrappers so that the integration kernel is written once for both the vectorized body and the scalar remainder
+		struct Scalar {
+			static constexpr size_t SIZE = 1;
+			double v;
+			static inline Scalar Load(const double* p) {return {*p};}
+			static inline Scalar Set(double x) {return {x};}
+			inline void Store(double* p) const {*p = v;}
+			inline Scalar operator+(const Scalar& o) const {return {v + o.v};}
+			inline Scalar operator-(const Scalar& o) const {return {v - o.v};}
+			inline Scalar operator*(const Scalar& o) const {return {v * o.v};}
+			inline Scalar operator/(const Scalar& o) const {return {v / o.v};}
+			inline Scalar operator-() const {return {-v};}
+			static inline Scalar Sqrt(const Scalar& x) {return {std::sqrt(x.v)};}
+		};
+		#if defined(__AVX__)
+			struct Wide {
+				static constexpr size_t SIZE = 4;
+				__m256d v;
+				static inline Wide Load(const double* p) {return {_mm256_loadu_pd(p)};}
+				static inline Wide Set(double x) {return {_mm256_set1_pd(x)};}
+				inline void Store(double* p) const {_mm256_storeu_pd(p, v);}
+				inline Wide operator+(const Wide& o) const {return {_mm256_add_pd(v, o.v)};}
+				inline Wide operator-(const Wide& o) const {return {_mm256_sub_pd(v, o.v)};}
+				inline Wide operator*(const Wide& o) const {return {_mm256_mul_pd(v, o.v)};}
+				inline Wide operator/(const Wide& o) const {return {_mm256_div_pd(v, o.v)};}
+				inline Wide operator-() const {return {_mm256_sub_pd(_mm256_setzero_pd(), v)};}
+				static inline Wide Sqrt(const Wide& x) {return {_mm256_sqrt_pd(x.v)};}
+			};
+		#elif defined(__SSE2__)
+			struct Wide {
+				static constexpr size_t SIZE = 2;
+				__m128d v;
+				static inline Wide Load(const double* p) {return {_mm_loadu_pd(p)};}
+				static inline Wide Set(double x) {return {_mm_set1_pd(x)};}
+				inline void Store(double* p) const {_mm_storeu_pd(p, v);}
+				inline Wide operator+(const Wide& o) const {return {_mm_add_pd(v, o.v)};}
+				inline Wide operator-(const Wide& o) const {return {_mm_sub_pd(v, o.v)};}
+				inline Wide operator*(const Wide& o) const {return {_mm_mul_pd(v, o.v)};}
+				inline Wide operator/(const Wide& o) const {return {_mm_div_pd(v, o.v)};}
+				inline Wide operator-() const {return {_mm_sub_pd(_mm_setzero_pd(), v)};}
+				static inline Wide Sqrt(const Wide& x) {return {_mm_sqrt_pd(x.v)};}
+			};
+		#else
+			using Wide = Scalar;
+		#endif
+	#pragma endregion
+
+	// Semi-implicit Euler on bodies [i, i+V::SIZE), same equations as the original per-entity loop
+	template<typename V>
+	inline void IntegrateLanes(size_t i, const V& dt, const V& halfDt) {
+		#define FIELD(f) V::Load(&fields[f][i])
+		const V linearMask = FIELD(LINEAR_MASK);
+		const V angularMask = FIELD(ANGULAR_MASK);
+		const V invMass = FIELD(INV_MASS);
+
+		{// Linear
+			const V dtMasked = dt * linearMask;
+			const V ax = FIELD(ACCELERATION_X) + invMass * FIELD(FORCE_X);
+			const V ay = FIELD(ACCELERATION_Y) + invMass * FIELD(FORCE_Y);
+			const V az = FIELD(ACCELERATION_Z) + invMass * FIELD(FORCE_Z);
+			const V vx = FIELD(VELOCITY_X) + ax * dtMasked;
+			const V vy = FIELD(VELOCITY_Y) + ay * dtMasked;
+			const V vz = FIELD(VELOCITY_Z) + az * dtMasked;
+			(FIELD(POSITION_X) + vx * dtMasked).Store(&fields[POSITION_X][i]);
+			(FIELD(POSITION_Y) + vy * dtMasked).Store(&fields[POSITION_Y][i]);
+			(FIELD(POSITION_Z) + vz * dtMasked).Store(&fields[POSITION_Z][i]);
+			vx.Store(&fields[VELOCITY_X][i]);
+			vy.Store(&fields[VELOCITY_Y][i]);
+			vz.Store(&fields[VELOCITY_Z][i]);
+			ax.Store(&fields[ACCELERATION_X][i]);
+			ay.Store(&fields[ACCELERATION_Y][i]);
+			az.Store(&fields[ACCELERATION_Z][i]);
+		}
+
+		{// Angular
+			const V dtMasked = dt * angularMask;
+			const V tx = FIELD(TORQUE_X), ty = FIELD(TORQUE_Y), tz = FIELD(TORQUE_Z);
+			const V ax = FIELD(ANGULAR_ACCELERATION_X) + FIELD(INV_INERTIA_00) * tx + FIELD(INV_INERTIA_10) * ty + FIELD(INV_INERTIA_20) * tz;
+			const V ay = FIELD(ANGULAR_ACCELERATION_Y) + FIELD(INV_INERTIA_01) * tx + FIELD(INV_INERTIA_11) * ty + FIELD(INV_INERTIA_21) * tz;
+			const V az = FIELD(ANGULAR_ACCELERATION_Z) + FIELD(INV_INERTIA_02) * tx + FIELD(INV_INERTIA_12) * ty + FIELD(INV_INERTIA_22) * tz;
+			const V wx = FIELD(ANGULAR_VELOCITY_X) + ax * dtMasked;
+			const V wy = FIELD(ANGULAR_VELOCITY_Y) + ay * dtMasked;
+			const V wz = FIELD(ANGULAR_VELOCITY_Z) + az * dtMasked;
+			// q = normalize(q + quat(0, w * dt/2) * q)
+			const V qw = FIELD(ORIENTATION_W), qx = FIELD(ORIENTATION_X), qy = FIELD(ORIENTATION_Y), qz = FIELD(ORIENTATION_Z);
+			const V h = halfDt * angularMask;
+			const V hx = wx * h, hy = wy * h, hz = wz * h;
+			const V rw = qw - hx * qx - hy * qy - hz * qz;
+			const V rx = qx + hx * qw + hy * qz - hz * qy;
+			const V ry = qy - hx * qz + hy * qw + hz * qx;
+			const V rz = qz + hx * qy - hy * qx + hz * qw;
+			const V invLength = V::Set(1.0) / V::Sqrt(rw*rw + rx*rx + ry*ry + rz*rz);
+			(rw * invLength).Store(&fields[ORIENTATION_W][i]);
+			(rx * invLength).Store(&fields[ORIENTATION_X][i]);
+			(ry * invLength).Store(&fields[ORIENTATION_Y][i]);
+			(rz * invLength).Store(&fields[ORIENTATION_Z][i]);
+			wx.Store(&fields[ANGULAR_VELOCITY_X][i]);
+			wy.Store(&fields[ANGULAR_VELOCITY_Y][i]);
+			wz.Store(&fields[ANGULAR_VELOCITY_Z][i]);
+			ax.Store(&fields[ANGULAR_ACCELERATION_X][i]);
+			ay.Store(&fields[ANGULAR_ACCELERATION_Y][i]);
+			az.Store(&fields[ANGULAR_ACCELERATION_Z][i]);
+		}
+		#undef FIELD
+	}
+
+public:
+	#if defined(__AVX__)
+		static constexpr const char* SIMD_INSTRUCTIONS = "AVX (4 doubles)";
+	#elif defined(__SSE2__)
+		static constexpr const char* SIMD_INSTRUCTIONS = "SSE2 (2 doubles)";
+	#else
+		static constexpr const char* SIMD_INSTRUCTIONS = "none";
+	#endif
+
+	// False when compiled with ENABLE_AVX but running on a CPU without AVX, SSE2 is part of x86-64 itself
+	static bool IsSupportedByCpu() {
+		#if defined(__AVX__) && (defined(__GNUC__) || defined(__clang__))
+			return __builtin_cpu_supports("avx");
+		#else
+			return true;
+		#endif
+	}
+
+	size_t Count() const {
+		return denseToSlot.size();
+	}
+
+	inline bool IsAlive(const Handle& handle) const {
+		return handle.generation != 0 && handle.index < slotGenerations.size() && slotGenerations[handle.index] == handle.generation;
+	}
+
+	const double* GetField(Field field) const {
+		return fields[field].data();
+	}
+
+	Handle Create() {
+		uint32_t slot;
+		if (freeSlots.size() > 0) {
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		} else {
+			slot = uint32_t(slotGenerations.size());
+			slotGenerations.push_back(0);
+			slotToDense.push_back(0);
+			slotMarks.push_back(false);
+		}
+		if (++slotGenerations[slot] == 0) ++slotGenerations[slot];
+		slotToDense[slot] = uint32_t(denseToSlot.size());
+		denseToSlot.push_back(slot);
+		for (auto& field : fields) field.push_back(0);
+		fields[ORIENTATION_W].back() = 1;
+		return {slot, slotGenerations[slot]};
+	}
+
+	void Destroy(const Handle& handle) {
+		if (!IsAlive(handle)) return;
+		const uint32_t dense = slotToDense[handle.index];
+		const uint32_t last = uint32_t(denseToSlot.size() - 1);
+		if (dense != last) {
+			for (auto& field : fields) field[dense] = field[last];
+			denseToSlot[dense] = denseToSlot[last];
+			slotToDense[denseToSlot[dense]] = dense;
+		}
+		for (auto& field : fields) field.pop_back();
+		denseToSlot.pop_back();
+		if (++slotGenerations[handle.index] == 0) ++slotGenerations[handle.index];
+		slotMarks[handle.index] = false;
+		freeSlots.push_back(handle.index);
+	}
+
+	void Clear() {
+		for (auto& field : fields) field.clear();
+		denseToSlot.clear();
+		slotToDense.clear();
+		slotGenerations.clear();
+		slotMarks.clear();
+		freeSlots.clear();
+	}
+
+	// Garbage collection of bodies whose entity was destroyed: mark all live handles, then sweep the others
+	void Mark(const Handle& handle) {
+		if (IsAlive(handle)) slotMarks[handle.index] = true;
+	}
+	void Sweep() {
+		for (uint32_t slot = 0; slot < slotGenerations.size(); ++slot) {
+			if (slotMarks[slot]) {
+				slotMarks[slot] = false;
+			} else if (slotToDense[slot] < denseToSlot.size() && denseToSlot[slotToDense[slot]] == slot) {
+				Destroy({slot, slotGenerations[slot]});
+			}
+		}
+	}
+
+	// Copies the state of a rigidbody into the pool, sleeping and kinematic bodies are kept but not integrated
+	void Gather(const Handle& handle, const Rigidbody& rigidbody) {
+		if (!IsAlive(handle)) return;
+		const size_t i = slotToDense[handle.index];
+		const bool integrate = rigidbody.IsInitialized() && !rigidbody.IsKinematic() && !rigidbody.atRest;
+		fields[LINEAR_MASK][i] = integrate ? 1.0 : 0.0;
+		fields[ANGULAR_MASK][i] = (integrate && !rigidbody.IsOrientationLocked()) ? 1.0 : 0.0;
+		if (!integrate) return;
+		for (int c = 0; c < 3; ++c) {
+			fields[POSITION_X + c][i] = rigidbody.position[c];
+			fields[VELOCITY_X + c][i] = rigidbody.linearVelocity[c];
+			fields[ACCELERATION_X + c][i] = rigidbody.linearAcceleration[c];
+			fields[FORCE_X + c][i] = rigidbody.force[c];
+			fields[ANGULAR_VELOCITY_X + c][i] = rigidbody.angularVelocity[c];
+			fields[ANGULAR_ACCELERATION_X + c][i] = rigidbody.angularAcceleration[c];
+			fields[TORQUE_X + c][i] = rigidbody.torque[c];
+			for (int r = 0; r < 3; ++r) {
+				fields[INV_INERTIA_00 + c*3 + r][i] = rigidbody.invInertiaTensorWorld[c][r];
+			}
+		}
+		fields[INV_MASS][i] = rigidbody.invMass;
+		fields[ORIENTATION_W][i] = rigidbody.orientation.w;
+		fields[ORIENTATION_X][i] = rigidbody.orientation.x;
+		fields[ORIENTATION_Y][i] = rigidbody.orientation.y;
+		fields[ORIENTATION_Z][i] = rigidbody.orientation.z;
+	}
+
+	// For bodies put to sleep after they were gathered
+	void SkipIntegration(const Handle& handle) {
+		if (!IsAlive(handle)) return;
+		const size_t i = slotToDense[handle.index];
+		fields[LINEAR_MASK][i] = 0.0;
+		fields[ANGULAR_MASK][i] = 0.0;
+	}
+
+	// Copies the integrated state back into the rigidbody, returns false if the body was not integrated
+	bool Scatter(const Handle& handle, Rigidbody& rigidbody) const {
+		if (!IsAlive(handle)) return false;
+		const size_t i = slotToDense[handle.index];
+		if (fields[LINEAR_MASK][i] == 0.0) return false;
+		for (int c = 0; c < 3; ++c) {
+			rigidbody.position[c] = fields[POSITION_X + c][i];
+			rigidbody.linearVelocity[c] = fields[VELOCITY_X + c][i];
+			rigidbody.linearAcceleration[c] = fields[ACCELERATION_X + c][i];
+		}
+		if (fields[ANGULAR_MASK][i] != 0.0) {
+			for (int c = 0; c < 3; ++c) {
+				rigidbody.angularVelocity[c] = fields[ANGULAR_VELOCITY_X + c][i];
+				rigidbody.angularAcceleration[c] = fields[ANGULAR_ACCELERATION_X + c][i];
+			}
+			rigidbody.orientation = glm::dquat(fields[ORIENTATION_W][i], fields[ORIENTATION_X][i], fields[ORIENTATION_Y][i], fields[ORIENTATION_Z][i]);
+		}
+		return true;
+	}
+
+	void Integrate(double deltaTime) {
+		const size_t count = Count();
+		size_t i = 0;
+		{
+			const Wide dt = Wide::Set(deltaTime), halfDt = Wide::Set(deltaTime / 2.0);
+			for (; i + Wide::SIZE <= count; i += Wide::SIZE) IntegrateLanes<Wide>(i, dt, halfDt);
+		}
+		{
+			const Scalar dt = Scalar::Set(deltaTime), halfDt = Scalar::Set(deltaTime / 2.0);
+			for (; i < count; ++i) IntegrateLanes<Scalar>(i, dt, halfDt);
+		}
+	}
+};
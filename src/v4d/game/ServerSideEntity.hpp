@@ -4,6 +4,7 @@
 
 #include "Entity.h"
 #include "Rigidbody.hpp"
+#include "RigidbodyPool.hpp"
 #include "Collider.hpp"
 
 struct V4DGAME ServerSideEntity : Entity {
@@ -19,6 +20,13 @@ struct V4DGAME ServerSideEntity : Entity {
 
 	std::unordered_map<v4d::TextID, std::unique_ptr<Collider>> colliders {};
 	int colliderCacheIndex = -1;
+	int broadphaseProxyIndex = -1;
+	int collisionDispatchIndex = -1;
+	RigidbodyPool::Handle rigidbodyPoolHandle {};
+	
+	// Mirrors the rigidbody's sleep state so that other modules can skip sleeping entities without locking the rigidbody
+	std::atomic<bool> sleeping {false};
+	std::atomic<double> sleepTimestamp {0};
 	static bool colliderCacheValid;
 	
 	inline Iteration Iterate() {
@@ -49,4 +57,14 @@ struct V4DGAME ServerSideEntity : Entity {
 	inline void SetDynamic(bool dynamic = true) {
 		isDynamic = dynamic;
 	}
+	inline bool IsSleeping() const {
+		return sleeping;
+	}
+	inline void SetSleeping(bool sleeping = true) {
+		if (sleeping) sleepTimestamp = v4d::Timer::GetCurrentTimestamp();
+		this->sleeping = sleeping;
+	}
+	inline double GetSleepTimestamp() const {
+		return sleepTimestamp;
+	}
 };
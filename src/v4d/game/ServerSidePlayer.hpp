@@ -7,6 +7,11 @@
 struct EntitySubscription {
 	ServerSideEntity::WeakPtr entity;
 	Entity::Iteration iteration;
+	// Last values sent to the client with an action, so that updates only carry the fields that changed
+	Entity::ReferenceFrame referenceFrame {0};
+	Entity::ReferenceFrameExtra referenceFrameExtra {0};
+	Entity::Position position {0};
+	Entity::Orientation orientation {1,0,0,0};
 	EntitySubscription() : iteration(0) {}
 	EntitySubscription(ServerSideEntity::Ptr& entity, Entity::Iteration iteration = 0)
 	: entity(entity)
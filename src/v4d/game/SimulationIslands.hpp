@@ -0,0 +1,79 @@
+#pragma once
+
+#include <v4d.h>
+#include <vector>
+#include <unordered_map>
+
+#include "Entity.h"
+
+// Groups bodies connected by contacts into simulation islands (union-find), so that they can only go to sleep or wake up all together.
+// Buffers are kept between ticks to avoid reallocating every frame.
+class SimulationIslands {
+	std::unordered_map<Entity::Id, int> nodes {};
+	std::vector<Entity::Id> ids {};
+	std::vector<int> parents {};
+	std::vector<int> ranks {};
+	std::unordered_map<int, size_t> islandIndices {};
+	std::vector<std::vector<Entity::Id>> islands {};
+	size_t islandCount = 0;
+
+	int Find(int node) {
+		while (parents[node] != node) {
+			parents[node] = parents[parents[node]];
+			node = parents[node];
+		}
+		return node;
+	}
+
+public:
+	void Clear() {
+		nodes.clear();
+		ids.clear();
+		parents.clear();
+		ranks.clear();
+	}
+
+	// Adds a body to its own island if it was not already added
+	int Add(Entity::Id id) {
+		auto [it, inserted] = nodes.try_emplace(id, int(ids.size()));
+		if (inserted) {
+			ids.push_back(id);
+			parents.push_back(it->second);
+			ranks.push_back(0);
+		}
+		return it->second;
+	}
+
+	// Merges the islands of two bodies in contact
+	void AddContact(Entity::Id a, Entity::Id b) {
+		int rootA = Find(Add(a));
+		int rootB = Find(Add(b));
+		if (rootA == rootB) return;
+		if (ranks[rootA] < ranks[rootB]) std::swap(rootA, rootB);
+		parents[rootB] = rootA;
+		if (ranks[rootA] == ranks[rootB]) ++ranks[rootA];
+	}
+
+	size_t CountBodies() const {
+		return ids.size();
+	}
+
+	// Calls func(const std::vector<Entity::Id>& bodies) for each island
+	template<typename F>
+	void ForEachIsland(F&& func) {
+		islandIndices.clear();
+		for (auto& island : islands) island.clear();
+		islandCount = 0;
+		for (int node = 0; node < int(ids.size()); ++node) {
+			auto [it, inserted] = islandIndices.try_emplace(Find(node), islandCount);
+			if (inserted) {
+				if (islands.size() <= islandCount) islands.emplace_back();
+				++islandCount;
+			}
+			islands[it->second].push_back(ids[node]);
+		}
+		for (size_t i = 0; i < islandCount; ++i) {
+			func(islands[i]);
+		}
+	}
+};
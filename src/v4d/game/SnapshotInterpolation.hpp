@@ -0,0 +1,182 @@
+#pragma once
+
+#include <v4d.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+#define SNAPSHOT_INTERPOLATION_BUFFER_SIZE 16 // received transforms kept per entity, must cover the interpolation delay at the highest burst rate
+#define SNAPSHOT_CLOCK_WINDOW_SIZE 64 // latest bursts used to estimate the offset between the server's clock and ours
+
+// Offset between the timestamps of the server and the local clock, estimated from the bursts received.
+// The smallest offset seen within the window is the one of the burst that was delayed the least, so that jitter only ever delays the others.
+// The window lets the estimate follow a change of route or a drifting clock.
+class SnapshotClock {
+	mutable std::mutex mu;
+	std::array<double, SNAPSHOT_CLOCK_WINDOW_SIZE> offsets {};
+	size_t count = 0;
+	size_t next = 0;
+	double offset = 0;
+public:
+	// Timestamps are in seconds
+	void Received(double serverTimestamp, double localTimestamp) {
+		std::lock_guard lock(mu);
+		offsets[next] = localTimestamp - serverTimestamp;
+		next = (next + 1) % offsets.size();
+		count = std::min(count + 1, offsets.size());
+		offset = *std::min_element(offsets.begin(), offsets.begin() + count);
+	}
+
+	bool IsValid() const {
+		std::lock_guard lock(mu);
+		return count > 0;
+	}
+
+	// Server time at which the latest data received at localTimestamp was sent, for the least delayed bursts
+	double GetServerTime(double localTimestamp) const {
+		std::lock_guard lock(mu);
+		return localTimestamp - offset;
+	}
+
+	void Reset() {
+		std::lock_guard lock(mu);
+		count = 0;
+		next = 0;
+		offset = 0;
+	}
+};
+
+// Transforms of one entity received from the server, with the server time at which they were sent, in a small ring buffer ordered by time.
+// The entity is rendered a little in the past, between two received transforms, with a cubic hermite curve that goes through both positions with their sent velocities.
+// Past the latest transform it keeps going with its latest velocity, for a bounded time, until the next one arrives.
+// It must be locked by the caller, the same way as the ClientSideEntity it belongs to.
+class SnapshotInterpolation {
+	struct TimedTransform {
+		double time;
+		glm::dvec3 position;
+		glm::dvec3 velocity;
+		glm::dquat orientation;
+	};
+
+	std::array<TimedTransform, SNAPSHOT_INTERPOLATION_BUFFER_SIZE> samples {};
+	size_t first = 0;
+	size_t count = 0;
+	bool held = false; // a single transform that did not come from a burst, replaced by the first one that does
+
+	TimedTransform& At(size_t i) {return samples[(first + i) % samples.size()];}
+	const TimedTransform& At(size_t i) const {return samples[(first + i) % samples.size()];}
+
+	void DropOldest() {
+		first = (first + 1) % samples.size();
+		--count;
+	}
+
+public:
+	enum SAMPLING {
+		NONE, // nothing was received yet
+		HELD, // before the oldest transform, or a transform that was not received with a timestamp
+		INTERPOLATED,
+		EXTRAPOLATED, // past the latest transform, within the extrapolation limit
+		EXTRAPOLATION_LIMIT, // past the latest transform for longer than the extrapolation limit, stopped where the limit was reached
+	};
+
+	// Forgets everything and holds this transform until the next timestamped one, for instance when the entity was added or teleported
+	void Reset(const glm::dvec3& position, const glm::dquat& orientation) {
+		first = 0;
+		count = 1;
+		held = true;
+		samples[0] = {0, position, glm::dvec3(0), orientation};
+	}
+
+	// Adds a transform sent at the given server time, in seconds.
+	// Fields that were not sent are taken from the transform just before it, the server only sends those that changed.
+	// Transforms that arrive out of order are inserted at their place, unless they are older than everything in a full buffer.
+	void Push(double time, const glm::dvec3* position, const glm::dvec3* velocity, const glm::dquat* orientation) {
+		TimedTransform sample {time, glm::dvec3(0), glm::dvec3(0), glm::dquat(1,0,0,0)};
+		if (held) {
+			sample.position = At(0).position;
+			sample.orientation = At(0).orientation;
+			count = 0;
+			held = false;
+		}
+
+		// Find where it goes, most of the time it is the end
+		size_t index = count;
+		while (index > 0 && At(index-1).time > time) --index;
+		if (index > 0 && At(index-1).time == time) {
+			// Same burst time, merge the fields
+			TimedTransform& existing = At(index-1);
+			if (position) existing.position = *position;
+			if (velocity) existing.velocity = *velocity;
+			if (orientation) existing.orientation = *orientation;
+			return;
+		}
+		if (count > 0) {
+			const TimedTransform& previous = At(index > 0? index-1 : 0);
+			sample.position = previous.position;
+			sample.velocity = previous.velocity;
+			sample.orientation = previous.orientation;
+		}
+		if (position) sample.position = *position;
+		if (velocity) sample.velocity = *velocity;
+		if (orientation) sample.orientation = *orientation;
+
+		if (count == samples.size()) {
+			if (index == 0) return;
+			DropOldest();
+			--index;
+		}
+		for (size_t i = count; i > index; --i) At(i) = At(i-1);
+		At(index) = sample;
+		++count;
+	}
+
+	// Transform at the given server time, returns how it was obtained.
+	// Samples that are no longer needed for later times are dropped, so time is expected to only go forward.
+	SAMPLING Sample(double time, double maxExtrapolation, glm::dvec3& position, glm::dquat& orientation) {
+		if (count == 0) return NONE;
+		if (held || time <= At(0).time) {
+			position = At(0).position;
+			orientation = At(0).orientation;
+			return HELD;
+		}
+
+		// Keep only one sample before the given time
+		while (count > 2 && At(1).time <= time) DropOldest();
+
+		if (count == 1 || time >= At(count-1).time) {
+			const TimedTransform& latest = At(count-1);
+			const double elapsed = time - latest.time;
+			const double extrapolated = std::min(elapsed, std::max(0.0, maxExtrapolation));
+			position = latest.position + latest.velocity * extrapolated;
+			orientation = latest.orientation;
+			return (elapsed > extrapolated)? EXTRAPOLATION_LIMIT : EXTRAPOLATED;
+		}
+
+		// Cubic hermite between the two samples around the given time, its tangents are the velocities scaled to the interval
+		const TimedTransform& a = At(0);
+		const TimedTransform& b = At(1);
+		const double dt = b.time - a.time;
+		const double s = (time - a.time) / dt;
+		const double s2 = s*s;
+		const double s3 = s2*s;
+		position = a.position * (2*s3 - 3*s2 + 1)
+			+ a.velocity * (dt * (s3 - 2*s2 + s))
+			+ b.position * (-2*s3 + 3*s2)
+			+ b.velocity * (dt * (s3 - s2));
+		orientation = glm::slerp(a.orientation, b.orientation, s);
+		return INTERPOLATED;
+	}
+
+	// Server time of the latest transform received, or -infinity
+	double GetLatestTime() const {
+		if (count == 0 || held) return -std::numeric_limits<double>::infinity();
+		return At(count-1).time;
+	}
+
+	size_t Size() const {
+		return count;
+	}
+};
@@ -10,6 +10,14 @@ struct BoxCollider : Collider {
 	, halfSize(halfSize)
 	{}
 	
+	virtual ColliderType GetType() const override {return ColliderType::Box;}
+	
+	virtual glm::dvec3 Support(const Entity* entity, const glm::dvec3& direction) const override {
+		const glm::dmat3 rotation = GetWorldRotation(entity);
+		const glm::dvec3 localDirection = glm::transpose(rotation) * direction;
+		return GetWorldPosition(entity) + rotation * (glm::sign(localDirection) * glm::dvec3(halfSize));
+	}
+	
 	bool RayIntersect(const Ray& ray, Entity* entity, double& t1, double& t2) {
 		const glm::dvec3 position = entity->position + glm::mat3_cast(entity->orientation) * this->position;
 		const glm::dmat3 rotation = glm::mat3_cast(entity->orientation) * this->rotation;
@@ -12,6 +12,15 @@ struct CapsuleCollider : Collider {
 	, radius(radius)
 	{}
 
+	virtual ColliderType GetType() const override {return ColliderType::Capsule;}
+	
+	virtual glm::dvec3 Support(const Entity* entity, const glm::dvec3& direction) const override {
+		// Capsule is aligned with the Z axis
+		const glm::dmat3 rotation = GetWorldRotation(entity);
+		const glm::dvec3 localDirection = glm::transpose(rotation) * direction;
+		return GetWorldPosition(entity) + rotation * glm::dvec3(0, 0, localDirection.z < 0 ? -length/2 : length/2) + glm::normalize(direction) * double(radius);
+	}
+	
 	bool RayIntersect(const Ray& ray, Entity* entity, double& t1, double& t2) {
 		// const glm::dvec3 position = entity->position + glm::mat3_cast(entity->orientation) * this->position;
 		// const glm::dmat3 rotation = glm::mat3_cast(entity->orientation) * this->rotation;
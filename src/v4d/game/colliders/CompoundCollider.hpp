@@ -0,0 +1,327 @@
+#pragma once
+#include "../Collider.hpp"
+#include <shared_mutex>
+
+#define COMPOUND_COLLIDER_MAX_HEIGHT 64 // of the tree, it is kept balanced so that this is never reached (2^32 children would not get there)
+
+// Many primitive colliders that move together, in a tree of their bounding boxes (a dynamic AABB tree, kept balanced with rotations as children are added and removed),
+// so that only the children near another collider are tested against it.
+// Children are placed relative to the entity like any other collider, the compound itself must stay at the origin of the entity.
+// Children may be added and removed while the physics runs on other threads: Add, Remove and Clear must be called with the unique lock of mutex held,
+// all other methods take a shared lock themselves.
+struct CompoundCollider : Collider {
+
+	struct Bounds {
+		glm::dvec3 min;
+		glm::dvec3 max;
+		inline bool Overlaps(const Bounds& other) const {
+			return glm::all(glm::lessThanEqual(min, other.max)) && glm::all(glm::greaterThanEqual(max, other.min));
+		}
+		inline Bounds Union(const Bounds& other) const {
+			return {glm::min(min, other.min), glm::max(max, other.max)};
+		}
+		inline double Area() const {
+			const glm::dvec3 d = max - min;
+			return 2.0 * (d.x*d.y + d.y*d.z + d.z*d.x);
+		}
+	};
+
+	using Handle = int32_t;
+
+	mutable std::shared_mutex mutex;
+
+private:
+	struct Node {
+		Bounds bounds;
+		Handle parent = -1;
+		Handle left = -1; // -1 for leaves
+		Handle right = -1;
+		int height = 0; // 0 for leaves
+		std::unique_ptr<Collider> collider = nullptr; // leaves only
+		inline bool IsLeaf() const {return left == -1;}
+	};
+
+	std::vector<Node> nodes {};
+	std::vector<Handle> freeNodes {};
+	Handle root = -1;
+	size_t childCount = 0;
+
+	Handle AllocateNode() {
+		if (freeNodes.size() > 0) {
+			const Handle index = freeNodes.back();
+			freeNodes.pop_back();
+			return index;
+		}
+		nodes.emplace_back();
+		return Handle(nodes.size() - 1);
+	}
+
+	void FreeNode(Handle index) {
+		nodes[index] = Node{};
+		freeNodes.push_back(index);
+	}
+
+	// Rotates the taller child of A up if its children are more than one level apart, returns the new root of this subtree (Box2D's b2DynamicTree::Balance)
+	Handle Balance(Handle iA) {
+		Node& A = nodes[iA];
+		if (A.IsLeaf() || A.height < 2) return iA;
+		const Handle iB = A.left;
+		const Handle iC = A.right;
+		Node& B = nodes[iB];
+		Node& C = nodes[iC];
+		const int balance = C.height - B.height;
+
+		auto replaceChild = [this, iA](Handle parent, Handle child){
+			if (parent == -1) root = child;
+			else if (nodes[parent].left == iA) nodes[parent].left = child;
+			else nodes[parent].right = child;
+		};
+
+		if (balance > 1) {// Rotate C up
+			const Handle iF = C.left;
+			const Handle iG = C.right;
+			Node& F = nodes[iF];
+			Node& G = nodes[iG];
+			C.left = iA;
+			C.parent = A.parent;
+			A.parent = iC;
+			replaceChild(C.parent, iC);
+			if (F.height > G.height) {
+				C.right = iF;
+				A.right = iG;
+				G.parent = iA;
+				A.bounds = B.bounds.Union(G.bounds);
+				C.bounds = A.bounds.Union(F.bounds);
+				A.height = 1 + std::max(B.height, G.height);
+				C.height = 1 + std::max(A.height, F.height);
+			} else {
+				C.right = iG;
+				A.right = iF;
+				F.parent = iA;
+				A.bounds = B.bounds.Union(F.bounds);
+				C.bounds = A.bounds.Union(G.bounds);
+				A.height = 1 + std::max(B.height, F.height);
+				C.height = 1 + std::max(A.height, G.height);
+			}
+			return iC;
+		}
+
+		if (balance < -1) {// Rotate B up
+			const Handle iD = B.left;
+			const Handle iE = B.right;
+			Node& D = nodes[iD];
+			Node& E = nodes[iE];
+			B.left = iA;
+			B.parent = A.parent;
+			A.parent = iB;
+			replaceChild(B.parent, iB);
+			if (D.height > E.height) {
+				B.right = iD;
+				A.left = iE;
+				E.parent = iA;
+				A.bounds = C.bounds.Union(E.bounds);
+				B.bounds = A.bounds.Union(D.bounds);
+				A.height = 1 + std::max(C.height, E.height);
+				B.height = 1 + std::max(A.height, D.height);
+			} else {
+				B.right = iE;
+				A.left = iD;
+				D.parent = iA;
+				A.bounds = C.bounds.Union(D.bounds);
+				B.bounds = A.bounds.Union(E.bounds);
+				A.height = 1 + std::max(C.height, D.height);
+				B.height = 1 + std::max(A.height, E.height);
+			}
+			return iB;
+		}
+
+		return iA;
+	}
+
+	// Balances and refits the bounds of all nodes from this one up to the root
+	void Refit(Handle index) {
+		while (index != -1) {
+			index = Balance(index);
+			Node& node = nodes[index];
+			node.height = 1 + std::max(nodes[node.left].height, nodes[node.right].height);
+			node.bounds = nodes[node.left].bounds.Union(nodes[node.right].bounds);
+			index = node.parent;
+		}
+	}
+
+public:
+	CompoundCollider() : Collider() {}
+
+	// Returns the handle with which to remove this child, bounds are those of the child relative to the entity
+	Handle Add(std::unique_ptr<Collider>&& child, const Bounds& bounds) {
+		const Handle leaf = AllocateNode();
+		nodes[leaf].bounds = bounds;
+		nodes[leaf].collider = std::move(child);
+		++childCount;
+		if (root == -1) {
+			root = leaf;
+			return leaf;
+		}
+		// Go down to the sibling that makes the parent grow the least, with the cost of the area added to all ancestors
+		Handle index = root;
+		while (!nodes[index].IsLeaf()) {
+			const Node& node = nodes[index];
+			const double area = node.bounds.Area();
+			const double combinedArea = node.bounds.Union(bounds).Area();
+			const double cost = 2.0 * combinedArea; // new parent of this node and the leaf
+			const double inheritanceCost = 2.0 * (combinedArea - area); // minimum added to the ancestors when going further down
+			auto childCost = [&](Handle child){
+				const double grownArea = nodes[child].bounds.Union(bounds).Area();
+				return (nodes[child].IsLeaf()? grownArea : grownArea - nodes[child].bounds.Area()) + inheritanceCost;
+			};
+			const double leftCost = childCost(node.left);
+			const double rightCost = childCost(node.right);
+			if (cost < leftCost && cost < rightCost) break;
+			index = leftCost < rightCost? node.left : node.right;
+		}
+		const Handle sibling = index;
+		const Handle oldParent = nodes[sibling].parent;
+		const Handle newParent = AllocateNode();
+		nodes[newParent].parent = oldParent;
+		nodes[newParent].left = sibling;
+		nodes[newParent].right = leaf;
+		nodes[sibling].parent = newParent;
+		nodes[leaf].parent = newParent;
+		if (oldParent == -1) {
+			root = newParent;
+		} else if (nodes[oldParent].left == sibling) {
+			nodes[oldParent].left = newParent;
+		} else {
+			nodes[oldParent].right = newParent;
+		}
+		Refit(newParent);
+		return leaf;
+	}
+
+	void Remove(Handle leaf) {
+		if (leaf < 0 || leaf >= Handle(nodes.size()) || !nodes[leaf].collider) return;
+		--childCount;
+		if (leaf == root) {
+			root = -1;
+			FreeNode(leaf);
+			return;
+		}
+		const Handle parent = nodes[leaf].parent;
+		const Handle grandParent = nodes[parent].parent;
+		const Handle sibling = nodes[parent].left == leaf? nodes[parent].right : nodes[parent].left;
+		nodes[sibling].parent = grandParent;
+		if (grandParent == -1) {
+			root = sibling;
+		} else {
+			if (nodes[grandParent].left == parent) nodes[grandParent].left = sibling;
+			else nodes[grandParent].right = sibling;
+		}
+		FreeNode(parent);
+		FreeNode(leaf);
+		Refit(grandParent);
+	}
+
+	void Clear() {
+		nodes.clear();
+		freeNodes.clear();
+		root = -1;
+		childCount = 0;
+	}
+
+	// Calls func(Collider*) for each child whose bounds overlap the given ones (relative to the entity), with a shared lock
+	template<typename F>
+	void ForEachOverlapping(const Bounds& bounds, F&& func) const {
+		std::shared_lock lock(mutex);
+		if (root == -1) return;
+		Handle stack[COMPOUND_COLLIDER_MAX_HEIGHT + 1];
+		int size = 0;
+		stack[size++] = root;
+		while (size > 0) {
+			const Node& node = nodes[stack[--size]];
+			if (!node.bounds.Overlaps(bounds)) continue;
+			if (node.IsLeaf()) {
+				func(node.collider.get());
+			} else {
+				stack[size++] = node.left;
+				stack[size++] = node.right;
+			}
+		}
+	}
+
+	// Calls func(Collider*) for each child, with a shared lock
+	template<typename F>
+	void ForEachChild(F&& func) const {
+		std::shared_lock lock(mutex);
+		for (const auto& node : nodes) {
+			if (node.collider) func(node.collider.get());
+		}
+	}
+
+	// Of all children, relative to the entity
+	Bounds GetBounds() const {
+		std::shared_lock lock(mutex);
+		if (root == -1) return {glm::dvec3{0}, glm::dvec3{0}};
+		return nodes[root].bounds;
+	}
+
+	size_t GetChildCount() const {
+		return childCount;
+	}
+
+	int GetHeight() const {
+		return root == -1? 0 : nodes[root].height;
+	}
+
+	virtual ColliderType GetType() const override {return ColliderType::Compound;}
+
+	// Of the convex hull of all children
+	virtual glm::dvec3 Support(const Entity* entity, const glm::dvec3& direction) const override {
+		glm::dvec3 best = entity->position;
+		double bestDistance = std::numeric_limits<double>::lowest();
+		ForEachChild([&](const Collider* child){
+			const glm::dvec3 p = child->Support(entity, direction);
+			const double distance = glm::dot(p, direction);
+			if (distance > bestDistance) {
+				bestDistance = distance;
+				best = p;
+			}
+		});
+		return best;
+	}
+
+	// Deepest hit among the children that the ray goes through
+	virtual bool RayCollision(const Ray& ray, Entity* entity, CollisionInfo& collision) override {
+		const glm::dmat3 rotation = glm::mat3_cast(entity->orientation);
+		const glm::dvec3 a = glm::transpose(rotation) * (ray.origin - entity->position);
+		const glm::dvec3 b = a + glm::transpose(rotation) * (glm::normalize(ray.direction) * ray.length);
+		bool collided = false;
+		CollisionInfo childCollision;
+		ForEachOverlapping({glm::min(a, b), glm::max(a, b)}, [&](Collider* child){
+			if (child->RayCollision(ray, entity, childCollision)) {
+				if (!collided || childCollision.penetration > collision.penetration) collision = childCollision;
+				collided = true;
+			}
+		});
+		return collided;
+	}
+
+	// Deepest contact among all children
+	virtual bool TerrainCollision(const std::function<double(const glm::dvec3&)>& terrainHeightMap, Entity* entity, TerrainCollisionInfo& collision) override {
+		bool collided = false;
+		ForEachChild([&](Collider* child){
+			TerrainCollisionInfo childCollision = collision;
+			if (child->TerrainCollision(terrainHeightMap, entity, childCollision)) {
+				if (!collided || childCollision.penetration > collision.penetration) collision = childCollision;
+				collided = true;
+			}
+		});
+		return collided;
+	}
+
+	virtual void GenerateCollisionRays(Entity* entity, const v4d::TextID& id, std::vector<Ray>& rays, uint& randomSeed) override {
+		ForEachChild([&](Collider* child){
+			child->GenerateCollisionRays(entity, id, rays, randomSeed);
+		});
+	}
+
+};
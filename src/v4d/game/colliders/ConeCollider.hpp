@@ -14,6 +14,19 @@ struct ConeCollider : Collider {
 	, radiusB(radiusB)
 	{}
 
+	virtual ColliderType GetType() const override {return ColliderType::Cone;}
+	
+	virtual glm::dvec3 Support(const Entity* entity, const glm::dvec3& direction) const override {
+		// Cone is aligned with the Z axis, with radiusA at -length/2 and radiusB at +length/2
+		const glm::dmat3 rotation = GetWorldRotation(entity);
+		const glm::dvec3 localDirection = glm::transpose(rotation) * direction;
+		const double radial = glm::length(glm::dvec2(localDirection));
+		const glm::dvec2 rimDirection = radial > DOUBLE_EPSILON ? glm::dvec2(localDirection) / radial : glm::dvec2(0);
+		const glm::dvec3 a {rimDirection * double(radiusA), -length/2};
+		const glm::dvec3 b {rimDirection * double(radiusB), +length/2};
+		return GetWorldPosition(entity) + rotation * (glm::dot(a, localDirection) > glm::dot(b, localDirection) ? a : b);
+	}
+	
 	bool RayIntersect(const Ray& ray, Entity* entity, double& t1, double& t2) {
 		// const glm::dvec3 position = entity->position + glm::mat3_cast(entity->orientation) * this->position;
 		// const glm::dmat3 rotation = glm::mat3_cast(entity->orientation) * this->rotation;
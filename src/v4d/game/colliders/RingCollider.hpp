@@ -14,6 +14,17 @@ struct RingCollider : Collider {
 	, radiusB(radiusB)
 	{}
 
+	virtual ColliderType GetType() const override {return ColliderType::Ring;}
+	
+	virtual glm::dvec3 Support(const Entity* entity, const glm::dvec3& direction) const override {
+		// A ring is not convex, this is the support of its convex hull (a cylinder with the largest radius, aligned with the Z axis)
+		const glm::dmat3 rotation = GetWorldRotation(entity);
+		const glm::dvec3 localDirection = glm::transpose(rotation) * direction;
+		const double radial = glm::length(glm::dvec2(localDirection));
+		const glm::dvec2 rim = radial > DOUBLE_EPSILON ? glm::dvec2(localDirection) / radial * double(glm::max(radiusA, radiusB)) : glm::dvec2(0);
+		return GetWorldPosition(entity) + rotation * glm::dvec3(rim, localDirection.z < 0 ? -length/2 : length/2);
+	}
+	
 	bool RayIntersect(const Ray& ray, Entity* entity, double& t1, double& t2) {
 		// const glm::dvec3 position = entity->position + glm::mat3_cast(entity->orientation) * this->position;
 		// const glm::dmat3 rotation = glm::mat3_cast(entity->orientation) * this->rotation;
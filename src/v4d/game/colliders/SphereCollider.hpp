@@ -15,6 +15,12 @@ struct SphereCollider : Collider {
 	, radius(radius)
 	{}
 	
+	virtual ColliderType GetType() const override {return ColliderType::Sphere;}
+	
+	virtual glm::dvec3 Support(const Entity* entity, const glm::dvec3& direction) const override {
+		return GetWorldPosition(entity) + glm::normalize(direction) * double(radius);
+	}
+	
 	bool RayIntersect(const Ray& ray, Entity* entity, double& t1, double& t2) {
 		const glm::dvec3 position = entity->position + glm::mat3_cast(entity->orientation) * this->position;
 		// const glm::dmat3 rotation = glm::mat3_cast(entity->orientation) * this->rotation;
@@ -26,6 +26,20 @@ struct TriangleCollider : Collider {
 		this->center = glm::inverse(rotation) * (center - vertex0);
 	}
 
+	virtual ColliderType GetType() const override {return ColliderType::Triangle;}
+	
+	virtual glm::dvec3 Support(const Entity* entity, const glm::dvec3& direction) const override {
+		const glm::dmat3 rotation = GetWorldRotation(entity);
+		const glm::dvec3 localDirection = glm::transpose(rotation) * direction;
+		const glm::dvec3 v1 {0,vertex1_y,0};
+		const glm::dvec3 v2 {vertex2,0};
+		const double d0 = 0;
+		const double d1 = glm::dot(v1, localDirection);
+		const double d2 = glm::dot(v2, localDirection);
+		const glm::dvec3 v = (d1 > d0 && d1 >= d2)? v1 : ((d2 > d0)? v2 : glm::dvec3{0});
+		return GetWorldPosition(entity) + rotation * v;
+	}
+	
 	bool RayIntersect(const Ray& ray, Entity* entity, double& u, double& v, double& t, glm::dvec3& normal) {
 		const glm::dvec3 position = entity->position + glm::mat3_cast(entity->orientation) * this->position;
 		const glm::dmat3 rotation = glm::mat3_cast(entity->orientation) * this->rotation;
@@ -0,0 +1,194 @@
+#pragma once
+#include "../Collider.hpp"
+
+// Convex hull of some of the 8 corners of a box: all of them make a box, 6 make a wedge, fewer make corners and pyramids.
+// Corner i is at halfSize * {i&1? +1:-1, i&2? +1:-1, i&4? +1:-1} in local space.
+struct WedgeCollider : Collider {
+
+	glm::vec3 halfSize;
+	uint8_t corners; // bit i is set when corner i is part of the hull
+	std::vector<glm::dvec4> cutPlanes {}; // faces of the hull that are not on a face of the box, as {normal, distance} in local space, the hull is the box behind all of them
+
+	WedgeCollider(const glm::dvec3& position, const glm::dmat3& rotation, const glm::vec3& halfSize, uint8_t corners)
+	: Collider(position, rotation)
+	, halfSize(halfSize)
+	, corners(corners)
+	{
+		// Three corners make a face of the hull when all other corners are behind their plane
+		const double epsilon = 1e-6 * glm::max(halfSize.x, glm::max(halfSize.y, halfSize.z));
+		for (int a = 0; a < 8; ++a) if (HasCorner(a))
+		for (int b = a+1; b < 8; ++b) if (HasCorner(b))
+		for (int c = b+1; c < 8; ++c) if (HasCorner(c)) {
+			glm::dvec3 normal = glm::cross(GetLocalCorner(b) - GetLocalCorner(a), GetLocalCorner(c) - GetLocalCorner(a));
+			const double length = glm::length(normal);
+			if (length < DOUBLE_EPSILON) continue;
+			normal /= length;
+			if (glm::abs(normal.x) > 1.0-1e-9 || glm::abs(normal.y) > 1.0-1e-9 || glm::abs(normal.z) > 1.0-1e-9) continue; // face of the box
+			double distance = glm::dot(normal, GetLocalCorner(a));
+			int front = 0, back = 0;
+			for (int i = 0; i < 8; ++i) if (HasCorner(i)) {
+				const double d = glm::dot(normal, GetLocalCorner(i)) - distance;
+				if (d > epsilon) ++front;
+				else if (d < -epsilon) ++back;
+			}
+			if (front > 0 && back > 0) continue;
+			if (front > 0) {
+				normal = -normal;
+				distance = -distance;
+			}
+			bool duplicate = false;
+			for (const auto& plane : cutPlanes) {
+				if (glm::dot(glm::dvec3(plane), normal) > 1.0-1e-9) duplicate = true;
+			}
+			if (!duplicate) cutPlanes.emplace_back(normal, distance);
+		}
+	}
+
+	inline bool HasCorner(int i) const {
+		return corners & (1 << i);
+	}
+
+	inline glm::dvec3 GetLocalCorner(int i) const {
+		return glm::dvec3{i&1? 1.0:-1.0, i&2? 1.0:-1.0, i&4? 1.0:-1.0} * glm::dvec3(halfSize);
+	}
+
+	virtual ColliderType GetType() const override {return ColliderType::Wedge;}
+
+	virtual glm::dvec3 Support(const Entity* entity, const glm::dvec3& direction) const override {
+		const glm::dmat3 rotation = GetWorldRotation(entity);
+		const glm::dvec3 localDirection = glm::transpose(rotation) * direction;
+		glm::dvec3 best {0};
+		double bestDistance = std::numeric_limits<double>::lowest();
+		for (int i = 0; i < 8; ++i) if (HasCorner(i)) {
+			const glm::dvec3 corner = GetLocalCorner(i);
+			const double distance = glm::dot(corner, localDirection);
+			if (distance > bestDistance) {
+				bestDistance = distance;
+				best = corner;
+			}
+		}
+		return GetWorldPosition(entity) + rotation * best;
+	}
+
+	// Same as the box, with the ray also clipped by the cut planes
+	bool RayIntersect(const Ray& ray, Entity* entity, double& t1, double& t2) {
+		const glm::dvec3 position = GetWorldPosition(entity);
+		const glm::dmat3 rotation = GetWorldRotation(entity);
+
+		const glm::dvec3 localRayOrigin = glm::transpose(rotation) * (ray.origin - position);
+		const glm::dvec3 localRayDirection = glm::normalize(glm::transpose(rotation) * ray.direction);
+
+		const glm::dvec3 invDir = 1.0 / localRayDirection;
+		const glm::dvec3 tbot = invDir * (-glm::dvec3(halfSize) - localRayOrigin);
+		const glm::dvec3 ttop = invDir * (+glm::dvec3(halfSize) - localRayOrigin);
+		const glm::dvec3 tmin = glm::min(ttop, tbot);
+		const glm::dvec3 tmax = glm::max(ttop, tbot);
+		t1 = glm::max(tmin.x, glm::max(tmin.y, tmin.z));
+		t2 = glm::min(tmax.x, glm::min(tmax.y, tmax.z));
+
+		for (const auto& plane : cutPlanes) {
+			const glm::dvec3 normal {plane};
+			const double denom = glm::dot(normal, localRayDirection);
+			const double distance = glm::dot(normal, localRayOrigin) - plane.w;
+			if (glm::abs(denom) < DOUBLE_EPSILON) {
+				if (distance > 0) return false; // parallel and in front of the plane
+				continue;
+			}
+			const double t = -distance / denom;
+			if (denom < 0) t1 = glm::max(t1, t);
+			else t2 = glm::min(t2, t);
+		}
+
+		return t1 < ray.length && t2 > 0 && t2 > t1;
+	}
+
+	virtual bool RayCollision(const Ray& ray, Entity* entity, CollisionInfo& collision) override {
+		double t1, t2;
+		if (RayIntersect(ray, entity, t1, t2) && t1 < 0 && t2 < ray.length) {
+			collision.penetration = float(t2);
+			collision.contactA = ray.origin;
+			collision.contactB = ray.origin + ray.direction * t2;
+			collision.normal = -ray.direction;
+			return true;
+		}
+		return false;
+	}
+
+	// Same as the box, with the corners of the hull only
+	virtual bool TerrainCollision(const std::function<double(const glm::dvec3&)>& terrainHeightMap, Entity* entity, TerrainCollisionInfo& collision) override {
+		const glm::dvec3 position = GetWorldPosition(entity);
+		const glm::dmat3 rotation = GetWorldRotation(entity);
+
+		constexpr int MIN_TEST_VERTICES = 3; // test at least the first 3 lowest vertices of the hull
+		constexpr int MAX_TEST_VERTICES = 6; // test up to 6 lowest vertices of the hull
+
+		std::array<glm::dvec3, 8> points;
+		int pointCount = 0;
+		for (int i = 0; i < 8; ++i) if (HasCorner(i)) {
+			points[pointCount++] = position + rotation * GetLocalCorner(i);
+		}
+		if (pointCount < 3) return false;
+
+		// Sort hull vertices by lowest
+		std::sort(points.begin(), points.begin() + pointCount, [](const glm::dvec3& a, const glm::dvec3& b){
+			return glm::dot(a,a) < glm::dot(b,b);
+		});
+
+		const int testCount = glm::min(pointCount, MAX_TEST_VERTICES);
+		glm::dvec3 normalizedPos[MAX_TEST_VERTICES];
+		double terrainHeight[MAX_TEST_VERTICES];
+		double contactPoints = 0;
+
+		for (int i = 0; i < testCount; ++i) {
+			normalizedPos[i] = glm::normalize(points[i]);
+			terrainHeight[i] = terrainHeightMap(normalizedPos[i]);
+			const double altitudeAboveTerrain = glm::length(points[i]) - terrainHeight[i];
+
+			if (altitudeAboveTerrain < 0) {
+				++contactPoints;
+				const double mixRatio = 1.0/contactPoints;
+
+				collision.penetration = glm::mix(collision.penetration, float(-altitudeAboveTerrain), mixRatio);
+				collision.contactTerrain = glm::mix(collision.contactTerrain, points[i], mixRatio);
+				collision.contactB = glm::mix(collision.contactB, points[i], mixRatio);
+
+				if (contactPoints == MIN_TEST_VERTICES) break; // good enough!
+			}
+		}
+
+		if (contactPoints > 0) {
+			// Compute terrain surface normal
+			const glm::dvec3 posOnTerrain0 = normalizedPos[0] * terrainHeight[0];
+			const glm::dvec3 posOnTerrain1 = normalizedPos[1] * terrainHeight[1];
+			const glm::dvec3 posOnTerrain2 = normalizedPos[2] * terrainHeight[2];
+			const glm::dvec3 tangentX = glm::normalize(posOnTerrain1 - posOnTerrain0);
+			const glm::dvec3 tangentY = glm::normalize(posOnTerrain2 - posOnTerrain0);
+			collision.normal = glm::normalize(glm::cross(tangentX, tangentY));
+			if (glm::dot(collision.normal, glm::vec3(normalizedPos[0])) < 0) collision.normal *= -1.0;
+			return true;
+		}
+
+		return false;
+	}
+
+	// Rays from each corner of the hull towards its center
+	virtual void GenerateCollisionRays(Entity* entity, const v4d::TextID& id, std::vector<Ray>& rays, uint& randomSeed) override {
+		const glm::dvec3 position = GetWorldPosition(entity);
+		const glm::dmat3 rotation = GetWorldRotation(entity);
+		glm::dvec3 center {0};
+		int count = 0;
+		for (int i = 0; i < 8; ++i) if (HasCorner(i)) {
+			center += GetLocalCorner(i);
+			++count;
+		}
+		if (count == 0) return;
+		center /= double(count);
+		for (int i = 0; i < 8; ++i) if (HasCorner(i)) {
+			const glm::dvec3 dir = center - GetLocalCorner(i);
+			const double length = glm::length(dir);
+			if (length < DOUBLE_EPSILON) continue;
+			rays.emplace_back(position + rotation * GetLocalCorner(i), rotation * (dir / length), length, id);
+		}
+	}
+
+};
@@ -10,6 +10,16 @@
 #define COLLISION_STATIC_FRICTION_SPEED_REDUCTION 0.5 // should be less than COLLISION_REST_SPEED_THRESHOLD / avgDeltaTime
 #define COLLISION_STATIC_FRICTION_ANGULAR_SPEED_REDUCTION 0.8 // should be less than COLLISION_REST_ANGULAR_SPEED_THRESHOLD / avgDeltaTime
 
+#define PHYSICS_SLEEP_SPEED_THRESHOLD 0.04
+#define PHYSICS_SLEEP_ANGULAR_SPEED_THRESHOLD 0.05
+#define PHYSICS_SLEEP_TIME 0.5 // seconds that all bodies of a simulation island must stay below sleep thresholds before the island goes to sleep
+
+#define PHYSICS_FORCE_COLLISION_RAYS false // use stochastic collision rays even for collider pairs that have a contact generator in Narrowphase.hpp
+
+#define PHYSICS_NARROWPHASE_PAIRS_PER_BATCH 32 // broadphase pairs tested by a thread at a time
+#define PHYSICS_SOLVER_CONTACTS_PER_BATCH 16 // contacts of the same color resolved by a thread at a time
+#define PHYSICS_SOLVER_MAX_COLORS 64 // contacts of bodies that already have this many colors are resolved serially
+
 #define TERRAIN_COLLISION_REST_SPEED_THRESHOLD 0.04
 #define TERRAIN_COLLISION_REST_ANGULAR_SPEED_THRESHOLD 0.05
 #define TERRAIN_COLLISION_STATIC_FRICTION_SPEED_REDUCTION 0.5 // should be less than TERRAIN_COLLISION_REST_SPEED_THRESHOLD / avgDeltaTime
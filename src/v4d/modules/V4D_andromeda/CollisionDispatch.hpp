@@ -0,0 +1,83 @@
+#pragma once
+
+#include <v4d.h>
+#include <V4D_Mod.h>
+#include <vector>
+
+#include "v4d/game/Entity.h"
+#include "v4d/game/ServerSideEntity.hpp"
+#include "v4d/game/CollisionEvents.h"
+
+// Collision callbacks of the loaded modules, indexed by module, so that the physics never has to look modules up by name.
+// Entities keep the index of their module's entry (or -1 when their module has no collision callback), resolved when the collider cache is rebuilt.
+// Hits are accumulated per module during the tick and flushed at the end of it.
+class CollisionDispatch {
+	struct Entry {
+		v4d::modular::ModuleID moduleID;
+		V4D_Mod* mod;
+		CollisionEvents::BatchHandler batchHandler;
+		std::vector<CollisionHit> hits;
+	};
+	std::vector<Entry> entries {};
+	uint64_t signature = 0;
+
+	// Changes whenever a module is loaded, unloaded or reloaded, or when a batch handler is registered
+	static uint64_t ComputeSignature() {
+		uint64_t sig = CollisionEvents::GetGeneration() * 0x9E3779B97F4A7C15ull;
+		V4D_Mod::ForEachSortedModule([&sig](auto* mod){
+			sig = (sig ^ uint64_t(reinterpret_cast<uintptr_t>(mod))) * 0x100000001B3ull;
+			sig = (sig ^ uint64_t(reinterpret_cast<uintptr_t>(mod->OnCollisionHit))) * 0x100000001B3ull;
+		});
+		return sig;
+	}
+
+public:
+	// Called at the beginning of a tick, returns true when the table was rebuilt, in which case the entity indices must be resolved again
+	bool Update() {
+		const uint64_t sig = ComputeSignature();
+		if (sig == signature && signature != 0) return false;
+		signature = sig;
+		entries.clear();
+		V4D_Mod::ForEachSortedModule([this](auto* mod){
+			v4d::modular::ModuleID moduleID(mod->ModuleName());
+			auto batchHandler = CollisionEvents::GetBatchHandler(moduleID);
+			if (batchHandler || mod->OnCollisionHit) {
+				entries.push_back({moduleID, mod, batchHandler, {}});
+			}
+		});
+		return true;
+	}
+
+	int IndexOf(const v4d::modular::ModuleID& moduleID) const {
+		for (size_t i = 0; i < entries.size(); ++i) {
+			if (entries[i].moduleID.vendor == moduleID.vendor && entries[i].moduleID.module == moduleID.module) return int(i);
+		}
+		return -1;
+	}
+
+	// contactPoint is in world space
+	void AddHit(ServerSideEntity* entity, const glm::dvec3& contactPoint, double contactSpeed) {
+		if (entity->collisionDispatchIndex < 0 || entity->collisionDispatchIndex >= int(entries.size())) return;
+		entries[entity->collisionDispatchIndex].hits.push_back({
+			entity->GetID(),
+			entity->type,
+			glm::inverse(glm::mat3_cast(entity->orientation)) * (contactPoint - entity->position),
+			glm::max(0.0, contactSpeed)
+		});
+	}
+
+	// Modules with a batch handler receive all of their hits in one call, others get one OnCollisionHit call per hit
+	void Flush() {
+		for (auto& entry : entries) {
+			if (entry.hits.size() == 0) continue;
+			if (entry.batchHandler) {
+				entry.batchHandler(entry.hits.data(), entry.hits.size());
+			} else {
+				for (const auto& hit : entry.hits) {
+					entry.mod->OnCollisionHit(hit.id, hit.type, hit.contactPoint, hit.contactSpeed);
+				}
+			}
+			entry.hits.clear();
+		}
+	}
+};
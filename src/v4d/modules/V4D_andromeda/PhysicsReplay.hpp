@@ -0,0 +1,163 @@
+#pragma once
+
+#include <v4d.h>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+
+#include "v4d/game/Entity.h"
+#include "v4d/game/ServerSideEntity.hpp"
+#include "v4d/game/Game.h"
+
+#define PHYSICS_REPLAY_FILE_MAGIC 0x59414C5045524434ull // "4DREPLAY"
+#define PHYSICS_REPLAY_FILE_VERSION 1
+
+// A server-received input that affects the simulation
+struct PhysicsInput {
+	enum Type : uint8_t {
+		PLAYER_JOINED = 0,
+		PLAYER_MOTION = 1,
+	};
+	uint64_t tick = 0;
+	Type type = PLAYER_MOTION;
+	uint64_t clientId = 0;
+	// PLAYER_JOINED
+	Entity::ReferenceFrame referenceFrame = 0;
+	Entity::Position position {0};
+	// PLAYER_MOTION
+	Entity::Orientation orientation {1,0,0,0};
+	glm::dvec3 acceleration {0};
+	bool brakes = false;
+};
+
+// When the simulation is deterministic or being recorded, inputs received from the network are queued and only applied at the beginning of the next physics tick.
+// They are written to the record file along with that tick number, so that the console can replay the exact same simulation.
+class PhysicsReplay {
+	std::mutex mu;
+	std::vector<PhysicsInput> pendingInputs {};
+	std::vector<PhysicsInput> currentInputs {};
+	std::ofstream recordFile;
+
+	template<typename T>
+	void WriteValue(const T& value) {
+		recordFile.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	static bool ReadValue(std::ifstream& file, T& value) {
+		return bool(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+public:
+	std::atomic<uint64_t> tick {0}; // number of physics ticks since the server started
+
+	static bool IsQueueingInputs() {
+		return GameConfig::physicsDeterministic || GameConfig::physicsReplayRecordFile != "";
+	}
+
+	// Called from the network thread
+	void Enqueue(const PhysicsInput& input) {
+		std::lock_guard lock(mu);
+		pendingInputs.push_back(input);
+	}
+
+	// Called from the physics thread at the beginning of a tick, calls func(const PhysicsInput&) for each input queued since the last tick, in the order they were received
+	template<typename F>
+	void ApplyPendingInputs(F&& func) {
+		{
+			std::lock_guard lock(mu);
+			currentInputs.clear();
+			std::swap(currentInputs, pendingInputs);
+		}
+		if (currentInputs.size() == 0) return;
+		if (!recordFile.is_open() && GameConfig::physicsReplayRecordFile != "") {
+			StartRecording(GameConfig::physicsReplayRecordFile, GameConfig::physicsFixedTimestep);
+		}
+		for (auto& input : currentInputs) {
+			input.tick = tick;
+			if (recordFile.is_open()) Record(input);
+			func(input);
+		}
+		if (recordFile.is_open()) recordFile.flush();
+	}
+
+	bool StartRecording(const std::string& filePath, double timestep) {
+		recordFile.open(filePath, std::ios::binary | std::ios::trunc);
+		if (!recordFile.is_open()) {
+			LOG_ERROR("PhysicsReplay: Failed to open record file " << filePath)
+			GameConfig::physicsReplayRecordFile = "";
+			return false;
+		}
+		WriteValue(uint64_t(PHYSICS_REPLAY_FILE_MAGIC));
+		WriteValue(uint32_t(PHYSICS_REPLAY_FILE_VERSION));
+		WriteValue(timestep);
+		LOG("PhysicsReplay: Recording inputs to " << filePath)
+		return true;
+	}
+
+	void Record(const PhysicsInput& input) {
+		// Fields are written one by one so that the file does not depend on struct padding
+		WriteValue(input.tick);
+		WriteValue(input.type);
+		WriteValue(input.clientId);
+		switch (input.type) {
+			case PhysicsInput::PLAYER_JOINED:
+				WriteValue(input.referenceFrame);
+				WriteValue(input.position);
+			break;
+			case PhysicsInput::PLAYER_MOTION:
+				WriteValue(input.orientation);
+				WriteValue(input.acceleration);
+				WriteValue(input.brakes);
+			break;
+		}
+	}
+
+	void StopRecording() {
+		if (recordFile.is_open()) recordFile.close();
+	}
+
+	// Reads a recorded file, inputs are sorted by tick
+	static bool Load(const std::string& filePath, double& timestep, std::vector<PhysicsInput>& inputs) {
+		std::ifstream file(filePath, std::ios::binary);
+		if (!file.is_open()) {
+			LOG_ERROR("PhysicsReplay: Failed to open " << filePath)
+			return false;
+		}
+		uint64_t magic = 0;
+		uint32_t version = 0;
+		if (!ReadValue(file, magic) || !ReadValue(file, version) || !ReadValue(file, timestep) || magic != PHYSICS_REPLAY_FILE_MAGIC || version != PHYSICS_REPLAY_FILE_VERSION) {
+			LOG_ERROR("PhysicsReplay: " << filePath << " is not a valid replay file")
+			return false;
+		}
+		inputs.clear();
+		for (;;) {
+			PhysicsInput input {};
+			if (!ReadValue(file, input.tick) || !ReadValue(file, input.type) || !ReadValue(file, input.clientId)) break;
+			bool ok = false;
+			switch (input.type) {
+				case PhysicsInput::PLAYER_JOINED:
+					ok = ReadValue(file, input.referenceFrame) && ReadValue(file, input.position);
+				break;
+				case PhysicsInput::PLAYER_MOTION:
+					ok = ReadValue(file, input.orientation) && ReadValue(file, input.acceleration) && ReadValue(file, input.brakes);
+				break;
+			}
+			if (!ok) {
+				LOG_ERROR("PhysicsReplay: " << filePath << " is truncated or corrupted after " << inputs.size() << " inputs")
+				break;
+			}
+			inputs.push_back(input);
+		}
+		return true;
+	}
+};
+
+extern PhysicsReplay physicsReplay;
+
+// Defined in physics.cpp, applies a player input to the simulation
+void ApplyPhysicsInput(const PhysicsInput& input);
+
+// Defined in andromeda.cpp, creates the (inactive) player entity of a client
+ServerSideEntity::Ptr CreatePlayerEntity(uint64_t clientId, Entity::ReferenceFrame referenceFrame, const Entity::Position& position);
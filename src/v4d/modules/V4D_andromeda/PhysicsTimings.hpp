@@ -0,0 +1,38 @@
+#pragma once
+
+#include <v4d.h>
+
+// Time spent in each stage of ServerPhysicsUpdate, only accumulated while enabled (used by the physics benchmark)
+struct PhysicsTimings {
+	bool enabled = false;
+	uint64_t ticks = 0;
+	uint64_t collisionPairs = 0;
+	uint64_t terrainCacheHits = 0;
+	uint64_t terrainCacheMisses = 0;
+	// seconds
+	double broadphase = 0; // including the sort of the pairs in deterministic mode
+	double narrowphase = 0; // contact generation and merging the batches
+	double solver = 0; // contact coloring, collision response, islands and collision events
+	double terrain = 0;
+	double sleep = 0; // sleep timers, islands and gathering into the rigidbody pool
+	double integration = 0;
+	double entityUpdate = 0; // scattering back from the pool and updating the broadphase
+	double collisionDispatch = 0; // collision callbacks of the modules
+	
+	void Reset() {
+		ticks = 0;
+		collisionPairs = 0;
+		terrainCacheHits = 0;
+		terrainCacheMisses = 0;
+		broadphase = 0;
+		narrowphase = 0;
+		solver = 0;
+		terrain = 0;
+		sleep = 0;
+		integration = 0;
+		entityUpdate = 0;
+		collisionDispatch = 0;
+	}
+};
+
+extern PhysicsTimings physicsTimings;
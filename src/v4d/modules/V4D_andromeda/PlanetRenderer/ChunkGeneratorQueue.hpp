@@ -0,0 +1,255 @@
+#pragma once
+
+#include <v4d.h>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#define CHUNK_GENERATOR_QUEUE_MIN_COMPACT_SIZE 64 // stale entries are only removed from the heap all at once when there are more than this many and more than live ones
+
+// Items waiting to be generated (terrain chunks) in a binary min-heap of their priority, for several generator threads to pop the most urgent one.
+// Pushing returns a handle with which the item is cancelled in constant time: the handle is invalidated right away,
+// and its entry is left in the heap to be skipped when it reaches the top, or dropped when the heap is compacted.
+// Priorities are given when pushing and recomputed all at once with Reprioritize after the camera moved.
+// The lock is only held for a push, a cancel or a pop (logarithmic), the number of items is atomic so that it can be checked without locking.
+template<typename T>
+class ChunkGeneratorQueue {
+public:
+	struct Handle {
+		uint32_t slot = ~0u;
+		uint32_t generation = 0;
+	};
+
+	// Counters since the last ResetStats, for contention a lock acquisition is contended when it could not be taken right away
+	struct Stats {
+		uint64_t pushes = 0;
+		uint64_t pops = 0;
+		uint64_t cancels = 0;
+		uint64_t staleEntriesSkipped = 0; // cancelled entries that reached the top of the heap
+		uint64_t compactions = 0;
+		uint64_t reprioritizations = 0;
+		uint64_t lockAcquisitions = 0;
+		uint64_t contendedLockAcquisitions = 0;
+		double lockWaitSeconds = 0; // total time spent waiting for contended locks
+		uint64_t emptyWaits = 0; // pops that had to wait for an item
+		size_t maxSize = 0;
+	};
+
+private:
+	struct Entry {
+		double priority;
+		uint32_t slot;
+		uint32_t generation;
+		bool operator<(const Entry& other) const {
+			return priority > other.priority; // std heap functions keep the greatest on top, this makes it the lowest priority value
+		}
+	};
+
+	struct Slot {
+		T item {};
+		uint32_t generation = 0; // incremented when its item is popped or cancelled, so that handles and heap entries of that item become stale
+	};
+
+	std::vector<Entry> heap {};
+	std::vector<Slot> slots {};
+	std::vector<uint32_t> freeSlots {};
+	std::atomic<size_t> size {0};
+	bool closed = false;
+
+	mutable std::mutex mutex;
+	std::condition_variable itemAvailable;
+
+	// Metrics
+	mutable std::atomic<uint64_t> lockAcquisitions {0};
+	mutable std::atomic<uint64_t> contendedLockAcquisitions {0};
+	mutable std::atomic<uint64_t> lockWaitNanoseconds {0};
+	std::atomic<uint64_t> pushes {0};
+	std::atomic<uint64_t> pops {0};
+	std::atomic<uint64_t> cancels {0};
+	std::atomic<uint64_t> staleEntriesSkipped {0};
+	std::atomic<uint64_t> compactions {0};
+	std::atomic<uint64_t> reprioritizations {0};
+	std::atomic<uint64_t> emptyWaits {0};
+	std::atomic<size_t> maxSize {0};
+
+	std::unique_lock<std::mutex> Lock() const {
+		std::unique_lock lock(mutex, std::try_to_lock);
+		lockAcquisitions.fetch_add(1, std::memory_order_relaxed);
+		if (!lock.owns_lock()) {
+			const auto start = std::chrono::steady_clock::now();
+			lock.lock();
+			contendedLockAcquisitions.fetch_add(1, std::memory_order_relaxed);
+			lockWaitNanoseconds.fetch_add(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()), std::memory_order_relaxed);
+		}
+		return lock;
+	}
+
+	inline bool IsLive(const Entry& entry) const {
+		return slots[entry.slot].generation == entry.generation;
+	}
+
+	// Frees the slot of a popped or cancelled item, the lock must be held
+	void Release(uint32_t slot) {
+		slots[slot].item = T{};
+		++slots[slot].generation;
+		freeSlots.push_back(slot);
+		size.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	// Rebuilds the heap without stale entries once they are the majority, so that cancelled items do not make it grow forever, the lock must be held
+	void CompactIfNeeded() {
+		const size_t staleEntries = heap.size() - size.load(std::memory_order_relaxed);
+		if (staleEntries <= CHUNK_GENERATOR_QUEUE_MIN_COMPACT_SIZE || staleEntries <= heap.size() / 2) return;
+		heap.erase(std::remove_if(heap.begin(), heap.end(), [this](const Entry& entry){return !IsLive(entry);}), heap.end());
+		std::make_heap(heap.begin(), heap.end());
+		compactions.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Takes the item with the lowest priority value, returns false if there is none, the lock must be held
+	bool PopLocked(T& item) {
+		while (heap.size() > 0) {
+			const Entry top = heap.front();
+			std::pop_heap(heap.begin(), heap.end());
+			heap.pop_back();
+			if (!IsLive(top)) {
+				staleEntriesSkipped.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+			item = slots[top.slot].item;
+			Release(top.slot);
+			pops.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+		return false;
+	}
+
+public:
+
+	// Lower priority values are popped first
+	Handle Push(const T& item, double priority) {
+		auto lock = Lock();
+		uint32_t slot;
+		if (freeSlots.size() > 0) {
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		} else {
+			slot = uint32_t(slots.size());
+			slots.emplace_back();
+		}
+		slots[slot].item = item;
+		const Handle handle {slot, slots[slot].generation};
+		heap.push_back({priority, slot, handle.generation});
+		std::push_heap(heap.begin(), heap.end());
+		const size_t newSize = size.fetch_add(1, std::memory_order_relaxed) + 1;
+		if (newSize > maxSize.load(std::memory_order_relaxed)) maxSize.store(newSize, std::memory_order_relaxed);
+		pushes.fetch_add(1, std::memory_order_relaxed);
+		lock.unlock();
+		itemAvailable.notify_one();
+		return handle;
+	}
+
+	// Returns false if the item was already popped or cancelled (the handle is stale)
+	bool Cancel(const Handle& handle) {
+		auto lock = Lock();
+		if (handle.slot >= slots.size() || slots[handle.slot].generation != handle.generation) return false;
+		Release(handle.slot);
+		cancels.fetch_add(1, std::memory_order_relaxed);
+		CompactIfNeeded();
+		return true;
+	}
+
+	// Takes the item with the lowest priority value, returns false if there is none
+	bool TryPop(T& item) {
+		auto lock = Lock();
+		return PopLocked(item);
+	}
+
+	// Waits for an item and takes the one with the lowest priority value, returns false once the queue is closed even if items are left in it
+	bool WaitPop(T& item) {
+		auto lock = Lock();
+		for (;;) {
+			if (closed) return false;
+			if (PopLocked(item)) return true;
+			emptyWaits.fetch_add(1, std::memory_order_relaxed);
+			itemAvailable.wait(lock, [this]{return closed || size.load(std::memory_order_relaxed) > 0;});
+		}
+	}
+
+	// Recomputes the priority of all items with getPriority(const T&) -> double, in a single pass followed by a linear rebuild of the heap
+	template<typename F>
+	void Reprioritize(F&& getPriority) {
+		auto lock = Lock();
+		size_t count = 0;
+		for (const auto& entry : heap) {
+			if (IsLive(entry)) {
+				heap[count++] = {getPriority(slots[entry.slot].item), entry.slot, entry.generation};
+			}
+		}
+		heap.resize(count);
+		std::make_heap(heap.begin(), heap.end());
+		reprioritizations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Wakes up all threads waiting in WaitPop and makes them return false, until Open is called
+	void Close() {
+		{
+			std::lock_guard lock(mutex);
+			closed = true;
+		}
+		itemAvailable.notify_all();
+	}
+
+	void Open() {
+		std::lock_guard lock(mutex);
+		closed = false;
+	}
+
+	void Clear() {
+		auto lock = Lock();
+		heap.clear();
+		freeSlots.clear();
+		for (uint32_t slot = 0; slot < uint32_t(slots.size()); ++slot) {
+			slots[slot].item = T{};
+			++slots[slot].generation; // handles of cleared items must not match new ones
+			freeSlots.push_back(slot);
+		}
+		size = 0;
+	}
+
+	size_t Size() const {
+		return size.load(std::memory_order_relaxed);
+	}
+
+	Stats GetStats() const {
+		Stats stats {};
+		stats.pushes = pushes.load(std::memory_order_relaxed);
+		stats.pops = pops.load(std::memory_order_relaxed);
+		stats.cancels = cancels.load(std::memory_order_relaxed);
+		stats.staleEntriesSkipped = staleEntriesSkipped.load(std::memory_order_relaxed);
+		stats.compactions = compactions.load(std::memory_order_relaxed);
+		stats.reprioritizations = reprioritizations.load(std::memory_order_relaxed);
+		stats.lockAcquisitions = lockAcquisitions.load(std::memory_order_relaxed);
+		stats.contendedLockAcquisitions = contendedLockAcquisitions.load(std::memory_order_relaxed);
+		stats.lockWaitSeconds = double(lockWaitNanoseconds.load(std::memory_order_relaxed)) / 1e9;
+		stats.emptyWaits = emptyWaits.load(std::memory_order_relaxed);
+		stats.maxSize = maxSize.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	void ResetStats() {
+		pushes = 0;
+		pops = 0;
+		cancels = 0;
+		staleEntriesSkipped = 0;
+		compactions = 0;
+		reprioritizations = 0;
+		lockAcquisitions = 0;
+		contendedLockAcquisitions = 0;
+		lockWaitNanoseconds = 0;
+		emptyWaits = 0;
+		maxSize = Size();
+	}
+};
@@ -6,10 +6,8 @@ Device* PlanetTerrain::renderingDevice = nullptr;
 v4d::Timer PlanetTerrain::lastGarbageCollectionTime {true};
 
 // Chunk Generator
-std::vector<PlanetTerrain::Chunk*> PlanetTerrain::chunkGeneratorQueue {};
+ChunkGeneratorQueue<PlanetTerrain::Chunk*> PlanetTerrain::chunkGeneratorQueue {};
 std::vector<std::thread> PlanetTerrain::chunkGeneratorThreads {};
-std::mutex PlanetTerrain::chunkGeneratorQueueMutex {};
-std::condition_variable PlanetTerrain::chunkGeneratorEventVar {};
 std::atomic<bool> PlanetTerrain::chunkGeneratorActive = false;
 double (*PlanetTerrain::generatorFunction)(TERRAIN_GENERATOR_LIB_HEIGHTMAP_ARGS) = nullptr;
 glm::vec3 (*PlanetTerrain::generateColor)(double heightMap) = nullptr;
@@ -8,6 +8,7 @@
 #include <condition_variable>
 
 #include "CubeToSphere.hpp"
+#include "ChunkGeneratorQueue.hpp"
 // #include "Noise.hpp"
 
 #include "v4d/modules/V4D_raytracing/camera_options.hh"
@@ -39,6 +40,7 @@ struct PlanetTerrain {
 	static constexpr double garbageCollectionInterval = 20; // seconds
 	static constexpr double chunkOptimizationMinMoveDistance = 500; // meters
 	static constexpr double chunkOptimizationMinTimeInterval = 10; // seconds
+	static constexpr double chunkGeneratorReprioritizeMinMoveDistance = 10; // meters
 	static constexpr int CHUNK_CACHE_VERSION = 5;
 	static const bool useSkirts = true;
 	static bool generateAabbChunks;
@@ -62,6 +64,7 @@ struct PlanetTerrain {
 	
 	// Cache
 	glm::dvec3 lastOptimizePosition {0};
+	glm::dvec3 lastReprioritizePosition {0};
 	v4d::Timer lastOptimizeTime {true};
 	static v4d::Timer lastGarbageCollectionTime;
 	// #ifdef _DEBUG
@@ -136,6 +139,7 @@ struct PlanetTerrain {
 		std::atomic<bool> meshEnqueuedForGeneration = false;
 		std::atomic<bool> meshGenerating = false;
 		std::atomic<bool> meshGenerated = false;
+		ChunkGeneratorQueue<Chunk*>::Handle generatorQueueHandle {};
 
 		// std::recursive_mutex stateMutex;
 		std::recursive_mutex subChunksMutex;
@@ -162,6 +166,11 @@ struct PlanetTerrain {
 			return distanceFromCamera > planet->chunkSubdivisionDistanceFactor*chunkSize * 1.1 || (triangleSize < targetVertexSeparationInMeters);
 		}
 		
+		// Screen error of this chunk (distance in triangles), chunks with the lowest one are generated first
+		double GetGeneratorPriority() const {
+			return distanceFromCamera / triangleSize;
+		}
+		
 		void RefreshDistanceFromCamera() {
 			distanceFromCamera = glm::distance(planet->cameraPos, centerPos);
 			if (distanceFromCamera > chunkSize/2.0)
@@ -1105,14 +1114,13 @@ struct PlanetTerrain {
 	};
 	
 	// Chunk Generator
-	static std::vector<Chunk*> chunkGeneratorQueue;
+	static ChunkGeneratorQueue<Chunk*> chunkGeneratorQueue;
 	static std::vector<std::thread> chunkGeneratorThreads;
-	static std::mutex chunkGeneratorQueueMutex;
-	static std::condition_variable chunkGeneratorEventVar;
 	static std::atomic<bool> chunkGeneratorActive;
 	static void StartChunkGenerator() {
 		if (chunkGeneratorActive) return;
 		chunkGeneratorActive = true;
+		chunkGeneratorQueue.Open();
 		uint32_t nbThreads = std::max((uint32_t)1, std::thread::hardware_concurrency() - 4);
 		chunkGeneratorThreads.reserve(nbThreads);
 		LOG_VERBOSE("Using " << nbThreads << " threads to render planet terrain")
@@ -1123,34 +1131,9 @@ struct PlanetTerrain {
 				if (std::thread::hardware_concurrency() > 4) UNSET_CPU_AFFINITY(0, 1, std::thread::hardware_concurrency()/2, std::thread::hardware_concurrency()/2+1)
 				else SET_CPU_AFFINITY(0)
 				
-				while (chunkGeneratorActive) {
-					Chunk* chunk = nullptr;
-					double closestChunkDistance = std::numeric_limits<double>::max();
-					{
-						std::unique_lock lock(chunkGeneratorQueueMutex);
-						chunkGeneratorEventVar.wait(lock, [] {
-							return !chunkGeneratorActive || chunkGeneratorQueue.size() > 0;
-						});
-						if (!chunkGeneratorActive) return;
-						int lastIndex = chunkGeneratorQueue.size()-1;
-						int index = -1;
-						for (int i = lastIndex; i >= 0; --i) {
-							Chunk* c = chunkGeneratorQueue[i];
-							if (c && c->distanceFromCamera < closestChunkDistance) {
-								index = i;
-								chunk = c;
-								closestChunkDistance = c->distanceFromCamera;
-							}
-						}
-						if (!chunk) {
-							continue;
-						}
-						if (index != lastIndex) {
-							chunkGeneratorQueue[index] = chunkGeneratorQueue[lastIndex];
-						}
-						chunkGeneratorQueue.pop_back();
-						chunk->meshEnqueuedForGeneration = false;
-					}
+				Chunk* chunk = nullptr;
+				while (chunkGeneratorQueue.WaitPop(chunk)) {
+					chunk->meshEnqueuedForGeneration = false;
 					std::lock_guard lock(chunk->generatorMutex);
 					if (chunk->meshGenerating) {
 						chunk->Generate();
@@ -1163,20 +1146,21 @@ struct PlanetTerrain {
 	static void EndChunkGenerator() {
 		if (!chunkGeneratorActive) return;
 		chunkGeneratorActive = false;
-		chunkGeneratorEventVar.notify_all();
+		chunkGeneratorQueue.Close();
 		for (auto& thread : chunkGeneratorThreads) {
 			if (thread.joinable()) thread.join();
 		}
-		std::lock_guard lock(chunkGeneratorQueueMutex);
 		chunkGeneratorThreads.clear();
-		chunkGeneratorQueue.clear();
+		chunkGeneratorQueue.Clear();
+		auto stats = chunkGeneratorQueue.GetStats();
+		LOG_VERBOSE("Chunk generator queue: " << stats.pops << " generated, " << stats.cancels << " cancelled, max " << stats.maxSize << " queued, " << stats.contendedLockAcquisitions << "/" << stats.lockAcquisitions << " contended locks (" << stats.lockWaitSeconds << " s)")
+		chunkGeneratorQueue.ResetStats();
 	}
 	static void ChunkGeneratorEnqueue(Chunk* chunk) {
-		std::lock_guard lock(chunkGeneratorQueueMutex);
-		chunkGeneratorQueue.push_back(chunk);
+		// Flags are set before pushing, since a generator thread may pop it right away
 		chunk->meshGenerating = true;
 		chunk->meshEnqueuedForGeneration = true;
-		chunkGeneratorEventVar.notify_all();
+		chunk->generatorQueueHandle = chunkGeneratorQueue.Push(chunk, chunk->GetGeneratorPriority());
 	}
 	static void ChunkGeneratorCancel(Chunk* chunk, bool recursive = false) {
 		if (recursive) {
@@ -1187,17 +1171,7 @@ struct PlanetTerrain {
 				}
 			}
 		}
-		std::lock_guard lock(chunkGeneratorQueueMutex);
-		int lastIndex = chunkGeneratorQueue.size()-1;
-		for (int index = 0; index < chunkGeneratorQueue.size(); ++index) {
-			if (chunkGeneratorQueue[index] == chunk) {
-				if (index != lastIndex) {
-					chunkGeneratorQueue[index] = chunkGeneratorQueue[lastIndex];
-				}
-				chunkGeneratorQueue.pop_back();
-				break;
-			}
-		}
+		chunkGeneratorQueue.Cancel(chunk->generatorQueueHandle);
 		chunk->meshEnqueuedForGeneration = false;
 		chunk->meshGenerating = false;
 	}
@@ -1335,6 +1309,14 @@ struct PlanetTerrain {
 			chunk->Process();
 		}
 		
+		// Distances were refreshed while processing, the chunks still waiting to be generated are sorted again once the camera moved enough
+		if (glm::distance(cameraPos, lastReprioritizePosition) > chunkGeneratorReprioritizeMinMoveDistance && chunkGeneratorQueue.Size() > 0) {
+			lastReprioritizePosition = cameraPos;
+			chunkGeneratorQueue.Reprioritize([](const Chunk* chunk){
+				return chunk->GetGeneratorPriority();
+			});
+		}
+		
 		// for (auto* chunk : chunks) {
 		// 	chunk->BeforeRender();
 		// }
@@ -1394,7 +1376,7 @@ struct PlanetTerrain {
 	
 	void Optimize() {
 		// Optimize only when no chunk is being generated, camera moved at least x distance and not more than once every x seconds
-		if ((PlanetTerrain::chunkGeneratorQueue.size() > 0) || glm::distance(cameraPos, lastOptimizePosition) < chunkOptimizationMinMoveDistance || lastOptimizeTime.GetElapsedSeconds() < chunkOptimizationMinTimeInterval)
+		if ((PlanetTerrain::chunkGeneratorQueue.Size() > 0) || glm::distance(cameraPos, lastOptimizePosition) < chunkOptimizationMinMoveDistance || lastOptimizeTime.GetElapsedSeconds() < chunkOptimizationMinTimeInterval)
 			return;
 		
 		// reset 
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <v4d.h>
+#include <vector>
+#include <array>
+#include <mutex>
+#include <atomic>
+
+#define TERRAIN_HEIGHT_CACHE_DEFAULT_MEMORY_BUDGET (64 * 1024 * 1024) // bytes
+#define TERRAIN_HEIGHT_CACHE_STRIPES 64 // number of independently locked slices of the table, must be a power of two
+#define TERRAIN_HEIGHT_CACHE_PROBE_LENGTH 16 // maximum number of slots checked for a given key, eviction happens within this window
+
+// Fixed-size open-addressing hash table of terrain heights, keyed by (reference frame, quantized position on the terrain sphere).
+// Memory usage is bounded by the budget given at construction; when the probe window of a key is full, a victim is chosen with the CLOCK algorithm.
+// The table is only allocated by the first query, so that processes which never run the server physics do not pay for it.
+// The table is split into lock stripes so that several physics threads may query it at once. Heights are generated outside of the lock.
+class TerrainHeightCache {
+	struct Slot {
+		uint64_t referenceFrame;
+		int32_t x, y, z;
+		bool occupied;
+		bool referenced;
+		double height;
+	};
+
+	struct alignas(64) Stripe {
+		std::mutex mu;
+		size_t clockHand = 0;
+	};
+
+	std::vector<Slot> slots {};
+	size_t slotsPerStripe;
+	std::once_flag allocateOnce;
+	std::atomic<bool> allocated {false};
+	std::array<Stripe, TERRAIN_HEIGHT_CACHE_STRIPES> stripes {};
+
+	std::atomic<uint64_t> hits {0};
+	std::atomic<uint64_t> misses {0};
+	std::atomic<uint64_t> evictions {0};
+
+	static inline uint64_t Hash(uint64_t referenceFrame, const glm::ivec3& pos) {
+		uint64_t h = referenceFrame * 0x9E3779B97F4A7C15ull;
+		h ^= uint64_t(uint32_t(pos.x)) * 0xC2B2AE3D27D4EB4Full;
+		h ^= uint64_t(uint32_t(pos.y)) * 0x165667B19E3779F9ull;
+		h ^= uint64_t(uint32_t(pos.z)) * 0x27D4EB2F165667C5ull;
+		return h ^ (h >> 29);
+	}
+
+	static inline bool Matches(const Slot& slot, uint64_t referenceFrame, const glm::ivec3& pos) {
+		return slot.referenceFrame == referenceFrame && slot.x == pos.x && slot.y == pos.y && slot.z == pos.z;
+	}
+
+	void Allocate() {
+		std::call_once(allocateOnce, [this]{
+			slots.resize(slotsPerStripe * TERRAIN_HEIGHT_CACHE_STRIPES, Slot{0,0,0,0,false,false,0});
+			allocated.store(true, std::memory_order_release);
+		});
+	}
+
+public:
+	TerrainHeightCache(size_t memoryBudget = TERRAIN_HEIGHT_CACHE_DEFAULT_MEMORY_BUDGET) {
+		// Round down to a power of two number of slots per stripe
+		slotsPerStripe = TERRAIN_HEIGHT_CACHE_PROBE_LENGTH;
+		while (slotsPerStripe * 2 * TERRAIN_HEIGHT_CACHE_STRIPES * sizeof(Slot) <= memoryBudget) slotsPerStripe *= 2;
+	}
+
+	// Returns the cached height at the given position, or calls generate() and caches its result on a miss
+	template<typename F>
+	double Get(uint64_t referenceFrame, const glm::ivec3& pos, F&& generate) {
+		Allocate();
+		const uint64_t hash = Hash(referenceFrame, pos);
+		const size_t stripeIndex = hash & (TERRAIN_HEIGHT_CACHE_STRIPES - 1);
+		const size_t mask = slotsPerStripe - 1;
+		const size_t start = (hash >> 6) & mask;
+		Stripe& stripe = stripes[stripeIndex];
+		Slot* stripeSlots = &slots[stripeIndex * slotsPerStripe];
+
+		{// Lookup
+			std::lock_guard lock(stripe.mu);
+			for (size_t i = 0; i < TERRAIN_HEIGHT_CACHE_PROBE_LENGTH; ++i) {
+				Slot& slot = stripeSlots[(start + i) & mask];
+				// Slots are never emptied, so an empty slot ends the probe sequence
+				if (!slot.occupied) break;
+				if (Matches(slot, referenceFrame, pos)) {
+					slot.referenced = true;
+					++hits;
+					return slot.height;
+				}
+			}
+		}
+
+		++misses;
+		const double height = generate();
+
+		{// Insert
+			std::lock_guard lock(stripe.mu);
+			Slot* victim = nullptr;
+			for (size_t i = 0; i < TERRAIN_HEIGHT_CACHE_PROBE_LENGTH; ++i) {
+				Slot& slot = stripeSlots[(start + i) & mask];
+				if (!slot.occupied || Matches(slot, referenceFrame, pos)) {
+					// Empty, or inserted by another thread in the meantime
+					victim = &slot;
+					break;
+				}
+			}
+			if (!victim) {
+				// CLOCK: sweep the probe window, giving a second chance to recently referenced slots
+				for (size_t i = 0; ; ++i) {
+					Slot& slot = stripeSlots[(start + (stripe.clockHand++ % TERRAIN_HEIGHT_CACHE_PROBE_LENGTH)) & mask];
+					if (!slot.referenced || i >= TERRAIN_HEIGHT_CACHE_PROBE_LENGTH) {
+						victim = &slot;
+						break;
+					}
+					slot.referenced = false;
+				}
+				++evictions;
+			}
+			*victim = {referenceFrame, pos.x, pos.y, pos.z, true, false, height};
+		}
+
+		return height;
+	}
+
+	void Clear() {
+		for (auto& stripe : stripes) stripe.mu.lock();
+		// Nothing to clear before the first query, a table being allocated concurrently starts empty anyway
+		if (allocated.load(std::memory_order_acquire)) {
+			for (auto& slot : slots) slot.occupied = false;
+		}
+		for (auto& stripe : stripes) stripe.mu.unlock();
+		hits = 0;
+		misses = 0;
+		evictions = 0;
+	}
+
+	size_t GetCapacity() const {return slotsPerStripe * TERRAIN_HEIGHT_CACHE_STRIPES;}
+	size_t GetMemoryUsage() const {return allocated.load(std::memory_order_acquire)? GetCapacity() * sizeof(Slot) : 0;}
+	uint64_t GetHits() const {return hits.load(std::memory_order_relaxed);}
+	uint64_t GetMisses() const {return misses.load(std::memory_order_relaxed);}
+	uint64_t GetEvictions() const {return evictions.load(std::memory_order_relaxed);}
+	double GetHitRatio() const {
+		const uint64_t h = GetHits(), m = GetMisses();
+		return (h + m) > 0 ? double(h) / double(h + m) : 0.0;
+	}
+};
@@ -6,6 +6,7 @@
 #include "v4d/game/ClientSideEntity.hpp"
 #include "v4d/game/ServerSidePlayer.hpp"
 #include "v4d/game/Collider.hpp"
+#include "v4d/game/PacketPool.hpp"
 
 #include "utilities/io/Logger.h"
 #include "utilities/graphics/vulkan/RenderPass.h"
@@ -17,6 +18,7 @@
 
 #include "celestials/Planet.h"
 #include "TerrainGeneratorLib.h"
+#include "PhysicsReplay.hpp"
 
 
 #include "utilities/scene/GltfModelLoader.h"
@@ -78,11 +80,23 @@ Entity::Id clientSidePlayerEntityID = -1;
 		const uint32_t Ball = 1;
 	}
 
-	std::recursive_mutex serverActionQueueMutex;
-	std::unordered_map<uint64_t /* clientID */, std::queue<v4d::data::Stream>> serverActionQueuePerClient {};
-	void ServerEnqueueAction(uint64_t clientId, v4d::data::WriteOnlyStream& stream) {
-		std::lock_guard lock(serverActionQueueMutex);
-		serverActionQueuePerClient[clientId].emplace(stream);
+	ServerSideEntity::Ptr CreatePlayerEntity(uint64_t clientId, Entity::ReferenceFrame referenceFrame, const Entity::Position& position) {
+		ServerSidePlayer::Ptr player = ServerSidePlayer::Create(clientId);
+		ServerSideEntity::Ptr entity = ServerSideEntity::Create(-1, THIS_MODULE, OBJECT_TYPE::Player, referenceFrame);
+		entity->SetDynamic();
+		player->parentEntityId = entity->GetID();
+		auto rb = entity->Add_rigidbody(10.0);
+		rb->boundingRadius = 0.4;
+		rb->SetOrientationLocked();
+		entity->colliders.emplace("head", std::make_unique<SphereCollider>(0.4));
+		entity->position = position;
+		return entity;
+	}
+
+	PacketPool<v4d::data::WriteOnlyStream> serverActionPool {128}; // initial capacity of pooled action streams, enough for ASSIGN_PLAYER_OBJ
+	PacketQueues<v4d::data::WriteOnlyStream> serverActionQueuePerClient {};
+	void ServerEnqueueAction(uint64_t clientId, const PacketPool<v4d::data::WriteOnlyStream>::Ref& packet) {
+		serverActionQueuePerClient.Push(clientId, packet);
 	}
 
 	std::recursive_mutex clientActionQueueMutex;
@@ -92,6 +106,8 @@ Entity::Id clientSidePlayerEntityID = -1;
 		clientActionQueue.emplace(stream);
 	}
 
+	PhysicsReplay physicsReplay {};
+
 #pragma endregion
 
 #pragma region Galaxy
@@ -322,6 +338,7 @@ V4D_MODULE_CLASS(V4D_Mod) {
 	}
 	
 	V4D_MODULE_FUNC(void, UnloadScene) {
+		serverActionQueuePerClient.Clear();
 		if (galaxyBackgroundShader) delete galaxyBackgroundShader;
 		if (galaxyFadeShader) delete galaxyFadeShader;
 	}
@@ -363,15 +380,12 @@ V4D_MODULE_CLASS(V4D_Mod) {
 #pragma region Networking
 	
 	V4D_MODULE_FUNC(void, ServerSendActions, v4d::io::SocketPtr stream, v4d::networking::IncomingClientPtr client) {
-		std::scoped_lock lock(serverActionQueueMutex);
-		auto& actionQueue = serverActionQueuePerClient[client->id];
-		while (actionQueue.size()) {
+		serverActionQueuePerClient.Drain(client->id, [&stream](v4d::data::WriteOnlyStream& packet){
 			// LOG_DEBUG("Server SendActionFromQueue for client " << client->id)
 			stream->Begin();
-				stream->EmplaceStream(actionQueue.front());
+				stream->EmplaceStream(packet);
 			stream->End();
-			actionQueue.pop();
-		}
+		});
 	}
 	
 	V4D_MODULE_FUNC(void, ClientSendActions, v4d::io::SocketPtr stream) {
@@ -393,16 +407,6 @@ V4D_MODULE_CLASS(V4D_Mod) {
 		glm::dvec3 worldPosition = GetDefaultWorldPosition();
 		
 		LOG("Server: IncomingClient " << client->id)
-		Entity::Id playerEntityId;
-		ServerSidePlayer::Ptr player = ServerSidePlayer::Create(client->id);
-		ServerSideEntity::Ptr entity = ServerSideEntity::Create(-1, THIS_MODULE, OBJECT_TYPE::Player, defaultPosition.rawValue);
-		playerEntityId = entity->GetID();
-		entity->SetDynamic();
-		player->parentEntityId = playerEntityId;
-		auto rb = entity->Add_rigidbody(10.0);
-		rb->boundingRadius = 0.4;
-		rb->SetOrientationLocked();
-		entity->colliders.emplace("head", std::make_unique<SphereCollider>(0.4));
 		
 		// Set player position
 		if (defaultPosition.IsCelestial()) {
@@ -416,11 +420,24 @@ V4D_MODULE_CLASS(V4D_Mod) {
 		auto upVector = glm::normalize(worldPosition);
 		auto rightVector = glm::cross(forwardVector, upVector);
 		worldPosition += rightVector * (double)client->id;
-		entity->position = worldPosition;
 		
-		entity->Activate();
+		ServerSideEntity::Ptr entity = CreatePlayerEntity(client->id, defaultPosition.rawValue, worldPosition);
+		Entity::Id playerEntityId = entity->GetID();
 		
-		v4d::data::WriteOnlyStream stream(sizeof(networking::action::Action) + sizeof(playerEntityId));
+		if (PhysicsReplay::IsQueueingInputs()) {
+			// The entity is activated by the physics thread at the beginning of its next tick
+			PhysicsInput input {};
+			input.type = PhysicsInput::PLAYER_JOINED;
+			input.clientId = client->id;
+			input.referenceFrame = defaultPosition.rawValue;
+			input.position = worldPosition;
+			physicsReplay.Enqueue(input);
+		} else {
+			entity->Activate();
+		}
+		
+		auto packet = serverActionPool.Acquire();
+		auto& stream = *packet;
 			stream << networking::action::ASSIGN_PLAYER_OBJ;
 			stream << playerEntityId;
 			stream << v4d::Timer::GetCurrentTimestamp();
@@ -430,7 +447,7 @@ V4D_MODULE_CLASS(V4D_Mod) {
 			stream << defaultPosition.IsCelestial();
 			stream << v4d::TextID("head").numericValue;
 		
-		ServerEnqueueAction(client->id, stream);
+		ServerEnqueueAction(client->id, packet);
 	}
 	
 	V4D_MODULE_FUNC(void, ServerReceiveAction, v4d::io::SocketPtr stream, v4d::networking::IncomingClientPtr client) {
@@ -479,21 +496,17 @@ V4D_MODULE_CLASS(V4D_Mod) {
 		switch (action) {
 			case SYNC_PLAYER_MOTION:{
 				auto id = stream->Read<Entity::Id>();
-				auto orientation = stream->Read<Entity::Orientation>();
-				auto acceleration = stream->Read<typeof(playerView->velocity)>();
-				bool brakes = stream->Read<bool>();
+				PhysicsInput input {};
+				input.type = PhysicsInput::PLAYER_MOTION;
+				input.clientId = client->id;
+				input.orientation = stream->Read<Entity::Orientation>();
+				input.acceleration = stream->Read<typeof(playerView->velocity)>();
+				input.brakes = stream->Read<bool>();
 				if (ServerSidePlayer::Ptr player = ServerSidePlayer::Get(client->id); player && player->parentEntityId == id) {
-					if (ServerSideEntity::Ptr entity = ServerSideEntity::Get(id); entity) {
-						entity->orientation = orientation;
-						if (auto rigidbody = entity->rigidbody.Lock(); rigidbody) {
-							if (glm::dot(acceleration,acceleration) > 0) {
-								rigidbody->ApplyImpulse(acceleration);
-							} else if (brakes) {
-								rigidbody->linearVelocity *= 0.5;
-								if (glm::length(rigidbody->linearVelocity) < 0.0001) rigidbody->linearVelocity = {0,0,0};
-							}
-							rigidbody->angularVelocity = {0,0,0};
-						}
+					if (PhysicsReplay::IsQueueingInputs()) {
+						physicsReplay.Enqueue(input);
+					} else {
+						ApplyPhysicsInput(input);
 					}
 				}
 			}break;
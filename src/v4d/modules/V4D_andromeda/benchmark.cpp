@@ -0,0 +1,238 @@
+#include <v4d.h>
+#include <V4D_Mod.h>
+
+#include "utilities/io/Logger.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "v4d/game/Entity.h"
+#include "v4d/game/ServerSideEntity.hpp"
+#include "v4d/game/Collider.hpp"
+#include "v4d/game/Game.h"
+#include "v4d/game/random.hh"
+
+#include "GalaxyGenerator.h"
+#include "GalacticPosition.hpp"
+#include "celestials/Planet.h"
+#include "TerrainGeneratorLib.h"
+#include "PhysicsTimings.hpp"
+
+// Defined in andromeda.cpp
+GalacticPosition GetDefaultGalacticPosition();
+glm::dvec4 GetDefaultWorldPosition();
+
+const uint32_t BENCHMARK_OBJECT_TYPE = 1; // same as andromeda's balls, so that gravity applies
+
+enum class BenchmarkBodyShape {Sphere, Box, Capsule};
+
+ServerSideEntity::Ptr SpawnBody(BenchmarkBodyShape shape, Entity::ReferenceFrame referenceFrame, const glm::dvec3& position, const glm::dquat& orientation = {1,0,0,0}) {
+	ServerSideEntity::Ptr entity = ServerSideEntity::Create(-1, THIS_MODULE, BENCHMARK_OBJECT_TYPE, referenceFrame);
+	entity->position = position;
+	entity->orientation = orientation;
+	switch (shape) {
+		case BenchmarkBodyShape::Sphere:{
+			auto rigidbody = entity->Add_rigidbody(Rigidbody::SphereInertia(1.0f/*mass*/, 0.5f/*radius*/));
+			rigidbody->boundingRadius = 0.5;
+			entity->colliders.emplace("root", std::make_unique<SphereCollider>(0.5f));
+		}break;
+		case BenchmarkBodyShape::Box:{
+			auto rigidbody = entity->Add_rigidbody(Rigidbody::BoxInertia(2.0f/*mass*/, 1,1,1));
+			rigidbody->boundingRadius = 0.87;
+			entity->colliders.emplace("root", std::make_unique<BoxCollider>(glm::dvec3(0), glm::dmat3(1), glm::vec3{0.5f, 0.5f, 0.5f}));
+		}break;
+		case BenchmarkBodyShape::Capsule:{
+			auto rigidbody = entity->Add_rigidbody(Rigidbody::CylinderInertia(1.0f/*mass*/, 0.3f/*radiusXY*/, 1.0f/*heightZ*/));
+			rigidbody->boundingRadius = 0.8;
+			entity->colliders.emplace("root", std::make_unique<CapsuleCollider>(glm::dvec3(0), glm::dmat3(1), 1.0f/*length*/, 0.3f/*radius*/));
+		}break;
+	}
+	entity->SetDynamic();
+	entity->Activate();
+	return entity;
+}
+
+// Local frame on the surface of the default planet, bodies are placed relative to the terrain height at their own position
+struct BenchmarkPlanetSurface {
+	Entity::ReferenceFrame referenceFrame = 0;
+	std::shared_ptr<Celestial> celestial = nullptr;
+	const Planet* planet = nullptr;
+	glm::dvec3 origin {0};
+	glm::dvec3 up {0,0,1};
+	glm::dvec3 right {1,0,0};
+	glm::dvec3 forward {0,1,0};
+
+	bool Init() {
+		const GalacticPosition galacticPosition = GetDefaultGalacticPosition();
+		referenceFrame = galacticPosition.rawValue;
+		celestial = GalaxyGenerator::GetCelestial(galacticPosition);
+		planet = dynamic_cast<const Planet*>(celestial.get());
+		if (!planet) return false;
+		up = glm::normalize(glm::dvec3(GetDefaultWorldPosition()));
+		right = glm::normalize(glm::cross(glm::dvec3(0,1,0), up));
+		forward = glm::cross(up, right);
+		origin = up * planet->GetTerrainHeightAtPos(up);
+		return true;
+	}
+
+	// Position at the given distance above the terrain, x and y being along the surface
+	glm::dvec3 At(double x, double y, double altitude) const {
+		const glm::dvec3 normalizedPos = glm::normalize(origin + right * x + forward * y);
+		return normalizedPos * (planet->GetTerrainHeightAtPos(normalizedPos) + altitude);
+	}
+
+	glm::dquat Orientation() const {
+		return glm::quat_cast(glm::dmat3(right, forward, up));
+	}
+};
+
+// Piles of mixed shapes dropped on the terrain
+bool SpawnPile(int bodies, std::vector<ServerSideEntity::Ptr>& entities) {
+	BenchmarkPlanetSurface surface;
+	if (!surface.Init()) return false;
+	const int side = glm::max(1, int(glm::sqrt(double(bodies) / 10)));
+	constexpr double spacing = 1.2;
+	for (int i = 0; i < bodies; ++i) {
+		const int layer = i / (side*side);
+		const int x = i % side;
+		const int y = (i / side) % side;
+		// every other layer is offset so that bodies don't land exactly on top of each other
+		const double offset = (layer % 2) * spacing * 0.5;
+		entities.push_back(SpawnBody(BenchmarkBodyShape(i % 3), surface.referenceFrame, surface.At(x * spacing + offset, y * spacing + offset, 1.0 + layer * spacing), surface.Orientation()));
+	}
+	return true;
+}
+
+// Towers of boxes stacked on the terrain, 10 boxes high
+bool SpawnTowers(int bodies, std::vector<ServerSideEntity::Ptr>& entities) {
+	BenchmarkPlanetSurface surface;
+	if (!surface.Init()) return false;
+	constexpr int height = 10;
+	constexpr double spacing = 3.0;
+	const int side = glm::max(1, int(glm::ceil(glm::sqrt(double(bodies) / height))));
+	for (int i = 0; i < bodies; ++i) {
+		const int tower = i / height;
+		const int level = i % height;
+		const glm::dvec3 base = surface.At((tower % side) * spacing, (tower / side) * spacing, 0.5);
+		entities.push_back(SpawnBody(BenchmarkBodyShape::Box, surface.referenceFrame, base + surface.up * (level * 1.0), surface.Orientation()));
+	}
+	return true;
+}
+
+// Free-floating bodies with random velocities, away from any celestial so that there is no gravity nor terrain
+bool SpawnSwarm(int bodies, std::vector<ServerSideEntity::Ptr>& entities) {
+	constexpr double bodiesPerCubicMeter = 0.05;
+	const double size = glm::pow(double(bodies) / bodiesPerCubicMeter, 1.0/3.0);
+	uint seed = 0;
+	for (int i = 0; i < bodies; ++i) {
+		const glm::dvec3 position = glm::dvec3(RandomFloat(seed), RandomFloat(seed), RandomFloat(seed)) * size;
+		auto entity = SpawnBody(BenchmarkBodyShape(i % 3), 0, position);
+		if (auto rigidbody = entity->rigidbody.Lock(); rigidbody) {
+			rigidbody->linearVelocity = glm::dvec3(RandomInUnitCube(seed)) * 2.0;
+		}
+		entities.push_back(entity);
+	}
+	return true;
+}
+
+void DestroyBodies(std::vector<ServerSideEntity::Ptr>& entities) {
+	for (auto& entity : entities) {
+		entity->Deactivate();
+		entity->Destroy();
+	}
+	entities.clear();
+}
+
+// Runs the andromeda server physics on generated scenes without any other module, and prints the time per tick of each stage as JSON
+int physicsbenchmark(const std::string& scene, int bodies, int ticks, double timestep, int threads) {
+	auto mod = V4D_Mod::GetModule(THIS_MODULE);
+	if (!mod || !mod->ServerPhysicsUpdate) return -1;
+
+	const std::vector<std::string> allScenes {"pile", "tower", "swarm"};
+	std::vector<std::string> scenes;
+	if (scene == "all") scenes = allScenes;
+	else if (std::find(allScenes.begin(), allScenes.end(), scene) != allScenes.end()) scenes.push_back(scene);
+	else {
+		LOG_ERROR("Unknown benchmark scene '" << scene << "', must be one of: pile, tower, swarm, all")
+		return -1;
+	}
+
+	// Makes runs comparable with one another, the settings of the application are restored afterwards
+	const bool previousDeterministic = GameConfig::physicsDeterministic;
+	const double previousFixedTimestep = GameConfig::physicsFixedTimestep;
+	const int previousThreads = GameConfig::physicsThreads;
+	GameConfig::physicsDeterministic = true;
+	GameConfig::physicsFixedTimestep = timestep;
+	GameConfig::physicsThreads = threads;
+	TerrainGeneratorLib::Load();
+
+	int ret = 0;
+	std::vector<ServerSideEntity::Ptr> entities;
+	std::cout << "[\n";
+	for (size_t s = 0; s < scenes.size(); ++s) {
+		bool spawned = false;
+		if (scenes[s] == "pile") spawned = SpawnPile(bodies, entities);
+		if (scenes[s] == "tower") spawned = SpawnTowers(bodies, entities);
+		if (scenes[s] == "swarm") spawned = SpawnSwarm(bodies, entities);
+		if (!spawned) {
+			LOG_ERROR("Failed to spawn benchmark scene " << scenes[s])
+			DestroyBodies(entities);
+			ret = -1;
+			continue;
+		}
+
+		// First tick builds the collider cache
+		mod->ServerPhysicsUpdate(timestep);
+
+		physicsTimings.Reset();
+		physicsTimings.enabled = true;
+		v4d::Timer t(true);
+		for (int i = 0; i < ticks; ++i) {
+			mod->ServerPhysicsUpdate(timestep);
+		}
+		const double totalTime = t.GetElapsedSeconds();
+		physicsTimings.enabled = false;
+
+		size_t sleepingBodies = 0;
+		for (auto& entity : entities) if (entity->IsSleeping()) ++sleepingBodies;
+
+		const double nsPerTick = 1e9 / glm::max(1, ticks);
+		std::cout << "\t{\n"
+			<< "\t\t\"scene\": \"" << scenes[s] << "\",\n"
+			<< "\t\t\"bodies\": " << bodies << ",\n"
+			<< "\t\t\"ticks\": " << ticks << ",\n"
+			<< "\t\t\"timestep\": " << timestep << ",\n"
+			<< "\t\t\"threads\": " << GameConfig::GetPhysicsThreadCount() << ",\n"
+			<< "\t\t\"ns_per_tick\": {\n"
+			<< "\t\t\t\"total\": " << uint64_t(totalTime * nsPerTick) << ",\n"
+			<< "\t\t\t\"broadphase\": " << uint64_t(physicsTimings.broadphase * nsPerTick) << ",\n"
+			<< "\t\t\t\"narrowphase\": " << uint64_t(physicsTimings.narrowphase * nsPerTick) << ",\n"
+			<< "\t\t\t\"solver\": " << uint64_t(physicsTimings.solver * nsPerTick) << ",\n"
+			<< "\t\t\t\"terrain\": " << uint64_t(physicsTimings.terrain * nsPerTick) << ",\n"
+			<< "\t\t\t\"sleep\": " << uint64_t(physicsTimings.sleep * nsPerTick) << ",\n"
+			<< "\t\t\t\"integration\": " << uint64_t(physicsTimings.integration * nsPerTick) << ",\n"
+			<< "\t\t\t\"entity_update\": " << uint64_t(physicsTimings.entityUpdate * nsPerTick) << ",\n"
+			<< "\t\t\t\"collision_dispatch\": " << uint64_t(physicsTimings.collisionDispatch * nsPerTick) << "\n"
+			<< "\t\t},\n"
+			<< "\t\t\"collision_pairs_per_tick\": " << (double(physicsTimings.collisionPairs) / glm::max(1, ticks)) << ",\n"
+			<< "\t\t\"terrain_cache\": {\n"
+			<< "\t\t\t\"hits\": " << physicsTimings.terrainCacheHits << ",\n"
+			<< "\t\t\t\"misses\": " << physicsTimings.terrainCacheMisses << ",\n"
+			<< "\t\t\t\"hit_ratio\": " << (double(physicsTimings.terrainCacheHits) / glm::max(uint64_t(1), physicsTimings.terrainCacheHits + physicsTimings.terrainCacheMisses)) << "\n"
+			<< "\t\t},\n"
+			<< "\t\t\"sleeping_bodies\": " << sleepingBodies << "\n"
+			<< "\t}" << (s+1 < scenes.size()? "," : "") << "\n";
+
+		DestroyBodies(entities);
+		// Lets the physics release the destroyed bodies before the next scene
+		mod->ServerPhysicsUpdate(timestep);
+	}
+	std::cout << "]" << std::endl;
+
+	TerrainGeneratorLib::Unload();
+	GameConfig::physicsDeterministic = previousDeterministic;
+	GameConfig::physicsFixedTimestep = previousFixedTimestep;
+	GameConfig::physicsThreads = previousThreads;
+	return ret;
+}
@@ -3,12 +3,28 @@
 
 #include "utilities/io/Logger.h"
 
+#include <iomanip>
+
 #include "GalaxyGenerator.h"
 #include "Celestial.h"
 #include "StarSystem.h"
 
 #include "noise_functions.hpp"
 
+#include "v4d/game/physics.hh"
+#include "v4d/game/Broadphase.hpp"
+#include "v4d/game/Collider.hpp"
+#include "v4d/game/Narrowphase.hpp"
+#include "v4d/game/RigidbodyPool.hpp"
+#include "v4d/game/Game.h"
+
+#include "TerrainGeneratorLib.h"
+#include "PlanetRenderer/ChunkGeneratorQueue.hpp"
+#include "PhysicsReplay.hpp"
+
+// Defined in benchmark.cpp
+int physicsbenchmark(const std::string& scene, int bodies, int ticks, double timestep, int threads);
+
 int starsystem(uint32_t x, uint32_t y, uint32_t z) {
 	std::string tabs {""};
 	auto displayCelestialInfo = [&tabs](Celestial* celestial) {
@@ -208,6 +224,432 @@ int stats() {
 	return 0;
 }
 
+int broadphase(int minBodies, int maxBodies) {
+	// Bodies are spread in a cube sized to keep a constant density, similar to a busy area of a planet surface
+	constexpr double bodiesPerCubicMeter = 0.002;
+	constexpr int maxBruteForceBodies = 20'000;
+	constexpr int frames = 10;
+	
+	std::cout << "bodies\tpairs\tbruteforce(ms)\tbuild(ms)\tpairs(ms)\tupdate(ms)\n";
+	for (int n = minBodies; n <= maxBodies; n = (n*2 == 400 || n*2 == 4'000 || n*2 == 40'000)? n*5/2 : n*2) {
+		const double size = glm::pow(double(n) / bodiesPerCubicMeter, 1.0/3.0);
+		uint seed = 0;
+		std::vector<BroadphaseCollider> colliders {};
+		std::vector<glm::dvec3> velocities {};
+		colliders.reserve(n);
+		velocities.reserve(n);
+		for (int i = 0; i < n; ++i) {
+			colliders.emplace_back(glm::dvec3{RandomFloat(seed)*size, RandomFloat(seed)*size, RandomFloat(seed)*size}, 0.5 + RandomFloat(seed)*2.5, Entity::Id(i));
+			velocities.emplace_back(RandomFloat(seed)-0.5, RandomFloat(seed)-0.5, RandomFloat(seed)-0.5);
+		}
+		
+		// Reference O(n²) broadphase, same test as the one used in physics before the spatial hash
+		std::vector<std::pair<Entity::Id, Entity::Id>> bruteForcePairs {};
+		double bruteForceTime = -1;
+		if (n <= maxBruteForceBodies) {
+			v4d::Timer t(true);
+			for (size_t a = 0; a < colliders.size(); ++a) {
+				for (size_t b = a+1; b < colliders.size(); ++b) {
+					const float radiusSum = colliders[a].radius + colliders[b].radius;
+					const glm::vec3 d = colliders[b].position - colliders[a].position;
+					if (glm::dot(d,d) < radiusSum*radiusSum) {
+						bruteForcePairs.emplace_back(colliders[a].id, colliders[b].id);
+					}
+				}
+			}
+			bruteForceTime = t.GetElapsedSeconds() * 1000.0;
+		}
+		
+		// Spatial hash
+		Broadphase grid {};
+		std::vector<Broadphase::ProxyIndex> proxies {};
+		proxies.reserve(n);
+		v4d::Timer t(true);
+		for (auto& collider : colliders) {
+			proxies.push_back(grid.Insert(0, collider));
+		}
+		const double buildTime = t.GetElapsedSeconds() * 1000.0;
+		
+		std::vector<std::pair<Entity::Id, Entity::Id>> gridPairs {};
+		t.Reset();
+		grid.ForEachPair([&gridPairs](const BroadphaseCollider& a, const BroadphaseCollider& b){
+			gridPairs.emplace_back(std::min(a.id, b.id), std::max(a.id, b.id));
+		});
+		const double pairsTime = t.GetElapsedSeconds() * 1000.0;
+		
+		// Move all bodies at roughly 1 m/s at 60 fps
+		t.Reset();
+		for (int frame = 0; frame < frames; ++frame) {
+			for (int i = 0; i < n; ++i) {
+				colliders[i].position += velocities[i] / 60.0;
+				grid.Update(proxies[i], colliders[i].position);
+			}
+		}
+		const double updateTime = t.GetElapsedSeconds() * 1000.0 / frames;
+		
+		std::cout << n << "\t" << gridPairs.size() << "\t";
+		if (bruteForceTime >= 0) std::cout << bruteForceTime; else std::cout << "-";
+		std::cout << "\t" << buildTime << "\t" << pairsTime << "\t" << updateTime << "\n";
+		
+		if (bruteForceTime >= 0) {
+			std::sort(gridPairs.begin(), gridPairs.end());
+			std::sort(bruteForcePairs.begin(), bruteForcePairs.end());
+			if (gridPairs != bruteForcePairs) {
+				LOG_ERROR("Broadphase mismatch with " << n << " bodies: " << gridPairs.size() << " pairs instead of " << bruteForcePairs.size())
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+int narrowphase(int iterations) {
+	struct Shape {
+		std::string name;
+		std::function<std::unique_ptr<Collider>()> create;
+	};
+	const std::vector<Shape> shapes {
+		{"sphere", []{return std::make_unique<SphereCollider>(0.5f);}},
+		{"box", []{return std::make_unique<BoxCollider>(glm::dvec3(0), glm::dmat3(1), glm::vec3{0.5f, 0.4f, 0.3f});}},
+		{"capsule", []{return std::make_unique<CapsuleCollider>(glm::dvec3(0), glm::dmat3(1), 1.0f, 0.2f);}},
+		{"cylinder", []{return std::make_unique<CylinderCollider>(glm::dvec3(0), glm::dmat3(1), 1.0f, 0.3f);}},
+		{"cone", []{return std::make_unique<ConeCollider>(glm::dvec3(0), glm::dmat3(1), 1.0f, 0.4f, 0.1f);}},
+		{"wedge", []{return std::make_unique<WedgeCollider>(glm::dvec3(0), glm::dmat3(1), glm::vec3{0.5f, 0.4f, 0.3f}, 0xf3/*without the two top back corners*/);}},
+	};
+	
+	std::cout << "pair\tcontacts\tanalytic(us)\trays(us)\trays contacts\tnormal spread\n";
+	for (size_t a = 0; a < shapes.size(); ++a) for (size_t b = a; b < shapes.size(); ++b) {
+		auto colliderA = shapes[a].create();
+		auto colliderB = shapes[b].create();
+		const auto contactGenerator = Narrowphase::GetContactGenerator(colliderA->GetType(), colliderB->GetType());
+		if (!contactGenerator) continue;
+		
+		// Same random poses for both methods, with bodies close enough to overlap most of the time
+		uint seed = 0;
+		std::vector<std::pair<Entity, Entity>> poses(iterations);
+		for (auto&[entityA, entityB] : poses) {
+			entityA.orientation = glm::normalize(glm::dquat(RandomFloat(seed)*2-1, RandomFloat(seed)*2-1, RandomFloat(seed)*2-1, RandomFloat(seed)*2-1));
+			entityB.orientation = glm::normalize(glm::dquat(RandomFloat(seed)*2-1, RandomFloat(seed)*2-1, RandomFloat(seed)*2-1, RandomFloat(seed)*2-1));
+			entityB.position = glm::dvec3(RandomInUnitSphere(seed)) * 0.8;
+		}
+		
+		CollisionInfo collision;
+		int analyticContacts = 0;
+		v4d::Timer t(true);
+		for (auto&[entityA, entityB] : poses) {
+			if (contactGenerator(colliderA.get(), &entityA, colliderB.get(), &entityB, collision)) ++analyticContacts;
+		}
+		const double analyticTime = t.GetElapsedSeconds() * 1'000'000.0 / iterations;
+		
+		// Ray path in both directions, as done in physics before contact generators
+		int rayContacts = 0;
+		glm::dvec3 normalSum {0};
+		double normalCount = 0;
+		std::vector<Ray> rays {};
+		uint randomSeed = 0;
+		t.Reset();
+		for (auto&[entityA, entityB] : poses) {
+			rays.clear();
+			colliderA->GenerateCollisionRays(&entityA, "root", rays, randomSeed);
+			for (const auto& ray : rays) if (colliderB->RayCollision(ray, &entityB, collision)) ++rayContacts;
+			rays.clear();
+			colliderB->GenerateCollisionRays(&entityB, "root", rays, randomSeed);
+			for (const auto& ray : rays) if (colliderA->RayCollision(ray, &entityA, collision)) ++rayContacts;
+		}
+		const double raysTime = t.GetElapsedSeconds() * 1'000'000.0 / iterations;
+		
+		// Contact stability: spread of the normals generated by the ray path over the same pose, repeated with different random rays
+		double spread = 0;
+		{
+			auto&[entityA, entityB] = poses[0];
+			for (int i = 0; i < 100; ++i) {
+				rays.clear();
+				colliderA->GenerateCollisionRays(&entityA, "root", rays, randomSeed);
+				for (const auto& ray : rays) if (colliderB->RayCollision(ray, &entityB, collision)) {
+					normalSum += glm::dvec3(collision.normal);
+					++normalCount;
+				}
+			}
+			if (normalCount > 0) spread = 1.0 - glm::length(normalSum / normalCount);
+		}
+		
+		std::cout << shapes[a].name << "-" << shapes[b].name << "\t" << analyticContacts << "\t" << analyticTime << "\t" << raysTime << "\t" << rayContacts << "\t" << spread << "\n";
+	}
+	return 0;
+}
+
+int integrator(int bodies) {
+	constexpr int ticks = 100;
+	constexpr double deltaTime = 1.0 / 200;
+	
+	uint seed = 0;
+	std::vector<Rigidbody> rigidbodies {};
+	rigidbodies.reserve(bodies);
+	for (int i = 0; i < bodies; ++i) {
+		auto& rigidbody = rigidbodies.emplace_back(Rigidbody::BoxInertia(10.0f, 1.0f, 2.0f, 0.5f));
+		rigidbody.position = glm::dvec3(RandomInUnitCube(seed)) * 1000.0;
+		rigidbody.linearVelocity = glm::dvec3(RandomInUnitSphere(seed)) * 5.0;
+		rigidbody.angularVelocity = glm::dvec3(RandomInUnitSphere(seed));
+		rigidbody.SetInitialized();
+	}
+	auto applyForces = [](Rigidbody& rigidbody){
+		rigidbody.linearAcceleration = {0,0,-9.8};
+		rigidbody.torque = {0.1,0,0};
+	};
+	
+	// Original per-entity loop
+	std::vector<Rigidbody> scalarBodies = rigidbodies;
+	v4d::Timer t(true);
+	for (int tick = 0; tick < ticks; ++tick) {
+		for (auto& rigidbody : scalarBodies) {
+			applyForces(rigidbody);
+			rigidbody.linearAcceleration += rigidbody.invMass * rigidbody.force;
+			rigidbody.linearVelocity += rigidbody.linearAcceleration * deltaTime;
+			rigidbody.position += rigidbody.linearVelocity * deltaTime;
+			rigidbody.angularAcceleration += rigidbody.invInertiaTensorWorld * rigidbody.torque;
+			rigidbody.angularVelocity += rigidbody.angularAcceleration * deltaTime;
+			rigidbody.orientation = glm::normalize(rigidbody.orientation + glm::dquat(0.0, rigidbody.angularVelocity * deltaTime / 2.0) * rigidbody.orientation);
+			rigidbody.ComputeInvInertiaTensorWorld();
+			rigidbody.linearAcceleration = {0,0,0};
+			rigidbody.angularAcceleration = {0,0,0};
+		}
+	}
+	const double scalarTime = t.GetElapsedSeconds();
+	
+	// SoA pool, including gather and scatter as done in physics
+	RigidbodyPool pool {};
+	std::vector<RigidbodyPool::Handle> handles {};
+	handles.reserve(bodies);
+	for (int i = 0; i < bodies; ++i) handles.push_back(pool.Create());
+	double integrateTime = 0;
+	t.Reset();
+	for (int tick = 0; tick < ticks; ++tick) {
+		for (int i = 0; i < bodies; ++i) {
+			applyForces(rigidbodies[i]);
+			pool.Gather(handles[i], rigidbodies[i]);
+		}
+		v4d::Timer integrateTimer(true);
+		pool.Integrate(deltaTime);
+		integrateTime += integrateTimer.GetElapsedSeconds();
+		for (int i = 0; i < bodies; ++i) {
+			pool.Scatter(handles[i], rigidbodies[i]);
+			rigidbodies[i].ComputeInvInertiaTensorWorld();
+			rigidbodies[i].linearAcceleration = {0,0,0};
+			rigidbodies[i].angularAcceleration = {0,0,0};
+		}
+	}
+	const double poolTime = t.GetElapsedSeconds();
+	
+	double maxError = 0;
+	for (int i = 0; i < bodies; ++i) {
+		maxError = glm::max(maxError, glm::length(rigidbodies[i].position - scalarBodies[i].position));
+	}
+	
+	const double bodyTicks = double(bodies) * ticks;
+	std::cout << "SIMD: " << RigidbodyPool::SIMD_INSTRUCTIONS << "\n";
+	std::cout << "Per-entity loop:          " << (bodyTicks / scalarTime / 1e6) << " M bodies/s per core\n";
+	std::cout << "Pool integrate only:      " << (bodyTicks / integrateTime / 1e6) << " M bodies/s per core\n";
+	std::cout << "Pool gather+integrate+scatter: " << (bodyTicks / poolTime / 1e6) << " M bodies/s per core\n";
+	std::cout << "Max position difference:  " << maxError << " m\n";
+	return 0;
+}
+
+// Previous chunk generator queue, for comparison: generator threads scan the whole queue for the closest chunk, cancelling also scans it
+struct LinearChunkQueue {
+	std::vector<int> queue {};
+	std::mutex mutex;
+	std::condition_variable eventVar;
+	bool closed = false;
+	void Push(int chunk) {
+		std::lock_guard lock(mutex);
+		queue.push_back(chunk);
+		eventVar.notify_all();
+	}
+	bool Cancel(int chunk) {
+		std::lock_guard lock(mutex);
+		for (size_t i = 0; i < queue.size(); ++i) {
+			if (queue[i] == chunk) {
+				queue[i] = queue.back();
+				queue.pop_back();
+				return true;
+			}
+		}
+		return false;
+	}
+	bool WaitPop(int& chunk, const std::atomic<double>* distances) {
+		std::unique_lock lock(mutex);
+		eventVar.wait(lock, [this]{return closed || queue.size() > 0;});
+		if (closed) return false;
+		size_t index = 0;
+		for (size_t i = 1; i < queue.size(); ++i) {
+			if (distances[queue[i]] < distances[queue[index]]) index = i;
+		}
+		chunk = queue[index];
+		queue[index] = queue.back();
+		queue.pop_back();
+		return true;
+	}
+	void Close() {
+		std::lock_guard lock(mutex);
+		closed = true;
+		eventVar.notify_all();
+	}
+};
+
+// Camera flying over chunks while generator threads take the closest ones, with a quarter of them cancelled before being generated
+int chunkqueue(int chunks, int threads) {
+	constexpr int frames = 100;
+	constexpr double workMilliseconds = 0.2; // per generated chunk
+	if (threads <= 0) threads = std::max(1, int(std::thread::hardware_concurrency()) - 4);
+	
+	uint seed = 0;
+	std::vector<glm::dvec3> positions {};
+	positions.reserve(chunks);
+	for (int i = 0; i < chunks; ++i) {
+		positions.push_back(glm::dvec3(RandomInUnitCube(seed)) * 10'000.0);
+	}
+	auto distances = std::make_unique<std::atomic<double>[]>(chunks);
+	auto enqueued = std::make_unique<std::atomic<bool>[]>(chunks);
+	
+	// push(int chunk), cancel(int chunk) -> bool, reprioritize() and close() are called from this thread, pop(int& chunk) from the generator threads
+	auto simulate = [&](auto&& push, auto&& cancel, auto&& pop, auto&& reprioritize, auto&& close, double& producerTime){
+		std::atomic<int> generated = 0;
+		int pushed = 0;
+		int cancelled = 0;
+		std::vector<std::thread> generators {};
+		for (int i = 0; i < threads; ++i) {
+			generators.emplace_back([&](){
+				int chunk;
+				while (pop(chunk)) {
+					enqueued[chunk] = false;
+					v4d::Timer work(true);
+					while (work.GetElapsedMilliseconds() < workMilliseconds);
+					++generated;
+				}
+			});
+		}
+		producerTime = 0;
+		v4d::Timer t(true);
+		const int chunksPerFrame = chunks / frames;
+		for (int frame = 0; frame < frames; ++frame) {
+			const glm::dvec3 cameraPos = glm::dvec3{-10'000.0 + 20'000.0 * frame / frames, 0, 0};
+			for (int i = 0; i < chunks; ++i) {
+				distances[i] = glm::distance(cameraPos, positions[i]);
+			}
+			v4d::Timer producerTimer(true);
+			reprioritize();
+			for (int i = frame * chunksPerFrame; i < (frame+1) * chunksPerFrame; ++i) {
+				enqueued[i] = true;
+				push(i);
+				++pushed;
+			}
+			for (int i = frame * chunksPerFrame; i < (frame+1) * chunksPerFrame; i += 4) {
+				if (enqueued[i] && cancel(i)) {
+					enqueued[i] = false;
+					++cancelled;
+				}
+			}
+			producerTime += producerTimer.GetElapsedSeconds();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		while (generated + cancelled < pushed) {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		close();
+		for (auto& thread : generators) thread.join();
+		return t.GetElapsedSeconds();
+	};
+	
+	double linearProducerTime;
+	LinearChunkQueue linearQueue {};
+	const double linearTime = simulate(
+		[&](int chunk){linearQueue.Push(chunk);},
+		[&](int chunk){return linearQueue.Cancel(chunk);},
+		[&](int& chunk){return linearQueue.WaitPop(chunk, distances.get());},
+		[](){},
+		[&](){linearQueue.Close();},
+		linearProducerTime
+	);
+	
+	double heapProducerTime;
+	ChunkGeneratorQueue<int> heapQueue {};
+	std::vector<ChunkGeneratorQueue<int>::Handle> handles(chunks);
+	const double heapTime = simulate(
+		[&](int chunk){handles[chunk] = heapQueue.Push(chunk, distances[chunk]);},
+		[&](int chunk){return heapQueue.Cancel(handles[chunk]);},
+		[&](int& chunk){return heapQueue.WaitPop(chunk);},
+		[&](){heapQueue.Reprioritize([&](int chunk){return distances[chunk].load();});},
+		[&](){heapQueue.Close();},
+		heapProducerTime
+	);
+	
+	const auto stats = heapQueue.GetStats();
+	std::cout << "Chunks: " << chunks << ", generator threads: " << threads << "\n";
+	std::cout << "Linear scan:   " << (linearTime * 1000) << " ms total, " << (linearProducerTime * 1000) << " ms enqueuing/cancelling\n";
+	std::cout << "Priority heap: " << (heapTime * 1000) << " ms total, " << (heapProducerTime * 1000) << " ms enqueuing/cancelling/reprioritizing\n";
+	std::cout << "Heap queue: " << stats.pops << " popped, " << stats.cancels << " cancelled, " << stats.staleEntriesSkipped << " stale entries skipped, " << stats.compactions << " compactions, max " << stats.maxSize << " queued\n";
+	std::cout << "Heap lock: " << stats.contendedLockAcquisitions << " contended of " << stats.lockAcquisitions << " acquisitions, " << (stats.lockWaitSeconds * 1000) << " ms waiting, " << stats.emptyWaits << " waits for an empty queue\n";
+	return 0;
+}
+
+int replay(const std::string& filePath, int extraTicks) {
+	double timestep;
+	std::vector<PhysicsInput> inputs;
+	if (!PhysicsReplay::Load(filePath, timestep, inputs)) return -1;
+	if (inputs.size() == 0 || timestep <= 0) {
+		std::cout << "Nothing to replay, the file must be recorded with physics_deterministic enabled\n";
+		return -1;
+	}
+	
+	auto mod = V4D_Mod::GetModule(THIS_MODULE);
+	GameConfig::physicsDeterministic = true;
+	GameConfig::physicsFixedTimestep = timestep;
+	GameConfig::physicsReplayRecordFile = "";
+	TerrainGeneratorLib::Load();
+	
+	// Nothing is simulated before the first input, so the replay starts there
+	physicsReplay.tick = inputs.front().tick;
+	const uint64_t lastTick = inputs.back().tick + extraTicks;
+	size_t nextInput = 0;
+	double minTickTime = std::numeric_limits<double>::max();
+	double maxTickTime = 0;
+	v4d::Timer t(true);
+	v4d::Timer tickTimer(true);
+	while (physicsReplay.tick <= lastTick) {
+		for (; nextInput < inputs.size() && inputs[nextInput].tick == physicsReplay.tick; ++nextInput) {
+			const auto& input = inputs[nextInput];
+			if (input.type == PhysicsInput::PLAYER_JOINED) {
+				CreatePlayerEntity(input.clientId, input.referenceFrame, input.position);
+			}
+			physicsReplay.Enqueue(input);
+		}
+		tickTimer.Reset();
+		mod->ServerPhysicsUpdate(timestep);
+		const double tickTime = tickTimer.GetElapsedSeconds();
+		minTickTime = glm::min(minTickTime, tickTime);
+		maxTickTime = glm::max(maxTickTime, tickTime);
+	}
+	const double totalTime = t.GetElapsedSeconds();
+	const uint64_t ticks = lastTick - inputs.front().tick + 1;
+	
+	// Two replays of the same file must end up with the exact same state
+	glm::dvec3 positionSum {0};
+	size_t bodies = 0;
+	ServerSideEntity::rigidbodyComponents.ForEach_Entity([&positionSum, &bodies](ServerSideEntity::Ptr& entity, Rigidbody& rigidbody){
+		positionSum += rigidbody.position;
+		++bodies;
+	});
+	
+	TerrainGeneratorLib::Unload();
+	
+	std::cout << std::setprecision(17);
+	std::cout << "Replayed " << inputs.size() << " inputs over " << ticks << " ticks of " << (timestep*1000) << " ms\n";
+	std::cout << "Simulated time: " << (ticks * timestep) << " s, wall time: " << totalTime << " s\n";
+	std::cout << "Tick time avg: " << (totalTime / ticks * 1000) << " ms, min: " << (minTickTime * 1000) << " ms, max: " << (maxTickTime * 1000) << " ms\n";
+	std::cout << "Final state: " << bodies << " bodies, position checksum " << positionSum.x << " " << positionSum.y << " " << positionSum.z << "\n";
+	return 0;
+}
+
 V4D_MODULE_CLASS(V4D_Mod) {
 	V4D_MODULE_FUNC(int, RunFromConsole, const int argc, const char** argv) {
 		if (argc == 4 && std::string("starsystem") == argv[0]) {
@@ -220,6 +662,45 @@ V4D_MODULE_CLASS(V4D_Mod) {
 		if (argc == 1 && std::string("stats") == argv[0]) {
 			return stats();
 		}
+		if (argc == 1 && std::string("broadphase") == argv[0]) {
+			return broadphase(100, 50'000);
+		}
+		if (argc == 3 && std::string("broadphase") == argv[0]) {
+			return broadphase(atoi(argv[1]), atoi(argv[2]));
+		}
+		if (argc == 1 && std::string("integrator") == argv[0]) {
+			return integrator(100'000);
+		}
+		if (argc == 2 && std::string("integrator") == argv[0]) {
+			return integrator(atoi(argv[1]));
+		}
+		if (argc == 1 && std::string("narrowphase") == argv[0]) {
+			return narrowphase(100'000);
+		}
+		if (argc == 2 && std::string("narrowphase") == argv[0]) {
+			return narrowphase(atoi(argv[1]));
+		}
+		if (argc >= 1 && argc <= 6 && std::string("benchmark") == argv[0]) {
+			return physicsbenchmark(
+				argc > 1? argv[1] : "all",
+				argc > 2? atoi(argv[2]) : 1000,
+				argc > 3? atoi(argv[3]) : 1000,
+				argc > 4? atof(argv[4]) : 1.0/200,
+				argc > 5? atoi(argv[5]) : 0
+			);
+		}
+		if (argc == 1 && std::string("chunkqueue") == argv[0]) {
+			return chunkqueue(50'000, 0);
+		}
+		if (argc == 3 && std::string("chunkqueue") == argv[0]) {
+			return chunkqueue(atoi(argv[1]), atoi(argv[2]));
+		}
+		if (argc == 2 && std::string("replay") == argv[0]) {
+			return replay(argv[1], 0);
+		}
+		if (argc == 3 && std::string("replay") == argv[0]) {
+			return replay(argv[1], atoi(argv[2]));
+		}
 		
 		return 0;
 	}
@@ -6,9 +6,20 @@
 #include "v4d/game/physics.hh"
 #include "v4d/game/Collider.hpp"
 #include "v4d/game/ServerSideEntity.hpp"
+#include "v4d/game/ServerSidePlayer.hpp"
+#include "v4d/game/Game.h"
+#include "v4d/game/Broadphase.hpp"
+#include "v4d/game/Narrowphase.hpp"
+#include "v4d/game/SimulationIslands.hpp"
+#include "v4d/game/RigidbodyPool.hpp"
+#include "v4d/game/JobSystem.hpp"
+#include "v4d/game/random.hh"
 
 #include <vector>
+#include <map>
 #include <unordered_map>
+#include <algorithm>
+#include <memory>
 
 #include "GalaxyGenerator.h"
 #include "Celestial.h"
@@ -16,102 +27,222 @@
 #include "celestials/Planet.h"
 #include "TerrainGeneratorLib.h"
 #include "noise_functions.hpp"
+#include "TerrainHeightCache.hpp"
+#include "PhysicsReplay.hpp"
+#include "PhysicsTimings.hpp"
+#include "CollisionDispatch.hpp"
 
 extern V4D_Mod* mainRenderModule;
 extern v4d::scene::Scene* scene;
 
-std::unordered_map<uint64_t, std::vector<BroadphaseCollider>> cachedBroadphaseColliders {};
-std::vector<Ray> cachedCollisionRays {};
+// Bounding sphere of each active body, per reference frame, with what the gravity and terrain pass needs to skip it without looking up its entity
+struct CachedBroadphaseCollider : BroadphaseCollider {
+	bool immovable; // zero inverse mass, never moved by physics (kinematic bodies such as builds)
+	bool sleeping; // as of the end of the previous tick, bodies woken up during this tick are only picked up on the next one
+	CachedBroadphaseCollider(glm::dvec3 position, double radius, Entity::Id id, bool immovable, bool sleeping)
+	 : BroadphaseCollider(position, radius, id)
+	 , immovable(immovable)
+	 , sleeping(sleeping)
+	{}
+};
+std::map<uint64_t, std::vector<CachedBroadphaseCollider>> cachedBroadphaseColliders {}; // ordered, so that reference frames are always visited in the same order
+Broadphase broadphase {};
+std::vector<std::pair<Entity::Id, Entity::Id>> cachedCollisionPairs {};
+SimulationIslands islands {};
+RigidbodyPool rigidbodyPool {};
 uint randomSeed;
 double avgDeltaTime = 1.0 / 200;
+PhysicsTimings physicsTimings {};
+CollisionDispatch collisionDispatch {};
 
-#pragma region Collision response
+// Entities sorted by ID, only used in deterministic mode
+std::vector<std::pair<ServerSideEntity::Ptr, Rigidbody*>> sortedRigidbodies {};
 
-void RespondToCollision(ServerSideEntity::Ptr& entityA, ServerSideEntity::Ptr& entityB, CollisionInfo& collision) {
-	double contactSpeed {0};
-	
-	// This should be the only place where we lock two rigidbodies simultaneously. Doing it on any other thread could result in a deadlock.
-	if (auto rbA = entityA->rigidbody.Lock(); rbA) {
-		if (auto rbB = entityB->rigidbody.Lock(); rbB) {
-			
-			if (rbA->atRest && rbB->atRest) return;
-			
-			// Projection method (separate the two bodies so that they don't penetrate anymore)
-			const glm::dvec3 separation = glm::dvec3(collision.normal * collision.penetration) / (rbA->invMass + rbB->invMass);
-			// Reposition rigidbody
-			rbA->position -= separation * rbA->invMass;
-			rbB->position += separation * rbB->invMass;
-			
-			// Impulse method (Adjust linear and angular velocities to simulate a bounce)
-			const glm::dvec3 normal = collision.normal;
-			const glm::dvec3 contactA = collision.contactA - rbA->position;
-			const glm::dvec3 contactB = collision.contactB - rbB->position;
-			const glm::dvec3 angularVelocityA = glm::cross(rbA->angularVelocity, contactA);
-			const glm::dvec3 angularVelocityB = glm::cross(rbB->angularVelocity, contactB);
-			const glm::dvec3 totalVelocityA = rbA->linearVelocity + angularVelocityA;
-			const glm::dvec3 totalVelocityB = rbB->linearVelocity + angularVelocityB;
-			const glm::dvec3 contactVelocity = totalVelocityB - totalVelocityA;
-			const glm::dvec3 inertiaA = glm::cross(rbA->invInertiaTensorWorld * glm::cross(contactA, normal), contactA);
-			const glm::dvec3 inertiaB = glm::cross(rbB->invInertiaTensorWorld * glm::cross(contactB, normal), contactB);
-			contactSpeed = -glm::dot(contactVelocity, normal);
-			const double J = contactSpeed * (rbA->restitution * rbB->restitution + 1.0) / (rbA->invMass + rbB->invMass + glm::dot(inertiaA + inertiaB, normal));
-			const glm::dvec3 impulse = J * normal;
-			
-			// Apply impulses to rigidbody
-			rbA->ApplyImpulse(-impulse, contactA);
-			rbB->ApplyImpulse(+impulse, contactB);
-			
-			// Dynamic Friction
-			const double frictionCoeficient = rbA->friction * rbB->friction;
-			glm::dvec3 tangent = contactVelocity - normal * glm::dot(contactVelocity, normal);
-			const double tangentLength = glm::length(tangent);
-			if (tangentLength > 1e-6) {
-				tangent /= tangentLength;
-				const double frictionalMass = (rbA->invMass + rbB->invMass) + glm::dot(tangent, glm::cross(rbA->invInertiaTensorWorld * glm::cross(contactA, tangent), contactA) + glm::cross(rbB->invInertiaTensorWorld * glm::cross(contactB, tangent), contactB));
-				if (frictionalMass > 0) {
-					const glm::dvec3 frictionImpulse = tangent * double(-glm::dot(contactVelocity, tangent) * frictionCoeficient / frictionalMass);
-					// Apply impulses from friction
-					rbA->ApplyImpulse(-frictionImpulse, contactA);
-					rbB->ApplyImpulse(+frictionImpulse, contactB);
+// Calls func(ServerSideEntity::Ptr& entity, Rigidbody& rigidbody) for each entity with a rigidbody
+// The component storage order depends on the order in which entities were created and destroyed, so in deterministic mode they are visited in the order of their IDs, which also decides the order of islands and of the rigidbody pool
+template<typename F>
+void ForEachRigidbody(F&& func) {
+	if (!GameConfig::physicsDeterministic) {
+		ServerSideEntity::rigidbodyComponents.ForEach_Entity(func);
+		return;
+	}
+	sortedRigidbodies.clear();
+	ServerSideEntity::rigidbodyComponents.ForEach_Entity([](ServerSideEntity::Ptr& entity, Rigidbody& rigidbody){
+		sortedRigidbodies.emplace_back(entity, &rigidbody);
+	});
+	std::sort(sortedRigidbodies.begin(), sortedRigidbodies.end(), [](const auto& a, const auto& b){
+		return a.first->GetID() < b.first->GetID();
+	});
+	for (auto&[entity, rigidbody] : sortedRigidbodies) func(entity, *rigidbody);
+	// Don't keep destroyed entities alive until the next pass
+	sortedRigidbodies.clear();
+}
+
+// A contact found by the narrowphase, resolved afterwards by the solver
+struct Contact {
+	Entity::Id a;
+	Entity::Id b;
+	CollisionInfo collision;
+	double contactSpeed = 0;
+	bool responded = false;
+	bool connectsIslands = false;
+	bool immovableA; // zero inverse mass, never written by the solver
+	bool immovableB;
+	Rigidbody* rigidbodyA = nullptr; // resolved from the physics thread before solving
+	Rigidbody* rigidbodyB = nullptr;
+	Contact(Entity::Id a, Entity::Id b, const CollisionInfo& collision, bool immovableA, bool immovableB) : a(a), b(b), collision(collision), immovableA(immovableA), immovableB(immovableB) {}
+};
+
+std::unique_ptr<JobSystem> physicsJobs = nullptr;
+std::vector<std::vector<Ray>> threadCollisionRays {}; // one per thread
+std::vector<std::vector<Contact>> batchContacts {}; // one per narrowphase batch
+std::vector<Contact> contacts {};
+std::unordered_map<Entity::Id, uint64_t> bodyContactColors {}; // bitmask of the colors already used by each body's contacts
+std::vector<std::vector<uint32_t>> contactColors {}; // contact indices per color, plus a last list of contacts that could not be colored
+std::unordered_map<Entity::Id, Rigidbody*> solverRigidbodies {}; // rigidbody of each body in contact, resolved once per tick
+
+#pragma region Inputs
+
+void ApplyPhysicsInput(const PhysicsInput& input) {
+	ServerSidePlayer::Ptr player = ServerSidePlayer::Get(input.clientId);
+	if (!player) return;
+	ServerSideEntity::Ptr entity = player->GetServerSideEntity();
+	if (!entity) return;
+	switch (input.type) {
+		case PhysicsInput::PLAYER_JOINED:{
+			entity->Activate();
+		}break;
+		case PhysicsInput::PLAYER_MOTION:{
+			entity->orientation = input.orientation;
+			if (auto rigidbody = entity->rigidbody.Lock(); rigidbody) {
+				if (glm::dot(input.acceleration,input.acceleration) > 0) {
+					rigidbody->ApplyImpulse(input.acceleration);
+				} else if (input.brakes) {
+					rigidbody->linearVelocity *= 0.5;
+					if (glm::length(rigidbody->linearVelocity) < 0.0001) rigidbody->linearVelocity = {0,0,0};
 				}
+				rigidbody->angularVelocity = {0,0,0};
 			}
-			
-			// Static Friction
-			if (glm::length(rbA->linearVelocity) > COLLISION_REST_SPEED_THRESHOLD || glm::length(rbA->angularVelocity) > COLLISION_REST_ANGULAR_SPEED_THRESHOLD) {
-				rbA->linearVelocity -= glm::normalize(rbA->linearVelocity) * COLLISION_STATIC_FRICTION_SPEED_REDUCTION * avgDeltaTime * frictionCoeficient;
-				rbA->angularVelocity -= glm::normalize(rbA->angularVelocity) * COLLISION_STATIC_FRICTION_ANGULAR_SPEED_REDUCTION * avgDeltaTime * frictionCoeficient;
-			} else {
-				rbA->linearVelocity = {0,0,0};
-				rbA->angularVelocity = {0,0,0};
-				rbA->atRest = true;
-			}
-			if (glm::length(rbB->linearVelocity) > COLLISION_REST_SPEED_THRESHOLD || glm::length(rbB->angularVelocity) > COLLISION_REST_ANGULAR_SPEED_THRESHOLD) {
-				rbB->linearVelocity -= glm::normalize(rbB->linearVelocity) * COLLISION_STATIC_FRICTION_SPEED_REDUCTION * avgDeltaTime * frictionCoeficient;
-				rbB->angularVelocity -= glm::normalize(rbB->angularVelocity) * COLLISION_STATIC_FRICTION_ANGULAR_SPEED_REDUCTION * avgDeltaTime * frictionCoeficient;
-			} else {
-				rbB->linearVelocity = {0,0,0};
-				rbB->angularVelocity = {0,0,0};
-				rbB->atRest = true;
-			}
-			
-			
+		}break;
+	}
+}
+
+#pragma endregion
+
+#pragma region Collision response
+
+// May run on several threads at once, for contacts of the same color, which never share a body
+// Rigidbodies are not locked, contact coloring guarantees that no other thread writes either of them at the same time, and immovable bodies are only ever read
+void RespondToCollision(Contact& contact) {
+	Rigidbody* rbA = contact.rigidbodyA;
+	Rigidbody* rbB = contact.rigidbodyB;
+	if (!rbA || !rbB) return;
+	const CollisionInfo& collision = contact.collision;
+	double& contactSpeed = contact.contactSpeed;
+	contact.responded = true;
+	
+	if (rbA->atRest && rbB->atRest) {
+		contact.responded = false;
+		return;
+	}
+	
+	// Bodies with a zero inverse mass (kinematic) are never moved by a collision, pairs of two of them are already skipped by the broadphase
+	const double invMassSum = rbA->invMass + rbB->invMass;
+	if (invMassSum <= 0) {
+		contact.responded = false;
+		return;
+	}
+	const bool movableA = rbA->invMass > 0;
+	const bool movableB = rbB->invMass > 0;
+	
+	// Bodies in contact go to sleep and wake up together. Kinematic bodies would connect everything that touches them, so they are left out.
+	contact.connectsIslands = !rbA->IsKinematic() && !rbB->IsKinematic();
+	
+	// Projection method (separate the two bodies so that they don't penetrate anymore)
+	const glm::dvec3 separation = glm::dvec3(collision.normal * collision.penetration) / invMassSum;
+	// Reposition rigidbody, a sleeping body is only pushed (and woken up) by more than it would move in a tick at the sleep speed threshold
+	auto reposition = [restDistance = PHYSICS_SLEEP_SPEED_THRESHOLD * avgDeltaTime](Rigidbody* rb, const glm::dvec3& offset){
+		if (rb->atRest) {
+			if (glm::length(offset) < restDistance) return;
+			rb->Wake();
+		}
+		rb->position += offset;
+	};
+	if (movableA) reposition(rbA, -separation * rbA->invMass);
+	if (movableB) reposition(rbB, +separation * rbB->invMass);
+	
+	// Impulse method (Adjust linear and angular velocities to simulate a bounce)
+	const glm::dvec3 normal = collision.normal;
+	const glm::dvec3 contactA = collision.contactA - rbA->position;
+	const glm::dvec3 contactB = collision.contactB - rbB->position;
+	const glm::dvec3 angularVelocityA = glm::cross(rbA->angularVelocity, contactA);
+	const glm::dvec3 angularVelocityB = glm::cross(rbB->angularVelocity, contactB);
+	const glm::dvec3 totalVelocityA = rbA->linearVelocity + angularVelocityA;
+	const glm::dvec3 totalVelocityB = rbB->linearVelocity + angularVelocityB;
+	const glm::dvec3 contactVelocity = totalVelocityB - totalVelocityA;
+	const glm::dvec3 inertiaA = glm::cross(rbA->invInertiaTensorWorld * glm::cross(contactA, normal), contactA);
+	const glm::dvec3 inertiaB = glm::cross(rbB->invInertiaTensorWorld * glm::cross(contactB, normal), contactB);
+	contactSpeed = -glm::dot(contactVelocity, normal);
+	const double J = contactSpeed * (rbA->restitution * rbB->restitution + 1.0) / (invMassSum + glm::dot(inertiaA + inertiaB, normal));
+	const glm::dvec3 impulse = J * normal;
+	
+	// Apply impulses to rigidbody
+	if (movableA) rbA->ApplyImpulse(-impulse, contactA);
+	if (movableB) rbB->ApplyImpulse(+impulse, contactB);
+	
+	// Dynamic Friction
+	const double frictionCoeficient = rbA->friction * rbB->friction;
+	glm::dvec3 tangent = contactVelocity - normal * glm::dot(contactVelocity, normal);
+	const double tangentLength = glm::length(tangent);
+	if (tangentLength > 1e-6) {
+		tangent /= tangentLength;
+		const double frictionalMass = invMassSum + glm::dot(tangent, glm::cross(rbA->invInertiaTensorWorld * glm::cross(contactA, tangent), contactA) + glm::cross(rbB->invInertiaTensorWorld * glm::cross(contactB, tangent), contactB));
+		if (frictionalMass > 0) {
+			const glm::dvec3 frictionImpulse = tangent * double(-glm::dot(contactVelocity, tangent) * frictionCoeficient / frictionalMass);
+			// Apply impulses from friction
+			if (movableA) rbA->ApplyImpulse(-frictionImpulse, contactA);
+			if (movableB) rbB->ApplyImpulse(+frictionImpulse, contactB);
 		}
 	}
 	
-	// Trigger collision events on entities
-	if (auto mod = V4D_Mod::GetModule(entityA->moduleID.String()); mod && mod->OnCollisionHit) {
-		mod->OnCollisionHit(entityA->GetID(), entityA->type, glm::inverse(glm::mat3_cast(entityA->orientation)) * (collision.contactA - entityA->position), glm::max(0.0, contactSpeed));
+	// Static Friction
+	if (movableA) {
+		if (glm::length(rbA->linearVelocity) > COLLISION_REST_SPEED_THRESHOLD || glm::length(rbA->angularVelocity) > COLLISION_REST_ANGULAR_SPEED_THRESHOLD) {
+			rbA->linearVelocity -= glm::normalize(rbA->linearVelocity) * COLLISION_STATIC_FRICTION_SPEED_REDUCTION * avgDeltaTime * frictionCoeficient;
+			rbA->angularVelocity -= glm::normalize(rbA->angularVelocity) * COLLISION_STATIC_FRICTION_ANGULAR_SPEED_REDUCTION * avgDeltaTime * frictionCoeficient;
+		} else {
+			rbA->linearVelocity = {0,0,0};
+			rbA->angularVelocity = {0,0,0};
+		}
 	}
-	if (auto mod = V4D_Mod::GetModule(entityB->moduleID.String()); mod && mod->OnCollisionHit) {
-		mod->OnCollisionHit(entityB->GetID(), entityB->type, glm::inverse(glm::mat3_cast(entityB->orientation)) * (collision.contactB - entityB->position), glm::max(0.0, contactSpeed));
+	if (movableB) {
+		if (glm::length(rbB->linearVelocity) > COLLISION_REST_SPEED_THRESHOLD || glm::length(rbB->angularVelocity) > COLLISION_REST_ANGULAR_SPEED_THRESHOLD) {
+			rbB->linearVelocity -= glm::normalize(rbB->linearVelocity) * COLLISION_STATIC_FRICTION_SPEED_REDUCTION * avgDeltaTime * frictionCoeficient;
+			rbB->angularVelocity -= glm::normalize(rbB->angularVelocity) * COLLISION_STATIC_FRICTION_ANGULAR_SPEED_REDUCTION * avgDeltaTime * frictionCoeficient;
+		} else {
+			rbB->linearVelocity = {0,0,0};
+			rbB->angularVelocity = {0,0,0};
+		}
 	}
 }
 
+void TriggerCollisionEvents(const Contact& contact) {
+	auto entityA = ServerSideEntity::Get(contact.a);
+	auto entityB = ServerSideEntity::Get(contact.b);
+	if (!entityA || !entityB) return;
+	// Trigger collision events on entities (sent to their modules at the end of the tick)
+	collisionDispatch.AddHit(entityA.get(), contact.collision.contactA, contact.contactSpeed);
+	collisionDispatch.AddHit(entityB.get(), contact.collision.contactB, contact.contactSpeed);
+}
+
 void RespondToCollisionWithTerrain(ServerSideEntity::Ptr& entity, TerrainCollisionInfo& collision) {
 	double contactSpeed {0};
 	
 	// This should be the only place where we lock two rigidbodies simultaneously. Doing it on any other thread could result in a deadlock.
 	if (auto rb = entity->rigidbody.Lock(); rb) {
+		
+		// Bodies with a zero inverse mass (kinematic) are never moved by the terrain
+		if (rb->invMass <= 0) return;
 
 		// Projection method (separate the two bodies so that they don't penetrate anymore)
 		const glm::dvec3 separation = glm::dvec3(collision.normal * collision.penetration) / rb->invMass;
@@ -153,15 +284,12 @@ void RespondToCollisionWithTerrain(ServerSideEntity::Ptr& entity, TerrainCollisi
 		} else {
 			rb->linearVelocity = {0,0,0};
 			rb->angularVelocity = {0,0,0};
-			rb->atRest = true;
 		}
 		
 	}
 	
-	// Trigger collision events on entities
-	if (auto mod = V4D_Mod::GetModule(entity->moduleID.String()); mod && mod->OnCollisionHit) {
-		mod->OnCollisionHit(entity->GetID(), entity->type, glm::inverse(glm::mat3_cast(entity->orientation)) * (collision.contactB - entity->position), glm::max(0.0, contactSpeed));
-	}
+	// Trigger collision events on entities (sent to their modules at the end of the tick)
+	collisionDispatch.AddHit(entity.get(), collision.contactB, contactSpeed);
 }
 
 #pragma endregion
@@ -172,7 +300,7 @@ void RespondToCollisionWithTerrain(ServerSideEntity::Ptr& entity, TerrainCollisi
 // collision.penetration should be a positive number of the amount of penetration between the collider and the terrain, typically the depth that it's penetrating in the ground
 // collision.contactB should be set to the contact point on the collider, but in world space
 
-std::map<uint64_t, std::map<int32_t, std::map<int32_t, std::map<int32_t, double>>>> terrainCache {};
+TerrainHeightCache terrainCache {};
 
 void SolveCollisionWithTerrain(ServerSideEntity::Ptr& entity, const Planet* const planet) {
 	const glm::dvec3 normalizedPos = glm::normalize(entity->position);
@@ -181,12 +309,9 @@ void SolveCollisionWithTerrain(ServerSideEntity::Ptr& entity, const Planet* cons
 	auto terrainHeightMap = [&planet, &terrainRadius](const glm::dvec3& normalizedPos) -> double {
 		const glm::dvec3 pos = glm::round(normalizedPos * terrainRadius);
 		const glm::ivec3 ipos = pos;
-		try{
-			return terrainCache.at(planet->GetID()).at(pos.x).at(pos.y).at(pos.z);
-		} catch (std::out_of_range) {
-			// LOG("Generating terrain " << pos.x << ", " << pos.y << ", " << pos.z)
-			return terrainCache[planet->GetID()][pos.x][pos.y][pos.z] = planet->GetTerrainHeightAtPos(glm::normalize(pos));
-		}
+		return terrainCache.Get(planet->GetID(), ipos, [&planet, &pos]{
+			return planet->GetTerrainHeightAtPos(glm::normalize(pos));
+		});
 	};
 	for (const auto&[_, collider] : entity->colliders) {
 		if (collider->TerrainCollision(terrainHeightMap, entity.get(), collision)) {
@@ -199,15 +324,47 @@ void SolveCollisionWithTerrain(ServerSideEntity::Ptr& entity, const Planet* cons
 
 V4D_MODULE_CLASS(V4D_Mod) {
 	
+	V4D_MODULE_FUNC(void, ModuleUnload) {
+		physicsJobs.reset();
+	}
+	
 	V4D_MODULE_FUNC(void, ServerPhysicsUpdate, double deltaTime) {
-		avgDeltaTime = glm::mix(avgDeltaTime, deltaTime, 0.1);
+		if (GameConfig::physicsDeterministic) {
+			// The timestep is fixed, and collision rays only depend on the tick number
+			avgDeltaTime = deltaTime;
+			randomSeed = uint(physicsReplay.tick * 2654435761ull);
+		} else {
+			avgDeltaTime = glm::mix(avgDeltaTime, deltaTime, 0.1);
+		}
+		
+		physicsReplay.ApplyPendingInputs(ApplyPhysicsInput);
+		
+		if (!physicsJobs || physicsJobs->GetThreadCount() != GameConfig::GetPhysicsThreadCount()) {
+			physicsJobs = std::make_unique<JobSystem>(GameConfig::GetPhysicsThreadCount());
+			threadCollisionRays.resize(physicsJobs->GetThreadCount());
+		}
+		
+		// Entities resolve their module's collision callbacks again when modules changed
+		if (collisionDispatch.Update()) {
+			ServerSideEntity::colliderCacheValid = false;
+		}
+		
+		v4d::Timer stageTimer(true);
+		auto endStage = [&stageTimer](double& stageTime){
+			if (physicsTimings.enabled) {
+				stageTime += stageTimer.GetElapsedSeconds();
+				stageTimer.Reset();
+			}
+		};
 		
 		if (!ServerSideEntity::colliderCacheValid) {// Prepare data
 			ServerSideEntity::colliderCacheValid = true;
 			for (auto&[referenceFrame, colliders] : cachedBroadphaseColliders) {
 				colliders.clear();
 			}
-			ServerSideEntity::rigidbodyComponents.ForEach_Entity([](ServerSideEntity::Ptr& entity, Rigidbody& rigidbody) {
+			broadphase.Clear();
+			ForEachRigidbody([](ServerSideEntity::Ptr& entity, Rigidbody& rigidbody) {
+				entity->collisionDispatchIndex = collisionDispatch.IndexOf(entity->moduleID);
 				if (entity->IsActive()) {
 					if (!rigidbody.IsInitialized()) {
 						if (rigidbody.IsKinematic()) {
@@ -220,74 +377,202 @@ V4D_MODULE_CLASS(V4D_Mod) {
 						}
 						rigidbody.SetInitialized();
 					}
+					if (!rigidbody.IsKinematic()) {
+						if (!rigidbodyPool.IsAlive(entity->rigidbodyPoolHandle)) {
+							entity->rigidbodyPoolHandle = rigidbodyPool.Create();
+						}
+						rigidbodyPool.Mark(entity->rigidbodyPoolHandle);
+					}
 					if (rigidbody.boundingRadius > 0) {
 						entity->colliderCacheIndex = cachedBroadphaseColliders[entity->referenceFrame].size();
 						cachedBroadphaseColliders[entity->referenceFrame].emplace_back(
 							rigidbody.position,
 							rigidbody.boundingRadius,
-							entity->GetID()
+							entity->GetID(),
+							rigidbody.invMass <= 0,
+							rigidbody.atRest
 						);
+						entity->broadphaseProxyIndex = broadphase.Insert(entity->referenceFrame, cachedBroadphaseColliders[entity->referenceFrame].back());
+						broadphase.SetSleeping(entity->broadphaseProxyIndex, rigidbody.atRest);
+						broadphase.SetImmovable(entity->broadphaseProxyIndex, rigidbody.invMass <= 0);
 					} else {
 						entity->colliderCacheIndex = -1;
+						entity->broadphaseProxyIndex = -1;
 					}
 				} else {
 					entity->colliderCacheIndex = -1;
+					entity->broadphaseProxyIndex = -1;
 				}
 			});
+			// Release pool slots of destroyed or deactivated entities
+			rigidbodyPool.Sweep();
 			// LOG("Generated collider cache")
 		}
 		
 		{// Collision Detection
-			for (const auto&[referenceFrame, colliders] : cachedBroadphaseColliders) {
-				for (size_t cacheIndexA = 0; cacheIndexA < colliders.size(); ++cacheIndexA) {
-					
-					ServerSideEntity::Ptr entityA = nullptr;
+			
+			islands.Clear();
+			
+			// Broadphase: each overlapping pair is reported once
+			cachedCollisionPairs.clear();
+			broadphase.ForEachPair([](const BroadphaseCollider& a, const BroadphaseCollider& b){
+				cachedCollisionPairs.emplace_back(a.id, b.id);
+			});
+			if (GameConfig::physicsDeterministic) {
+				// Pairs come out in hash grid order, responses must be applied in the same order on every run
+				for (auto& pair : cachedCollisionPairs) {
+					if (pair.second < pair.first) std::swap(pair.first, pair.second);
+				}
+				std::sort(cachedCollisionPairs.begin(), cachedCollisionPairs.end());
+			}
+			physicsTimings.collisionPairs += cachedCollisionPairs.size();
+			endStage(physicsTimings.broadphase);
+			
+			// Narrowphase: pairs are split into batches that each fill their own list of contacts, so that threads never write to shared data
+			// Debug collision rays can only be drawn from the physics thread, so everything runs in a single batch while they are shown
+			const bool drawCollisionRays = scene && (scene->camera.debugOptions & DEBUG_OPTION_PHYSICS);
+			const size_t pairsPerBatch = drawCollisionRays? std::max(size_t(1), cachedCollisionPairs.size()) : size_t(PHYSICS_NARROWPHASE_PAIRS_PER_BATCH);
+			const size_t batchCount = cachedCollisionPairs.size() / pairsPerBatch + 1;
+			if (batchContacts.size() < batchCount) batchContacts.resize(batchCount);
+			for (size_t i = 0; i < batchCount; ++i) batchContacts[i].clear();
+			const uint tickSeed = randomSeed;
+			physicsJobs->ParallelFor(cachedCollisionPairs.size(), pairsPerBatch, [pairsPerBatch, tickSeed, drawCollisionRays](size_t begin, size_t end, int threadIndex){
+				auto& contacts = batchContacts[begin / pairsPerBatch];
+				auto& rays = threadCollisionRays[threadIndex];
+				
+				// Generates the collision rays of a collider (only used for collider pairs that don't have a contact generator)
+				auto generateCollisionRays = [&rays, drawCollisionRays](ServerSideEntity::Ptr& entity, const v4d::TextID& id, Collider* collider, uint& seed){
+					rays.clear();
+					collider->GenerateCollisionRays(entity.get(), id, rays, seed);
+					// Debug collision rays
+					if (drawCollisionRays) {
+						for (auto& r : rays) {
+							mainRenderModule->DrawOverlayLineViewSpace(scene->camera.viewMatrix * glm::dvec4(r.origin, 1), scene->camera.viewMatrix * glm::dvec4(r.origin + r.direction * r.length, 1), glm::vec4{1}, 2.0);
+						}
+					}
+				};
+				
+				for (size_t i = begin; i < end; ++i) {
+					const auto&[idA, idB] = cachedCollisionPairs[i];
+					auto entityA = ServerSideEntity::Get(idA);
+					auto entityB = ServerSideEntity::Get(idB);
+					if (!entityA || !entityB) continue;
+					const bool immovableA = broadphase.IsImmovable(entityA->broadphaseProxyIndex);
+					const bool immovableB = broadphase.IsImmovable(entityB->broadphaseProxyIndex);
+					CollisionInfo collision;
+					// Each pair has its own random sequence, so that collision rays don't depend on how pairs are split between threads
+					uint seed = tickSeed + uint(i) * 2654435761u;
 					
-					for (size_t cacheIndexB = 0; cacheIndexB < colliders.size(); ++cacheIndexB) if (cacheIndexA != cacheIndexB) {
-						const float radiusSum = colliders[cacheIndexA].radius + colliders[cacheIndexB].radius;
-						const glm::vec3 d = colliders[cacheIndexB].position - colliders[cacheIndexA].position;
-						if (glm::dot(d,d) < radiusSum*radiusSum) {
-							// const glm::dvec3 normal = glm::normalize(d);
-							
-							if (!entityA) {
-								entityA = ServerSideEntity::Get(colliders[cacheIndexA].id);
-								if (!entityA) goto NextEntityA;
-								
-								// Loop through entityA's colliders to generate a list of collision rays
-								cachedCollisionRays.clear();
-								for (const auto&[id, colliderA] : entityA->colliders) {
-									colliderA->GenerateCollisionRays(entityA.get(), id, cachedCollisionRays, randomSeed);
+					// A -> B
+					for (const auto&[idColliderA, colliderA] : entityA->colliders) {
+						bool raysGenerated = false;
+						for (const auto&[_, colliderB] : entityB->colliders) {
+							if (auto contactGenerator = Narrowphase::GetContactGenerator(colliderA->GetType(), colliderB->GetType()); contactGenerator && !PHYSICS_FORCE_COLLISION_RAYS) {
+								if (contactGenerator(colliderA.get(), entityA.get(), colliderB.get(), entityB.get(), collision)) {
+									contacts.emplace_back(idA, idB, collision, immovableA, immovableB);
 								}
-								
-								// Debug collision rays
-								if (scene->camera.debugOptions & DEBUG_OPTION_PHYSICS) {
-									for (auto& r : cachedCollisionRays) {
-										mainRenderModule->DrawOverlayLineViewSpace(scene->camera.viewMatrix * glm::dvec4(r.origin, 1), scene->camera.viewMatrix * glm::dvec4(r.origin + r.direction * r.length, 1), glm::vec4{1}, 2.0);
+							} else {
+								if (!raysGenerated) {
+									generateCollisionRays(entityA, idColliderA, colliderA.get(), seed);
+									raysGenerated = true;
+								}
+								for (const auto& ray : rays) {
+									if (colliderB->RayCollision(ray, entityB.get(), collision)) {
+										contacts.emplace_back(idA, idB, collision, immovableA, immovableB);
 									}
 								}
-								
 							}
-							
-							CollisionInfo collision;
-							if (auto entityB = ServerSideEntity::Get(colliders[cacheIndexB].id); entityB) {
-								if (entityA->colliders.size() > 0 || entityB->colliders.size() > 0) {
-									for (const auto&[_, colliderB] : entityB->colliders) {
-										for (const auto& ray : cachedCollisionRays) {
-											if (colliderB->RayCollision(ray, entityB.get(), collision)) {
-												RespondToCollision(entityA, entityB, collision);
-											}
-										}
-									}
+						}
+					}
+					
+					// B -> A, only needed for collision rays since contact generators are symmetric
+					for (const auto&[idColliderB, colliderB] : entityB->colliders) {
+						bool raysGenerated = false;
+						for (const auto&[_, colliderA] : entityA->colliders) {
+							if (Narrowphase::GetContactGenerator(colliderB->GetType(), colliderA->GetType()) && !PHYSICS_FORCE_COLLISION_RAYS) continue;
+							if (!raysGenerated) {
+								generateCollisionRays(entityB, idColliderB, colliderB.get(), seed);
+								raysGenerated = true;
+							}
+							for (const auto& ray : rays) {
+								if (colliderA->RayCollision(ray, entityA.get(), collision)) {
+									contacts.emplace_back(idB, idA, collision, immovableB, immovableA);
 								}
 							}
-							
 						}
 					}
-					NextEntityA: (void)0;
 				}
+			});
+			RandomInt(randomSeed);
+			
+			// Contacts are merged in pair order, which does not depend on the number of threads
+			contacts.clear();
+			for (size_t i = 0; i < batchCount; ++i) {
+				contacts.insert(contacts.end(), batchContacts[i].begin(), batchContacts[i].end());
 			}
 		}
+		endStage(physicsTimings.narrowphase);
 		
+		{// Collision response
+			
+			// Graph coloring: two contacts of the same color never share a body, so that each color can be solved in parallel without two threads touching the same rigidbody
+			// Immovable bodies (such as builds) are never written by the solver, so they are left out of the graph, otherwise all contacts against the same build would need a color each
+			bodyContactColors.clear();
+			solverRigidbodies.clear();
+			contactColors.resize(PHYSICS_SOLVER_MAX_COLORS + 1);
+			for (auto& colorContacts : contactColors) colorContacts.clear();
+			// Each body's rigidbody is looked up once here, so that the solver threads don't have to lock them
+			auto resolveRigidbody = [](Entity::Id id) -> Rigidbody* {
+				auto[it, inserted] = solverRigidbodies.try_emplace(id, nullptr);
+				if (inserted) {
+					if (auto entity = ServerSideEntity::Get(id); entity) {
+						if (auto rb = entity->rigidbody.Lock(); rb) it->second = rb.operator->();
+					}
+				}
+				return it->second;
+			};
+			for (uint32_t i = 0; i < uint32_t(contacts.size()); ++i) {
+				contacts[i].rigidbodyA = resolveRigidbody(contacts[i].a);
+				contacts[i].rigidbodyB = resolveRigidbody(contacts[i].b);
+				if (!contacts[i].rigidbodyA || !contacts[i].rigidbodyB) continue;
+				uint64_t immovableColorsA = 0;
+				uint64_t immovableColorsB = 0;
+				uint64_t& colorsA = contacts[i].immovableA? immovableColorsA : bodyContactColors[contacts[i].a];
+				uint64_t& colorsB = contacts[i].immovableB? immovableColorsB : bodyContactColors[contacts[i].b];
+				const uint64_t availableColors = ~(colorsA | colorsB);
+				if (availableColors == 0) {
+					// Bodies with too many contacts are left for a last serial pass
+					contactColors[PHYSICS_SOLVER_MAX_COLORS].push_back(i);
+				} else {
+					const int color = __builtin_ctzll(availableColors);
+					colorsA |= 1ull << color;
+					colorsB |= 1ull << color;
+					contactColors[color].push_back(i);
+				}
+			}
+			for (int color = 0; color < PHYSICS_SOLVER_MAX_COLORS; ++color) {
+				const auto& colorContacts = contactColors[color];
+				if (colorContacts.size() == 0) break; // colors are assigned from the lowest, an empty one is the last one
+				physicsJobs->ParallelFor(colorContacts.size(), PHYSICS_SOLVER_CONTACTS_PER_BATCH, [&colorContacts](size_t begin, size_t end, int){
+					for (size_t i = begin; i < end; ++i) {
+						RespondToCollision(contacts[colorContacts[i]]);
+					}
+				});
+			}
+			for (auto i : contactColors[PHYSICS_SOLVER_MAX_COLORS]) {
+				RespondToCollision(contacts[i]);
+			}
+			
+			// Islands and collision events are handled from the physics thread, in the order the contacts were found
+			for (const auto& contact : contacts) if (contact.responded) {
+				if (contact.connectsIslands) islands.AddContact(contact.a, contact.b);
+				TriggerCollisionEvents(contact);
+			}
+		}
+		endStage(physicsTimings.solver);
+		
+		const uint64_t terrainCacheHits = terrainCache.GetHits();
+		const uint64_t terrainCacheMisses = terrainCache.GetMisses();
 		if (PlanetTerrain::generatorFunction) {// Apply Gravity and Collision with terrain
 			for (const auto&[referenceFrame, colliders] : cachedBroadphaseColliders) {
 				const GalacticPosition galacticPosition(referenceFrame);
@@ -298,7 +583,9 @@ V4D_MODULE_CLASS(V4D_Mod) {
 						const double terrainRadius = planet->GetTerrainRadius();
 						const double terrainTopRadius = terrainRadius + planet->GetTerrainHeightVariation();
 						const double atmosphereTopRadius = planet->GetAtmosphereRadius();
-						for (auto collider : colliders) {
+						for (const auto& collider : colliders) {
+							// Kinematic bodies have no gravity and are not pushed by the terrain, sleeping bodies are skipped before looking up and locking them
+							if (collider.immovable || collider.sleeping) continue;
 							const double distanceFromPlanetCenter = glm::length(collider.position);
 							if (distanceFromPlanetCenter > 0) {
 								if (auto entity = ServerSideEntity::Get(collider.id); entity) {
@@ -320,13 +607,9 @@ V4D_MODULE_CLASS(V4D_Mod) {
 										
 										const glm::dvec3 pos = glm::round(normalizedPos * terrainRadius);
 										const glm::ivec3 ipos = pos;
-										double height;
-										try{
-											height = terrainCache.at(planet->GetID()).at(pos.x).at(pos.y).at(pos.z);
-										} catch (std::out_of_range) {
-											// LOG("Generating terrain " << pos.x << ", " << pos.y << ", " << pos.z)
-											height = terrainCache[planet->GetID()][pos.x][pos.y][pos.z] = planet->GetTerrainHeightAtPos(glm::normalize(pos));
-										}
+										const double height = terrainCache.Get(planet->GetID(), ipos, [&planet, &pos]{
+											return planet->GetTerrainHeightAtPos(glm::normalize(pos));
+										});
 		
 										if (distanceFromPlanetCenter - collider.radius*radiusMarginFactor - height < 0) {
 											SolveCollisionWithTerrain(entity, planet);
@@ -339,28 +622,80 @@ V4D_MODULE_CLASS(V4D_Mod) {
 				}
 			}
 		}
+		endStage(physicsTimings.terrain);
+		if (physicsTimings.enabled) {
+			physicsTimings.terrainCacheHits += terrainCache.GetHits() - terrainCacheHits;
+			physicsTimings.terrainCacheMisses += terrainCache.GetMisses() - terrainCacheMisses;
+		}
 		
-		{// Integrate motion
-			ServerSideEntity::rigidbodyComponents.ForEach([](Entity::Id id, Rigidbody& rigidbody){
+		{// Sleep
+			// Sleep timers are updated after collision responses and before integration, otherwise gravity would keep bodies resting on the ground above the threshold
+			// Bodies are gathered into the pool in the same pass, their state does not change anymore before integration
+			ForEachRigidbody([](ServerSideEntity::Ptr& entity, Rigidbody& rigidbody){
 				if (rigidbody.IsInitialized() && !rigidbody.IsKinematic() && !rigidbody.atRest) {
-					// Linear integration
-					rigidbody.linearAcceleration += rigidbody.invMass * rigidbody.force;
-					rigidbody.linearVelocity += rigidbody.linearAcceleration * avgDeltaTime;
-					rigidbody.position += rigidbody.linearVelocity * avgDeltaTime;
-					// Angular integration
-					if (!rigidbody.IsOrientationLocked()) {
-						rigidbody.angularAcceleration += rigidbody.invInertiaTensorWorld * rigidbody.torque;
-						rigidbody.angularVelocity += rigidbody.angularAcceleration * avgDeltaTime;
-						rigidbody.orientation = glm::normalize(rigidbody.orientation + glm::dquat(0.0, rigidbody.angularVelocity * avgDeltaTime / 2.0) * rigidbody.orientation);
-						rigidbody.ComputeInvInertiaTensorWorld();
+					if (glm::length(rigidbody.linearVelocity) < PHYSICS_SLEEP_SPEED_THRESHOLD && glm::length(rigidbody.angularVelocity) < PHYSICS_SLEEP_ANGULAR_SPEED_THRESHOLD) {
+						rigidbody.sleepTimer += avgDeltaTime;
+					} else {
+						rigidbody.sleepTimer = 0;
 					}
+					// Bodies without contacts are islands of their own
+					islands.Add(entity->GetID());
 				}
+				rigidbodyPool.Gather(entity->rigidbodyPoolHandle, rigidbody);
 			});
+			// An island goes to sleep when all of its bodies have been still for long enough, otherwise all of its bodies are woken up
+			islands.ForEachIsland([](const std::vector<Entity::Id>& bodies){
+				bool canSleep = true;
+				for (auto id : bodies) {
+					if (auto entity = ServerSideEntity::Get(id); entity) {
+						if (auto rb = entity->rigidbody.Lock(); rb) {
+							if (!rb->atRest && rb->sleepTimer < PHYSICS_SLEEP_TIME) {
+								canSleep = false;
+								break;
+							}
+						}
+					}
+				}
+				for (auto id : bodies) {
+					if (auto entity = ServerSideEntity::Get(id); entity) {
+						if (auto rb = entity->rigidbody.Lock(); rb) {
+							if (canSleep) {
+								if (!rb->atRest) {
+									rb->Sleep();
+									rigidbodyPool.SkipIntegration(entity->rigidbodyPoolHandle);
+								}
+							} else {
+								// Woken up with no velocity nor force, so there is nothing to integrate until the next tick gathers it
+								if (rb->atRest) rb->Wake();
+							}
+						}
+					}
+				}
+			});
+		}
+		endStage(physicsTimings.sleep);
+		
+		{// Integrate motion
+			rigidbodyPool.Integrate(avgDeltaTime);
 		}
+		endStage(physicsTimings.integration);
 		
 		{// Update entity
-			ServerSideEntity::rigidbodyComponents.ForEach_Entity([](ServerSideEntity::Ptr& entity, Rigidbody& rigidbody){
+			ForEachRigidbody([](ServerSideEntity::Ptr& entity, Rigidbody& rigidbody){
 				if (rigidbody.IsInitialized() && !rigidbody.IsKinematic()) {
+					if (entity->IsSleeping() != rigidbody.atRest) {
+						entity->SetSleeping(rigidbody.atRest);
+						if (entity->broadphaseProxyIndex != -1) {
+							broadphase.SetSleeping(entity->broadphaseProxyIndex, rigidbody.atRest);
+						}
+						if (entity->colliderCacheIndex != -1) {
+							cachedBroadphaseColliders[entity->referenceFrame][entity->colliderCacheIndex].sleeping = rigidbody.atRest;
+						}
+					}
+					if (rigidbody.atRest) return;
+					if (rigidbodyPool.Scatter(entity->rigidbodyPoolHandle, rigidbody) && !rigidbody.IsOrientationLocked()) {
+						rigidbody.ComputeInvInertiaTensorWorld();
+					}
 					entity->position = rigidbody.position;
 					if (!rigidbody.IsOrientationLocked()) entity->orientation = rigidbody.orientation;
 					// Clear forces
@@ -371,10 +706,19 @@ V4D_MODULE_CLASS(V4D_Mod) {
 					if (entity->colliderCacheIndex != -1) {
 						cachedBroadphaseColliders[entity->referenceFrame][entity->colliderCacheIndex].position = rigidbody.position;
 					}
+					if (entity->broadphaseProxyIndex != -1) {
+						broadphase.Update(entity->broadphaseProxyIndex, rigidbody.position);
+					}
 				}
 			});
 		}
+		endStage(physicsTimings.entityUpdate);
+		
+		collisionDispatch.Flush();
+		endStage(physicsTimings.collisionDispatch);
+		if (physicsTimings.enabled) ++physicsTimings.ticks;
 		
+		++physicsReplay.tick;
 	}
 
 };
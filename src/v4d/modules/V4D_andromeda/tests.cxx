@@ -0,0 +1,155 @@
+#include <v4d.h>
+
+#include "utilities/io/Logger.h"
+
+#include "v4d/game/random.hh"
+#include "v4d/game/Broadphase.hpp"
+#include "v4d/game/Rigidbody.hpp"
+#include "TerrainHeightCache.hpp"
+
+namespace v4d::tests {
+
+	// Heights read through the cache the same way as the physics (keyed by the position on the terrain sphere rounded to the meter), with a budget small enough to evict
+	int ANDROMEDA_TERRAIN_HEIGHT_CACHE() {
+		constexpr double terrainRadius = 1'000'000;
+		constexpr double heightVariation = 5'000;
+		constexpr double tolerance = 0.5; // meters, the steepest slope of the generator below times the rounding of the key
+		auto generator = [](const glm::dvec3& normalizedPos) -> double {
+			return terrainRadius + heightVariation * glm::sin(normalizedPos.x * 50.0) * glm::cos(normalizedPos.y * 50.0);
+		};
+
+		TerrainHeightCache cache(256 * 1024);
+		if (cache.GetMemoryUsage() != 0) return 1;
+
+		uint seed = 1;
+		std::vector<glm::dvec3> positions {};
+		// A few regions where bodies would be resting, so that keys repeat
+		for (int region = 0; region < 8; ++region) {
+			const glm::dvec3 center = glm::normalize(glm::dvec3(RandomInUnitSphere(seed)) + glm::dvec3(0.01));
+			for (int i = 0; i < 2000; ++i) {
+				positions.push_back(glm::normalize(center * terrainRadius + glm::dvec3(RandomInUnitCube(seed)) * 50.0));
+			}
+		}
+
+		for (int pass = 0; pass < 2; ++pass) {
+			for (size_t i = 0; i < positions.size(); ++i) {
+				const uint64_t referenceFrame = 1 + i % 2;
+				const glm::dvec3 pos = glm::round(positions[i] * terrainRadius);
+				const glm::ivec3 ipos = pos;
+				const double height = cache.Get(referenceFrame, ipos, [&]{
+					return generator(glm::normalize(pos)) + double(referenceFrame);
+				});
+				// Exactly what the generator gives at the rounded position, whether it was a hit or a miss
+				if (height != generator(glm::normalize(pos)) + double(referenceFrame)) {
+					LOG_ERROR("Cached height " << height << " for another key at " << i)
+					return 2;
+				}
+				if (glm::abs(height - double(referenceFrame) - generator(positions[i])) > tolerance) {
+					LOG_ERROR("Cached height " << height << " differs by more than " << tolerance << " m from the generator at " << i)
+					return 3;
+				}
+			}
+		}
+
+		if (cache.GetMemoryUsage() == 0 || cache.GetMemoryUsage() > 256 * 1024) return 4;
+		if (cache.GetHits() == 0 || cache.GetMisses() == 0) return 5;
+		if (cache.GetEvictions() == 0) return 6;
+		if (cache.GetHits() + cache.GetMisses() != positions.size() * 2) return 7;
+
+		cache.Clear();
+		if (cache.GetHits() != 0 || cache.GetMisses() != 0) return 8;
+
+		return 0;
+	}
+
+	// A box dropped on a kinematic build (an immovable compound that never sleeps) goes to sleep and stays asleep, with the same order of stages as ServerPhysicsUpdate
+	int ANDROMEDA_PHYSICS_SLEEP_ON_KINEMATIC() {
+		constexpr double deltaTime = 1.0 / 60;
+		constexpr double gravity = 9.8;
+		constexpr double halfSize = 0.5;
+		constexpr Entity::Id buildId = 1;
+		constexpr Entity::Id boxId = 2;
+
+		Broadphase broadphase {};
+		// The build's top face is at z=0 and its bounding sphere overlaps the box wherever it rests
+		Rigidbody build(0);
+		build.SetKinematic();
+		const Broadphase::ProxyIndex buildProxy = broadphase.Insert(0, BroadphaseCollider({0,0,-4}, 6, buildId));
+		broadphase.SetImmovable(buildProxy, true);
+		Rigidbody box(Rigidbody::BoxInertia(10, 1, 1, 1));
+		box.restitution = 0;
+		box.position = {0.3, -0.2, 2};
+		box.boundingRadius = 0.87;
+		const Broadphase::ProxyIndex boxProxy = broadphase.Insert(0, BroadphaseCollider(box.position, box.boundingRadius, boxId));
+
+		auto countPairs = [&broadphase]{
+			int pairs = 0;
+			broadphase.ForEachPair([&pairs](const BroadphaseCollider& a, const BroadphaseCollider& b){
+				if ((a.id == buildId && b.id == boxId) || (a.id == boxId && b.id == buildId)) ++pairs;
+			});
+			return pairs;
+		};
+
+		int sleepingTick = -1;
+		int wakeUps = 0;
+		for (int tick = 0; tick < 240; ++tick) {
+			// Collision response against the build's top face, including zero impulses once the box is resting
+			if (countPairs() > 0) {
+				const double penetration = halfSize - box.position.z;
+				if (penetration > 0) {
+					if (!box.atRest) box.position.z += penetration;
+					box.ApplyImpulse({0, 0, -box.linearVelocity.z * (box.restitution + 1.0) / box.invMass});
+				}
+			}
+			if (sleepingTick != -1 && !box.atRest) ++wakeUps;
+			// Gravity
+			if (!box.atRest) box.linearAcceleration += glm::dvec3{0, 0, -gravity};
+			// Sleep
+			if (!box.atRest) {
+				if (glm::length(box.linearVelocity) < PHYSICS_SLEEP_SPEED_THRESHOLD && glm::length(box.angularVelocity) < PHYSICS_SLEEP_ANGULAR_SPEED_THRESHOLD) {
+					box.sleepTimer += deltaTime;
+				} else {
+					box.sleepTimer = 0;
+				}
+				if (box.sleepTimer >= PHYSICS_SLEEP_TIME) {
+					box.Sleep();
+					broadphase.SetSleeping(boxProxy, true);
+					if (sleepingTick == -1) sleepingTick = tick;
+				}
+			}
+			// Integrate
+			if (!box.atRest) {
+				box.linearVelocity += box.linearAcceleration * deltaTime;
+				box.position += box.linearVelocity * deltaTime;
+				box.linearAcceleration = {0,0,0};
+				broadphase.Update(boxProxy, box.position);
+			}
+		}
+
+		if (sleepingTick == -1) {
+			LOG_ERROR("Box resting on a kinematic build never went to sleep")
+			return 1;
+		}
+		if (wakeUps > 0 || !box.atRest) {
+			LOG_ERROR("Box resting on a kinematic build was woken up " << wakeUps << " times after going to sleep at tick " << sleepingTick)
+			return 2;
+		}
+		if (glm::abs(box.position.z - halfSize) > 0.05) return 3;
+		// The pair is not reported while the box sleeps, nothing could move either of them
+		if (countPairs() != 0) return 4;
+
+		// Impulses too weak to bring it above the sleep thresholds keep it asleep
+		box.ApplyImpulse({0,0,0});
+		box.ApplyImpulse({0,0,0}, {halfSize,0,-halfSize});
+		box.ApplyImpulse({0, 0, PHYSICS_SLEEP_SPEED_THRESHOLD * 0.5 / box.invMass});
+		if (!box.atRest || glm::length(box.linearVelocity) != 0) return 5;
+		// A stronger one wakes it up with its full velocity
+		box.ApplyImpulse({0, 0, 1.0 / box.invMass});
+		if (box.atRest || glm::abs(box.linearVelocity.z - 1.0) > 1e-9) return 6;
+		broadphase.SetSleeping(boxProxy, false);
+		if (countPairs() != 1) return 7;
+
+		return 0;
+	}
+
+}
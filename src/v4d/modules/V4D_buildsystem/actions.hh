@@ -9,5 +9,10 @@ namespace networking::actions {
 	const Action REMOVE_BLOCK_FROM_BUILD = 3;
 	const Action PAINT_BLOCK_FACE = 4;
 	const Action PAINT_BLOCK_VERTEX_GRADIENT = 5;
+	const Action REQUEST_BUILD_STATE = 6;
+	
+	// Server -> Client
+	const Action BUILD_STATE = 7;
+	const Action BUILD_NOT_FOUND = 8; // reply to REQUEST_BUILD_STATE for a build that does not exist (anymore)
 	
 }
@@ -6,6 +6,7 @@
 #include "v4d/game/ClientSideEntity.hpp"
 #include "v4d/game/ServerSidePlayer.hpp"
 #include "v4d/game/Collider.hpp"
+#include "v4d/game/PacketPool.hpp"
 
 #include "utilities/io/Logger.h"
 #include "utilities/networking/ListeningServer.h"
@@ -57,6 +58,62 @@ void ClientEnqueueAction(v4d::data::WriteOnlyStream& stream) {
 	clientActionQueue.emplace(stream);
 }
 
+PacketPool<v4d::data::WriteOnlyStream> serverActionPool {1024}; // initial capacity of pooled action streams, BUILD_STATE grows it to the size of the build
+PacketQueues<v4d::data::WriteOnlyStream> serverActionQueuePerClient {};
+
+// Client-Only, cachedData.objectMapsMutex must be locked
+void UpdateBuildEntityInstances(int64_t entityUniqueID, const std::shared_ptr<Build>& build) {
+	ClientSideEntity::Ptr entity = ClientSideEntity::Get(entityUniqueID);
+	if (!entity) return;
+	// Chunks that were not regenerated keep their entity, those that were removed have expired
+	for (auto it = entity->renderableGeometryEntityInstances.begin(); it != entity->renderableGeometryEntityInstances.end(); ) {
+		if (it->second.expired()) {
+			it = entity->renderableGeometryEntityInstances.erase(it);
+		} else {
+			++it;
+		}
+	}
+	build->ForEachEntity([&entity](BuildMesh::ChunkKey key, const std::shared_ptr<RenderableGeometryEntity>& chunkEntity){
+		entity->renderableGeometryEntityInstances[v4d::TextID("blocks:" + std::to_string(key))] = chunkEntity;
+	});
+}
+
+// Client-Only, cachedData.objectMapsMutex must be locked
+void ApplyBuildEdits(int64_t entityUniqueID, const std::shared_ptr<Build>& build, std::vector<BlockEdit>& edits) {
+	if (build->ApplyEdits(edits)) {
+		cachedData.pendingBuildEdits.erase(entityUniqueID);
+		UpdateBuildEntityInstances(entityUniqueID, build);
+	} else {
+		// Edits are missing, keep the latest ones until the full state arrives
+		if (cachedData.pendingBuildEdits.count(entityUniqueID) == 0) {
+			v4d::data::WriteOnlyStream stream(32);
+				stream << REQUEST_BUILD_STATE;
+				// Network data
+				stream << (Entity::Id)entityUniqueID;
+			ClientEnqueueAction(stream);
+		}
+		cachedData.pendingBuildEdits[entityUniqueID].swap(edits);
+	}
+}
+
+// Server-Only, cachedData.serverObjectMapsMutex must be locked
+// Replaces the primitives of the chunks that changed in the compound collider of the build, and fits the bounding sphere of its rigidbody around them
+void UpdateBuildCollider(const ServerSideEntity::Ptr& entity, BuildCollider& buildCollider) {
+	auto collider = entity->colliders.find("blocks");
+	if (collider == entity->colliders.end()) return;
+	auto& compound = static_cast<CompoundCollider&>(*collider->second);
+	if (buildCollider.UpdateDirtyChunks(compound) == 0) return;
+	const auto bounds = compound.GetBounds();
+	double boundingRadius = 0;
+	for (int i = 0; i < 8; ++i) {
+		boundingRadius = glm::max(boundingRadius, glm::length(glm::dvec3{i&1? bounds.max.x : bounds.min.x, i&2? bounds.max.y : bounds.min.y, i&4? bounds.max.z : bounds.min.z}));
+	}
+	if (auto rigidbody = entity->rigidbody.Lock(); rigidbody && rigidbody->boundingRadius != boundingRadius) {
+		rigidbody->boundingRadius = boundingRadius;
+		ServerSideEntity::colliderCacheValid = false;
+	}
+}
+
 V4D_MODULE_CLASS(V4D_Mod) {
 	
 	V4D_MODULE_FUNC(void, ModuleLoad) {
@@ -78,12 +135,15 @@ V4D_MODULE_CLASS(V4D_Mod) {
 		buildInterface.scene = scene;
 	}
 	
+	V4D_MODULE_FUNC(void, UnloadScene) {
+		serverActionQueuePerClient.Clear();
+	}
+	
 	V4D_MODULE_FUNC(void, CreateEntity, int64_t entityUniqueID, uint64_t type) {
 		std::lock_guard lock(cachedData.objectMapsMutex);
 		switch (type) {
 			case OBJECT_TYPE::Build:{
 				cachedData.builds[entityUniqueID] = std::make_shared<Build>(entityUniqueID);
-				cachedData.buildBlocks[entityUniqueID] = {};
 			}break;
 		}
 	}
@@ -92,7 +152,7 @@ V4D_MODULE_CLASS(V4D_Mod) {
 		switch (type) {
 			case OBJECT_TYPE::Build:{
 				try {cachedData.builds.erase(entityUniqueID);} catch(...){}
-				try {cachedData.buildBlocks.erase(entityUniqueID);} catch(...){}
+				try {cachedData.pendingBuildEdits.erase(entityUniqueID);} catch(...){}
 			}break;
 		}
 	}
@@ -100,25 +160,27 @@ V4D_MODULE_CLASS(V4D_Mod) {
 	// Server-Only
 	V4D_MODULE_FUNC(void, StreamSendEntityData, int64_t entityUniqueID, uint64_t type, v4d::data::WriteOnlyStream& stream) {
 		std::lock_guard lock1(cachedData.serverObjectMapsMutex);
-		{// Data over network
-			stream.Write(cachedData.serverBuildBlocks[entityUniqueID]);
+		{// Data over network, only the latest edits, clients that missed older ones request the full state
+			// Builds whose last block was removed have no log anymore, looking it up must not create it again
+			if (auto log = cachedData.serverBuildEditLogs.find(entityUniqueID); log != cachedData.serverBuildEditLogs.end()) {
+				log->second.Write(stream);
+			} else {
+				BuildEditLog{}.Write(stream);
+			}
 		}
 	}
 	
 	// Client-Only
 	V4D_MODULE_FUNC(void, StreamReceiveEntityData, int64_t entityUniqueID, uint64_t type, v4d::data::ReadOnlyStream& stream) {
 		std::lock_guard lock(cachedData.objectMapsMutex);
+		std::vector<BlockEdit> edits {};
 		{// Data over network
-			cachedData.buildBlocks[entityUniqueID] = stream.Read<std::vector<Block>>();
+			BuildEditLog::Read(stream, edits);
 		}
 		try { // Update build in-game
-			ClientSideEntity::Ptr entity = ClientSideEntity::Get(entityUniqueID);
 			auto& build = cachedData.builds.at(entityUniqueID);
 			if (build) {
-				auto& blocks = cachedData.buildBlocks.at(entityUniqueID);
-				entity->renderableGeometryEntityInstances["blocks"] = build->SwapBlocksAndRebuild(blocks);
-				entity->posInit = false;
-				entity->renderableGeometryEntityInstances["blocks"] = cachedData.builds[entityUniqueID]->CreateEntity();
+				ApplyBuildEdits(entityUniqueID, build, edits);
 			}
 		} catch(...){}
 	}
@@ -304,7 +366,18 @@ V4D_MODULE_CLASS(V4D_Mod) {
 				entity->position = position;
 				entity->orientation = orientation;
 				entity->SetDynamic();
-				cachedData.serverBuildBlocks[entity->GetID()].push_back(block);
+				if (auto rigidbody = entity->Add_rigidbody(0.0f); rigidbody) {
+					// Does not move by itself, collides with the primitives of its blocks
+					rigidbody->SetKinematic();
+					rigidbody->position = position;
+					rigidbody->orientation = orientation;
+				}
+				entity->colliders.emplace("blocks", std::make_unique<CompoundCollider>());
+				auto edit = BlockEdit::Add(block);
+				auto& buildBlocks = cachedData.serverBuildBlocks[entity->GetID()];
+				edit.ApplyTo(buildBlocks);
+				cachedData.serverBuildEditLogs[entity->GetID()].Push(edit);
+				UpdateBuildCollider(entity, buildBlocks);
 				entity->Activate();
 			}break;
 		
@@ -316,16 +389,14 @@ V4D_MODULE_CLASS(V4D_Mod) {
 				std::scoped_lock lock(cachedData.serverObjectMapsMutex);
 				try {
 					auto& buildBlocks = cachedData.serverBuildBlocks.at(parentId);
-					uint32_t nextIndex = 1;
-					for (auto& b : buildBlocks) {
-						nextIndex = std::max(nextIndex, b.GetIndex()+1);
-					}
-					block.SetIndex(nextIndex);
-					if (Build::IsBlockAdditionValid(buildBlocks, block)) {
-						buildBlocks.push_back(block);
-					}
+					block.SetIndex(buildBlocks.GetFreeIndex());
+					if (!Build::IsBlockAdditionValid(buildBlocks.GetBlocks(), block)) break;
+					auto edit = BlockEdit::Add(block);
+					if (!edit.ApplyTo(buildBlocks)) break;
+					cachedData.serverBuildEditLogs[parentId].Push(edit);
 				}catch(...){break;}
 				if (ServerSideEntity::Ptr entity = ServerSideEntity::Get(parentId); entity) {
+					UpdateBuildCollider(entity, cachedData.serverBuildBlocks.at(parentId));
 					entity->Iterate();
 				}
 			}break;
@@ -338,21 +409,22 @@ V4D_MODULE_CLASS(V4D_Mod) {
 				std::scoped_lock lock(cachedData.serverObjectMapsMutex);
 				try {
 					auto& buildBlocks = cachedData.serverBuildBlocks.at(parentId);
-					for (auto&b : buildBlocks) {
-						if (b.GetIndex() == blockIndex) {
-							b = buildBlocks.back();
-							buildBlocks.pop_back();
-							break;
-						}
-					}
-					if (buildBlocks.size() == 0) {
+					auto edit = BlockEdit::Remove(blockIndex);
+					if (!edit.ApplyTo(buildBlocks)) break;
+					cachedData.serverBuildEditLogs[parentId].Push(edit);
+					if (buildBlocks.GetBlockCount() == 0) {
 						if (ServerSideEntity::Ptr entity = ServerSideEntity::Get(parentId); entity) {
+							UpdateBuildCollider(entity, buildBlocks);
 							entity->Deactivate();
 						}
+						// The build is gone, later actions and state requests for it find nothing
+						cachedData.serverBuildBlocks.erase(parentId);
+						cachedData.serverBuildEditLogs.erase(parentId);
 						break;
 					}
 				}catch(...){break;}
 				if (ServerSideEntity::Ptr entity = ServerSideEntity::Get(parentId); entity) {
+					UpdateBuildCollider(entity, cachedData.serverBuildBlocks.at(parentId));
 					entity->Iterate();
 				}
 			}break;
@@ -367,12 +439,9 @@ V4D_MODULE_CLASS(V4D_Mod) {
 				std::scoped_lock lock(cachedData.serverObjectMapsMutex);
 				try {
 					auto& buildBlocks = cachedData.serverBuildBlocks.at(parentId);
-					for (auto&b : buildBlocks) {
-						if (b.GetIndex() == blockIndex) {
-							b.SetFaceColor(faceIndex, colorIndex);
-							break;
-						}
-					}
+					auto edit = BlockEdit::PaintFace(blockIndex, faceIndex, colorIndex);
+					if (!edit.ApplyTo(buildBlocks)) break;
+					cachedData.serverBuildEditLogs[parentId].Push(edit);
 				}catch(...){break;}
 				if (ServerSideEntity::Ptr entity = ServerSideEntity::Get(parentId); entity) {
 					entity->Iterate();
@@ -389,24 +458,57 @@ V4D_MODULE_CLASS(V4D_Mod) {
 				std::scoped_lock lock(cachedData.serverObjectMapsMutex);
 				try {
 					auto& buildBlocks = cachedData.serverBuildBlocks.at(parentId);
-					for (auto&b : buildBlocks) {
-						if (b.GetIndex() == blockIndex) {
-							b.SetVertexGradientColor(vertexIndex, colorIndex);
-							break;
-						}
-					}
+					auto edit = BlockEdit::PaintVertexGradient(blockIndex, vertexIndex, colorIndex);
+					if (!edit.ApplyTo(buildBlocks)) break;
+					cachedData.serverBuildEditLogs[parentId].Push(edit);
 				}catch(...){break;}
 				if (ServerSideEntity::Ptr entity = ServerSideEntity::Get(parentId); entity) {
 					entity->Iterate();
 				}
 			}break;
 			
+			case REQUEST_BUILD_STATE:{
+				// Network data
+				auto parentId = stream->Read<Entity::Id>();
+				//
+				auto packet = serverActionPool.Acquire();
+				{std::scoped_lock lock(cachedData.serverObjectMapsMutex);
+					auto blocks = cachedData.serverBuildBlocks.find(parentId);
+					auto& state = *packet;
+					if (blocks == cachedData.serverBuildBlocks.end()) {
+						// The client must not keep waiting for the state of a build that was removed in the meantime
+						state << BUILD_NOT_FOUND;
+						// Network data
+						state << parentId;
+					} else {
+						state << BUILD_STATE;
+						// Network data
+						state << parentId;
+						state << cachedData.serverBuildEditLogs[parentId].GetVersion();
+						state.Write(blocks->second.GetBlocks().GetBlocks());
+					}
+				}
+				serverActionQueuePerClient.Push(client->id, packet);
+			}break;
+			
 			default: 
 				LOG_ERROR("Server ReceiveAction UNRECOGNIZED MODULE ACTION " << std::to_string((int)action))
 			break;
 		}
 	}
 	
+	V4D_MODULE_FUNC(void, ServerSendActions, v4d::io::SocketPtr stream, v4d::networking::IncomingClientPtr client) {
+		serverActionQueuePerClient.Drain(client->id, [&stream](v4d::data::WriteOnlyStream& packet){
+			stream->Begin();
+				stream->EmplaceStream(packet);
+			stream->End();
+		});
+	}
+	
+	V4D_MODULE_FUNC(void, SlowLoopUpdate, double deltaTime) {
+		serverActionQueuePerClient.EraseIf([](uint64_t clientId){return !ServerSidePlayer::Get(clientId);});
+	}
+	
 	#pragma endregion
 	
 	#pragma region Client-Side networking
@@ -425,6 +527,41 @@ V4D_MODULE_CLASS(V4D_Mod) {
 		}
 	}
 	
+	V4D_MODULE_FUNC(void, ClientReceiveAction, v4d::io::SocketPtr stream) {
+		auto action = stream->Read<Action>();
+		switch (action) {
+			case BUILD_STATE:{
+				// Network data
+				auto id = stream->Read<Entity::Id>();
+				auto version = stream->Read<uint32_t>();
+				auto blocks = stream->Read<std::vector<Block>>();
+				//
+				std::lock_guard lock(cachedData.objectMapsMutex);
+				auto build = cachedData.builds.find(id);
+				if (build == cachedData.builds.end() || !build->second) break;
+				build->second->SetState(version, blocks);
+				// Edits received while waiting for it
+				if (auto pending = cachedData.pendingBuildEdits.find(id); pending != cachedData.pendingBuildEdits.end()) {
+					auto edits = std::move(pending->second);
+					cachedData.pendingBuildEdits.erase(pending);
+					ApplyBuildEdits(id, build->second, edits);
+				}
+				UpdateBuildEntityInstances(id, build->second);
+			}break;
+			case BUILD_NOT_FOUND:{
+				// Network data
+				auto id = stream->Read<Entity::Id>();
+				//
+				std::lock_guard lock(cachedData.objectMapsMutex);
+				// Edits received for it are dropped, so that the state is requested again if newer edits are still missing some
+				cachedData.pendingBuildEdits.erase(id);
+			}break;
+			default: 
+				LOG_ERROR("Client ReceiveAction UNRECOGNIZED MODULE ACTION " << std::to_string((int)action))
+			break;
+		}
+	}
+	
 	#pragma endregion
 	
 	#pragma region Input
@@ -0,0 +1,433 @@
+#include <v4d.h>
+#include <V4D_Mod.h>
+
+#include "utilities/io/Logger.h"
+
+#include <iomanip>
+
+#include "v4d/game/Entity.h"
+#include "v4d/game/ClientSideEntity.hpp"
+#include "v4d/game/random.hh"
+
+#include "common.hh"
+
+using namespace v4d::graphics;
+
+// Blocks of a ship-like hull, 1 m blocks of all shapes filling a box that is 20 m wide, 10 m high and as long as needed
+std::vector<Block> GenerateBenchmarkBuild(int nbBlocks) {
+	std::vector<Block> blocks {};
+	blocks.reserve(nbBlocks);
+	for (int i = 0; i < nbBlocks; ++i) {
+		Block block((SHAPE)(i % NB_BLOCKS));
+		block.SetIndex(i + 1);
+		block.SetPosition({float(i % 20), float((i / 20) % 10), float(i / 200)});
+		block.SetColor(i % NB_COLORS);
+		blocks.push_back(block);
+	}
+	return blocks;
+}
+
+// Geometry of all blocks at once, the way builds were generated before they were split into chunks
+uint GenerateFullGeometry(std::vector<Block>& blocks) {
+	std::vector<Mesh::Index32> meshIndices (Block::MAX_INDICES * blocks.size());
+	std::vector<Mesh::VertexPosition> vertexPositions (Block::MAX_VERTICES * blocks.size());
+	std::vector<Mesh::VertexNormal> vertexNormals (Block::MAX_VERTICES * blocks.size());
+	std::vector<Mesh::VertexColor<uint8_t>> vertexColors (Block::MAX_VERTICES * blocks.size());
+	std::vector<uint32_t> customData (Block::MAX_VERTICES * blocks.size());
+	uint nextVertex = 0;
+	uint nextIndex = 0;
+	for (auto& block : blocks) {
+		auto[vertexCount, indexCount] = block.GenerateGeometry(&meshIndices.data()[nextIndex], &vertexPositions.data()[nextVertex], &vertexNormals.data()[nextVertex], &vertexColors.data()[nextVertex], &customData.data()[nextVertex], nextVertex);
+		nextVertex += vertexCount;
+		nextIndex += indexCount;
+	}
+	return nextVertex;
+}
+
+// Times random block edits (add, remove, paint) on a generated build, regenerating the whole build versus only the chunks that changed
+int meshbenchmark(int nbBlocks, int edits) {
+	auto blocks = GenerateBenchmarkBuild(nbBlocks);
+
+	// Whole build
+	const int fullRuns = 5;
+	uint fullVertices = 0;
+	v4d::Timer t(true);
+	for (int i = 0; i < fullRuns; ++i) {
+		fullVertices = GenerateFullGeometry(blocks);
+	}
+	const double fullTime = t.GetElapsedMilliseconds() / fullRuns;
+
+	// Initial generation of all chunks
+	BuildMesh mesh {};
+	t.Reset();
+	mesh.SetBlocks(blocks);
+	mesh.RegenerateDirtyChunks();
+	const double initialTime = t.GetElapsedMilliseconds();
+
+	std::cout << "blocks\tchunks\tvertices\tfull(ms)\tchunked initial(ms)\n";
+	std::cout << nbBlocks << "\t" << mesh.GetChunks().size() << "\t" << fullVertices << "\t" << fullTime << "\t" << initialTime << "\n\n";
+
+	// Edits, applied directly to the mesh (incremental), or to the list of blocks which is then given to the mesh as a whole (as received from the server)
+	std::cout << "edit\tmode\tavg(ms)\tmax(ms)\tchunks/edit\tvertices/edit\n";
+	const char* editNames[] = {"add", "remove", "paint"};
+	uint32_t nextIndex = nbBlocks + 1;
+	for (int mode = 0; mode < 2; ++mode) {
+		for (int editType = 0; editType < 3; ++editType) {
+			uint seed = 0;
+			double totalTime = 0, maxTime = 0;
+			size_t regeneratedChunks = 0, regeneratedVertices = 0;
+			for (int e = 0; e < edits; ++e) {
+				t.Reset();
+				switch (editType) {
+					case 0:{// add a block on top of the hull
+						Block block(SHAPE::CUBE);
+						block.SetIndex(nextIndex++);
+						block.SetPosition({float(RandomInt(seed, 0, 20)), float(10 + e / 200), float(RandomInt(seed, 0, nbBlocks / 200 + 1))});
+						blocks.push_back(block);
+						if (mode == 0) mesh.SetBlock(block);
+					}break;
+					case 1:{// remove a random block
+						auto i = RandomInt(seed, 0, blocks.size());
+						const auto blockIndex = blocks[i].GetIndex();
+						blocks[i] = blocks.back();
+						blocks.pop_back();
+						if (mode == 0) mesh.RemoveBlock(blockIndex);
+					}break;
+					case 2:{// paint a face of a random block
+						auto& block = blocks[RandomInt(seed, 0, blocks.size())];
+						block.SetFaceColor(RandomInt(seed, 0, 6), RandomInt(seed, 0, NB_COLORS));
+						if (mode == 0) mesh.SetBlock(block);
+					}break;
+				}
+				if (mode == 1) mesh.SetBlocks(blocks);
+				regeneratedChunks += mesh.RegenerateDirtyChunks([&regeneratedVertices](BuildMesh::ChunkKey, const std::shared_ptr<BuildMesh::Geometry>& geometry){
+					if (geometry) regeneratedVertices += geometry->vertexPositions.size();
+				});
+				const double time = t.GetElapsedMilliseconds();
+				totalTime += time;
+				maxTime = std::max(maxTime, time);
+			}
+			std::cout << editNames[editType] << "\t" << (mode == 0? "block" : "swap") << "\t" << (totalTime / edits) << "\t" << maxTime << "\t" << (double(regeneratedChunks) / edits) << "\t" << (double(regeneratedVertices) / edits) << "\n";
+		}
+	}
+	return 0;
+}
+
+// Vertices and indices of sample builds, with all faces, with hidden faces culled, and with coplanar faces merged too
+int facesbenchmark(int size) {
+	std::vector<std::pair<std::string, std::vector<Block>>> builds {};
+	uint32_t index = 0;
+	auto makeBlock = [&index](SHAPE shape, glm::vec3 position, uint8_t orientation = 0){
+		Block block(shape);
+		block.SetIndex(++index);
+		block.SetPosition(position);
+		block.SetOrientation(orientation);
+		return block;
+	};
+	{// Solid box of cubes
+		std::vector<Block> blocks {};
+		for (int x = 0; x < size; ++x) for (int y = 0; y < size; ++y) for (int z = 0; z < size; ++z) {
+			blocks.push_back(makeBlock(SHAPE::CUBE, glm::vec3(x,y,z)));
+		}
+		builds.emplace_back("solid box", blocks);
+	}
+	{// Hollow hull of cubes
+		std::vector<Block> blocks {};
+		for (int x = 0; x < size; ++x) for (int y = 0; y < size; ++y) for (int z = 0; z < size; ++z) {
+			if (x == 0 || y == 0 || z == 0 || x == size-1 || y == size-1 || z == size-1) {
+				blocks.push_back(makeBlock(SHAPE::CUBE, glm::vec3(x,y,z)));
+			}
+		}
+		builds.emplace_back("hollow hull", blocks);
+	}
+	{// Stairs of slopes on cubes
+		std::vector<Block> blocks {};
+		for (int x = 0; x < size; ++x) for (int z = 0; z < size; ++z) {
+			for (int y = 0; y < z; ++y) {
+				blocks.push_back(makeBlock(SHAPE::CUBE, glm::vec3(x,y,z)));
+			}
+			blocks.push_back(makeBlock(SHAPE::SLOPE, glm::vec3(x,z,z)));
+		}
+		builds.emplace_back("slope stairs", blocks);
+	}
+	builds.emplace_back("mixed ship", GenerateBenchmarkBuild(size*size*size));
+	
+	std::cout << "build\tblocks\tvariant\tvertices\tindices\thidden faces\tmerged faces\ttime(ms)\n";
+	for (auto&[name, blocks] : builds) {
+		for (int variant = 0; variant < 3; ++variant) {
+			BuildMesh mesh {};
+			mesh.options.cullHiddenFaces = variant > 0;
+			mesh.options.mergeFaces = variant > 1;
+			BlockMesher::Stats stats {};
+			size_t vertices = 0, indices = 0;
+			v4d::Timer t(true);
+			mesh.SetBlocks(blocks);
+			mesh.RegenerateDirtyChunks([&](BuildMesh::ChunkKey, const std::shared_ptr<BuildMesh::Geometry>& geometry){
+				if (geometry) {
+					vertices += geometry->vertexPositions.size();
+					indices += geometry->indices.size();
+				}
+			}, &stats);
+			const double time = t.GetElapsedMilliseconds();
+			const char* variantNames[] = {"all", "culled", "merged"};
+			std::cout << name << "\t" << blocks.size() << "\t" << variantNames[variant] << "\t" << vertices << "\t" << indices << "\t" << stats.hiddenFaces << "\t" << stats.mergedFaces << "\t" << time << "\n";
+		}
+	}
+	return 0;
+}
+
+// Blocks of a build as they were stored before BlockStore, every lookup is a linear scan
+struct LinearBlocks {
+	std::vector<Block> blocks {};
+	const Block* GetBlock(uint32_t blockIndex) const {
+		for (const auto& b : blocks) if (b.GetIndex() == blockIndex) return &b;
+		return nullptr;
+	}
+	void SetBlock(const Block& block) {
+		for (auto& b : blocks) if (b.GetIndex() == block.GetIndex()) {b = block; return;}
+		blocks.push_back(block);
+	}
+	bool RemoveBlock(uint32_t blockIndex) {
+		for (auto& b : blocks) if (b.GetIndex() == blockIndex) {
+			b = blocks.back();
+			blocks.pop_back();
+			return true;
+		}
+		return false;
+	}
+};
+
+// Times server-side block edits (add, remove, paint) and neighbour queries on a large build, with linear scans of a vector of blocks versus a BlockStore
+int storebenchmark(int nbBlocks, int edits) {
+	const auto generated = GenerateBenchmarkBuild(nbBlocks);
+	LinearBlocks vectorBlocks {generated};
+	BlockStore store {};
+	v4d::Timer t(true);
+	store.Assign(generated);
+	std::cout << "blocks\tstore initial(ms)\n" << nbBlocks << "\t" << t.GetElapsedMilliseconds() << "\n\n";
+	
+	std::cout << "edit\tvector(us/edit)\tstore(us/edit)\n";
+	const char* editNames[] = {"add", "remove", "paint", "neighbours"};
+	for (int editType = 0; editType < 4; ++editType) {
+		double times[2] {0, 0};
+		size_t neighbours[2] {0, 0};
+		std::vector<BlockStore::Bounds> vectorBounds {};
+		if (editType == 3) for (const auto& b : vectorBlocks.blocks) vectorBounds.push_back(BlockStore::GetBounds(b));
+		for (int mode = 0; mode < 2; ++mode) {
+			uint seed = editType;
+			t.Reset();
+			for (int e = 0; e < edits; ++e) {
+				const uint32_t blockIndex = RandomInt(seed, 1, nbBlocks + 1);
+				switch (editType) {
+					case 0:{// add a block on top of the hull, with the next free index
+						Block block(SHAPE::CUBE);
+						block.SetPosition({float(RandomInt(seed, 0, 20)), float(10 + e / 200), float(RandomInt(seed, 0, nbBlocks / 200 + 1))});
+						if (mode == 0) {
+							uint32_t nextIndex = 1;
+							for (auto& b : vectorBlocks.blocks) nextIndex = std::max(nextIndex, b.GetIndex()+1);
+							block.SetIndex(nextIndex);
+							BlockEdit::Add(block).ApplyTo(vectorBlocks);
+						} else {
+							block.SetIndex(store.GetFreeIndex());
+							BlockEdit::Add(block).ApplyTo(store);
+						}
+					}break;
+					case 1:{// remove a random block
+						if (mode == 0) BlockEdit::Remove(blockIndex).ApplyTo(vectorBlocks);
+						else BlockEdit::Remove(blockIndex).ApplyTo(store);
+					}break;
+					case 2:{// paint a face of a random block
+						auto edit = BlockEdit::PaintFace(blockIndex, RandomInt(seed, 0, 6), RandomInt(seed, 0, NB_COLORS));
+						if (mode == 0) edit.ApplyTo(vectorBlocks);
+						else edit.ApplyTo(store);
+					}break;
+					case 3:{// blocks touching a random block
+						const auto& blocks = (mode == 0)? vectorBlocks.blocks : store.GetBlocks();
+						const auto bounds = BlockStore::GetBounds(blocks[blockIndex % blocks.size()]);
+						if (mode == 0) {
+							for (const auto& b : vectorBounds) if (b.Touches(bounds)) ++neighbours[mode];
+						} else {
+							store.ForEachTouching(bounds, [&](const Block&, const BlockStore::Bounds&){++neighbours[mode];});
+						}
+					}break;
+				}
+			}
+			times[mode] = t.GetElapsedMilliseconds() * 1000.0 / edits;
+		}
+		if (neighbours[0] != neighbours[1]) LOG_ERROR("Neighbour queries differ: " << neighbours[0] << " vs " << neighbours[1])
+		std::cout << editNames[editType] << "\t" << times[0] << "\t" << times[1] << "\n";
+	}
+	return 0;
+}
+
+// Times saving and loading a large build, raw and compressed, in memory (encoding and decoding only) and through a file
+int filebenchmark(int nbBlocks) {
+	const auto blocks = GenerateBenchmarkBuild(nbBlocks);
+	const auto path = (std::filesystem::temp_directory_path() / "v4d_buildsystem_benchmark.build").string();
+	const double megabytes = double(blocks.size() * sizeof(Block)) / (1024 * 1024);
+	const int runs = 5;
+	std::cout << "blocks\tformat\tsize(KB)\tencode(ms)\tdecode(ms)\tdecode(MB/s)\tsave(ms)\tload(ms)\n";
+	for (bool compressed : {false, true}) {
+		std::vector<uint8_t> file {};
+		BlockStore store {};
+		v4d::Timer t(true);
+		for (int i = 0; i < runs; ++i) file = BuildFile::Encode(blocks.data(), blocks.size(), 1, compressed);
+		const double encodeTime = t.GetElapsedMilliseconds() / runs;
+		t.Reset();
+		for (int i = 0; i < runs; ++i) {
+			if (BuildFile::Decode(file.data(), file.size(), store) != BuildFile::OK) {
+				LOG_ERROR("Could not decode the build")
+				return 1;
+			}
+		}
+		const double decodeTime = t.GetElapsedMilliseconds() / runs;
+		t.Reset();
+		for (int i = 0; i < runs; ++i) {
+			if (BuildFile::Save(path, blocks, 1, compressed) != BuildFile::OK) {
+				LOG_ERROR("Could not save the build to " << path)
+				return 1;
+			}
+		}
+		const double saveTime = t.GetElapsedMilliseconds() / runs;
+		t.Reset();
+		for (int i = 0; i < runs; ++i) {
+			if (BuildFile::Load(path, store) != BuildFile::OK) {
+				LOG_ERROR("Could not load the build from " << path)
+				return 1;
+			}
+		}
+		const double loadTime = t.GetElapsedMilliseconds() / runs;
+		if (store.Size() != blocks.size()) LOG_ERROR("Loaded " << store.Size() << " blocks instead of " << blocks.size())
+		std::cout << nbBlocks << "\t" << (compressed? "lz4" : "raw") << "\t" << (file.size() / 1024) << "\t" << encodeTime << "\t" << decodeTime << "\t" << (megabytes * 1000.0 / decodeTime) << "\t" << saveTime << "\t" << loadTime << "\n";
+	}
+	{// Decoding alone is mostly indexing the blocks in the store
+		BlockStore store {};
+		v4d::Timer t(true);
+		store.Assign(blocks);
+		std::cout << "\nindexing only(ms)\t" << t.GetElapsedMilliseconds() << "\n";
+	}
+	std::filesystem::remove(path);
+	return 0;
+}
+
+// Collision primitives of sample builds compared to their blocks and to the triangles of a mesh collider,
+// with the time to merge them, to update them after random edits, and to find those near a point with the tree versus going through all of them
+int colliderbenchmark(int nbBlocks, int edits) {
+	std::vector<std::pair<std::string, std::vector<Block>>> builds {};
+	{// Solid box of cubes
+		const int size = std::max(1, int(std::cbrt(double(nbBlocks))));
+		std::vector<Block> blocks {};
+		for (int x = 0; x < size; ++x) for (int y = 0; y < size; ++y) for (int z = 0; z < size; ++z) {
+			Block block(SHAPE::CUBE);
+			block.SetIndex(blocks.size() + 1);
+			block.SetPosition(glm::vec3(x,y,z));
+			blocks.push_back(block);
+		}
+		builds.emplace_back("solid box", blocks);
+	}
+	builds.emplace_back("mixed ship", GenerateBenchmarkBuild(nbBlocks));
+	
+	std::cout << "build\tblocks\ttriangles\tprimitives\ttree height\tinitial(ms)\tedit(us)\tquery tree(us)\tquery all(us)\n";
+	for (auto&[name, blocks] : builds) {
+		size_t triangles = 0;
+		BuildMesh mesh {};
+		mesh.SetBlocks(blocks);
+		mesh.RegenerateDirtyChunks([&triangles](BuildMesh::ChunkKey, const std::shared_ptr<BuildMesh::Geometry>& geometry){
+			if (geometry) triangles += geometry->indices.size() / 3;
+		});
+		
+		BuildCollider buildCollider {};
+		CompoundCollider compound {};
+		v4d::Timer t(true);
+		for (const auto& b : blocks) buildCollider.SetBlock(b);
+		buildCollider.UpdateDirtyChunks(compound);
+		const double initialTime = t.GetElapsedMilliseconds();
+		const size_t primitives = buildCollider.GetPrimitiveCount();
+		const int height = compound.GetHeight();
+		
+		// Edits, each followed by the update of the tree like the server does
+		uint seed = 1;
+		t.Reset();
+		for (int e = 0; e < edits; ++e) {
+			if (e % 2 == 0) {
+				Block block(SHAPE::CUBE);
+				block.SetIndex(buildCollider.GetFreeIndex());
+				block.SetPosition({float(RandomInt(seed, 0, 20)), float(RandomInt(seed, 0, 12)), float(RandomInt(seed, 0, int(blocks.size()) / 200 + 1))});
+				BlockEdit::Add(block).ApplyTo(buildCollider);
+			} else {
+				BlockEdit::Remove(RandomInt(seed, 1, int(blocks.size()) + 1)).ApplyTo(buildCollider);
+			}
+			buildCollider.UpdateDirtyChunks(compound);
+		}
+		const double editTime = t.GetElapsedMilliseconds() * 1000.0 / std::max(1, edits);
+		
+		// Queries of 1 m around random points of the build, as the narrowphase does with the bounds of another collider
+		Entity entity {};
+		entity.position = {0,0,0};
+		entity.orientation = {1,0,0,0};
+		std::vector<CompoundCollider::Bounds> allBounds {};
+		compound.ForEachChild([&](const Collider* child){
+			CompoundCollider::Bounds bounds {};
+			for (int axis = 0; axis < 3; ++axis) {
+				glm::dvec3 direction {0};
+				direction[axis] = 1;
+				bounds.max[axis] = child->Support(&entity, direction)[axis];
+				bounds.min[axis] = child->Support(&entity, -direction)[axis];
+			}
+			allBounds.push_back(bounds);
+		});
+		const auto buildBounds = compound.GetBounds();
+		std::vector<CompoundCollider::Bounds> queries {};
+		for (int i = 0; i < 10000; ++i) {
+			const glm::dvec3 p = glm::mix(buildBounds.min, buildBounds.max, glm::dvec3(RandomFloat(seed), RandomFloat(seed), RandomFloat(seed)));
+			queries.push_back({p - 0.5, p + 0.5});
+		}
+		size_t found[2] {0, 0};
+		double queryTimes[2] {0, 0};
+		for (int mode = 0; mode < 2; ++mode) {
+			t.Reset();
+			for (const auto& q : queries) {
+				if (mode == 0) {
+					compound.ForEachOverlapping(q, [&](Collider*){++found[mode];});
+				} else {
+					for (const auto& b : allBounds) if (b.Overlaps(q)) ++found[mode];
+				}
+			}
+			queryTimes[mode] = t.GetElapsedMilliseconds() * 1000.0 / queries.size();
+		}
+		if (found[0] != found[1]) LOG_ERROR("Collider queries differ: " << found[0] << " vs " << found[1])
+		
+		std::cout << name << "\t" << blocks.size() << "\t" << triangles << "\t" << primitives << "\t" << height << "\t" << initialTime << "\t" << editTime << "\t" << queryTimes[0] << "\t" << queryTimes[1] << "\n";
+	}
+	return 0;
+}
+
+V4D_MODULE_CLASS(V4D_Mod) {
+	V4D_MODULE_FUNC(int, RunFromConsole, const int argc, const char** argv) {
+		if (argc >= 1 && argc <= 3 && std::string("mesh") == argv[0]) {
+			return meshbenchmark(
+				argc > 1? atoi(argv[1]) : 5000,
+				argc > 2? atoi(argv[2]) : 200
+			);
+		}
+		if (argc >= 1 && argc <= 3 && std::string("store") == argv[0]) {
+			return storebenchmark(
+				argc > 1? atoi(argv[1]) : 100000,
+				argc > 2? atoi(argv[2]) : 1000
+			);
+		}
+		if (argc >= 1 && argc <= 2 && std::string("faces") == argv[0]) {
+			return facesbenchmark(argc > 1? atoi(argv[1]) : 10);
+		}
+		if (argc >= 1 && argc <= 2 && std::string("file") == argv[0]) {
+			return filebenchmark(argc > 1? atoi(argv[1]) : 100000);
+		}
+		if (argc >= 1 && argc <= 3 && std::string("collider") == argv[0]) {
+			return colliderbenchmark(
+				argc > 1? atoi(argv[1]) : 100000,
+				argc > 2? atoi(argv[2]) : 1000
+			);
+		}
+		return 0;
+	}
+};
@@ -0,0 +1,362 @@
+#include <v4d.h>
+
+#include "utilities/io/Logger.h"
+
+#include "v4d/game/random.hh"
+#include "blocks.hh"
+
+namespace v4d::tests {
+
+	// Blocks of all shapes, sizes, orientations and colors, at random positions, with random unique indices
+	std::vector<Block> GenerateRandomBuild(uint& seed, int nbBlocks) {
+		std::vector<Block> blocks {};
+		blocks.reserve(nbBlocks);
+		for (int i = 0; i < nbBlocks; ++i) {
+			Block block((SHAPE)RandomInt(seed, 0, NB_BLOCKS));
+			block.SetIndex(1 + i * 7 + RandomInt(seed, 0, 7));
+			block.SetPosition(glm::vec3(RandomInt(seed, -500, 500), RandomInt(seed, -500, 500), RandomInt(seed, -500, 500)) / 5.0f);
+			block.SetSize(glm::vec3(RandomInt(seed, 1, 50), RandomInt(seed, 1, 50), RandomInt(seed, 1, 50)) / 5.0f);
+			block.SetOrientation(RandomInt(seed, 0, NB_ORIENTATIONS));
+			block.SetColor(RandomInt(seed, 0, NB_COLORS));
+			if (RandomInt(seed, 0, 4) == 0) block.SetFaceColor(RandomInt(seed, 0, 6), RandomInt(seed, 0, NB_COLORS));
+			if (RandomInt(seed, 0, 8) == 0) block.SetVertexGradientColor(RandomInt(seed, 0, 8), RandomInt(seed, 0, NB_COLORS));
+			blocks.push_back(block);
+		}
+		return blocks;
+	}
+
+	bool SameBlocks(const std::vector<Block>& blocks, const BlockStore& store) {
+		if (store.Size() != blocks.size()) return false;
+		for (const auto& b : blocks) {
+			const Block* stored = store.GetBlock(b.GetIndex());
+			if (!stored || *stored != b) return false;
+		}
+		return true;
+	}
+
+	int BUILDSYSTEM_FILE_COMPRESSION() {
+		uint seed = 1;
+		std::vector<uint8_t> compressed {};
+		std::vector<uint8_t> decompressed {};
+		// Random bytes that do not compress, runs longer than the extra length bytes can hold in one, and short inputs
+		for (size_t size : {0, 1, 5, 12, 13, 64, 300, 5000, 70000}) {
+			for (int pattern = 0; pattern < 3; ++pattern) {
+				std::vector<uint8_t> data (size);
+				for (size_t i = 0; i < size; ++i) {
+					switch (pattern) {
+						case 0: data[i] = uint8_t(RandomInt(seed)); break;
+						case 1: data[i] = 42; break;
+						case 2: data[i] = uint8_t((i % 37) < 30? i % 7 : RandomInt(seed)); break;
+					}
+				}
+				compressed.resize(size + size / 255 + 16);
+				const size_t compressedSize = BuildFile::Compress(data.data(), size, compressed.data(), compressed.size());
+				if (compressedSize == 0) {
+					LOG_ERROR("Compress did not fit " << size << " bytes of pattern " << pattern)
+					return 1;
+				}
+				if (pattern == 1 && size >= 5000 && compressedSize > size / 100) return 2;
+				decompressed.assign(size, 0);
+				if (!BuildFile::Decompress(compressed.data(), compressedSize, decompressed.data(), size) || decompressed != data) {
+					LOG_ERROR("Decompress did not restore " << size << " bytes of pattern " << pattern)
+					return 3;
+				}
+				// Truncated or too small outputs are refused instead of overflowing
+				if (compressedSize > 1 && BuildFile::Decompress(compressed.data(), compressedSize - 1, decompressed.data(), size)) return 4;
+				if (size > 0 && BuildFile::Decompress(compressed.data(), compressedSize, decompressed.data(), size - 1)) return 5;
+			}
+		}
+		return 0;
+	}
+
+	int BUILDSYSTEM_FILE_ROUND_TRIP() {
+		uint seed = 2;
+		const auto path = (std::filesystem::temp_directory_path() / "v4d_buildsystem_test.build").string();
+		for (int nbBlocks : {0, 1, 100, BUILD_FILE_CHUNK_BLOCKS, BUILD_FILE_CHUNK_BLOCKS * 3 + 17}) {
+			const auto blocks = GenerateRandomBuild(seed, nbBlocks);
+			for (bool compressed : {false, true}) {
+				const uint32_t buildVersion = RandomInt(seed);
+				{// In memory
+					const auto file = BuildFile::Encode(blocks.data(), blocks.size(), buildVersion, compressed);
+					BlockStore store {};
+					uint32_t loadedVersion = 0;
+					if (BuildFile::Decode(file.data(), file.size(), store, &loadedVersion) != BuildFile::OK) return 1;
+					if (loadedVersion != buildVersion || !SameBlocks(blocks, store)) {
+						LOG_ERROR("Build of " << nbBlocks << " blocks differs after decoding, compressed " << compressed)
+						return 2;
+					}
+				}
+				{// On disk
+					if (BuildFile::Save(path, blocks, buildVersion, compressed) != BuildFile::OK) return 3;
+					BlockStore store {};
+					store.SetBlock(Block(SHAPE::CUBE)); // replaced by the loaded blocks
+					uint32_t loadedVersion = 0;
+					if (BuildFile::Load(path, store, &loadedVersion) != BuildFile::OK) return 4;
+					if (loadedVersion != buildVersion || !SameBlocks(blocks, store)) {
+						LOG_ERROR("Build of " << nbBlocks << " blocks differs after loading, compressed " << compressed)
+						return 5;
+					}
+				}
+			}
+		}
+		std::filesystem::remove(path);
+		BlockStore store {};
+		if (BuildFile::Load(path, store) != BuildFile::CANNOT_OPEN) return 6;
+		return 0;
+	}
+
+	int BUILDSYSTEM_FILE_CORRUPTION() {
+		uint seed = 3;
+		const auto blocks = GenerateRandomBuild(seed, 1000);
+		for (bool compressed : {false, true}) {
+			const auto file = BuildFile::Encode(blocks.data(), blocks.size(), 1, compressed);
+			BlockStore store {};
+			{// Any damaged byte of the data
+				for (int i = 0; i < 50; ++i) {
+					auto damaged = file;
+					damaged[RandomInt(seed, sizeof(BuildFile::Header), damaged.size())] ^= uint8_t(1 << RandomInt(seed, 0, 8));
+					if (BuildFile::Decode(damaged.data(), damaged.size(), store) != BuildFile::CORRUPTED) return 1;
+				}
+			}
+			{// Any damaged byte of the header
+				for (size_t i = 0; i < sizeof(BuildFile::Header); ++i) {
+					auto damaged = file;
+					damaged[i] ^= 0x10;
+					if (BuildFile::Decode(damaged.data(), damaged.size(), store) != BuildFile::INVALID_HEADER) return 2;
+				}
+			}
+			{// Truncated
+				if (BuildFile::Decode(file.data(), file.size() - 1, store) != BuildFile::CORRUPTED) return 3;
+				if (BuildFile::Decode(file.data(), sizeof(BuildFile::Header) - 1, store) != BuildFile::INVALID_HEADER) return 4;
+			}
+			{// From a newer version
+				auto newer = file;
+				BuildFile::Header header;
+				memcpy(&header, newer.data(), sizeof(header));
+				header.formatVersion = BUILD_FILE_FORMAT_VERSION + 1;
+				header.headerChecksum = BuildFile::Crc32(reinterpret_cast<const uint8_t*>(&header), offsetof(BuildFile::Header, headerChecksum));
+				memcpy(newer.data(), &header, sizeof(header));
+				if (BuildFile::Decode(newer.data(), newer.size(), store) != BuildFile::UNSUPPORTED_VERSION) return 5;
+			}
+			// The store is left as it was when loading fails
+			if (store.Size() != 0) return 6;
+		}
+		return 0;
+	}
+
+	// Inside its box and behind the cut planes of its hull
+	bool PrimitiveContains(const BuildCollider::Primitive& primitive, const glm::dvec3& point) {
+		if (!BuildCollider::GetBounds(primitive).Overlaps({point, point})) return false;
+		if (primitive.corners == 0xff) return true;
+		const auto collider = BuildCollider::CreateCollider(primitive);
+		const auto& wedge = static_cast<const WedgeCollider&>(*collider);
+		for (const auto& plane : wedge.cutPlanes) {
+			if (glm::dot(glm::dvec3(plane), point - wedge.position) > plane.w) return false;
+		}
+		return true;
+	}
+
+	// Position, size and hull of each child of a compound collider, sorted, to compare two of them
+	std::vector<std::tuple<double,double,double, float,float,float, int>> GetChildren(const CompoundCollider& compound) {
+		std::vector<std::tuple<double,double,double, float,float,float, int>> children {};
+		compound.ForEachChild([&](const Collider* child){
+			if (child->GetType() == ColliderType::Box) {
+				const auto& box = static_cast<const BoxCollider&>(*child);
+				children.emplace_back(box.position.x, box.position.y, box.position.z, box.halfSize.x, box.halfSize.y, box.halfSize.z, 0xff);
+			} else {
+				const auto& wedge = static_cast<const WedgeCollider&>(*child);
+				children.emplace_back(wedge.position.x, wedge.position.y, wedge.position.z, wedge.halfSize.x, wedge.halfSize.y, wedge.halfSize.z, wedge.corners);
+			}
+		});
+		std::sort(children.begin(), children.end());
+		return children;
+	}
+
+	int BUILDSYSTEM_COLLIDER_PRIMITIVES() {
+		{// Each block is the hull of the corners of its primitive
+			uint seed = 4;
+			for (const auto& block : GenerateRandomBuild(seed, 500)) {
+				const auto primitive = BuildCollider::GetPrimitive(block);
+				const auto points = block.GetFinalPointsPositions();
+				size_t nbCorners = 0;
+				for (int i = 0; i < 8; ++i) if (primitive.corners & (1 << i)) ++nbCorners;
+				if (nbCorners != points.size()) return 1;
+				for (const auto& p : points) {
+					const glm::ivec3 point = glm::ivec3(glm::round(p * 20.0f));
+					int corner = 0;
+					for (int axis = 0; axis < 3; ++axis) {
+						if (point[axis] == primitive.max[axis]) corner |= 1 << axis;
+						else if (point[axis] != primitive.min[axis]) return 2;
+					}
+					if (!(primitive.corners & (1 << corner))) return 3;
+				}
+			}
+		}
+		auto makeBlock = [](SHAPE shape, glm::vec3 position, uint8_t orientation = 0){
+			Block block(shape);
+			block.SetPosition(position);
+			block.SetOrientation(orientation);
+			return block;
+		};
+		auto countMerged = [](const std::vector<Block>& blocks){
+			std::vector<BuildCollider::Primitive> primitives {};
+			for (const auto& b : blocks) primitives.push_back(BuildCollider::GetPrimitive(b));
+			BuildCollider::Merge(primitives);
+			return primitives.size();
+		};
+		{// Rows and boxes of blocks become a single primitive when their hull stays the same along them
+			std::vector<Block> cubes {}, slopesAlong {}, slopesAcross {};
+			for (int i = 0; i < 6; ++i) {
+				cubes.push_back(makeBlock(SHAPE::CUBE, {float(i), 0, 0}));
+				slopesAlong.push_back(makeBlock(SHAPE::SLOPE, {float(i), 0, 0}));
+				slopesAcross.push_back(makeBlock(SHAPE::SLOPE, {0, 0, float(i)}));
+			}
+			if (countMerged(cubes) != 1) return 4;
+			if (countMerged(slopesAlong) != 1) return 5;
+			if (countMerged(slopesAcross) != 6) return 6;
+			std::vector<Block> box {};
+			for (int x = 0; x < 4; ++x) for (int y = 0; y < 4; ++y) for (int z = 0; z < 4; ++z) {
+				box.push_back(makeBlock(SHAPE::CUBE, glm::vec3(x,y,z)));
+			}
+			if (countMerged(box) != 1) return 7;
+		}
+		{// Merged primitives cover exactly the same space as the blocks
+			uint seed = 5;
+			std::vector<Block> blocks {};
+			for (int x = 0; x < 6; ++x) for (int y = 0; y < 6; ++y) for (int z = 0; z < 6; ++z) {
+				if (RandomInt(seed, 0, 4) == 0) continue;
+				blocks.push_back(makeBlock((SHAPE)RandomInt(seed, 0, 2), glm::vec3(x,y,z), RandomInt(seed, 0, 2)));
+			}
+			std::vector<BuildCollider::Primitive> primitives {};
+			for (const auto& b : blocks) primitives.push_back(BuildCollider::GetPrimitive(b));
+			auto merged = primitives;
+			BuildCollider::Merge(merged);
+			if (merged.size() >= primitives.size() / 2) {
+				LOG_ERROR("Only merged " << primitives.size() << " blocks into " << merged.size() << " primitives")
+				return 8;
+			}
+			for (int i = 0; i < 20000; ++i) {
+				const glm::dvec3 point = glm::dvec3(RandomFloat(seed), RandomFloat(seed), RandomFloat(seed)) * 7.0 - 0.75;
+				bool inBlocks = false, inMerged = false;
+				for (const auto& p : primitives) inBlocks = inBlocks || PrimitiveContains(p, point);
+				for (const auto& p : merged) inMerged = inMerged || PrimitiveContains(p, point);
+				if (inBlocks != inMerged) {
+					LOG_ERROR("Point " << point.x << "," << point.y << "," << point.z << " is " << (inBlocks? "" : "not ") << "in a block but " << (inMerged? "" : "not ") << "in a merged primitive")
+					return 9;
+				}
+			}
+		}
+		return 0;
+	}
+
+	int BUILDSYSTEM_COLLIDER_UPDATES() {
+		uint seed = 6;
+		BuildCollider buildCollider {};
+		CompoundCollider compound {};
+		auto randomBlock = [&seed](uint32_t index){
+			Block block((SHAPE)RandomInt(seed, 0, NB_BLOCKS));
+			block.SetIndex(index);
+			block.SetPosition(glm::vec3(RandomInt(seed, -10, 10), RandomInt(seed, -10, 10), RandomInt(seed, -10, 10)));
+			block.SetOrientation(RandomInt(seed, 0, 4));
+			return block;
+		};
+		for (int i = 0; i < 2000; ++i) {
+			BlockEdit::Add(randomBlock(buildCollider.GetFreeIndex())).ApplyTo(buildCollider);
+		}
+		buildCollider.UpdateDirtyChunks(compound);
+		for (int round = 0; round < 20; ++round) {
+			for (int e = 0; e < 50; ++e) {
+				const uint32_t blockIndex = RandomInt(seed, 1, 2000);
+				switch (RandomInt(seed, 0, 4)) {
+					case 0: BlockEdit::Add(randomBlock(buildCollider.GetFreeIndex())).ApplyTo(buildCollider); break;
+					case 1: BlockEdit::Remove(blockIndex).ApplyTo(buildCollider); break;
+					case 2: BlockEdit::PaintFace(blockIndex, RandomInt(seed, 0, 6), RandomInt(seed, 0, NB_COLORS)).ApplyTo(buildCollider); break;
+					case 3: if (buildCollider.GetBlock(blockIndex)) buildCollider.SetBlock(randomBlock(blockIndex)); break;
+				}
+			}
+			const size_t updated = buildCollider.UpdateDirtyChunks(compound);
+			if (buildCollider.UpdateDirtyChunks(compound) != 0) return 1;
+			if (updated == 0 || compound.GetChildCount() != buildCollider.GetPrimitiveCount()) return 2;
+			// Same primitives as merging all blocks again
+			BuildCollider rebuilt {};
+			CompoundCollider rebuiltCompound {};
+			for (const auto& b : buildCollider.GetBlocks().GetBlocks()) rebuilt.SetBlock(b);
+			rebuilt.UpdateDirtyChunks(rebuiltCompound);
+			if (GetChildren(compound) != GetChildren(rebuiltCompound)) {
+				LOG_ERROR("Compound collider has " << compound.GetChildCount() << " primitives after edits instead of " << rebuiltCompound.GetChildCount())
+				return 3;
+			}
+		}
+		// Painting does not change the primitives
+		const auto& anyBlock = buildCollider.GetBlocks().GetBlocks()[0];
+		BlockEdit::PaintFace(anyBlock.GetIndex(), 0, BLOCK_COLOR_RED).ApplyTo(buildCollider);
+		if (buildCollider.UpdateDirtyChunks(compound) != 0) return 4;
+		// Removing all blocks removes all primitives
+		while (buildCollider.GetBlockCount() > 0) buildCollider.RemoveBlock(buildCollider.GetBlocks().GetBlocks()[0].GetIndex());
+		buildCollider.UpdateDirtyChunks(compound);
+		if (compound.GetChildCount() != 0 || buildCollider.GetPrimitiveCount() != 0) return 5;
+		return 0;
+	}
+
+	int BUILDSYSTEM_COLLIDER_TREE() {
+		uint seed = 7;
+		CompoundCollider compound {};
+		std::vector<std::tuple<CompoundCollider::Handle, CompoundCollider::Bounds, const Collider*>> children {};
+		auto randomBounds = [&seed](double size){
+			const glm::dvec3 min = glm::dvec3(RandomFloat(seed), RandomFloat(seed), RandomFloat(seed)) * 100.0;
+			return CompoundCollider::Bounds{min, min + glm::dvec3(RandomFloat(seed), RandomFloat(seed), RandomFloat(seed)) * size};
+		};
+		auto add = [&](int count){
+			std::unique_lock lock(compound.mutex);
+			for (int i = 0; i < count; ++i) {
+				const auto bounds = randomBounds(5.0);
+				auto box = std::make_unique<BoxCollider>((bounds.min + bounds.max) * 0.5, glm::dmat3{1}, glm::vec3((bounds.max - bounds.min) * 0.5));
+				const Collider* collider = box.get();
+				children.emplace_back(compound.Add(std::move(box), bounds), bounds, collider);
+			}
+		};
+		auto remove = [&](int count){
+			std::unique_lock lock(compound.mutex);
+			for (int i = 0; i < count; ++i) {
+				const size_t c = RandomInt(seed, 0, children.size());
+				compound.Remove(std::get<0>(children[c]));
+				children[c] = children.back();
+				children.pop_back();
+			}
+		};
+		for (auto[added, removed] : std::vector<std::pair<int,int>>{{2000, 0}, {0, 1500}, {1000, 200}, {1, 1299}}) {
+			add(added);
+			remove(removed);
+			if (compound.GetChildCount() != children.size()) return 1;
+			// Kept balanced
+			const int maxHeight = 2 * int(std::ceil(std::log2(double(children.size() + 1))));
+			if (compound.GetHeight() > maxHeight) {
+				LOG_ERROR("Tree of " << children.size() << " children is " << compound.GetHeight() << " high")
+				return 2;
+			}
+			// Same children as going through all of them
+			for (int q = 0; q < 200; ++q) {
+				const auto query = randomBounds(20.0);
+				std::vector<const Collider*> found {}, expected {};
+				compound.ForEachOverlapping(query, [&found](Collider* c){found.push_back(c);});
+				for (const auto&[handle, bounds, collider] : children) if (bounds.Overlaps(query)) expected.push_back(collider);
+				std::sort(found.begin(), found.end());
+				std::sort(expected.begin(), expected.end());
+				if (found != expected) return 3;
+			}
+		}
+		{// Bounds of the whole tree
+			auto bounds = std::get<1>(children[0]);
+			for (const auto& child : children) bounds = bounds.Union(std::get<1>(child));
+			const auto treeBounds = compound.GetBounds();
+			if (treeBounds.min != bounds.min || treeBounds.max != bounds.max) return 4;
+		}
+		{
+			std::unique_lock lock(compound.mutex);
+			compound.Clear();
+		}
+		if (compound.GetChildCount() != 0 || compound.GetHeight() != 0) return 5;
+		return 0;
+	}
+
+}
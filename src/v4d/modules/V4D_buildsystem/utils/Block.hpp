@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <unordered_set>
 
 using namespace v4d::graphics;
@@ -13,6 +14,7 @@ public:
 	static constexpr int MAX_INDICES_SIMPLE = 36;
 	static constexpr int MAX_VERTICES = MAX_VERTICES_SIMPLE + MAX_POINTS*3 + MAX_LINES*4 + 6;
 	static constexpr int MAX_INDICES = MAX_INDICES_SIMPLE + MAX_POINTS*3 + MAX_LINES*6;
+	friend class BlockMesher;
 protected:
 	
 	// 32 Bytes
@@ -171,6 +173,19 @@ protected:
 		return 0;
 	}
 	
+	uint8_t GetFaceMaterial(uint8_t i) const {
+		switch (i) {
+			case 0: return data.face0Material;
+			case 1: return data.face1Material;
+			case 2: return data.face2Material;
+			case 3: return data.face3Material;
+			case 4: return data.face4Material;
+			case 5: return data.face5Material;
+			case 6: return data.face6Material;
+		}
+		return data.structureMaterial;
+	}
+	
 	bool GetFaceActive(uint8_t i) const {
 		switch (i) {
 			case 0: return !! data.face0;
@@ -184,10 +199,6 @@ protected:
 		return false;
 	}
 	
-	glm::ivec3 GetRawPosition() const {
-		return glm::ivec3(data.posX, data.posY, data.posZ);
-	};
-	
 	void SetRawPosition(glm::ivec3 pos) {
 		data.posX = pos.x;
 		data.posY = pos.y;
@@ -606,6 +617,25 @@ public:
 	glm::vec3 GetPosition() const {
 		return glm::vec3(data.posX, data.posY, data.posZ) / 10.0f;
 	};
+	// Position in grid units of 10 cm
+	glm::ivec3 GetRawPosition() const {
+		return glm::ivec3(data.posX, data.posY, data.posZ);
+	};
+	
+	bool operator==(const Block& other) const {
+		return memcmp(&data, &other.data, sizeof(data)) == 0;
+	}
+	bool operator!=(const Block& other) const {
+		return !(*this == other);
+	}
+	
+	// Same shape, size, orientation and position, colors and materials may differ
+	bool HasSameGeometryAs(const Block& other) const {
+		return data.shape == other.data.shape
+			&& data.orientation == other.data.orientation
+			&& data.sizeX == other.data.sizeX && data.sizeY == other.data.sizeY && data.sizeZ == other.data.sizeZ
+			&& GetRawPosition() == other.GetRawPosition();
+	}
 	
 	void SetSimilarTo(const Block& ref) {
 		data.shape = ref.data.shape;
@@ -798,7 +828,8 @@ public:
 		Mesh::VertexColor<uint8_t>* outputVerticesColor,
 		uint32_t* outputCustomData,
 		uint vertexIndexOffset = 0,
-		float alpha = 1.0f
+		float alpha = 1.0f,
+		uint8_t hiddenFaces = 0 // bit mask of the faces that are not generated
 	) {
 		uint vertexCount = 0, indexCount = 0;
 		auto points = GetPointsPositions();
@@ -809,6 +840,10 @@ public:
 		for (const auto& face : GetFaces()) {
 			assert(faceIndex < MAX_FACES);
 			assert(face.triangles.size() >= 3 && (face.triangles.size() % 3) == 0);
+			if (hiddenFaces & (1 << faceIndex)) {
+				++faceIndex;
+				continue;
+			}
 			// Normal
 			glm::vec3 faceNormal = glm::normalize(glm::cross(points[face.triangles[1]] - points[face.triangles[0]], points[face.triangles[1]] - points[face.triangles[2]]));
 			// Vertices
@@ -816,9 +851,9 @@ public:
 				assert(pointIndex < MAX_POINTS);
 				uint8_t faceVerticesIndex = (faceIndex << 4) | pointIndex; // each face should have their own vertices, but vertices within a face can be reused
 				FaceVertex* faceVertex;
-				try {
-					faceVertex = &faceVertices.at(faceVerticesIndex);
-				} catch (...) {
+				if (auto existing = faceVertices.find(faceVerticesIndex); existing != faceVertices.end()) {
+					faceVertex = &existing->second;
+				} else {
 					faceVertex = &faceVertices[faceVerticesIndex];
 					faceVertex->vertexIndex = vertexCount++;
 					faceVertex->vertexPosition = &outputVerticesPosition[faceVertex->vertexIndex];
@@ -861,13 +896,22 @@ public:
 		Mesh::VertexNormal* outputVerticesNormal,
 		Mesh::VertexColor<uint8_t>* outputVerticesColor,
 		uint32_t* outputCustomData,
-		uint vertexIndexOffset = 0
+		uint vertexIndexOffset = 0,
+		uint8_t hiddenFaces = 0 // bit mask of the faces that are not generated, the bevels between them too
 	) {
 		uint vertexCount = 0, indexCount = 0;
 		auto points = GetPointsPositions(true);
 		
 		bool addBevels = true;
 		
+		// Vertices of hidden faces are still needed to generate the bevels around them, they are generated here instead of in the output
+		uint hiddenVertexCount = 0;
+		std::array<Mesh::VertexPosition, MAX_VERTICES_SIMPLE> hiddenVerticesPosition;
+		std::array<Mesh::VertexNormal, MAX_VERTICES_SIMPLE> hiddenVerticesNormal;
+		std::array<Mesh::VertexColor<uint8_t>, MAX_VERTICES_SIMPLE> hiddenVerticesColor;
+		std::array<uint32_t, MAX_VERTICES_SIMPLE> hiddenCustomData;
+		uint8_t visibleCorners = 0; // bit mask of the points that are part of at least one visible face
+		
 		std::map<uint8_t/*faceAndPointIndex*/, FaceVertex> faceVertices {};
 		std::unordered_map<uint8_t/*pointIndex*/, std::unordered_set<glm::vec3>> cornerVertices {};
 		std::unordered_map<uint8_t/*pointIndex*/, std::vector<std::tuple<uint8_t/*faceIndex*/, glm::vec3/*vertexPosition*/>>> extraCornerVertices {};
@@ -879,20 +923,30 @@ public:
 			assert(face.triangles.size() >= 3 && (face.triangles.size() % 3) == 0);
 			// Normal
 			glm::vec3 faceNormal = glm::normalize(glm::cross(points[face.triangles[1]] - points[face.triangles[0]], points[face.triangles[1]] - points[face.triangles[2]]));
+			const bool hidden = hiddenFaces & (1 << faceIndex);
 			// Vertices
 			for (const auto& pointIndex : face.triangles) {
 				assert(pointIndex < MAX_POINTS);
 				uint8_t faceVerticesIndex = (faceIndex << 4) | pointIndex; // each face should have their own vertices, but vertices within a face can be reused
 				FaceVertex* faceVertex;
-				try {
-					faceVertex = &faceVertices.at(faceVerticesIndex);
-				} catch (...) {
+				if (auto existing = faceVertices.find(faceVerticesIndex); existing != faceVertices.end()) {
+					faceVertex = &existing->second;
+				} else {
 					faceVertex = &faceVertices[faceVerticesIndex];
-					faceVertex->vertexIndex = vertexCount++;
-					faceVertex->vertexPosition = &outputVerticesPosition[faceVertex->vertexIndex];
-					faceVertex->vertexNormal = &outputVerticesNormal[faceVertex->vertexIndex];
-					faceVertex->vertexColor = &outputVerticesColor[faceVertex->vertexIndex];
-					faceVertex->customData = &outputCustomData[faceVertex->vertexIndex];
+					if (hidden) {
+						faceVertex->vertexIndex = hiddenVertexCount++;
+						faceVertex->vertexPosition = &hiddenVerticesPosition[faceVertex->vertexIndex];
+						faceVertex->vertexNormal = &hiddenVerticesNormal[faceVertex->vertexIndex];
+						faceVertex->vertexColor = &hiddenVerticesColor[faceVertex->vertexIndex];
+						faceVertex->customData = &hiddenCustomData[faceVertex->vertexIndex];
+					} else {
+						faceVertex->vertexIndex = vertexCount++;
+						faceVertex->vertexPosition = &outputVerticesPosition[faceVertex->vertexIndex];
+						faceVertex->vertexNormal = &outputVerticesNormal[faceVertex->vertexIndex];
+						faceVertex->vertexColor = &outputVerticesColor[faceVertex->vertexIndex];
+						faceVertex->customData = &outputCustomData[faceVertex->vertexIndex];
+						visibleCorners |= 1 << pointIndex;
+					}
 					PackedBlockCustomData customData;{
 						customData.blockIndex = data.index;
 						customData.faceIndex = faceIndex;
@@ -930,7 +984,7 @@ public:
 						extraCornerVertices[pointIndex].emplace_back(faceIndex, *faceVertex->vertexPosition);
 					}
 				}
-				outputIndices[indexCount++] = vertexIndexOffset + faceVertex->vertexIndex;
+				if (!hidden) outputIndices[indexCount++] = vertexIndexOffset + faceVertex->vertexIndex;
 			}
 			++faceIndex;
 		}
@@ -963,7 +1017,7 @@ public:
 			};
 			// Corners
 			for (auto&[corner, vertices] : cornerVertices) {
-				if (vertices.size() == 3) {
+				if (vertices.size() == 3 && (visibleCorners & (1 << corner))) {
 					addStructureTriangle(vertices);
 					if (extraCornerVertices.count(corner)) {
 						for (auto&[faceIndex, vert0] : extraCornerVertices[corner]) {
@@ -977,6 +1031,7 @@ public:
 			}
 			// Edges
 			for (auto& line : GetLines()) {
+				if ((hiddenFaces & (1 << line.face1)) && (hiddenFaces & (1 << line.face2))) continue;
 				auto vert0 = *faceVertices[(line.face1 << 4) | line.point1].vertexPosition;
 				auto vert1 = *faceVertices[(line.face1 << 4) | line.point2].vertexPosition;
 				auto vert2 = *faceVertices[(line.face2 << 4) | line.point1].vertexPosition;
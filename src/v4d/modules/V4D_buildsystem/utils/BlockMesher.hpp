@@ -0,0 +1,265 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+#define BLOCK_MESHER_EPSILON 0.001f // in meters, tolerance for faces to be coplanar or within another face, well below the grid size of 10 cm
+
+// Generates the geometry of a group of blocks, knowing the blocks around them.
+// Faces that are entirely covered by a face of an adjacent block, facing it on the same plane, are culled along with the bevels between them.
+// Optionally, coplanar axis-aligned rectangular faces of the same color and material are merged into larger rectangles, then without bevels.
+class BlockMesher {
+public:
+	// Generated geometry, sized to what was actually generated
+	struct Geometry {
+		std::vector<Mesh::Index32> indices {};
+		std::vector<Mesh::VertexPosition> vertexPositions {};
+		std::vector<Mesh::VertexNormal> vertexNormals {};
+		std::vector<Mesh::VertexColor<uint8_t>> vertexColors {};
+		std::vector<uint32_t> customData {};
+	};
+
+	struct Options {
+		bool cullHiddenFaces = true;
+		bool mergeFaces = false; // a merged face only has the custom data of one of its blocks, which is the one that gets picked when aiming at it
+	};
+
+	struct Stats {
+		size_t faces = 0;
+		size_t hiddenFaces = 0;
+		size_t mergedFaces = 0; // visible faces that were merged, into mergedRectangles
+		size_t mergedRectangles = 0;
+	};
+
+	// Face of a block in build space, without bevels
+	struct Face {
+		std::vector<glm::vec3> triangles {};
+		glm::vec3 normal {0};
+		float distance = 0; // of its plane from the origin of the build, along the normal
+		glm::vec3 min {0};
+		glm::vec3 max {0};
+	};
+
+	static std::vector<Face> GetFaces(const Block& block) {
+		std::vector<Face> faces {};
+		const auto points = block.GetFinalPointsPositions();
+		for (const auto& blockFace : block.GetFaces()) {
+			auto& face = faces.emplace_back();
+			const auto& t = blockFace.triangles;
+			face.normal = glm::normalize(glm::cross(points[t[1]] - points[t[0]], points[t[1]] - points[t[2]]));
+			face.distance = glm::dot(face.normal, points[t[0]]);
+			face.min = face.max = points[t[0]];
+			for (auto pointIndex : t) {
+				face.triangles.push_back(points[pointIndex]);
+				face.min = glm::min(face.min, points[pointIndex]);
+				face.max = glm::max(face.max, points[pointIndex]);
+			}
+		}
+		return faces;
+	}
+
+	// Whether all points of the face are within the other face, the other face facing it on the same plane
+	static bool IsFaceCoveredBy(const Face& face, const Face& other) {
+		if (glm::abs(face.distance + other.distance) > BLOCK_MESHER_EPSILON) return false;
+		if (glm::dot(face.normal, other.normal) > -1.0f + BLOCK_MESHER_EPSILON) return false;
+		if (!glm::all(glm::greaterThanEqual(face.min, other.min - BLOCK_MESHER_EPSILON)) || !glm::all(glm::lessThanEqual(face.max, other.max + BLOCK_MESHER_EPSILON))) return false;
+		for (const auto& p : face.triangles) {
+			bool inside = false;
+			for (size_t i = 0; i+2 < other.triangles.size() && !inside; i += 3) {
+				const glm::vec3 v[3] {other.triangles[i], other.triangles[i+1], other.triangles[i+2]};
+				const glm::vec3 n = glm::normalize(glm::cross(v[1] - v[0], v[2] - v[0]));
+				inside = true;
+				for (int e = 0; e < 3 && inside; ++e) {
+					const glm::vec3 edge = v[(e+1)%3] - v[e];
+					// distance from the edge within the plane, positive towards the inside of the triangle
+					if (glm::dot(glm::cross(edge, p - v[e]), n) / glm::length(edge) < -BLOCK_MESHER_EPSILON) inside = false;
+				}
+			}
+			if (!inside) return false;
+		}
+		return true;
+	}
+
+	// Generates the given blocks and appends them to the geometry.
+	// forEachNeighbour(const Block& block, func) must call func(const Block&) for the other blocks of the build that may touch the block, or at least those that do.
+	template<typename N>
+	static void Generate(std::vector<Block>& blocks, N&& forEachNeighbour, Geometry& geometry, const Options& options = {}, Stats* stats = nullptr) {
+		Stats localStats {};
+		if (!stats) stats = &localStats;
+
+		// Each block is generated in these first, then only what it actually generated is appended
+		std::array<Mesh::Index32, Block::MAX_INDICES> indices;
+		std::array<Mesh::VertexPosition, Block::MAX_VERTICES> vertexPositions;
+		std::array<Mesh::VertexNormal, Block::MAX_VERTICES> vertexNormals;
+		std::array<Mesh::VertexColor<uint8_t>, Block::MAX_VERTICES> vertexColors;
+		std::array<uint32_t, Block::MAX_VERTICES> customData;
+
+		// Rectangles to be merged, per plane/color/material
+		struct Rectangle {
+			int64_t u0, u1, v0, v1; // in units of 5 cm
+			uint32_t customData;
+		};
+		std::map<std::tuple<int/*axis*/, int/*sign*/, int64_t/*w*/, uint8_t/*color*/, uint8_t/*material*/>, std::vector<Rectangle>> rectangles {};
+
+		// Faces of neighbours are needed by several blocks
+		std::unordered_map<uint32_t/*blockIndex*/, std::vector<Face>> neighbourFaces {};
+		auto getNeighbourFaces = [&neighbourFaces](const Block& neighbour) -> const std::vector<Face>& {
+			auto it = neighbourFaces.find(neighbour.GetIndex());
+			if (it == neighbourFaces.end()) it = neighbourFaces.emplace(neighbour.GetIndex(), GetFaces(neighbour)).first;
+			return it->second;
+		};
+
+		for (auto& block : blocks) {
+			uint8_t hiddenFaces = 0;
+			uint8_t mergedFaces = 0;
+			const auto faces = GetFaces(block);
+			stats->faces += faces.size();
+
+			if (options.cullHiddenFaces) {
+				forEachNeighbour(block, [&](const Block& neighbour){
+					if (neighbour.GetIndex() == block.GetIndex()) return;
+					const auto& otherFaces = getNeighbourFaces(neighbour);
+					for (size_t f = 0; f < faces.size(); ++f) {
+						if (hiddenFaces & (1 << f)) continue;
+						for (const auto& other : otherFaces) {
+							if (IsFaceCoveredBy(faces[f], other)) {
+								hiddenFaces |= 1 << f;
+								break;
+							}
+						}
+					}
+				});
+				for (size_t f = 0; f < faces.size(); ++f) {
+					if (hiddenFaces & (1 << f)) ++stats->hiddenFaces;
+				}
+			}
+
+			if (options.mergeFaces && !block.data.useVertexColorGradients) {
+				for (size_t f = 0; f < faces.size(); ++f) {
+					if (hiddenFaces & (1 << f)) continue;
+					const auto& face = faces[f];
+					if (face.triangles.size() != 6) continue;
+					int axis = -1;
+					for (int a = 0; a < 3; ++a) {
+						if (glm::abs(face.normal[a]) > 1.0f - BLOCK_MESHER_EPSILON) axis = a;
+					}
+					if (axis == -1) continue;
+					const int uAxis = (axis + 1) % 3;
+					const int vAxis = (axis + 2) % 3;
+					Rectangle rect {INT64_MAX, INT64_MIN, INT64_MAX, INT64_MIN, 0};
+					for (const auto& p : face.triangles) {
+						rect.u0 = std::min(rect.u0, (int64_t)glm::round(p[uAxis] * 20.0f));
+						rect.u1 = std::max(rect.u1, (int64_t)glm::round(p[uAxis] * 20.0f));
+						rect.v0 = std::min(rect.v0, (int64_t)glm::round(p[vAxis] * 20.0f));
+						rect.v1 = std::max(rect.v1, (int64_t)glm::round(p[vAxis] * 20.0f));
+					}
+					// Two triangles with all their points on the corners of their bounds are the rectangle
+					bool isRectangle = true;
+					for (const auto& p : face.triangles) {
+						const auto u = (int64_t)glm::round(p[uAxis] * 20.0f);
+						const auto v = (int64_t)glm::round(p[vAxis] * 20.0f);
+						if ((u != rect.u0 && u != rect.u1) || (v != rect.v0 && v != rect.v1)) isRectangle = false;
+					}
+					const glm::vec3 e1 = face.triangles[1] - face.triangles[0], e2 = face.triangles[2] - face.triangles[0];
+					const glm::vec3 e3 = face.triangles[4] - face.triangles[3], e4 = face.triangles[5] - face.triangles[3];
+					const float area = (glm::length(glm::cross(e1, e2)) + glm::length(glm::cross(e3, e4))) / 2.0f;
+					if (!isRectangle || glm::abs(area * 400.0f - float((rect.u1 - rect.u0) * (rect.v1 - rect.v0))) > 0.5f) continue;
+
+					PackedBlockCustomData packed;{
+						packed.blockIndex = block.data.index;
+						packed.faceIndex = f;
+						packed.materialId = block.GetFaceMaterial(f);
+					}
+					rect.customData = packed.packed;
+					const int sign = face.normal[axis] > 0? 1 : -1;
+					const int64_t w = (int64_t)glm::round(face.triangles[0][axis] * 20.0f);
+					rectangles[{axis, sign, w, block.GetColorIndex(f), (uint8_t)packed.materialId}].push_back(rect);
+					mergedFaces |= 1 << f;
+					++stats->mergedFaces;
+				}
+			}
+
+			const uint vertexOffset = geometry.vertexPositions.size();
+			auto[vertexCount, indexCount] = options.mergeFaces?
+				block.GenerateSimpleGeometry(indices.data(), vertexPositions.data(), vertexNormals.data(), vertexColors.data(), customData.data(), vertexOffset, 1.0f, hiddenFaces | mergedFaces)
+				: block.GenerateGeometry(indices.data(), vertexPositions.data(), vertexNormals.data(), vertexColors.data(), customData.data(), vertexOffset, hiddenFaces);
+			geometry.indices.insert(geometry.indices.end(), indices.begin(), indices.begin() + indexCount);
+			geometry.vertexPositions.insert(geometry.vertexPositions.end(), vertexPositions.begin(), vertexPositions.begin() + vertexCount);
+			geometry.vertexNormals.insert(geometry.vertexNormals.end(), vertexNormals.begin(), vertexNormals.begin() + vertexCount);
+			geometry.vertexColors.insert(geometry.vertexColors.end(), vertexColors.begin(), vertexColors.begin() + vertexCount);
+			geometry.customData.insert(geometry.customData.end(), customData.begin(), customData.begin() + vertexCount);
+		}
+
+		// Merged rectangles
+		for (auto&[key, rects] : rectangles) {
+			const auto&[axis, sign, w, colorIndex, materialId] = key;
+			MergeRectangles(rects);
+			stats->mergedRectangles += rects.size();
+			const int uAxis = (axis + 1) % 3;
+			const int vAxis = (axis + 2) % 3;
+			glm::vec3 normal {0};
+			normal[axis] = sign;
+			const auto color = COLORS[colorIndex];
+			for (const auto& rect : rects) {
+				const uint vertexOffset = geometry.vertexPositions.size();
+				geometry.vertexPositions.resize(vertexOffset + 4);
+				geometry.vertexNormals.resize(vertexOffset + 4);
+				geometry.vertexColors.resize(vertexOffset + 4);
+				geometry.customData.resize(vertexOffset + 4);
+				const int64_t corners[4][2] {{rect.u0, rect.v0}, {rect.u1, rect.v0}, {rect.u1, rect.v1}, {rect.u0, rect.v1}};
+				for (int i = 0; i < 4; ++i) {
+					glm::vec3 position;
+					position[axis] = w / 20.0f;
+					position[uAxis] = corners[i][0] / 20.0f;
+					position[vAxis] = corners[i][1] / 20.0f;
+					geometry.vertexPositions[vertexOffset + i] = position;
+					geometry.vertexNormals[vertexOffset + i] = normal;
+					geometry.vertexColors[vertexOffset + i] = glm::u8vec4(glm::vec4{color.r, color.g, color.b, 1.0f} * 255.0f);
+					geometry.customData[vertexOffset + i] = rect.customData;
+				}
+				// Same winding as the faces of blocks
+				const std::array<uint, 6> quad = (sign > 0)? std::array<uint, 6>{0,2,1, 0,3,2} : std::array<uint, 6>{0,1,2, 0,2,3};
+				for (auto i : quad) geometry.indices.push_back(vertexOffset + i);
+			}
+		}
+	}
+
+	// Greedy merge of rectangles that share a whole side, first along u then along v, until none can be merged
+	template<typename R>
+	static void MergeRectangles(std::vector<R>& rects) {
+		bool merged = true;
+		while (merged && rects.size() > 1) {
+			merged = false;
+			std::sort(rects.begin(), rects.end(), [](const R& a, const R& b){
+				return std::tie(a.v0, a.v1, a.u0) < std::tie(b.v0, b.v1, b.u0);
+			});
+			size_t n = 0;
+			for (size_t i = 1; i < rects.size(); ++i) {
+				if (rects[n].v0 == rects[i].v0 && rects[n].v1 == rects[i].v1 && rects[n].u1 == rects[i].u0) {
+					rects[n].u1 = rects[i].u1;
+					merged = true;
+				} else {
+					rects[++n] = rects[i];
+				}
+			}
+			rects.resize(n+1);
+			std::sort(rects.begin(), rects.end(), [](const R& a, const R& b){
+				return std::tie(a.u0, a.u1, a.v0) < std::tie(b.u0, b.u1, b.v0);
+			});
+			n = 0;
+			for (size_t i = 1; i < rects.size(); ++i) {
+				if (rects[n].u0 == rects[i].u0 && rects[n].u1 == rects[i].u1 && rects[n].v1 == rects[i].v0) {
+					rects[n].v1 = rects[i].v1;
+					merged = true;
+				} else {
+					rects[++n] = rects[i];
+				}
+			}
+			rects.resize(n+1);
+		}
+	}
+
+};
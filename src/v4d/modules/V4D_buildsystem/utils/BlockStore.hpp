@@ -0,0 +1,220 @@
+#pragma once
+
+#include <unordered_map>
+
+#define BLOCK_STORE_GRID_CELL_SIZE 20 // in grid units of 10 cm, blocks are indexed in every cell that their bounds overlap
+#define BLOCK_STORE_GRID_MAX_CELLS 64 // blocks that overlap more cells than this are kept in a list that every query goes through instead
+
+// Blocks of a build, contiguous in memory, with their index mapped to their slot for constant-time lookups and edits,
+// indices of removed blocks recycled for the next added ones (they only have 24 bits),
+// and a grid of their bounds to find the blocks touching a given one without going through all of them.
+// It must be locked by the caller, the same way as the Build it belongs to.
+class BlockStore {
+public:
+	struct Bounds {
+		glm::vec3 min;
+		glm::vec3 max;
+		bool Touches(const Bounds& other) const {
+			return glm::all(glm::lessThanEqual(min, other.max + BLOCK_MESHER_EPSILON))
+				&& glm::all(glm::greaterThanEqual(max, other.min - BLOCK_MESHER_EPSILON));
+		}
+		void Grow(const Bounds& other) {
+			min = glm::min(min, other.min);
+			max = glm::max(max, other.max);
+		}
+	};
+
+	static Bounds GetBounds(const Block& block) {
+		const auto points = block.GetFinalPointsPositions();
+		Bounds bounds {points[0], points[0]};
+		for (const auto& p : points) {
+			bounds.min = glm::min(bounds.min, p);
+			bounds.max = glm::max(bounds.max, p);
+		}
+		return bounds;
+	}
+
+private:
+	using CellKey = uint64_t;
+
+	std::vector<Block> blocks {};
+	std::vector<Bounds> blockBounds {}; // same order as blocks
+	std::unordered_map<uint32_t/*blockIndex*/, uint32_t/*slot*/> slots {};
+	std::vector<uint32_t> freeIndices {}; // removed indices, some may have been taken again since, they are skipped when reached
+	uint32_t nextIndex = 1; // greater than all indices ever used
+	std::unordered_map<CellKey, std::vector<uint32_t/*blockIndex*/>> grid {};
+	std::vector<uint32_t/*blockIndex*/> largeBlocks {};
+
+	static glm::ivec3 GetCell(const glm::vec3& position) {
+		return glm::ivec3(glm::floor(position * 10.0f / float(BLOCK_STORE_GRID_CELL_SIZE)));
+	}
+
+	static CellKey GetCellKey(const glm::ivec3& cell) {
+		return (uint64_t(cell.x) & 0x1fffff) | ((uint64_t(cell.y) & 0x1fffff) << 21) | ((uint64_t(cell.z) & 0x1fffff) << 42);
+	}
+
+	// Cells overlapped by the bounds, slightly grown so that blocks that only touch share a cell
+	static void GetCells(const Bounds& bounds, glm::ivec3& minCell, glm::ivec3& maxCell) {
+		minCell = GetCell(bounds.min - BLOCK_MESHER_EPSILON);
+		maxCell = GetCell(bounds.max + BLOCK_MESHER_EPSILON);
+	}
+
+	static size_t CountCells(const glm::ivec3& minCell, const glm::ivec3& maxCell) {
+		const glm::ivec3 count = maxCell - minCell + 1;
+		return size_t(count.x) * size_t(count.y) * size_t(count.z);
+	}
+
+	static void EraseIndex(std::vector<uint32_t>& indices, uint32_t blockIndex) {
+		for (auto& i : indices) {
+			if (i == blockIndex) {
+				i = indices.back();
+				indices.pop_back();
+				return;
+			}
+		}
+	}
+
+	void AddToGrid(uint32_t blockIndex, const Bounds& bounds) {
+		glm::ivec3 minCell, maxCell;
+		GetCells(bounds, minCell, maxCell);
+		if (CountCells(minCell, maxCell) > BLOCK_STORE_GRID_MAX_CELLS) {
+			largeBlocks.push_back(blockIndex);
+			return;
+		}
+		for (int x = minCell.x; x <= maxCell.x; ++x)
+		for (int y = minCell.y; y <= maxCell.y; ++y)
+		for (int z = minCell.z; z <= maxCell.z; ++z) {
+			grid[GetCellKey({x,y,z})].push_back(blockIndex);
+		}
+	}
+
+	void RemoveFromGrid(uint32_t blockIndex, const Bounds& bounds) {
+		glm::ivec3 minCell, maxCell;
+		GetCells(bounds, minCell, maxCell);
+		if (CountCells(minCell, maxCell) > BLOCK_STORE_GRID_MAX_CELLS) {
+			EraseIndex(largeBlocks, blockIndex);
+			return;
+		}
+		for (int x = minCell.x; x <= maxCell.x; ++x)
+		for (int y = minCell.y; y <= maxCell.y; ++y)
+		for (int z = minCell.z; z <= maxCell.z; ++z) {
+			if (auto cell = grid.find(GetCellKey({x,y,z})); cell != grid.end()) {
+				EraseIndex(cell->second, blockIndex);
+				if (cell->second.empty()) grid.erase(cell);
+			}
+		}
+	}
+
+public:
+
+	const Block* GetBlock(uint32_t blockIndex) const {
+		if (auto it = slots.find(blockIndex); it != slots.end()) return &blocks[it->second];
+		return nullptr;
+	}
+
+	// Adds the block, or replaces the one with the same index
+	void SetBlock(const Block& block) {
+		const uint32_t blockIndex = block.GetIndex();
+		if (auto it = slots.find(blockIndex); it != slots.end()) {
+			auto& existing = blocks[it->second];
+			if (!existing.HasSameGeometryAs(block)) {
+				RemoveFromGrid(blockIndex, blockBounds[it->second]);
+				blockBounds[it->second] = GetBounds(block);
+				AddToGrid(blockIndex, blockBounds[it->second]);
+			}
+			existing = block;
+			return;
+		}
+		if (!freeIndices.empty() && freeIndices.back() == blockIndex) freeIndices.pop_back();
+		nextIndex = std::max(nextIndex, blockIndex + 1);
+		slots.emplace(blockIndex, uint32_t(blocks.size()));
+		blocks.push_back(block);
+		blockBounds.push_back(GetBounds(block));
+		AddToGrid(blockIndex, blockBounds.back());
+	}
+
+	// Returns false if there was no block with this index
+	bool RemoveBlock(uint32_t blockIndex) {
+		auto it = slots.find(blockIndex);
+		if (it == slots.end()) return false;
+		const uint32_t slot = it->second;
+		RemoveFromGrid(blockIndex, blockBounds[slot]);
+		slots.erase(it);
+		if (slot != blocks.size() - 1) {
+			blocks[slot] = blocks.back();
+			blockBounds[slot] = blockBounds.back();
+			slots[blocks[slot].GetIndex()] = slot;
+		}
+		blocks.pop_back();
+		blockBounds.pop_back();
+		freeIndices.push_back(blockIndex);
+		return true;
+	}
+
+	// Index for the next block to add, the most recently removed one that was not taken again, or a new one
+	uint32_t GetFreeIndex() {
+		while (!freeIndices.empty() && slots.count(freeIndices.back())) freeIndices.pop_back();
+		return freeIndices.empty()? nextIndex : freeIndices.back();
+	}
+
+	// Replaces all blocks, they may be anywhere in memory (like a mapped file) as they are copied into the store
+	void Assign(const Block* otherBlocks, size_t count) {
+		Clear();
+		blocks.reserve(count);
+		blockBounds.reserve(count);
+		slots.reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			SetBlock(otherBlocks[i]);
+		}
+	}
+	void Assign(const std::vector<Block>& otherBlocks) {
+		Assign(otherBlocks.data(), otherBlocks.size());
+	}
+
+	void Clear() {
+		blocks.clear();
+		blockBounds.clear();
+		slots.clear();
+		freeIndices.clear();
+		nextIndex = 1;
+		grid.clear();
+		largeBlocks.clear();
+	}
+
+	// Calls func(const Block&, const Bounds&) once for each block that touches the given bounds
+	template<typename F>
+	void ForEachTouching(const Bounds& bounds, F&& func) const {
+		auto call = [&](uint32_t slot){
+			if (blockBounds[slot].Touches(bounds)) func(blocks[slot], blockBounds[slot]);
+		};
+		glm::ivec3 minCell, maxCell;
+		GetCells(bounds, minCell, maxCell);
+		if (CountCells(minCell, maxCell) > BLOCK_STORE_GRID_MAX_CELLS) {
+			for (uint32_t slot = 0; slot < blocks.size(); ++slot) call(slot);
+			return;
+		}
+		for (int x = minCell.x; x <= maxCell.x; ++x)
+		for (int y = minCell.y; y <= maxCell.y; ++y)
+		for (int z = minCell.z; z <= maxCell.z; ++z) {
+			if (auto cell = grid.find(GetCellKey({x,y,z})); cell != grid.end()) {
+				for (auto blockIndex : cell->second) {
+					const uint32_t slot = slots.at(blockIndex);
+					// A block in several of these cells is only given for the first one of them, the one with its smallest coordinates within the bounds
+					glm::ivec3 blockMinCell, blockMaxCell;
+					GetCells(blockBounds[slot], blockMinCell, blockMaxCell);
+					if (glm::ivec3(x,y,z) == glm::max(minCell, blockMinCell)) call(slot);
+				}
+			}
+		}
+		for (auto blockIndex : largeBlocks) call(slots.at(blockIndex));
+	}
+
+	const std::vector<Block>& GetBlocks() const {
+		return blocks;
+	}
+
+	size_t Size() const {
+		return blocks.size();
+	}
+
+};
@@ -1,97 +1,122 @@
 #pragma once
 
+// Blocks of a build, rendered with one entity per chunk of its BuildMesh so that editing a block only regenerates and reuploads its own chunk
 class Build {
-	std::shared_ptr<v4d::graphics::RenderableGeometryEntity> entity = nullptr;
-	std::vector<Block> blocks {};
+	std::unordered_map<BuildMesh::ChunkKey, std::shared_ptr<v4d::graphics::RenderableGeometryEntity>> entities {};
+	BuildMesh mesh {}; // also holds the blocks
+	uint32_t version = 0; // of the latest BlockEdit applied
 	mutable std::recursive_mutex blocksMutex;
 	
+	std::shared_ptr<v4d::graphics::RenderableGeometryEntity> CreateChunkEntity(std::shared_ptr<BuildMesh::Geometry> geometry) {
+		auto entity = RenderableGeometryEntity::Create(THIS_MODULE, networkId);
+		entity->Add_physics(v4d::scene::PhysicsInfo::RigidBodyType::STATIC, 1.0f);
+		entity->generator = [geometry](RenderableGeometryEntity* entity, Device* device){
+			RenderableGeometryEntity::Material material {};
+			material.visibility.roughness = 0;
+			material.visibility.metallic = 255;
+			entity->Allocate(device, "V4D_buildsystem:block")->material = material;
+			
+			entity->Add_meshIndices32()->AllocateBuffersFromArray(device, geometry->indices.data(), geometry->indices.size());
+			entity->Add_meshVertexPosition()->AllocateBuffersFromArray(device, geometry->vertexPositions.data(), geometry->vertexPositions.size());
+			entity->Add_meshVertexNormal()->AllocateBuffersFromArray(device, geometry->vertexNormals.data(), geometry->vertexNormals.size());
+			entity->Add_meshVertexColorU8()->AllocateBuffersFromArray(device, geometry->vertexColors.data(), geometry->vertexColors.size());
+			entity->Add_meshCustomData()->AllocateBuffersFromArray(device, (float*)geometry->customData.data(), geometry->customData.size());
+			
+			entity->Add_physics()->SetMeshCollider();
+		};
+		return entity;
+	}
+	
 public:
 	uint64_t networkId;
 
 	Build(uint64_t networkId) : networkId(networkId) {}
 	
 	~Build() {
-		if (entity) entity->Destroy();
 		std::lock_guard lock(blocksMutex);
-		blocks.clear();
+		for (auto&[key, entity] : entities) {
+			entity->Destroy();
+		}
+		entities.clear();
+	}
+	
+	// Recreates the entities of the chunks in which blocks changed since the last call, the others are kept as they are
+	void UpdateEntities() {
+		std::lock_guard lock(blocksMutex);
+		mesh.RegenerateDirtyChunks([this](BuildMesh::ChunkKey key, std::shared_ptr<BuildMesh::Geometry> geometry){
+			if (auto it = entities.find(key); it != entities.end()) {
+				it->second->Destroy();
+				entities.erase(it);
+			}
+			if (geometry) {
+				entities[key] = CreateChunkEntity(geometry);
+			}
+		});
 	}
 	
-	std::shared_ptr<v4d::graphics::RenderableGeometryEntity> CreateEntity() {
+	// Calls func(BuildMesh::ChunkKey, std::shared_ptr<RenderableGeometryEntity>) for the entity of each chunk
+	template<typename F>
+	void ForEachEntity(F&& func) const {
 		std::lock_guard lock(blocksMutex);
-		if (entity) {
-			entity->Destroy();
-			entity = nullptr;
-		}
-		if (blocks.size() > 0) {
-			entity = RenderableGeometryEntity::Create(THIS_MODULE, networkId);
-			entity->Add_physics(v4d::scene::PhysicsInfo::RigidBodyType::STATIC, 1.0f);
-			entity->generator = [this](RenderableGeometryEntity* entity, Device* device){
-				std::lock_guard lock(blocksMutex);
-				RenderableGeometryEntity::Material material {};
-				material.visibility.roughness = 0;
-				material.visibility.metallic = 255;
-				entity->Allocate(device, "V4D_buildsystem:block")->material = material;
-				
-				std::vector<Mesh::Index32> meshIndices (Block::MAX_INDICES * blocks.size());
-				std::vector<Mesh::VertexPosition> vertexPositions (Block::MAX_VERTICES * blocks.size());
-				std::vector<Mesh::VertexNormal> vertexNormals (Block::MAX_VERTICES * blocks.size());
-				std::vector<Mesh::VertexColor<uint8_t>> vertexColors (Block::MAX_VERTICES * blocks.size());
-				std::vector<uint32_t> customData (Block::MAX_VERTICES * blocks.size());
-				
-				uint nextVertex = 0;
-				uint nextIndex = 0;
-				for (int i = 0; i < blocks.size(); ++i) {
-					auto[vertexCount, indexCount] = blocks[i].GenerateGeometry(&meshIndices.data()[nextIndex], &vertexPositions.data()[nextVertex], &vertexNormals.data()[nextVertex], &vertexColors.data()[nextVertex], &customData.data()[nextVertex], nextVertex);
-					nextVertex += vertexCount;
-					nextIndex += indexCount;
-				}
-				
-				entity->Add_meshIndices32()->AllocateBuffersFromArray(device, meshIndices.data(), nextIndex);
-				entity->Add_meshVertexPosition()->AllocateBuffersFromArray(device, vertexPositions.data(), nextVertex);
-				entity->Add_meshVertexNormal()->AllocateBuffersFromArray(device, vertexNormals.data(), nextVertex);
-				entity->Add_meshVertexColorU8()->AllocateBuffersFromArray(device, vertexColors.data(), nextVertex);
-				entity->Add_meshCustomData()->AllocateBuffersFromArray(device, (float*)customData.data(), nextVertex);
-				
-				entity->Add_physics()->SetMeshCollider();
-			};
+		for (const auto&[key, entity] : entities) {
+			func(key, entity);
 		}
-		return entity;
 	}
 	
-	static bool IsBlockAdditionValid(const std::vector<Block>& existingBlocks, const Block& newBlock) {
+	static bool IsBlockAdditionValid(const BlockStore& existingBlocks, const Block& newBlock) {
 		return true; //TODO
 	}
 	
 	std::optional<Block> GetBlock(uint32_t index) const {
 		std::lock_guard lock(blocksMutex);
-		for (auto& b : blocks) {
-			if (b.GetIndex() == index) return b;
-		}
+		if (const Block* block = mesh.GetBlock(index); block) return *block;
 		return std::nullopt;
 	}
 	
-	const std::vector<Block>& GetBlocks() const {
-		return blocks;
+	const BlockStore& GetBlocks() const {
+		return mesh.GetBlocks();
+	}
+	
+	uint32_t GetVersion() const {
+		std::lock_guard lock(blocksMutex);
+		return version;
+	}
+	
+	// Replaces all blocks with the full state of the build at the given version, received when edits were missing.
+	// Only the chunks in which blocks differ from the current ones are regenerated.
+	void SetState(uint32_t stateVersion, const std::vector<Block>& otherBlocks) {
+		std::lock_guard lock(blocksMutex);
+		mesh.SetBlocks(otherBlocks);
+		UpdateEntities();
+		version = stateVersion;
 	}
 	
-	std::shared_ptr<v4d::graphics::RenderableGeometryEntity> SwapBlocksAndRebuild(std::vector<Block>& otherBlocks) {
+	// Applies the edits that came after the current version, in order, then regenerates the chunks they touched.
+	// Returns false if edits are missing between the current version and the given ones, nothing is applied then and the full state is needed.
+	bool ApplyEdits(const std::vector<BlockEdit>& edits) {
 		std::lock_guard lock(blocksMutex);
-		blocks.swap(otherBlocks);
-		if (entity) {
-			CreateEntity();
-			return entity;
+		if (edits.size() == 0 || edits.back().version <= version) return true;
+		if (edits.front().version > version + 1) return false;
+		for (const auto& edit : edits) {
+			if (edit.version <= version) continue;
+			edit.ApplyTo(mesh);
+			version = edit.version;
 		}
-		return nullptr;
+		UpdateEntities();
+		return true;
 	}
 	
 	void SetWorldTransform(glm::dmat4 t) {
-		if (entity) {
+		std::lock_guard lock(blocksMutex);
+		for (auto&[key, entity] : entities) {
 			entity->SetWorldTransform(t);
 		}
 	}
 	
 	glm::dmat4 GetWorldTransform() const {
-		return entity->GetWorldTransform();
+		std::lock_guard lock(blocksMutex);
+		if (entities.empty()) return glm::dmat4(1);
+		return entities.begin()->second->GetWorldTransform();
 	}
 	
 };
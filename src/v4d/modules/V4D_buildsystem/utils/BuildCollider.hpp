@@ -0,0 +1,240 @@
+#pragma once
+
+#include <unordered_map>
+#include "v4d/game/Collider.hpp"
+
+// Collision shape of a build, as primitives in the tree of a CompoundCollider instead of a triangle mesh.
+// All block shapes are the convex hull of some corners of their box, so each block is one box or wedge,
+// and adjacent blocks of the same shape and orientation that line up are merged into a single longer one.
+// Blocks are merged within the same chunks as the BuildMesh, so that editing a block only merges the blocks of its own chunk again and replaces their primitives.
+// It must be locked by the caller, the same way as the Build it belongs to.
+class BuildCollider {
+public:
+	using ChunkKey = BuildMesh::ChunkKey;
+
+	// Box in grid units of 5 cm (half the grid of block positions, so that blocks of any size have integer bounds), relative to the build,
+	// and the corners of that box that make the hull, numbered as in WedgeCollider (0xff for a box)
+	struct Primitive {
+		glm::ivec3 min;
+		glm::ivec3 max;
+		uint8_t corners;
+		bool operator==(const Primitive& other) const {
+			return min == other.min && max == other.max && corners == other.corners;
+		}
+		bool operator<(const Primitive& other) const {
+			return std::make_tuple(min.x, min.y, min.z, max.x, max.y, max.z, corners) < std::make_tuple(other.min.x, other.min.y, other.min.z, other.max.x, other.max.y, other.max.z, other.corners);
+		}
+	};
+
+	struct Chunk {
+		std::vector<std::pair<uint32_t, Primitive>> blocks {}; // index and primitive of each block, before merging
+		std::vector<std::pair<Primitive, CompoundCollider::Handle>> primitives {}; // merged, sorted, with their handle in the compound collider
+		bool dirty = false;
+	};
+
+private:
+	std::unordered_map<ChunkKey, Chunk> chunks {};
+	BlockStore store {};
+	std::vector<ChunkKey> dirtyChunks {};
+	size_t nbPrimitives = 0;
+
+	void MarkDirty(ChunkKey key, Chunk& chunk) {
+		if (!chunk.dirty) {
+			chunk.dirty = true;
+			dirtyChunks.push_back(key);
+		}
+	}
+
+	void RemoveFromChunk(ChunkKey key, uint32_t blockIndex) {
+		auto& chunk = chunks.at(key);
+		for (auto& b : chunk.blocks) {
+			if (b.first == blockIndex) {
+				b = chunk.blocks.back();
+				chunk.blocks.pop_back();
+				break;
+			}
+		}
+		MarkDirty(key, chunk);
+	}
+
+	void AddToChunk(ChunkKey key, const Block& block) {
+		auto& chunk = chunks[key];
+		chunk.blocks.emplace_back(block.GetIndex(), GetPrimitive(block));
+		MarkDirty(key, chunk);
+	}
+
+	// Whether the hull is the same when mirrored along this axis, so that two of them side by side along it make one longer hull
+	static bool IsSymmetric(uint8_t corners, int axis) {
+		for (int i = 0; i < 8; ++i) {
+			if (bool(corners & (1 << i)) != bool(corners & (1 << (i ^ (1 << axis))))) return false;
+		}
+		return true;
+	}
+
+public:
+
+	static Primitive GetPrimitive(const Block& block) {
+		Primitive primitive {glm::ivec3{0}, glm::ivec3{0}, 0};
+		glm::ivec3 halfSize {0};
+		// Unscaled points are the rotated corners of the box in grid units of 5 cm, relative to the position of the block
+		for (const auto& p : block.GetPointsPositions(false)) {
+			const glm::ivec3 corner = glm::ivec3(glm::round(p));
+			halfSize = glm::max(halfSize, glm::abs(corner));
+			primitive.corners |= uint8_t(1 << ((corner.x > 0? 1:0) | (corner.y > 0? 2:0) | (corner.z > 0? 4:0)));
+		}
+		const glm::ivec3 center = block.GetRawPosition() * 2;
+		primitive.min = center - halfSize;
+		primitive.max = center + halfSize;
+		return primitive;
+	}
+
+	// Greedy merge, one axis at a time until nothing changes: primitives with the same hull that line up exactly and touch along an axis in which their hull is symmetric
+	static void Merge(std::vector<Primitive>& primitives) {
+		for (bool merged = true; merged;) {
+			merged = false;
+			for (int axis = 0; axis < 3; ++axis) {
+				const int u = (axis + 1) % 3;
+				const int v = (axis + 2) % 3;
+				auto key = [=](const Primitive& p){
+					return std::make_tuple(p.corners, p.min[u], p.max[u], p.min[v], p.max[v], p.min[axis], p.max[axis]);
+				};
+				std::sort(primitives.begin(), primitives.end(), [&](const Primitive& a, const Primitive& b){
+					return key(a) < key(b);
+				});
+				size_t count = 0;
+				for (const auto& p : primitives) {
+					if (count > 0) {
+						Primitive& previous = primitives[count-1];
+						if (previous.corners == p.corners && IsSymmetric(p.corners, axis)
+							&& previous.min[u] == p.min[u] && previous.max[u] == p.max[u]
+							&& previous.min[v] == p.min[v] && previous.max[v] == p.max[v]
+							&& previous.max[axis] == p.min[axis]
+						) {
+							previous.max[axis] = p.max[axis];
+							merged = true;
+							continue;
+						}
+					}
+					primitives[count++] = p;
+				}
+				primitives.resize(count);
+			}
+		}
+	}
+
+	static CompoundCollider::Bounds GetBounds(const Primitive& primitive) {
+		return {glm::dvec3(primitive.min) * 0.05, glm::dvec3(primitive.max) * 0.05};
+	}
+
+	static std::unique_ptr<Collider> CreateCollider(const Primitive& primitive) {
+		const glm::dvec3 center = glm::dvec3(primitive.min + primitive.max) * 0.025;
+		const glm::vec3 halfSize = glm::vec3(primitive.max - primitive.min) * 0.025f;
+		if (primitive.corners == 0xff) return std::make_unique<BoxCollider>(center, glm::dmat3{1}, halfSize);
+		return std::make_unique<WedgeCollider>(center, glm::dmat3{1}, halfSize, primitive.corners);
+	}
+
+	const Block* GetBlock(uint32_t blockIndex) const {
+		return store.GetBlock(blockIndex);
+	}
+
+	// Adds the block, or replaces the one with the same index, painting a block does not change the primitives
+	void SetBlock(const Block& block) {
+		const ChunkKey key = GetChunkKey(block);
+		if (const Block* existing = store.GetBlock(block.GetIndex()); existing) {
+			if (existing->HasSameGeometryAs(block)) {
+				store.SetBlock(block);
+				return;
+			}
+			RemoveFromChunk(GetChunkKey(*existing), block.GetIndex());
+		}
+		store.SetBlock(block);
+		AddToChunk(key, block);
+	}
+
+	// Returns false if there was no block with this index
+	bool RemoveBlock(uint32_t blockIndex) {
+		const Block* existing = store.GetBlock(blockIndex);
+		if (!existing) return false;
+		RemoveFromChunk(GetChunkKey(*existing), blockIndex);
+		store.RemoveBlock(blockIndex);
+		return true;
+	}
+
+	uint32_t GetFreeIndex() {
+		return store.GetFreeIndex();
+	}
+
+	static ChunkKey GetChunkKey(const Block& block) {
+		return BuildMesh::GetChunkKey(block);
+	}
+
+	// Replaces the primitives of the chunks that changed since the last call in the compound collider, with the unique lock of its mutex.
+	// Only the primitives that are not exactly the same after merging the chunk again are removed from the tree and added back.
+	// Returns the number of chunks that were updated.
+	size_t UpdateDirtyChunks(CompoundCollider& compound) {
+		if (dirtyChunks.size() == 0) return 0;
+		const size_t count = dirtyChunks.size();
+		// Merged before locking, so that the physics only waits for the tree to be updated
+		std::vector<CompoundCollider::Handle> removedHandles {};
+		std::vector<Primitive> merged {};
+		for (ChunkKey key : dirtyChunks) {
+			auto& chunk = chunks.at(key);
+			chunk.dirty = false;
+			merged.clear();
+			for (const auto& b : chunk.blocks) {
+				merged.push_back(b.second);
+			}
+			Merge(merged);
+			std::sort(merged.begin(), merged.end());
+			std::vector<std::pair<Primitive, CompoundCollider::Handle>> primitives {};
+			primitives.reserve(merged.size());
+			auto previous = chunk.primitives.begin();
+			for (const auto& p : merged) {
+				while (previous != chunk.primitives.end() && previous->first < p) {
+					removedHandles.push_back((previous++)->second);
+				}
+				if (previous != chunk.primitives.end() && previous->first == p) {
+					primitives.push_back(*previous++);
+				} else {
+					primitives.emplace_back(p, -1); // added below
+				}
+			}
+			for (; previous != chunk.primitives.end(); ++previous) {
+				removedHandles.push_back(previous->second);
+			}
+			nbPrimitives += primitives.size();
+			nbPrimitives -= chunk.primitives.size();
+			chunk.primitives.swap(primitives);
+		}
+		std::unique_lock lock(compound.mutex);
+		for (auto handle : removedHandles) {
+			compound.Remove(handle);
+		}
+		for (ChunkKey key : dirtyChunks) {
+			auto it = chunks.find(key);
+			if (it == chunks.end()) continue;
+			if (it->second.blocks.size() == 0) {
+				chunks.erase(it);
+				continue;
+			}
+			for (auto&[p, handle] : it->second.primitives) {
+				if (handle == -1) handle = compound.Add(CreateCollider(p), GetBounds(p));
+			}
+		}
+		dirtyChunks.clear();
+		return count;
+	}
+
+	const BlockStore& GetBlocks() const {
+		return store;
+	}
+
+	size_t GetBlockCount() const {
+		return store.Size();
+	}
+
+	size_t GetPrimitiveCount() const {
+		return nbPrimitives;
+	}
+
+};
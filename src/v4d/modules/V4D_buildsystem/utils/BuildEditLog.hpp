@@ -0,0 +1,159 @@
+#pragma once
+
+#include <deque>
+
+#define BUILD_EDIT_LOG_MAX_EDITS 32 // latest edits kept per build and sent with every update of it, a client that missed older ones requests the full state instead
+
+// One change to the blocks of a build, as replicated to clients
+struct BlockEdit {
+	enum TYPE : uint8_t {
+		ADD = 1,
+		REMOVE,
+		PAINT_FACE,
+		PAINT_VERTEX_GRADIENT,
+	};
+
+	uint32_t version = 0; // of the build once this edit is applied, assigned by the BuildEditLog
+	TYPE type = ADD;
+	uint32_t blockIndex = 0;
+	uint8_t faceOrVertexIndex = 0; // PAINT_FACE and PAINT_VERTEX_GRADIENT only
+	uint8_t colorIndex = 0; // PAINT_FACE and PAINT_VERTEX_GRADIENT only
+	Block block {}; // ADD only
+
+	static BlockEdit Add(const Block& block) {
+		BlockEdit edit {};
+		edit.type = ADD;
+		edit.blockIndex = block.GetIndex();
+		edit.block = block;
+		return edit;
+	}
+	static BlockEdit Remove(uint32_t blockIndex) {
+		BlockEdit edit {};
+		edit.type = REMOVE;
+		edit.blockIndex = blockIndex;
+		return edit;
+	}
+	static BlockEdit PaintFace(uint32_t blockIndex, uint8_t faceIndex, uint8_t colorIndex) {
+		BlockEdit edit {};
+		edit.type = PAINT_FACE;
+		edit.blockIndex = blockIndex;
+		edit.faceOrVertexIndex = faceIndex;
+		edit.colorIndex = colorIndex;
+		return edit;
+	}
+	static BlockEdit PaintVertexGradient(uint32_t blockIndex, uint8_t vertexIndex, uint8_t colorIndex) {
+		BlockEdit edit {};
+		edit.type = PAINT_VERTEX_GRADIENT;
+		edit.blockIndex = blockIndex;
+		edit.faceOrVertexIndex = vertexIndex;
+		edit.colorIndex = colorIndex;
+		return edit;
+	}
+
+	// Blocks is a BlockStore, a BuildMesh or a BuildCollider.
+	// Returns false if it did not change anything (no block with this index, or already one for ADD)
+	template<typename Blocks>
+	bool ApplyTo(Blocks& blocks) const {
+		const Block* existing = blocks.GetBlock(blockIndex);
+		switch (type) {
+			case ADD:
+				if (existing) return false;
+				blocks.SetBlock(block);
+				return true;
+			case REMOVE:
+				return blocks.RemoveBlock(blockIndex);
+			case PAINT_FACE:
+			case PAINT_VERTEX_GRADIENT:{
+				if (!existing) return false;
+				Block painted = *existing;
+				if (type == PAINT_FACE) painted.SetFaceColor(faceOrVertexIndex, colorIndex);
+				else painted.SetVertexGradientColor(faceOrVertexIndex, colorIndex);
+				blocks.SetBlock(painted);
+			}return true;
+		}
+		return false;
+	}
+
+	// The version is not written, edits are always sent in a sequence
+	template<typename Stream>
+	void Write(Stream& stream) const {
+		stream << (uint8_t)type;
+		stream << blockIndex;
+		switch (type) {
+			case ADD:
+				stream << block;
+			break;
+			case REMOVE: break;
+			case PAINT_FACE:
+			case PAINT_VERTEX_GRADIENT:
+				stream << faceOrVertexIndex;
+				stream << colorIndex;
+			break;
+		}
+	}
+
+	template<typename Stream>
+	static BlockEdit Read(Stream& stream, uint32_t version) {
+		BlockEdit edit {};
+		edit.version = version;
+		edit.type = (TYPE)stream.template Read<uint8_t>();
+		edit.blockIndex = stream.template Read<uint32_t>();
+		switch (edit.type) {
+			case ADD:
+				edit.block = stream.template Read<Block>();
+			break;
+			case REMOVE: break;
+			case PAINT_FACE:
+			case PAINT_VERTEX_GRADIENT:
+				edit.faceOrVertexIndex = stream.template Read<uint8_t>();
+				edit.colorIndex = stream.template Read<uint8_t>();
+			break;
+		}
+		return edit;
+	}
+};
+
+// Server-side, versioned history of the latest edits of a build.
+// Every update of the build carries these edits, so that a client only applies those that came after the version it has,
+// and only a client that fell too far behind (or that just subscribed to a build that had too many edits) needs the full state.
+// It must be locked by the caller, the same way as the blocks of the build.
+class BuildEditLog {
+	static_assert(BUILD_EDIT_LOG_MAX_EDITS <= 255, "the number of edits is sent as a uint8_t");
+	std::deque<BlockEdit> edits {};
+	uint32_t version = 0;
+
+public:
+	// Returns the new version of the build
+	uint32_t Push(BlockEdit edit) {
+		edit.version = ++version;
+		edits.push_back(edit);
+		if (edits.size() > BUILD_EDIT_LOG_MAX_EDITS) edits.pop_front();
+		return version;
+	}
+
+	uint32_t GetVersion() const {
+		return version;
+	}
+
+	template<typename Stream>
+	void Write(Stream& stream) const {
+		stream << version;
+		stream << (uint8_t)edits.size();
+		for (const auto& edit : edits) {
+			edit.Write(stream);
+		}
+	}
+
+	// Reads what was written by Write(), returns the version of the build
+	template<typename Stream>
+	static uint32_t Read(Stream& stream, std::vector<BlockEdit>& edits) {
+		const auto version = stream.template Read<uint32_t>();
+		const auto count = stream.template Read<uint8_t>();
+		edits.clear();
+		edits.reserve(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			edits.push_back(BlockEdit::Read(stream, version - count + 1 + i));
+		}
+		return version;
+	}
+};
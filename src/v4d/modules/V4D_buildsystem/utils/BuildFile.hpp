@@ -0,0 +1,301 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _LINUX
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#define BUILD_FILE_FORMAT_VERSION 1
+#define BUILD_FILE_CHUNK_BLOCKS 2048 // blocks per compressed chunk (64 KB), each chunk is compressed on its own
+#define BUILD_FILE_HASH_BITS 12 // size of the table of the compressor, in bits
+
+// Binary file of the blocks of a build.
+// A header of 64 bytes with a checksum of itself and of the data that follows it, then either the blocks as they are in memory (32 bytes each, in the byte order of the machine),
+// or chunks of blocks compressed with the LZ4 block format, each prefixed with its compressed and uncompressed sizes.
+// Uncompressed files are memory-mapped and their blocks are given to the BlockStore right where they are in the mapping, compressed ones are decompressed chunk by chunk into a single buffer.
+// Files are written next to their destination and renamed over it once complete, so that a save that fails never leaves a truncated file.
+class BuildFile {
+public:
+	enum RESULT {
+		OK = 0,
+		CANNOT_OPEN,
+		CANNOT_WRITE,
+		INVALID_HEADER, // not a build file, or its header was damaged
+		UNSUPPORTED_VERSION, // written by a newer version of the game, or with blocks of a different size
+		CORRUPTED, // the data does not match its checksum, or could not be decompressed
+	};
+
+	enum FLAGS : uint16_t {
+		COMPRESSED = 1,
+	};
+
+	struct Header {
+		char magic[4] {'V','4','D','B'};
+		uint16_t formatVersion = BUILD_FILE_FORMAT_VERSION;
+		uint16_t flags = 0;
+		uint32_t blockSize = sizeof(Block);
+		uint32_t blockCount = 0;
+		uint32_t buildVersion = 0; // of the BuildEditLog when it was saved
+		uint32_t chunkCount = 0; // compressed files only
+		uint64_t dataSize = 0; // in bytes, after the header
+		uint32_t dataChecksum = 0; // CRC-32 of the data
+		uint8_t _reserved[24] {};
+		uint32_t headerChecksum = 0; // CRC-32 of everything above
+	};
+	static_assert(sizeof(Header) == 64, "the header keeps the blocks that follow it aligned to their size");
+
+	static uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+		static const auto table = []{
+			std::array<uint32_t, 256> t {};
+			for (uint32_t i = 0; i < 256; ++i) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; ++k) c = (c & 1)? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+				t[i] = c;
+			}
+			return t;
+		}();
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i) {
+			crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	// LZ4 block format, greedy, returns the compressed size or 0 if it does not fit in dstCapacity
+	static size_t Compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) {
+		const size_t minMatch = 4;
+		const size_t lastLiterals = 5; // the last bytes are always literals
+		const size_t matchFindLimit = 12; // the last match starts at least this many bytes before the end
+		std::array<uint32_t, 1 << BUILD_FILE_HASH_BITS> table {}; // position + 1 of the latest sequence with this hash, 0 when none
+		auto read32 = [src](size_t i){uint32_t v; memcpy(&v, src + i, 4); return v;};
+		auto hash = [](uint32_t sequence){return (sequence * 2654435761u) >> (32 - BUILD_FILE_HASH_BITS);};
+		size_t ip = 0, anchor = 0, op = 0;
+
+		auto writeLength = [&](size_t length) -> bool {
+			for (; length >= 255; length -= 255) {
+				if (op >= dstCapacity) return false;
+				dst[op++] = 255;
+			}
+			if (op >= dstCapacity) return false;
+			dst[op++] = uint8_t(length);
+			return true;
+		};
+		auto writeLiterals = [&](size_t literalLength, uint8_t matchToken) -> bool {
+			if (op >= dstCapacity) return false;
+			dst[op++] = uint8_t((std::min<size_t>(literalLength, 15) << 4) | matchToken);
+			if (literalLength >= 15 && !writeLength(literalLength - 15)) return false;
+			if (op + literalLength > dstCapacity) return false;
+			if (literalLength) memcpy(dst + op, src + anchor, literalLength);
+			op += literalLength;
+			return true;
+		};
+
+		if (srcSize > matchFindLimit) {
+			const size_t matchLimit = srcSize - lastLiterals;
+			const size_t lastMatchStart = srcSize - matchFindLimit;
+			while (ip < lastMatchStart) {
+				const uint32_t sequence = read32(ip);
+				auto& entry = table[hash(sequence)];
+				const size_t candidate = entry;
+				entry = uint32_t(ip + 1);
+				if (candidate == 0 || ip - (candidate - 1) > 65535 || read32(candidate - 1) != sequence) {
+					++ip;
+					continue;
+				}
+				const size_t ref = candidate - 1;
+				size_t length = minMatch;
+				while (ip + length < matchLimit && src[ip + length] == src[ref + length]) ++length;
+				const size_t matchLength = length - minMatch;
+				if (!writeLiterals(ip - anchor, uint8_t(std::min<size_t>(matchLength, 15)))) return 0;
+				if (op + 2 > dstCapacity) return 0;
+				const size_t offset = ip - ref;
+				dst[op++] = uint8_t(offset);
+				dst[op++] = uint8_t(offset >> 8);
+				if (matchLength >= 15 && !writeLength(matchLength - 15)) return 0;
+				ip += length;
+				anchor = ip;
+			}
+		}
+		if (!writeLiterals(srcSize - anchor, 0)) return 0;
+		return op;
+	}
+
+	// LZ4 block format, returns false unless it decompresses to exactly dstSize bytes
+	static bool Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+		size_t ip = 0, op = 0;
+		auto readLength = [&](size_t& length) -> bool {
+			uint8_t b;
+			do {
+				if (ip >= srcSize) return false;
+				b = src[ip++];
+				length += b;
+			} while (b == 255);
+			return true;
+		};
+		while (ip < srcSize) {
+			const uint8_t token = src[ip++];
+			size_t literalLength = token >> 4;
+			if (literalLength == 15 && !readLength(literalLength)) return false;
+			if (literalLength > srcSize - ip || literalLength > dstSize - op) return false;
+			if (literalLength) memcpy(dst + op, src + ip, literalLength);
+			ip += literalLength;
+			op += literalLength;
+			if (ip == srcSize) break; // the last sequence has no match
+			if (srcSize - ip < 2) return false;
+			const size_t offset = src[ip] | (size_t(src[ip+1]) << 8);
+			ip += 2;
+			if (offset == 0 || offset > op) return false;
+			size_t matchLength = token & 15;
+			if (matchLength == 15 && !readLength(matchLength)) return false;
+			matchLength += 4;
+			if (matchLength > dstSize - op) return false;
+			// Byte by byte, the match may overlap what it writes
+			for (size_t i = 0; i < matchLength; ++i, ++op) dst[op] = dst[op - offset];
+		}
+		return op == dstSize;
+	}
+
+	// Whole file in memory
+	static std::vector<uint8_t> Encode(const Block* blocks, size_t count, uint32_t buildVersion, bool compressed) {
+		std::vector<uint8_t> file (sizeof(Header));
+		Header header {};
+		header.blockCount = uint32_t(count);
+		header.buildVersion = buildVersion;
+		const uint8_t* raw = reinterpret_cast<const uint8_t*>(blocks);
+		if (compressed) {
+			header.flags |= COMPRESSED;
+			for (size_t first = 0; first < count; first += BUILD_FILE_CHUNK_BLOCKS) {
+				const size_t uncompressedSize = std::min<size_t>(BUILD_FILE_CHUNK_BLOCKS, count - first) * sizeof(Block);
+				const size_t offset = file.size();
+				file.resize(offset + 8 + uncompressedSize);
+				// A chunk that does not get smaller is stored as it is, with both sizes equal
+				size_t compressedSize = Compress(raw + first * sizeof(Block), uncompressedSize, file.data() + offset + 8, uncompressedSize - 1);
+				if (compressedSize == 0) {
+					compressedSize = uncompressedSize;
+					memcpy(file.data() + offset + 8, raw + first * sizeof(Block), uncompressedSize);
+				}
+				const uint32_t sizes[2] {uint32_t(compressedSize), uint32_t(uncompressedSize)};
+				memcpy(file.data() + offset, sizes, 8);
+				file.resize(offset + 8 + compressedSize);
+				++header.chunkCount;
+			}
+		} else {
+			file.insert(file.end(), raw, raw + count * sizeof(Block));
+		}
+		header.dataSize = file.size() - sizeof(Header);
+		header.dataChecksum = Crc32(file.data() + sizeof(Header), header.dataSize);
+		header.headerChecksum = Crc32(reinterpret_cast<const uint8_t*>(&header), offsetof(Header, headerChecksum));
+		memcpy(file.data(), &header, sizeof(Header));
+		return file;
+	}
+
+	// Whole file in memory, the blocks replace those of the store
+	static RESULT Decode(const uint8_t* file, size_t size, BlockStore& store, uint32_t* buildVersion = nullptr) {
+		if (size < sizeof(Header)) return INVALID_HEADER;
+		Header header;
+		memcpy(&header, file, sizeof(Header));
+		if (memcmp(header.magic, Header{}.magic, 4) != 0) return INVALID_HEADER;
+		if (header.headerChecksum != Crc32(file, offsetof(Header, headerChecksum))) return INVALID_HEADER;
+		if (header.formatVersion > BUILD_FILE_FORMAT_VERSION || header.blockSize != sizeof(Block)) return UNSUPPORTED_VERSION;
+		if (header.dataSize != size - sizeof(Header)) return CORRUPTED;
+		const uint8_t* data = file + sizeof(Header);
+		if (header.dataChecksum != Crc32(data, header.dataSize)) return CORRUPTED;
+
+		if (header.flags & COMPRESSED) {
+			std::vector<Block> blocks (header.blockCount);
+			uint8_t* out = reinterpret_cast<uint8_t*>(blocks.data());
+			size_t ip = 0, op = 0;
+			for (uint32_t chunk = 0; chunk < header.chunkCount; ++chunk) {
+				uint32_t sizes[2];
+				if (header.dataSize - ip < 8) return CORRUPTED;
+				memcpy(sizes, data + ip, 8);
+				ip += 8;
+				const auto[compressedSize, uncompressedSize] = sizes;
+				if (compressedSize > header.dataSize - ip || uncompressedSize > blocks.size() * sizeof(Block) - op) return CORRUPTED;
+				if (compressedSize == uncompressedSize) {
+					memcpy(out + op, data + ip, uncompressedSize);
+				} else if (!Decompress(data + ip, compressedSize, out + op, uncompressedSize)) {
+					return CORRUPTED;
+				}
+				ip += compressedSize;
+				op += uncompressedSize;
+			}
+			if (op != blocks.size() * sizeof(Block)) return CORRUPTED;
+			store.Assign(blocks);
+		} else {
+			if (header.dataSize != size_t(header.blockCount) * sizeof(Block)) return CORRUPTED;
+			if (reinterpret_cast<uintptr_t>(data) % alignof(Block) == 0) {
+				store.Assign(reinterpret_cast<const Block*>(data), header.blockCount);
+			} else {
+				std::vector<Block> blocks (header.blockCount);
+				memcpy(blocks.data(), data, header.dataSize);
+				store.Assign(blocks);
+			}
+		}
+		if (buildVersion) *buildVersion = header.buildVersion;
+		return OK;
+	}
+
+	static RESULT Save(const std::string& path, const std::vector<Block>& blocks, uint32_t buildVersion, bool compressed) {
+		const auto file = Encode(blocks.data(), blocks.size(), buildVersion, compressed);
+		const std::string tmpPath = path + ".tmp";
+		std::error_code err;
+		{
+			std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+			if (!out) return CANNOT_OPEN;
+			out.write(reinterpret_cast<const char*>(file.data()), file.size());
+			// The last buffered bytes are only written when closing, which may fail too (disk full)
+			out.close();
+			if (!out) {
+				std::filesystem::remove(tmpPath, err);
+				return CANNOT_WRITE;
+			}
+		}
+		std::filesystem::rename(tmpPath, path, err);
+		if (err) {
+			std::filesystem::remove(tmpPath, err);
+			return CANNOT_WRITE;
+		}
+		return OK;
+	}
+
+	static RESULT Load(const std::string& path, BlockStore& store, uint32_t* buildVersion = nullptr) {
+		#ifdef _LINUX
+			const int fd = open(path.c_str(), O_RDONLY);
+			if (fd < 0) return CANNOT_OPEN;
+			struct stat st;
+			if (fstat(fd, &st) != 0) {
+				close(fd);
+				return CANNOT_OPEN;
+			}
+			const size_t size = size_t(st.st_size);
+			if (size < sizeof(Header)) {
+				close(fd);
+				return INVALID_HEADER;
+			}
+			void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd);
+			if (mapped == MAP_FAILED) return CANNOT_OPEN;
+			madvise(mapped, size, MADV_SEQUENTIAL);
+			const RESULT result = Decode(static_cast<const uint8_t*>(mapped), size, store, buildVersion);
+			munmap(mapped, size);
+			return result;
+		#else
+			std::ifstream in(path, std::ios::binary | std::ios::ate);
+			if (!in) return CANNOT_OPEN;
+			std::vector<uint8_t> file (size_t(in.tellg()));
+			in.seekg(0);
+			in.read(reinterpret_cast<char*>(file.data()), file.size());
+			if (!in) return CANNOT_OPEN;
+			return Decode(file.data(), file.size(), store, buildVersion);
+		#endif
+	}
+};
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+
+#define BUILD_MESH_CHUNK_SIZE 64 // in grid units of 10 cm, blocks are grouped by the chunk that contains their position
+
+// Geometry of a build, split into chunks of nearby blocks so that editing a block only regenerates the geometry of its own chunk.
+// Blocks belong to the chunk that contains their position, their geometry may overlap neighbouring chunks.
+// Since faces hidden by adjacent blocks are culled, the chunks of the blocks that touch an edited block are regenerated too.
+// It must be locked by the caller, the same way as the Build it belongs to.
+class BuildMesh {
+public:
+	using ChunkKey = uint64_t;
+	using Geometry = BlockMesher::Geometry;
+	using Bounds = BlockStore::Bounds;
+
+	struct Chunk {
+		std::vector<Block> blocks {};
+		std::shared_ptr<Geometry> geometry = nullptr; // never modified, a regenerated chunk gets a new one so that a renderer may still use the previous one
+		bool dirty = false;
+	};
+
+	BlockMesher::Options options {};
+
+private:
+	std::unordered_map<ChunkKey, Chunk> chunks {};
+	BlockStore store {}; // all blocks, to find them by index and to find their neighbours
+	std::vector<ChunkKey> dirtyChunks {};
+
+	void MarkDirty(ChunkKey key, Chunk& chunk) {
+		if (!chunk.dirty) {
+			chunk.dirty = true;
+			dirtyChunks.push_back(key);
+		}
+	}
+
+	// Chunks with a block touching these bounds, in which faces may have become hidden or visible
+	void MarkTouchingDirty(const Bounds& bounds) {
+		if (!options.cullHiddenFaces) return;
+		store.ForEachTouching(bounds, [this](const Block& block, const Bounds&){
+			const ChunkKey key = GetChunkKey(block);
+			MarkDirty(key, chunks.at(key));
+		});
+	}
+
+	void RemoveFromChunk(ChunkKey key, uint32_t blockIndex) {
+		auto& chunk = chunks.at(key);
+		for (auto& b : chunk.blocks) {
+			if (b.GetIndex() == blockIndex) {
+				b = chunk.blocks.back();
+				chunk.blocks.pop_back();
+				break;
+			}
+		}
+		MarkDirty(key, chunk);
+	}
+
+	void AddToChunk(ChunkKey key, const Block& block) {
+		auto& chunk = chunks[key];
+		chunk.blocks.push_back(block);
+		MarkDirty(key, chunk);
+	}
+
+	void SetInChunk(ChunkKey key, const Block& block) {
+		auto& chunk = chunks.at(key);
+		for (auto& b : chunk.blocks) {
+			if (b.GetIndex() == block.GetIndex()) {
+				b = block;
+				break;
+			}
+		}
+		MarkDirty(key, chunk);
+	}
+
+public:
+
+	static ChunkKey GetChunkKey(const Block& block) {
+		const glm::ivec3 raw = block.GetRawPosition();
+		// floored division, so that chunks have the same size on both sides of zero
+		auto chunkCoord = [](int v) -> uint64_t {
+			return uint64_t((v >= 0? v : v - (BUILD_MESH_CHUNK_SIZE-1)) / BUILD_MESH_CHUNK_SIZE) & 0x1fffff;
+		};
+		return chunkCoord(raw.x) | (chunkCoord(raw.y) << 21) | (chunkCoord(raw.z) << 42);
+	}
+
+	// Calls func(const Block&) for each block that touches the given block, including itself
+	template<typename F>
+	void ForEachNeighbour(const Block& block, F&& func) const {
+		store.ForEachTouching(BlockStore::GetBounds(block), [&func](const Block& b, const Bounds&){
+			func(b);
+		});
+	}
+
+	const Block* GetBlock(uint32_t blockIndex) const {
+		return store.GetBlock(blockIndex);
+	}
+
+	// Adds the block, or replaces the one with the same index if it is different
+	void SetBlock(const Block& block) {
+		const ChunkKey key = GetChunkKey(block);
+		if (const Block* existing = store.GetBlock(block.GetIndex()); existing) {
+			if (*existing == block) return;
+			const ChunkKey previousKey = GetChunkKey(*existing);
+			if (existing->HasSameGeometryAs(block)) {
+				// Only painted, adjacent faces did not change
+				store.SetBlock(block);
+				SetInChunk(previousKey, block);
+				return;
+			}
+			const Bounds previousBounds = BlockStore::GetBounds(*existing);
+			MarkTouchingDirty(previousBounds);
+			RemoveFromChunk(previousKey, block.GetIndex());
+		}
+		store.SetBlock(block);
+		AddToChunk(key, block);
+		MarkTouchingDirty(BlockStore::GetBounds(block));
+	}
+
+	// Returns false if there was no block with this index
+	bool RemoveBlock(uint32_t blockIndex) {
+		const Block* existing = store.GetBlock(blockIndex);
+		if (!existing) return false;
+		MarkTouchingDirty(BlockStore::GetBounds(*existing));
+		RemoveFromChunk(GetChunkKey(*existing), blockIndex);
+		store.RemoveBlock(blockIndex);
+		return true;
+	}
+
+	// Makes the mesh contain exactly these blocks, only the chunks in which a block was added, removed or changed become dirty, along with the chunks of the blocks touching them
+	void SetBlocks(const std::vector<Block>& blocks) {
+		std::unordered_set<uint32_t> indices {};
+		indices.reserve(blocks.size());
+		for (const auto& b : blocks) {
+			indices.insert(b.GetIndex());
+		}
+		std::vector<uint32_t> removedIndices {};
+		for (const auto& b : store.GetBlocks()) {
+			if (indices.count(b.GetIndex()) == 0) removedIndices.push_back(b.GetIndex());
+		}
+		for (auto blockIndex : removedIndices) {
+			RemoveBlock(blockIndex);
+		}
+		for (const auto& b : blocks) {
+			SetBlock(b);
+		}
+	}
+
+	void Clear() {
+		for (auto&[key, chunk] : chunks) {
+			chunk.blocks.clear();
+			MarkDirty(key, chunk);
+		}
+		store.Clear();
+	}
+
+	// Regenerates the geometry of the chunks that changed since the last call, and calls func(ChunkKey, std::shared_ptr<Geometry>) for each of them.
+	// The geometry is nullptr for chunks that no longer have any block, they are forgotten after this call.
+	// Returns the number of chunks that were regenerated.
+	template<typename F>
+	size_t RegenerateDirtyChunks(F&& func, BlockMesher::Stats* stats = nullptr) {
+		const size_t count = dirtyChunks.size();
+		for (ChunkKey key : dirtyChunks) {
+			auto it = chunks.find(key);
+			if (it == chunks.end()) continue;
+			auto& chunk = it->second;
+			chunk.dirty = false;
+			if (chunk.blocks.size() == 0) {
+				chunks.erase(it);
+				func(key, std::shared_ptr<Geometry>(nullptr));
+			} else {
+				chunk.geometry = std::make_shared<Geometry>();
+				BlockMesher::Generate(chunk.blocks, [this](const Block& block, auto&& neighbourFunc){
+					ForEachNeighbour(block, neighbourFunc);
+				}, *chunk.geometry, options, stats);
+				func(key, chunk.geometry);
+			}
+		}
+		dirtyChunks.clear();
+		return count;
+	}
+
+	size_t RegenerateDirtyChunks(BlockMesher::Stats* stats = nullptr) {
+		return RegenerateDirtyChunks([](ChunkKey, const std::shared_ptr<Geometry>&){}, stats);
+	}
+
+	const std::unordered_map<ChunkKey, Chunk>& GetChunks() const {
+		return chunks;
+	}
+
+	const BlockStore& GetBlocks() const {
+		return store;
+	}
+
+	size_t GetBlockCount() const {
+		return store.Size();
+	}
+
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <v4d.h>
+#include <algorithm>
+#include <unordered_map>
+
+#define BURST_PRIORITY_DISTANCE_SCALE 100.0 // in meters, a still entity this far from the player accumulates priority half as fast as one right next to it
+#define BURST_PRIORITY_VELOCITY_WEIGHT 8.0 // extra priority rate per radian/second of apparent motion as seen from the player, which already accounts for the distance
+#define BURST_PRIORITY_MAX_APPARENT_SPEED 2.0 // in radians/second, so that something flying right past the player does not take the whole budget
+#define BURST_PRIORITY_BEHIND_VIEW_FACTOR 0.25 // priority rate of entities behind the player relative to those in front of it
+#define BURST_PRIORITY_MAX_DELTA_TIME 1.0 // in seconds, so that a stalled sender does not give everything a huge priority at once
+
+namespace networking::snapshot {
+
+	// How fast the priority of an entity grows, per second, while it has changes that were not sent.
+	// distance and speed are in meters and meters/second, viewDot is the cosine of the angle between the player's view and the direction of the entity.
+	inline double GetBurstPriorityRate(double distance, double speed, double viewDot) {
+		const double viewFactor = BURST_PRIORITY_BEHIND_VIEW_FACTOR + (1.0 - BURST_PRIORITY_BEHIND_VIEW_FACTOR) * std::clamp(0.5 + 0.5 * viewDot, 0.0, 1.0);
+		const double apparentSpeed = std::min(speed / std::max(distance, 1.0), BURST_PRIORITY_MAX_APPARENT_SPEED);
+		return viewFactor * (1.0 / (1.0 + distance / BURST_PRIORITY_DISTANCE_SCALE) + BURST_PRIORITY_VELOCITY_WEIGHT * apparentSpeed);
+	}
+
+	// Server-side priority of each entity for one client, which keeps growing until the entity is sent, so that everything that changes eventually gets its turn.
+	// Velocities are estimated from the positions seen in consecutive frames, which also works for entities that have no rigidbody, and are also sent to the client for it to interpolate between bursts.
+	// It must be locked by the caller, the same way as the client's DeltaBaselines.
+	class BurstPriorityAccumulator {
+		struct EntityPriority {
+			double priority = 0;
+			glm::dvec3 lastPosition {0};
+			glm::dvec3 velocity {0};
+			double lastTimestamp = 0;
+			uint64_t lastFrame = 0;
+		};
+
+		std::unordered_map<int32_t, EntityPriority> entities {};
+		uint64_t currentFrame = 0;
+		double currentTimestamp = 0;
+		double deltaTime = 0;
+		bool started = false;
+
+	public:
+		// Called once per burst frame, before accumulating, timestamp is in seconds
+		void BeginFrame(uint64_t frame, double timestamp) {
+			deltaTime = started? std::clamp(timestamp - currentTimestamp, 0.0, BURST_PRIORITY_MAX_DELTA_TIME) : 0.0;
+			currentFrame = frame;
+			currentTimestamp = timestamp;
+			started = true;
+		}
+
+		// Called once per frame for each entity, before Accumulate or UpToDate, returns its velocity in meters/second
+		const glm::dvec3& Observe(int32_t id, const glm::dvec3& worldPosition) {
+			auto [it, inserted] = entities.try_emplace(id);
+			EntityPriority& entity = it->second;
+			if (entity.lastFrame != currentFrame || inserted) {
+				const double elapsed = currentTimestamp - entity.lastTimestamp;
+				entity.velocity = (!inserted && elapsed > 0)? (worldPosition - entity.lastPosition) / elapsed : glm::dvec3(0);
+				entity.lastPosition = worldPosition;
+				entity.lastTimestamp = currentTimestamp;
+				entity.lastFrame = currentFrame;
+			}
+			return entity.velocity;
+		}
+
+		// Adds this frame's share to the priority of an entity that has something to send, and returns its accumulated priority
+		double Accumulate(int32_t id, double distance, double viewDot) {
+			EntityPriority& entity = entities[id];
+			// Something to send always gets some priority, even on the very first frame
+			entity.priority += GetBurstPriorityRate(distance, glm::length(entity.velocity), viewDot) * std::max(deltaTime, 1e-3);
+			return entity.priority;
+		}
+
+		// The entity has nothing new for this client
+		void UpToDate(int32_t id) {
+			entities[id].priority = 0;
+		}
+
+		void Sent(int32_t id) {
+			if (auto it = entities.find(id); it != entities.end()) it->second.priority = 0;
+		}
+
+		// Forgets the entities that were not seen this frame, which the client is no longer subscribed to
+		void EndFrame() {
+			for (auto it = entities.begin(); it != entities.end(); ) {
+				if (it->second.lastFrame != currentFrame) {
+					it = entities.erase(it);
+				} else {
+					++it;
+				}
+			}
+		}
+
+		void Reset() {
+			entities.clear();
+			started = false;
+		}
+	};
+
+}
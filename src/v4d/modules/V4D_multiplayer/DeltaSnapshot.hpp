@@ -0,0 +1,373 @@
+#pragma once
+
+#include <v4d.h>
+#include <vector>
+#include <array>
+#include <tuple>
+#include <mutex>
+#include <unordered_map>
+
+#include "SnapshotCodec.hpp"
+#include "BurstPriority.hpp"
+
+#define SNAPSHOT_BASELINE_RING_SIZE 256 // sent snapshots kept per client until they are acknowledged, must be a power of two
+#define SNAPSHOT_BASELINE_MAX_AGE_FRAMES 250 // an unchanged field is sent again once its acknowledged baseline is older than this many burst frames, in case the client has lost it
+#define SNAPSHOT_ACK_MASK_BITS 32
+#define SNAPSHOT_POSITION_EPSILON 0.001 // in meters
+#define SNAPSHOT_ROTATION_EPSILON 1e-7 // in 1 - |dot(a,b)|
+#define SNAPSHOT_VELOCITY_EPSILON 0.05 // in meters/second, slower entities are considered still
+#define SNAPSHOT_POSITION_RANGE_BAND 4 // entities are only packed together when their position ranges are within the same band of this many powers of two, so that near entities are not quantized within the range of far ones
+#define SNAPSHOT_VELOCITY_RELATIVE_EPSILON 0.02 // fraction of the speed, velocities are only used to interpolate and their estimation is noisy when the burst rate does not match the physics rate
+
+namespace networking::snapshot {
+
+	// Server-side state of what a client has acknowledged, one per client.
+	// Every burst gets a sequence number and remembers the fields it carried, so that when the client acknowledges it, those fields become that client's baselines.
+	// A field is only sent when it differs from its baseline, or when a different value was sent since and not acknowledged yet.
+	class DeltaBaselines {
+		struct EntityBaseline {
+			uint32_t resetSequence = 0; // acknowledgements of bursts older than this are ignored
+			bool hasAckedPosition = false;
+			bool hasAckedRotation = false;
+			bool hasAckedVelocity = false;
+			uint64_t ackedPositionFrame = 0;
+			uint64_t ackedRotationFrame = 0;
+			uint64_t ackedVelocityFrame = 0;
+			uint32_t ackedPositionSequence = 0;
+			uint32_t ackedRotationSequence = 0;
+			uint32_t ackedVelocitySequence = 0;
+			glm::dvec3 ackedPosition {0}; // as decoded by the client
+			glm::dvec3 sentPosition {0};
+			double ackedPositionPrecision = 0; // maximum distance between the decoded position and the actual one when it was sent
+			double sentPositionPrecision = 0;
+			glm::quat ackedOrientation {1,0,0,0};
+			glm::quat sentOrientation {1,0,0,0};
+			glm::vec3 ackedVelocity {0};
+			glm::vec3 sentVelocity {0};
+		};
+
+		struct SentSnapshot {
+			uint32_t sequence = 0;
+			uint64_t frame = 0;
+			bool acked = false;
+			std::vector<std::tuple<int32_t, glm::dvec3, double>> positions {};
+			std::vector<std::pair<int32_t, glm::quat>> rotations {};
+			std::vector<std::pair<int32_t, glm::vec3>> velocities {};
+		};
+
+		mutable std::mutex mu;
+		std::unordered_map<int32_t, EntityBaseline> entities {};
+		std::vector<SentSnapshot> sentSnapshots = std::vector<SentSnapshot>(SNAPSHOT_BASELINE_RING_SIZE);
+		uint32_t nextSequence = 1;
+		uint32_t lastAckedSequence = 0;
+		uint64_t currentFrame = 0;
+
+		// Positions are quantized within a range that depends on the other entities of the burst, an unchanged position only differs from its decoded value by the precision it was sent with
+		static bool SamePosition(const glm::dvec3& a, const glm::dvec3& b, double precision) {
+			const glm::dvec3 d = a - b;
+			const double epsilon = std::max(double(SNAPSHOT_POSITION_EPSILON), precision);
+			return glm::dot(d,d) <= epsilon*epsilon;
+		}
+
+		static bool SameVelocity(const glm::vec3& a, const glm::vec3& b) {
+			const glm::vec3 d = a - b;
+			const float epsilon = std::max(float(SNAPSHOT_VELOCITY_EPSILON), float(SNAPSHOT_VELOCITY_RELATIVE_EPSILON) * glm::length(b));
+			return glm::dot(d,d) <= epsilon*epsilon;
+		}
+
+		// In double precision and normalized, otherwise float rounding alone can make a rotation differ from itself by more than the epsilon
+		static bool SameRotation(const glm::quat& a, const glm::quat& b) {
+			const double dot = double(a.x)*b.x + double(a.y)*b.y + double(a.z)*b.z + double(a.w)*b.w;
+			const double lengths = std::sqrt((double(a.x)*a.x + double(a.y)*a.y + double(a.z)*a.z + double(a.w)*a.w) * (double(b.x)*b.x + double(b.y)*b.y + double(b.z)*b.z + double(b.w)*b.w));
+			return lengths > 0 && 1.0 - std::abs(dot) / lengths <= SNAPSHOT_ROTATION_EPSILON;
+		}
+
+		// An entity first seen in a snapshot must accept the acknowledgement of that snapshot
+		EntityBaseline& GetEntity(int32_t id, uint32_t sequence) {
+			auto [it, inserted] = entities.try_emplace(id);
+			if (inserted) it->second.resetSequence = sequence;
+			return it->second;
+		}
+
+	public:
+		std::unique_lock<std::mutex> GetLock() const {
+			return std::unique_lock<std::mutex>{mu};
+		}
+
+		// Called once per burst frame before encoding.
+		// If the client has not acknowledged anything within the ring buffer, all baselines are dropped so that everything is sent in full until it does.
+		void BeginFrame(uint64_t frame) {
+			currentFrame = frame;
+			if (nextSequence - lastAckedSequence > SNAPSHOT_BASELINE_RING_SIZE) {
+				entities.clear();
+			}
+		}
+
+		bool PositionChanged(int32_t id, const glm::dvec3& position) const {
+			auto it = entities.find(id);
+			if (it == entities.end()) return true;
+			const EntityBaseline& baseline = it->second;
+			if (!baseline.hasAckedPosition || currentFrame - baseline.ackedPositionFrame > SNAPSHOT_BASELINE_MAX_AGE_FRAMES) return true;
+			return !SamePosition(position, baseline.ackedPosition, baseline.ackedPositionPrecision) || !SamePosition(baseline.sentPosition, baseline.ackedPosition, baseline.sentPositionPrecision + baseline.ackedPositionPrecision);
+		}
+
+		bool RotationChanged(int32_t id, const glm::quat& orientation) const {
+			auto it = entities.find(id);
+			if (it == entities.end()) return true;
+			const EntityBaseline& baseline = it->second;
+			if (!baseline.hasAckedRotation || currentFrame - baseline.ackedRotationFrame > SNAPSHOT_BASELINE_MAX_AGE_FRAMES) return true;
+			return !SameRotation(orientation, baseline.ackedOrientation) || !SameRotation(baseline.sentOrientation, baseline.ackedOrientation);
+		}
+
+		bool VelocityChanged(int32_t id, const glm::vec3& velocity) const {
+			auto it = entities.find(id);
+			if (it == entities.end()) return true;
+			const EntityBaseline& baseline = it->second;
+			if (!baseline.hasAckedVelocity || currentFrame - baseline.ackedVelocityFrame > SNAPSHOT_BASELINE_MAX_AGE_FRAMES) return true;
+			return !SameVelocity(velocity, baseline.ackedVelocity) || !SameVelocity(baseline.sentVelocity, baseline.ackedVelocity);
+		}
+
+		// Returns the sequence number of the new burst, the fields it carries must then be added to it
+		uint32_t BeginSnapshot() {
+			const uint32_t sequence = nextSequence++;
+			SentSnapshot& snapshot = sentSnapshots[sequence % SNAPSHOT_BASELINE_RING_SIZE];
+			snapshot.sequence = sequence;
+			snapshot.frame = currentFrame;
+			snapshot.acked = false;
+			snapshot.positions.clear();
+			snapshot.rotations.clear();
+			snapshot.velocities.clear();
+			return sequence;
+		}
+
+		// position must be the one that the client decodes, precision its maximum distance to the actual position
+		void AddPosition(uint32_t sequence, int32_t id, const glm::dvec3& position, double precision = 0) {
+			EntityBaseline& baseline = GetEntity(id, sequence);
+			baseline.sentPosition = position;
+			baseline.sentPositionPrecision = precision;
+			sentSnapshots[sequence % SNAPSHOT_BASELINE_RING_SIZE].positions.emplace_back(id, position, precision);
+		}
+
+		void AddRotation(uint32_t sequence, int32_t id, const glm::quat& orientation) {
+			GetEntity(id, sequence).sentOrientation = orientation;
+			sentSnapshots[sequence % SNAPSHOT_BASELINE_RING_SIZE].rotations.emplace_back(id, orientation);
+		}
+
+		void AddVelocity(uint32_t sequence, int32_t id, const glm::vec3& velocity) {
+			GetEntity(id, sequence).sentVelocity = velocity;
+			sentSnapshots[sequence % SNAPSHOT_BASELINE_RING_SIZE].velocities.emplace_back(id, velocity);
+		}
+
+		// Bit n of mask acknowledges sequence latest-1-n
+		void Acknowledge(uint32_t latest, uint32_t mask) {
+			for (uint32_t i = 0; i <= SNAPSHOT_ACK_MASK_BITS; ++i) {
+				if (i > 0 && !(mask & (1u << (i-1)))) continue;
+				const uint32_t sequence = latest - i;
+				if (sequence == 0 || sequence >= nextSequence) continue;
+				SentSnapshot& snapshot = sentSnapshots[sequence % SNAPSHOT_BASELINE_RING_SIZE];
+				if (snapshot.sequence != sequence || snapshot.acked) continue;
+				snapshot.acked = true;
+				if (int32_t(sequence - lastAckedSequence) > 0) lastAckedSequence = sequence;
+				for (const auto&[id, position, precision] : snapshot.positions) {
+					auto it = entities.find(id);
+					if (it == entities.end()) continue;
+					EntityBaseline& baseline = it->second;
+					if (sequence < baseline.resetSequence) continue;
+					if (baseline.hasAckedPosition && sequence < baseline.ackedPositionSequence) continue;
+					baseline.hasAckedPosition = true;
+					baseline.ackedPositionSequence = sequence;
+					baseline.ackedPositionFrame = snapshot.frame;
+					baseline.ackedPosition = position;
+					baseline.ackedPositionPrecision = precision;
+				}
+				for (const auto&[id, orientation] : snapshot.rotations) {
+					auto it = entities.find(id);
+					if (it == entities.end()) continue;
+					EntityBaseline& baseline = it->second;
+					if (sequence < baseline.resetSequence) continue;
+					if (baseline.hasAckedRotation && sequence < baseline.ackedRotationSequence) continue;
+					baseline.hasAckedRotation = true;
+					baseline.ackedRotationSequence = sequence;
+					baseline.ackedRotationFrame = snapshot.frame;
+					baseline.ackedOrientation = orientation;
+				}
+				for (const auto&[id, velocity] : snapshot.velocities) {
+					auto it = entities.find(id);
+					if (it == entities.end()) continue;
+					EntityBaseline& baseline = it->second;
+					if (sequence < baseline.resetSequence) continue;
+					if (baseline.hasAckedVelocity && sequence < baseline.ackedVelocitySequence) continue;
+					baseline.hasAckedVelocity = true;
+					baseline.ackedVelocitySequence = sequence;
+					baseline.ackedVelocityFrame = snapshot.frame;
+					baseline.ackedVelocity = velocity;
+				}
+			}
+		}
+
+		// Forgets the baselines of an entity, for instance when its transform was sent to the client by other means or when it was removed
+		void Reset(int32_t id) {
+			entities.erase(id);
+		}
+
+		void Reset() {
+			entities.clear();
+			for (auto& snapshot : sentSnapshots) snapshot.sequence = 0;
+			lastAckedSequence = nextSequence - 1;
+		}
+	};
+
+	// Client-side record of the received burst sequences, sent back to the server as the latest sequence plus a mask of the ones before it
+	class DeltaAcks {
+		mutable std::mutex mu;
+		uint32_t latest = 0;
+		uint32_t mask = 0;
+	public:
+		void Received(uint32_t sequence) {
+			std::lock_guard lock(mu);
+			if (latest == 0) {
+				latest = sequence;
+				mask = 0;
+			} else if (int32_t(sequence - latest) > 0) {
+				// The previous latest sequence moves into the mask
+				const uint32_t shift = sequence - latest;
+				mask = (shift < SNAPSHOT_ACK_MASK_BITS)? (mask << shift) : 0;
+				if (shift <= SNAPSHOT_ACK_MASK_BITS) mask |= 1u << (shift - 1);
+				latest = sequence;
+			} else if (sequence != latest) {
+				const uint32_t age = latest - sequence;
+				if (age <= SNAPSHOT_ACK_MASK_BITS) mask |= 1u << (age - 1);
+			}
+		}
+
+		// Returns false when nothing was received yet
+		bool Get(uint32_t& latestSequence, uint32_t& previousMask) const {
+			std::lock_guard lock(mu);
+			latestSequence = latest;
+			previousMask = mask;
+			return latest != 0;
+		}
+
+		void Reset() {
+			std::lock_guard lock(mu);
+			latest = 0;
+			mask = 0;
+		}
+	};
+
+	// Calls sendBurst(uint32_t sequence, const std::vector<uint8_t>& packed) for each burst to send to a client for the given frame.
+	// entities must have the members id, worldPosition, position (relative to the base position of the bursts), orientation, distance and viewDot (see GetBurstPriorityRate).
+	// Only the fields that changed against the client's baselines are eligible, and the entities that have some accumulate priority until they are sent.
+	// Velocities are the ones estimated by priorities, they are sent as a field of their own so that entities moving in a straight line do not need to send theirs again.
+	// The entities with the highest accumulated priority are then packed together, in as few bursts as possible, until byteBudget bytes of packed data are used.
+	// Since the position range of a burst is that of its farthest entity, entities are only packed with others of a similar range (see SNAPSHOT_POSITION_RANGE_BAND), so that near entities keep a fine precision.
+	// baselines and priorities must be locked by the caller.
+	template<typename T, typename F>
+	void EncodeDeltaBursts(DeltaBaselines& baselines, BurstPriorityAccumulator& priorities, const std::vector<T>& entities, uint64_t frame, double timestamp, size_t maxBytes, size_t byteBudget, F&& sendBurst) {
+		baselines.BeginFrame(frame);
+		priorities.BeginFrame(frame, timestamp);
+		
+		struct Candidate {
+			double priority;
+			const T* entity;
+			uint8_t changeMask;
+			glm::vec3 velocity;
+		};
+		std::vector<Candidate> candidates {};
+		int32_t maxId = 0;
+		for (const T& entity : entities) {
+			glm::vec3 velocity = glm::vec3(priorities.Observe(entity.id, entity.worldPosition));
+			if (glm::dot(velocity, velocity) <= float(SNAPSHOT_VELOCITY_EPSILON*SNAPSHOT_VELOCITY_EPSILON)) velocity = glm::vec3(0);
+			uint8_t changeMask = 0;
+			if (baselines.PositionChanged(entity.id, entity.worldPosition)) changeMask |= SNAPSHOT_CHANGED_POSITION;
+			if (baselines.RotationChanged(entity.id, entity.orientation)) changeMask |= SNAPSHOT_CHANGED_ROTATION;
+			if (baselines.VelocityChanged(entity.id, velocity)) changeMask |= SNAPSHOT_CHANGED_VELOCITY;
+			if (changeMask) {
+				candidates.push_back({priorities.Accumulate(entity.id, entity.distance, entity.viewDot), &entity, changeMask, velocity});
+				maxId = std::max(maxId, entity.id);
+			} else {
+				priorities.UpToDate(entity.id);
+			}
+		}
+		priorities.EndFrame();
+		
+		// Greedy fill from a max-heap, only the entities that make it into this frame's budget get popped
+		const EntityTransform widestId {maxId, 0, {}, {}};
+		const int idBits = GetIdBits(&widestId, &widestId + 1);
+		const int64_t headerBits = SNAPSHOT_GROUP_HEADER_BITS;
+		const int64_t budgetBits = int64_t(byteBudget) * 8;
+		const int64_t minEntityBits = std::min({GetEntityTransformBits({0, SNAPSHOT_CHANGED_POSITION, {}, {}}, idBits), GetEntityTransformBits({0, SNAPSHOT_CHANGED_ROTATION, {}, {}}, idBits), GetEntityTransformBits({0, SNAPSHOT_CHANGED_VELOCITY, {}, {}}, idBits)});
+		const int64_t maxBurstBits = int64_t(maxBytes) * 8;
+		int64_t usedBits = 0;
+		// Bursts being filled, one per band of position ranges
+		struct Burst {
+			int64_t bits = 0;
+			size_t count = 0;
+		};
+		std::array<Burst, ((1 << SNAPSHOT_POSITION_EXPONENT_BITS) + SNAPSHOT_POSITION_RANGE_BAND - 1) / SNAPSHOT_POSITION_RANGE_BAND> bursts {};
+		auto getRangeBand = [](const EntityTransform& transform){
+			if (!(transform.changeMask & SNAPSHOT_CHANGED_POSITION)) return 0;
+			return (GetPositionRangeExponent(std::max({std::abs(transform.position.x), std::abs(transform.position.y), std::abs(transform.position.z)})) - SNAPSHOT_POSITION_MIN_EXPONENT) / SNAPSHOT_POSITION_RANGE_BAND;
+		};
+		auto higherPriority = [](const Candidate& a, const Candidate& b){return a.priority < b.priority;};
+		std::make_heap(candidates.begin(), candidates.end(), higherPriority);
+		struct Selected {
+			int rangeBand;
+			EntityTransform transform;
+			const T* entity;
+		};
+		std::vector<Selected> selected {};
+		for (auto heapEnd = candidates.end(); heapEnd != candidates.begin() && budgetBits - usedBits >= minEntityBits; ) {
+			std::pop_heap(candidates.begin(), heapEnd, higherPriority);
+			const Candidate& candidate = *--heapEnd;
+			const EntityTransform transform {candidate.entity->id, candidate.changeMask, candidate.entity->position, candidate.entity->orientation, candidate.velocity};
+			const int rangeBand = getRangeBand(transform);
+			Burst& burst = bursts[rangeBand];
+			// The header of each burst counts towards the budget too
+			const int64_t entityBits = GetEntityTransformBits(transform, idBits);
+			const bool newBurst = burst.count == 0 || burst.count == (1 << SNAPSHOT_COUNT_BITS) - 1 || burst.bits + entityBits > maxBurstBits;
+			const int64_t cost = entityBits + (newBurst? headerBits : 0);
+			if (usedBits + cost > budgetBits) continue; // a smaller one may still fit
+			usedBits += cost;
+			if (newBurst) {
+				burst.bits = headerBits;
+				burst.count = 0;
+			}
+			burst.bits += entityBits;
+			++burst.count;
+			selected.push_back({rangeBand, transform, candidate.entity});
+		}
+		
+		// Grouped by band, in order of priority within a band so that bursts are filled the same way as they were counted above
+		std::stable_sort(selected.begin(), selected.end(), [](const Selected& a, const Selected& b){return a.rangeBand < b.rangeBand;});
+		std::vector<EntityTransform> transforms {};
+		transforms.reserve(selected.size());
+		for (const auto& s : selected) transforms.push_back(s.transform);
+		
+		std::vector<uint8_t> packed {};
+		for (size_t written = 0; written < selected.size(); ) {
+			size_t bandEnd = written;
+			while (bandEnd < selected.size() && selected[bandEnd].rangeBand == selected[written].rangeBand) ++bandEnd;
+			packed.clear();
+			const size_t count = EncodeTransforms(transforms.data() + written, bandEnd - written, maxBytes, packed);
+			if (count == 0) break;
+			const int exponent = GetTransformsPositionExponent(transforms.data() + written, count);
+			const double precision = GetPositionMaxError(exponent) * std::sqrt(3.0);
+			const uint32_t sequence = baselines.BeginSnapshot();
+			for (size_t i = written; i < written + count; ++i) {
+				const EntityTransform& transform = transforms[i];
+				if (transform.changeMask & SNAPSHOT_CHANGED_POSITION) {
+					// The baseline is the position as decoded by the client, so that what it compares against is what the client actually has
+					const glm::dvec3 quantizationError = glm::dvec3(QuantizePosition(transform.position, exponent)) - glm::dvec3(transform.position);
+					baselines.AddPosition(sequence, transform.id, selected[i].entity->worldPosition + quantizationError, precision);
+				}
+				if (transform.changeMask & SNAPSHOT_CHANGED_ROTATION) baselines.AddRotation(sequence, transform.id, transform.orientation);
+				if (transform.changeMask & SNAPSHOT_CHANGED_VELOCITY) baselines.AddVelocity(sequence, transform.id, transform.velocity);
+				priorities.Sent(transform.id);
+			}
+			written += count;
+			sendBurst(sequence, packed);
+		}
+	}
+
+}
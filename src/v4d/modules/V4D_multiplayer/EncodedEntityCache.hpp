@@ -0,0 +1,70 @@
+#pragma once
+
+#include <v4d.h>
+#include <V4D_Mod.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "v4d/game/Entity.h"
+#include "v4d/game/ServerSideEntity.hpp"
+
+#include "common.hh"
+
+// Module streams of an entity as they were at a given iteration
+struct EncodedEntity {
+	ServerSideEntity::WeakPtr entity;
+	Entity::Iteration iteration;
+	v4d::data::WriteOnlyStream entityData {CUSTOM_ENTITY_DATA_INITIAL_STREAM_SIZE};
+	v4d::data::WriteOnlyStream transformData {CUSTOM_ENTITY_TRANSFORM_DATA_MAX_STREAM_SIZE};
+	std::once_flag encoded; // the streams are written by the first client that asks for them, outside of the cache lock
+	EncodedEntity(const ServerSideEntity::Ptr& entity, Entity::Iteration iteration) : entity(entity), iteration(iteration) {}
+};
+
+// Shared by all client send threads, so that the module streams of an entity are only encoded once per iteration, no matter how many clients are subscribed to it.
+// Client streams then copy the cached fragments instead of calling the module again.
+// The cache lock only covers the lookup, other clients asking for the same entity wait for its encoding while those asking for other entities do not.
+class EncodedEntityCache {
+	std::mutex mu;
+	std::unordered_map<Entity::Id, std::shared_ptr<EncodedEntity>> entities {};
+
+public:
+	// Returns the module streams of the entity at the given iteration, encoding them if this is the first client to ask for it
+	std::shared_ptr<EncodedEntity> Get(const ServerSideEntity::Ptr& entity, Entity::Iteration iteration) {
+		std::shared_ptr<EncodedEntity> encoded;
+		{
+			std::lock_guard lock(mu);
+			auto& cached = entities[entity->GetID()];
+			// A client that read the entity just before it was iterated may get the newer streams, it will receive another update for the newer iteration anyway
+			// Clients that still hold the previous fragment keep it alive until they are done with it
+			if (!cached || cached->iteration < iteration || cached->entity.lock() != entity) {
+				cached = std::make_shared<EncodedEntity>(entity, iteration);
+			}
+			encoded = cached;
+		}
+		std::call_once(encoded->encoded, [&entity, &encoded]{
+			if (auto mod = V4D_Mod::GetModule(entity->moduleID.String()); mod) {
+				if (mod->StreamSendEntityData) mod->StreamSendEntityData(entity->GetID(), entity->type, encoded->entityData);
+				if (mod->StreamSendEntityTransformData) mod->StreamSendEntityTransformData(entity->GetID(), entity->type, encoded->transformData);
+			}
+		});
+		return encoded;
+	}
+
+	// Forgets the entities that were destroyed
+	void Cleanup() {
+		std::lock_guard lock(mu);
+		for (auto it = entities.begin(); it != entities.end(); ) {
+			if (it->second->entity.expired()) {
+				it = entities.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	void Clear() {
+		std::lock_guard lock(mu);
+		entities.clear();
+	}
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <v4d.h>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+#include "v4d/game/Entity.h"
+#include "v4d/game/ServerSideEntity.hpp"
+
+// Server-side uniform grid of active entities, one per reference frame, used to find the entities a player should be subscribed to without walking all of them for every client.
+// Entities only move from one cell to another when the grid is refreshed, which is shared by all client threads and happens at most once per refresh interval.
+class InterestGrid {
+	struct TrackedEntity {
+		ServerSideEntity::WeakPtr entity;
+		Entity::ReferenceFrame referenceFrame;
+		glm::i64vec3 cell;
+		size_t indexInCell;
+		uint64_t generation;
+	};
+
+	double cellSize;
+	double invCellSize;
+	std::mutex mu;
+	double lastRefreshTimestamp = 0;
+	uint64_t generation = 0;
+	std::unordered_map<Entity::Id, TrackedEntity> trackedEntities {};
+	std::unordered_map<Entity::ReferenceFrame, std::unordered_map<uint64_t, std::vector<Entity::Id>>> frames {};
+
+	static inline uint64_t CellKey(const glm::i64vec3& cell) {
+		return (uint64_t(cell.x) * 73856093ull) ^ (uint64_t(cell.y) * 19349663ull) ^ (uint64_t(cell.z) * 83492791ull);
+	}
+
+	inline glm::i64vec3 Cell(const glm::dvec3& position) const {
+		return glm::i64vec3(glm::floor(position * invCellSize));
+	}
+
+	void Insert(Entity::Id id, TrackedEntity& tracked) {
+		auto& cellEntities = frames[tracked.referenceFrame][CellKey(tracked.cell)];
+		tracked.indexInCell = cellEntities.size();
+		cellEntities.push_back(id);
+	}
+
+	void Remove(const TrackedEntity& tracked) {
+		auto& cells = frames[tracked.referenceFrame];
+		auto cellIt = cells.find(CellKey(tracked.cell));
+		if (cellIt == cells.end()) return;
+		auto& cellEntities = cellIt->second;
+		// Swap with the last entity of the cell
+		if (tracked.indexInCell + 1 < cellEntities.size()) {
+			const Entity::Id movedId = cellEntities.back();
+			cellEntities[tracked.indexInCell] = movedId;
+			trackedEntities.at(movedId).indexInCell = tracked.indexInCell;
+		}
+		cellEntities.pop_back();
+		if (cellEntities.size() == 0) {
+			cells.erase(cellIt);
+			if (cells.size() == 0) frames.erase(tracked.referenceFrame);
+		}
+	}
+
+	// Only re-buckets the entities that changed cell or reference frame since the last refresh, and drops the ones that are no longer active
+	void Refresh() {
+		++generation;
+		ServerSideEntity::ForEach([this](ServerSideEntity::Ptr entity){
+			if (!entity->IsActive()) return;
+			const Entity::Id id = entity->GetID();
+			const glm::i64vec3 cell = Cell(entity->position);
+			auto [it, inserted] = trackedEntities.try_emplace(id);
+			TrackedEntity& tracked = it->second;
+			if (inserted) {
+				tracked.entity = entity;
+				tracked.referenceFrame = entity->referenceFrame;
+				tracked.cell = cell;
+				Insert(id, tracked);
+			} else if (tracked.referenceFrame != entity->referenceFrame || tracked.cell != cell || tracked.entity.expired()) {
+				Remove(tracked);
+				tracked.entity = entity;
+				tracked.referenceFrame = entity->referenceFrame;
+				tracked.cell = cell;
+				Insert(id, tracked);
+			}
+			tracked.generation = generation;
+		});
+		for (auto it = trackedEntities.begin(); it != trackedEntities.end(); ) {
+			if (it->second.generation != generation) {
+				Remove(it->second);
+				it = trackedEntities.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+public:
+	InterestGrid(double cellSize) : cellSize(cellSize), invCellSize(1.0 / cellSize) {}
+
+	// Called by every client thread before querying, only one of them actually refreshes the grid per interval
+	void RefreshIfNeeded(double interval) {
+		std::lock_guard lock(mu);
+		const double now = v4d::Timer::GetCurrentTimestamp();
+		if (now - lastRefreshTimestamp < interval) return;
+		lastRefreshTimestamp = now;
+		Refresh();
+	}
+
+	// Appends to entities all the active entities of the given reference frame that are within the given distance of the given position (as of the last refresh)
+	void Query(Entity::ReferenceFrame referenceFrame, const glm::dvec3& position, double distance, std::vector<ServerSideEntity::Ptr>& entities) {
+		std::lock_guard lock(mu);
+		auto frameIt = frames.find(referenceFrame);
+		if (frameIt == frames.end()) return;
+		const auto& cells = frameIt->second;
+		const glm::i64vec3 cellMin = Cell(position - distance);
+		const glm::i64vec3 cellMax = Cell(position + distance);
+		for (int64_t x = cellMin.x; x <= cellMax.x; ++x) {
+			for (int64_t y = cellMin.y; y <= cellMax.y; ++y) {
+				for (int64_t z = cellMin.z; z <= cellMax.z; ++z) {
+					const glm::i64vec3 cell {x,y,z};
+					auto cellIt = cells.find(CellKey(cell));
+					if (cellIt == cells.end()) continue;
+					for (const Entity::Id id : cellIt->second) {
+						const TrackedEntity& tracked = trackedEntities.at(id);
+						// Different cells may share the same key
+						if (tracked.cell != cell) continue;
+						if (auto entity = tracked.entity.lock(); entity && entity->IsActive() && entity->referenceFrame == referenceFrame) {
+							if (glm::length(entity->position - position) < distance) {
+								entities.push_back(entity);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void Clear() {
+		std::lock_guard lock(mu);
+		trackedEntities.clear();
+		frames.clear();
+		lastRefreshTimestamp = 0;
+	}
+};
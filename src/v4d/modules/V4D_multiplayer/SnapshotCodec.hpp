@@ -0,0 +1,311 @@
+#pragma once
+
+#include <v4d.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#define SNAPSHOT_POSITION_COMPONENT_BITS 16 // per axis, relative to the group's base position
+#define SNAPSHOT_POSITION_MIN_EXPONENT -8 // smallest position range is 2^-8 meters
+#define SNAPSHOT_POSITION_EXPONENT_BITS 6
+#define SNAPSHOT_ROTATION_COMPONENT_BITS 10 // for each of the three smallest quaternion components
+#define SNAPSHOT_VELOCITY_COMPONENT_BITS 10 // per axis, only used by clients to interpolate and extrapolate so it can be coarser than positions
+#define SNAPSHOT_VELOCITY_MIN_EXPONENT -4 // smallest velocity range is 2^-4 meters/second
+#define SNAPSHOT_VELOCITY_EXPONENT_BITS 5
+#define SNAPSHOT_COUNT_BITS 8
+#define SNAPSHOT_ID_BITS_BITS 5 // number of bits used to write the number of bits per entity id in a group
+#define SNAPSHOT_GROUP_HEADER_BITS (SNAPSHOT_COUNT_BITS + SNAPSHOT_ID_BITS_BITS + SNAPSHOT_POSITION_EXPONENT_BITS + SNAPSHOT_VELOCITY_EXPONENT_BITS)
+#define SNAPSHOT_CHANGE_MASK_BITS 3
+#define SNAPSHOT_CHANGED_POSITION 1
+#define SNAPSHOT_CHANGED_ROTATION 2
+#define SNAPSHOT_CHANGED_VELOCITY 4
+
+namespace networking::snapshot {
+
+	// Appends values of 1 to 32 bits to a byte buffer, least significant bits first
+	class BitWriter {
+		std::vector<uint8_t>& buffer;
+		uint64_t scratch = 0;
+		int scratchBits = 0;
+	public:
+		BitWriter(std::vector<uint8_t>& buffer) : buffer(buffer) {}
+		~BitWriter() {
+			Flush();
+		}
+
+		void Write(uint32_t value, int bits) {
+			scratch |= (uint64_t(value) & ((1ull << bits) - 1)) << scratchBits;
+			scratchBits += bits;
+			while (scratchBits >= 8) {
+				buffer.push_back(uint8_t(scratch));
+				scratch >>= 8;
+				scratchBits -= 8;
+			}
+		}
+
+		// Writes the remaining bits, padding the last byte with zeros
+		void Flush() {
+			if (scratchBits > 0) {
+				buffer.push_back(uint8_t(scratch));
+				scratch = 0;
+				scratchBits = 0;
+			}
+		}
+	};
+
+	// Reads values written by a BitWriter, reading past the end returns zeros and sets the overflow flag
+	class BitReader {
+		const uint8_t* data;
+		size_t size;
+		size_t bytePos = 0;
+		uint64_t scratch = 0;
+		int scratchBits = 0;
+		bool overflow = false;
+	public:
+		BitReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+		BitReader(const std::vector<uint8_t>& buffer) : data(buffer.data()), size(buffer.size()) {}
+
+		uint32_t Read(int bits) {
+			while (scratchBits < bits) {
+				if (bytePos < size) {
+					scratch |= uint64_t(data[bytePos++]) << scratchBits;
+				} else {
+					overflow = true;
+				}
+				scratchBits += 8;
+			}
+			const uint32_t value = uint32_t(scratch & ((1ull << bits) - 1));
+			scratch >>= bits;
+			scratchBits -= bits;
+			return value;
+		}
+
+		bool HasOverflowed() const {
+			return overflow;
+		}
+	};
+
+	#pragma region Quantization
+
+	// Step of a signed value in [-range, +range], from -maxQ to +maxQ
+	inline int64_t GetQuantizedStep(float value, float range, int64_t maxQ) {
+		const float normalized = std::isfinite(value)? (value / range) : 0.0f;
+		return std::clamp(int64_t(std::llround(double(normalized) * double(maxQ))), -maxQ, maxQ);
+	}
+
+	inline float GetQuantizedValue(int64_t step, float range, int64_t maxQ) {
+		return float(double(step) / double(maxQ) * double(range));
+	}
+
+	// Signed value in [-range, +range] written on the given number of bits, the error is at most half a step
+	inline void WriteQuantized(BitWriter& writer, float value, float range, int bits) {
+		const int64_t maxQ = (int64_t(1) << (bits - 1)) - 1;
+		writer.Write(uint32_t(GetQuantizedStep(value, range, maxQ) + maxQ), bits);
+	}
+
+	inline float ReadQuantized(BitReader& reader, float range, int bits) {
+		const int64_t maxQ = (int64_t(1) << (bits - 1)) - 1;
+		return GetQuantizedValue(int64_t(reader.Read(bits)) - maxQ, range, maxQ);
+	}
+
+	// The value that ReadQuantized returns once written with WriteQuantized
+	inline float Quantize(float value, float range, int bits) {
+		const int64_t maxQ = (int64_t(1) << (bits - 1)) - 1;
+		return GetQuantizedValue(GetQuantizedStep(value, range, maxQ), range, maxQ);
+	}
+
+	inline float GetQuantizationMaxError(float range, int bits) {
+		return range / float((int64_t(1) << (bits - 1)) - 1) * 0.5f;
+	}
+
+	// Smallest power of two that contains the given absolute value
+	inline int GetPositionRangeExponent(float maxAbsValue) {
+		const int maxExponent = SNAPSHOT_POSITION_MIN_EXPONENT + (1 << SNAPSHOT_POSITION_EXPONENT_BITS) - 1;
+		if (!std::isfinite(maxAbsValue)) return maxExponent;
+		int exponent = SNAPSHOT_POSITION_MIN_EXPONENT;
+		while (exponent < maxExponent && std::ldexp(1.0f, exponent) < maxAbsValue) ++exponent;
+		return exponent;
+	}
+
+	inline float GetPositionMaxError(int exponent) {
+		return GetQuantizationMaxError(std::ldexp(1.0f, exponent), SNAPSHOT_POSITION_COMPONENT_BITS);
+	}
+
+	inline void WritePosition(BitWriter& writer, const glm::vec3& position, int exponent) {
+		const float range = std::ldexp(1.0f, exponent);
+		WriteQuantized(writer, position.x, range, SNAPSHOT_POSITION_COMPONENT_BITS);
+		WriteQuantized(writer, position.y, range, SNAPSHOT_POSITION_COMPONENT_BITS);
+		WriteQuantized(writer, position.z, range, SNAPSHOT_POSITION_COMPONENT_BITS);
+	}
+
+	inline glm::vec3 ReadPosition(BitReader& reader, int exponent) {
+		const float range = std::ldexp(1.0f, exponent);
+		const float x = ReadQuantized(reader, range, SNAPSHOT_POSITION_COMPONENT_BITS);
+		const float y = ReadQuantized(reader, range, SNAPSHOT_POSITION_COMPONENT_BITS);
+		const float z = ReadQuantized(reader, range, SNAPSHOT_POSITION_COMPONENT_BITS);
+		return {x, y, z};
+	}
+
+	// The position that ReadPosition returns once written with WritePosition
+	inline glm::vec3 QuantizePosition(const glm::vec3& position, int exponent) {
+		const float range = std::ldexp(1.0f, exponent);
+		return {
+			Quantize(position.x, range, SNAPSHOT_POSITION_COMPONENT_BITS),
+			Quantize(position.y, range, SNAPSHOT_POSITION_COMPONENT_BITS),
+			Quantize(position.z, range, SNAPSHOT_POSITION_COMPONENT_BITS),
+		};
+	}
+
+	// Same as positions, with a range of its own for the whole group
+	inline int GetVelocityRangeExponent(float maxAbsValue) {
+		const int maxExponent = SNAPSHOT_VELOCITY_MIN_EXPONENT + (1 << SNAPSHOT_VELOCITY_EXPONENT_BITS) - 1;
+		if (!std::isfinite(maxAbsValue)) return maxExponent;
+		int exponent = SNAPSHOT_VELOCITY_MIN_EXPONENT;
+		while (exponent < maxExponent && std::ldexp(1.0f, exponent) < maxAbsValue) ++exponent;
+		return exponent;
+	}
+
+	inline float GetVelocityMaxError(int exponent) {
+		return GetQuantizationMaxError(std::ldexp(1.0f, exponent), SNAPSHOT_VELOCITY_COMPONENT_BITS);
+	}
+
+	inline void WriteVelocity(BitWriter& writer, const glm::vec3& velocity, int exponent) {
+		const float range = std::ldexp(1.0f, exponent);
+		WriteQuantized(writer, velocity.x, range, SNAPSHOT_VELOCITY_COMPONENT_BITS);
+		WriteQuantized(writer, velocity.y, range, SNAPSHOT_VELOCITY_COMPONENT_BITS);
+		WriteQuantized(writer, velocity.z, range, SNAPSHOT_VELOCITY_COMPONENT_BITS);
+	}
+
+	inline glm::vec3 ReadVelocity(BitReader& reader, int exponent) {
+		const float range = std::ldexp(1.0f, exponent);
+		const float x = ReadQuantized(reader, range, SNAPSHOT_VELOCITY_COMPONENT_BITS);
+		const float y = ReadQuantized(reader, range, SNAPSHOT_VELOCITY_COMPONENT_BITS);
+		const float z = ReadQuantized(reader, range, SNAPSHOT_VELOCITY_COMPONENT_BITS);
+		return {x, y, z};
+	}
+
+	// Smallest-three encoding: the largest component is dropped and recomputed from the others since the quaternion is normalized.
+	// The sign of the quaternion is flipped so that the dropped component is positive, which represents the same rotation.
+	// The remaining components are within ±1/sqrt(2).
+	inline void WriteQuaternion(BitWriter& writer, const glm::quat& orientation) {
+		const glm::quat q = glm::normalize(orientation);
+		const float components[4] {q.x, q.y, q.z, q.w};
+		int largest = 0;
+		for (int i = 1; i < 4; ++i) {
+			if (std::abs(components[i]) > std::abs(components[largest])) largest = i;
+		}
+		const float sign = components[largest] < 0? -1.0f : 1.0f;
+		writer.Write(uint32_t(largest), 2);
+		for (int i = 0; i < 4; ++i) if (i != largest) {
+			WriteQuantized(writer, components[i] * sign, float(M_SQRT1_2), SNAPSHOT_ROTATION_COMPONENT_BITS);
+		}
+	}
+
+	inline glm::quat ReadQuaternion(BitReader& reader) {
+		const int largest = int(reader.Read(2));
+		float components[4];
+		float sumSquares = 0;
+		for (int i = 0; i < 4; ++i) if (i != largest) {
+			components[i] = ReadQuantized(reader, float(M_SQRT1_2), SNAPSHOT_ROTATION_COMPONENT_BITS);
+			sumSquares += components[i] * components[i];
+		}
+		components[largest] = std::sqrt(std::max(0.0f, 1.0f - sumSquares));
+		return glm::normalize(glm::quat(components[3], components[0], components[1], components[2]));
+	}
+
+	#pragma endregion
+
+	#pragma region Grouped entities
+
+	// Only the fields flagged in changeMask are written
+	struct EntityTransform {
+		int32_t id;
+		uint8_t changeMask;
+		glm::vec3 position; // relative to the base position of the burst
+		glm::quat orientation;
+		glm::vec3 velocity {0}; // in meters/second
+	};
+
+	// Number of bits needed to write all ids in [begin, end), ids must be positive
+	inline int GetIdBits(const EntityTransform* begin, const EntityTransform* end) {
+		uint32_t maxId = 0;
+		for (const EntityTransform* it = begin; it != end; ++it) maxId = std::max(maxId, uint32_t(std::max(0, it->id)));
+		int bits = 1;
+		while (bits < 31 && (maxId >> bits) != 0) ++bits;
+		return bits;
+	}
+
+	inline int GetEntityTransformBits(const EntityTransform& entity, int idBits) {
+		int bits = idBits + SNAPSHOT_CHANGE_MASK_BITS;
+		if (entity.changeMask & SNAPSHOT_CHANGED_POSITION) bits += SNAPSHOT_POSITION_COMPONENT_BITS * 3;
+		if (entity.changeMask & SNAPSHOT_CHANGED_ROTATION) bits += 2 + SNAPSHOT_ROTATION_COMPONENT_BITS * 3;
+		if (entity.changeMask & SNAPSHOT_CHANGED_VELOCITY) bits += SNAPSHOT_VELOCITY_COMPONENT_BITS * 3;
+		return bits;
+	}
+
+	// Range exponent of the positions of a group, given by its farthest entity that has a position
+	inline int GetTransformsPositionExponent(const EntityTransform* entities, size_t count) {
+		float maxAbsValue = 0;
+		for (size_t i = 0; i < count; ++i) if (entities[i].changeMask & SNAPSHOT_CHANGED_POSITION) {
+			maxAbsValue = std::max({maxAbsValue, std::abs(entities[i].position.x), std::abs(entities[i].position.y), std::abs(entities[i].position.z)});
+		}
+		return GetPositionRangeExponent(maxAbsValue);
+	}
+
+	// Appends to buffer as many entities as fit in maxBytes, starting with the first one, and returns how many were written
+	inline size_t EncodeTransforms(const EntityTransform* entities, size_t count, size_t maxBytes, std::vector<uint8_t>& buffer) {
+		const int idBits = GetIdBits(entities, entities + count);
+		const int64_t maxBits = int64_t(maxBytes) * 8;
+		int64_t bits = SNAPSHOT_GROUP_HEADER_BITS;
+		size_t fitCount = 0;
+		while (fitCount < count && fitCount < (1 << SNAPSHOT_COUNT_BITS) - 1) {
+			const int entityBits = GetEntityTransformBits(entities[fitCount], idBits);
+			if (bits + entityBits > maxBits) break;
+			bits += entityBits;
+			++fitCount;
+		}
+		count = fitCount;
+
+		const int exponent = GetTransformsPositionExponent(entities, count);
+		float maxAbsVelocity = 0;
+		for (size_t i = 0; i < count; ++i) if (entities[i].changeMask & SNAPSHOT_CHANGED_VELOCITY) {
+			maxAbsVelocity = std::max({maxAbsVelocity, std::abs(entities[i].velocity.x), std::abs(entities[i].velocity.y), std::abs(entities[i].velocity.z)});
+		}
+		const int velocityExponent = GetVelocityRangeExponent(maxAbsVelocity);
+
+		BitWriter writer(buffer);
+		writer.Write(uint32_t(count), SNAPSHOT_COUNT_BITS);
+		writer.Write(uint32_t(idBits - 1), SNAPSHOT_ID_BITS_BITS);
+		writer.Write(uint32_t(exponent - SNAPSHOT_POSITION_MIN_EXPONENT), SNAPSHOT_POSITION_EXPONENT_BITS);
+		writer.Write(uint32_t(velocityExponent - SNAPSHOT_VELOCITY_MIN_EXPONENT), SNAPSHOT_VELOCITY_EXPONENT_BITS);
+		for (size_t i = 0; i < count; ++i) {
+			writer.Write(uint32_t(entities[i].id), idBits);
+			writer.Write(entities[i].changeMask, SNAPSHOT_CHANGE_MASK_BITS);
+			if (entities[i].changeMask & SNAPSHOT_CHANGED_POSITION) WritePosition(writer, entities[i].position, exponent);
+			if (entities[i].changeMask & SNAPSHOT_CHANGED_ROTATION) WriteQuaternion(writer, entities[i].orientation);
+			if (entities[i].changeMask & SNAPSHOT_CHANGED_VELOCITY) WriteVelocity(writer, entities[i].velocity, velocityExponent);
+		}
+		return count;
+	}
+
+	// Returns false if the buffer is truncated, fields that are not in an entity's changeMask are left as identity (or zero)
+	inline bool DecodeTransforms(const std::vector<uint8_t>& buffer, std::vector<EntityTransform>& entities) {
+		BitReader reader(buffer);
+		const size_t count = reader.Read(SNAPSHOT_COUNT_BITS);
+		const int idBits = int(reader.Read(SNAPSHOT_ID_BITS_BITS)) + 1;
+		const int exponent = int(reader.Read(SNAPSHOT_POSITION_EXPONENT_BITS)) + SNAPSHOT_POSITION_MIN_EXPONENT;
+		const int velocityExponent = int(reader.Read(SNAPSHOT_VELOCITY_EXPONENT_BITS)) + SNAPSHOT_VELOCITY_MIN_EXPONENT;
+		entities.reserve(entities.size() + count);
+		for (size_t i = 0; i < count; ++i) {
+			EntityTransform entity {int32_t(reader.Read(idBits)), uint8_t(reader.Read(SNAPSHOT_CHANGE_MASK_BITS)), glm::vec3(0), glm::quat(1,0,0,0), glm::vec3(0)};
+			if (entity.changeMask & SNAPSHOT_CHANGED_POSITION) entity.position = ReadPosition(reader, exponent);
+			if (entity.changeMask & SNAPSHOT_CHANGED_ROTATION) entity.orientation = ReadQuaternion(reader);
+			if (entity.changeMask & SNAPSHOT_CHANGED_VELOCITY) entity.velocity = ReadVelocity(reader, velocityExponent);
+			entities.push_back(entity);
+		}
+		return !reader.HasOverflowed();
+	}
+
+	#pragma endregion
+
+}
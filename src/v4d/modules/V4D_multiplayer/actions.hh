@@ -9,10 +9,17 @@ namespace networking::action {
 	const Action REMOVE_ENTITY = 2;
 	const Action UPDATE_ENTITY = 3;
 
+	// UPDATE_ENTITY change mask, only the flagged fields follow it
+	const uint8_t UPDATE_ENTITY_REFERENCE_FRAME = 1;
+	const uint8_t UPDATE_ENTITY_REFERENCE_FRAME_EXTRA = 2;
+	const uint8_t UPDATE_ENTITY_POSITION = 4;
+	const uint8_t UPDATE_ENTITY_ORIENTATION = 8;
+
 	// Burst streams only (TCP & UDP)
 	const Action SYNC_ENTITY_TRANSFORM = 16;
 	const Action SYNC_GROUPED_ENTITIES_POSITIONS_ROTATIONS = 17;
 	const Action SYNC_GROUPED_ENTITIES_POSITIONS = 18;
 	const Action SYNC_GROUPED_ENTITIES_ROTATIONS = 19;
+	const Action SNAPSHOT_ACK = 20; // client to server
 
 }
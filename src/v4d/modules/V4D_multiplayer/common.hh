@@ -1,4 +1,16 @@
 #pragma once
 
+#include <v4d.h>
+#include "v4d/game/PacketPool.hpp"
+
 #define CUSTOM_ENTITY_DATA_INITIAL_STREAM_SIZE 256 // anything between 128 and 768 should be safe and fast
 #define CUSTOM_ENTITY_TRANSFORM_DATA_MAX_STREAM_SIZE 254 // maximum of 254 because we do not want to use more than one byte for the stream size info (since in ZAP definition a size info of 255 means that we are expecting another 8 bytes for a full 64-bit size_t)
+
+#define CUSTOM_ACTION_PACKET_INITIAL_SIZE 64 // initial capacity of pooled action streams, they keep whatever they grew to when they are recycled
+
+// Action streams waiting to be sent to each client, and the pool they come from, returned by ModuleGetCustomPtr(CUSTOM_PTR_SERVER_ACTION_QUEUES) so that tools can monitor them
+#define CUSTOM_PTR_SERVER_ACTION_QUEUES 1
+struct ServerActionQueues {
+	PacketPool<v4d::data::WriteOnlyStream>& pool;
+	PacketQueues<v4d::data::WriteOnlyStream>& queues;
+};
@@ -1,20 +1,28 @@
 #include <v4d.h>
 #include <V4D_Mod.h>
+#include <unordered_set>
 
 #include "v4d/game/Entity.h"
 #include "v4d/game/ServerSideEntity.hpp"
 #include "v4d/game/ClientSideEntity.hpp"
 #include "v4d/game/ServerSidePlayer.hpp"
+#include "v4d/game/Game.h"
 
 #include "utilities/io/Logger.h"
 
 #include "common.hh"
 #include "actions.hh"
+#include "InterestGrid.hpp"
+#include "SnapshotCodec.hpp"
+#include "DeltaSnapshot.hpp"
+#include "BurstPriority.hpp"
+#include "EncodedEntityCache.hpp"
 #include "../V4D_flycam/common.hh"
 
 using namespace v4d::scene;
 using namespace v4d::networking;
 using namespace networking::action;
+namespace snapshot = networking::snapshot;
 using namespace v4d::modular;
 
 std::shared_ptr<ListeningServer> server = nullptr;
@@ -22,33 +30,65 @@ std::shared_ptr<OutgoingConnection> client = nullptr;
 Scene* scene = nullptr;
 v4d::graphics::Renderer* r = nullptr;
 
-std::recursive_mutex serverActionQueueMutex;
-std::unordered_map<uint64_t /* clientID */, std::queue<v4d::data::Stream>> serverActionQueuePerClient {};
+// Action streams are written directly into pooled packets, which are queued and sent without being copied in between
+PacketPool<v4d::data::WriteOnlyStream> serverActionPool {CUSTOM_ACTION_PACKET_INITIAL_SIZE};
+PacketQueues<v4d::data::WriteOnlyStream> serverActionQueuePerClient {};
 
-void EnqueueServerAction(ulong clientID, v4d::data::Stream& stream) {
-	std::lock_guard lock(serverActionQueueMutex);
-	serverActionQueuePerClient[clientID].emplace(stream);
+ServerActionQueues serverActionQueues {serverActionPool, serverActionQueuePerClient};
+
+void EnqueueServerAction(ulong clientID, const PacketPool<v4d::data::WriteOnlyStream>::Ref& packet) {
+	serverActionQueuePerClient.Push(clientID, packet);
 }
 
-inline const size_t BURST_SYNC_POSITIONS_PLUS_ROTATIONS_GROUP_SIZE = 14;
-inline const size_t BURST_SYNC_POSITIONS_GROUP_SIZE = 28; // max 28;
-inline const size_t BURST_SYNC_ROTATIONS_GROUP_SIZE = 24; // max 24;
+inline const size_t BURST_SYNC_PACKED_MAX_BYTES = 428; // bit-packed part of a grouped burst, leaves room for the module header, the action, the sequence number, the base position, the timestamp and the size of the packed data within APP_NETWORKING_BURST_BUFFER_MAXIMUM_SIZE
 inline const double ENTITY_SUBSCRIBE_MAX_DISTANCE = 10'000; // in meters
+inline const double INTEREST_GRID_REFRESH_INTERVAL = 1.0 / APP_NETWORKING_MAX_ACTION_STREAMS_PER_SECOND; // in seconds, the grid is shared by all clients so it only needs to be refreshed as often as each client sends its actions
+inline const double BURST_SYNC_SLEEPING_ENTITY_DURATION = 2.0; // in seconds, keep sending sleeping entities for a while so that their final transform reaches clients even if some bursts are lost
+inline const glm::dvec3 PLAYER_VIEW_FORWARD {0,0,-1}; // in the player entity's space, its orientation is the one of its view
 
 struct NearbyEntity {
 	int32_t id;
+	glm::dvec3 worldPosition;
 	glm::vec3 position;
 	glm::quat orientation;
 	double distance;
-	NearbyEntity(Entity::Id id, Entity::Position position, Entity::Orientation orientation, double distance)
+	double viewDot;
+	NearbyEntity(Entity::Id id, Entity::Position worldPosition, Entity::Position position, Entity::Orientation orientation, double distance, double viewDot)
 	: id(int32_t(id))
+	, worldPosition(worldPosition)
 	, position(position)
 	, orientation(orientation)
 	, distance(distance)
+	, viewDot(viewDot)
 	{}
 };
 
-float interpolationSpeed = 15.0;
+// Server side, what each client has acknowledged of the grouped bursts, and how long each entity has been waiting to be sent to it
+std::mutex deltaBaselinesMutex;
+std::unordered_map<uint64_t /* clientID */, std::shared_ptr<snapshot::DeltaBaselines>> deltaBaselinesPerClient {};
+std::unordered_map<uint64_t /* clientID */, std::shared_ptr<snapshot::BurstPriorityAccumulator>> burstPrioritiesPerClient {};
+
+std::shared_ptr<snapshot::DeltaBaselines> GetDeltaBaselines(uint64_t clientID) {
+	std::lock_guard lock(deltaBaselinesMutex);
+	auto& baselines = deltaBaselinesPerClient[clientID];
+	if (!baselines) baselines = std::make_shared<snapshot::DeltaBaselines>();
+	return baselines;
+}
+
+// Only used by the client's burst sender, under the lock of its baselines
+std::shared_ptr<snapshot::BurstPriorityAccumulator> GetBurstPriorities(uint64_t clientID) {
+	std::lock_guard lock(deltaBaselinesMutex);
+	auto& priorities = burstPrioritiesPerClient[clientID];
+	if (!priorities) priorities = std::make_shared<snapshot::BurstPriorityAccumulator>();
+	return priorities;
+}
+
+// Client side, grouped bursts received from the server, and the server time at which they were sent
+snapshot::DeltaAcks deltaAcks {};
+SnapshotClock burstClock {};
+
+InterestGrid interestGrid {ENTITY_SUBSCRIBE_MAX_DISTANCE};
+EncodedEntityCache encodedEntityCache {};
 
 V4D_MODULE_CLASS(V4D_Mod) {
 	
@@ -58,6 +98,13 @@ V4D_MODULE_CLASS(V4D_Mod) {
 		return -1000;
 	}
 	
+	V4D_MODULE_FUNC(void*, ModuleGetCustomPtr, int what) {
+		switch (what) {
+			case CUSTOM_PTR_SERVER_ACTION_QUEUES: return &serverActionQueues;
+		}
+		return nullptr;
+	}
+	
 	V4D_MODULE_FUNC(void, InitServer, std::shared_ptr<ListeningServer> _srv) {
 		server = _srv;
 	}
@@ -77,7 +124,16 @@ V4D_MODULE_CLASS(V4D_Mod) {
 	V4D_MODULE_FUNC(void, UnloadScene) {
 		ServerSidePlayer::ClearAll();
 		ServerSideEntity::ClearAll();
+		interestGrid.Clear();
+		encodedEntityCache.Clear();
+		serverActionQueuePerClient.Clear();
 		ClientSideEntity::ClearAll();
+		{
+			std::lock_guard lock(deltaBaselinesMutex);
+			deltaBaselinesPerClient.clear();
+			burstPrioritiesPerClient.clear();
+		}
+		deltaAcks.Reset();
 	}
 	
 	#pragma endregion
@@ -91,30 +147,45 @@ V4D_MODULE_CLASS(V4D_Mod) {
 		ServerSideEntity::CleanupOnThisThread();
 		ClientSideEntity::CleanupOnThisThread();
 		ServerSidePlayer::CleanupOnThisThread();
+		encodedEntityCache.Cleanup();
+		serverActionQueuePerClient.EraseIf([](uint64_t clientId){return !ServerSidePlayer::Get(clientId);});
+		{// Forget the baselines of disconnected clients
+			std::lock_guard lock(deltaBaselinesMutex);
+			for (auto it = deltaBaselinesPerClient.begin(); it != deltaBaselinesPerClient.end(); ) {
+				if (!ServerSidePlayer::Get(it->first)) {
+					it = deltaBaselinesPerClient.erase(it);
+				} else {
+					++it;
+				}
+			}
+			for (auto it = burstPrioritiesPerClient.begin(); it != burstPrioritiesPerClient.end(); ) {
+				if (!ServerSidePlayer::Get(it->first)) {
+					it = burstPrioritiesPerClient.erase(it);
+				} else {
+					++it;
+				}
+			}
+		}
 	}
 	
 	#pragma region Rendeering
 	
 	V4D_MODULE_FUNC(void, RenderFrame_BeforeUpdate) {
-		// Smoothly Interpolate position and orientation
-		double delta = r->deltaTime * interpolationSpeed;
-		ClientSideEntity::ForEach([&delta](ClientSideEntity::Ptr entity) {
-			if (entity->posInit) {
-				entity->position = glm::mix(entity->position, entity->targetPosition, delta);
-				entity->orientation = glm::slerp(entity->orientation, entity->targetOrientation, delta);
-			} else {
-				entity->position = entity->targetPosition;
-				entity->orientation = entity->targetOrientation;
-				entity->posInit = true;
-			}
-			
+		// Render entities slightly in the past, between the transforms received around that time
+		const double renderTime = burstClock.GetServerTime(v4d::Timer::GetCurrentTimestamp()) - GameConfig::interpolationDelay;
+		const double maxExtrapolation = GameConfig::maxExtrapolation;
+		ClientSideEntity::ForEach([renderTime, maxExtrapolation](ClientSideEntity::Ptr entity) {
+			entity->snapshots.Sample(renderTime, maxExtrapolation, entity->position, entity->orientation);
 			entity->UpdateRenderable();
 		});
 	}
 	
 	V4D_MODULE_FUNC(void, DrawUi2) {
 		#ifdef _ENABLE_IMGUI
-			ImGui::SliderFloat("Network interpolation smooth speed", &interpolationSpeed, 0.0f, 30.0f);
+			float interpolationDelay = float(GameConfig::interpolationDelay);
+			float maxExtrapolation = float(GameConfig::maxExtrapolation);
+			if (ImGui::SliderFloat("Network interpolation delay", &interpolationDelay, 0.0f, 0.5f)) GameConfig::interpolationDelay = interpolationDelay;
+			if (ImGui::SliderFloat("Network max extrapolation", &maxExtrapolation, 0.0f, 1.0f)) GameConfig::maxExtrapolation = maxExtrapolation;
 		#endif
 	}
 	
@@ -123,142 +194,164 @@ V4D_MODULE_CLASS(V4D_Mod) {
 	#pragma region Server
 	
 	V4D_MODULE_FUNC(void, ServerSendActions, v4d::io::SocketPtr stream, IncomingClientPtr client) {
-		v4d::data::WriteOnlyStream tmpStream(CUSTOM_ENTITY_DATA_INITIAL_STREAM_SIZE);
-		
 		// Player info
 		ServerSidePlayer::Ptr player = ServerSidePlayer::Get(client->id);
 		if (!player) return;
 		glm::dvec3 playerPosition {0,0,0};
 		uint64_t playerReferenceFrame = 0;
-		if (ServerSideEntity::Ptr playerEntity = player->GetServerSideEntity(); playerEntity) {
-			playerPosition = playerEntity->position;
-			playerReferenceFrame = playerEntity->referenceFrame;
+		
+		// For a player to be subscribed to an entity, it must be active, in the same reference frame, and within the maximum subscribe distance
+		std::vector<ServerSideEntity::Ptr> nearbyEntities {};
+		{// Entity fields are written by physics and entities may be deactivated at any time, they are only read with the lock held
+			auto serverSideLock = ServerSideEntity::GetLock();
+			if (ServerSideEntity::Ptr playerEntity = player->GetServerSideEntity(); playerEntity) {
+				playerPosition = playerEntity->position;
+				playerReferenceFrame = playerEntity->referenceFrame;
+			}
+			interestGrid.RefreshIfNeeded(INTEREST_GRID_REFRESH_INTERVAL);
+			interestGrid.Query(playerReferenceFrame, playerPosition, ENTITY_SUBSCRIBE_MAX_DISTANCE, nearbyEntities);
 		}
 		
-		auto serverSideLock = ServerSideEntity::GetLock();
+		std::unordered_set<Entity::Id> nearbyEntityIds {};
+		nearbyEntityIds.reserve(nearbyEntities.size());
 		
-		ServerSideEntity::ForEach([&stream, &client, &tmpStream, &player, &playerReferenceFrame, &playerPosition](ServerSideEntity::Ptr entity){
-			// For a player to be subscribed to an entity, it must be active, in the same reference frame, and within the maximum subscribe distance
-			if (entity->IsActive() && entity->referenceFrame == playerReferenceFrame && glm::length(entity->position - playerPosition) < ENTITY_SUBSCRIBE_MAX_DISTANCE) {
-				Entity::Iteration clientIteration = 0;
-				{
-					auto lock = player->GetSubscriptionLock();
-					try {
-						clientIteration = player->entitySubscriptions.at(entity->GetID()).iteration;
-					} catch (...) {
-						player->entitySubscriptions[entity->GetID()].entity = entity;
-					}
+		auto baselines = GetDeltaBaselines(client->id);
+		
+		for (auto& entity : nearbyEntities) {
+			// Fields read at once under the lock, the stream is then written without it
+			Entity::Iteration iteration;
+			Entity::ReferenceFrame referenceFrame;
+			Entity::ReferenceFrameExtra referenceFrameExtra;
+			Entity::Position position;
+			Entity::Orientation orientation;
+			bool isDynamic;
+			{
+				auto serverSideLock = ServerSideEntity::GetLock();
+				// Deactivated since the query, its subscription is removed below
+				if (!entity->IsActive()) continue;
+				iteration = entity->iteration;
+				referenceFrame = entity->referenceFrame;
+				referenceFrameExtra = entity->referenceFrameExtra;
+				position = entity->position;
+				orientation = entity->orientation;
+				isDynamic = entity->IsDynamic();
+			}
+			nearbyEntityIds.insert(entity->GetID());
+			Entity::Iteration clientIteration = 0;
+			EntitySubscription sent {};
+			{
+				auto lock = player->GetSubscriptionLock();
+				if (auto it = player->entitySubscriptions.find(entity->GetID()); it != player->entitySubscriptions.end()) {
+					clientIteration = it->second.iteration;
+					sent = it->second;
+				} else {
+					// Entered the player's interest area
+					player->entitySubscriptions[entity->GetID()].entity = entity;
 				}
-				if (entity->iteration > clientIteration) {
-					stream->Begin();
-						if (clientIteration == 0) {
-							// LOG_DEBUG("Server SendAction ADD_ENTITY for obj id " << obj->id << ", client " << client->id)
-							// Add
-							*stream << ADD_ENTITY;
-							*stream << entity->moduleID.vendor;
-							*stream << entity->moduleID.module;
-							*stream << entity->type;
-						} else {
-							// LOG_DEBUG("Server SendAction UPDATE_ENTITY for obj id " << obj->id << ", client " << client->id)
-							// Update
-							*stream << UPDATE_ENTITY;
-						}
-						*stream << entity->referenceFrame;
+			}
+			if (iteration > clientIteration) {
+				stream->Begin();
+					if (clientIteration == 0) {
+						// LOG_DEBUG("Server SendAction ADD_ENTITY for obj id " << obj->id << ", client " << client->id)
+						// Add
+						*stream << ADD_ENTITY;
+						*stream << entity->moduleID.vendor;
+						*stream << entity->moduleID.module;
+						*stream << entity->type;
+						*stream << referenceFrame;
 						*stream << entity->GetID();
-						*stream << entity->referenceFrameExtra;
-						*stream << entity->iteration;
-						*stream << entity->position;
-						*stream << entity->orientation;
-						
-						auto mod = V4D_Mod::GetModule(entity->moduleID.String());
-						
-						tmpStream.ClearWriteBuffer();
-						if (mod && mod->StreamSendEntityData) mod->StreamSendEntityData(entity->GetID(), entity->type, tmpStream);
-						stream->WriteStream(tmpStream);
-						
-						tmpStream.ClearWriteBuffer();
-						if (mod && mod->StreamSendEntityTransformData) mod->StreamSendEntityTransformData(entity->GetID(), entity->type, tmpStream);
-						stream->WriteStream(tmpStream);
-						
-					stream->End();
-					{
-						auto lock = player->GetSubscriptionLock();
-						player->entitySubscriptions[entity->GetID()].iteration = entity->iteration;
+						*stream << referenceFrameExtra;
+						*stream << iteration;
+						*stream << position;
+						*stream << orientation;
+					} else {
+						// LOG_DEBUG("Server SendAction UPDATE_ENTITY for obj id " << obj->id << ", client " << client->id)
+						// Update, only with the fields that changed since the last action sent for this entity
+						uint8_t changeMask = 0;
+						if (referenceFrame != sent.referenceFrame) changeMask |= UPDATE_ENTITY_REFERENCE_FRAME;
+						if (referenceFrameExtra != sent.referenceFrameExtra) changeMask |= UPDATE_ENTITY_REFERENCE_FRAME_EXTRA;
+						if (position != sent.position) changeMask |= UPDATE_ENTITY_POSITION;
+						if (orientation != sent.orientation) changeMask |= UPDATE_ENTITY_ORIENTATION;
+						*stream << UPDATE_ENTITY;
+						*stream << entity->GetID();
+						*stream << iteration;
+						*stream << changeMask;
+						if (changeMask & UPDATE_ENTITY_REFERENCE_FRAME) *stream << referenceFrame;
+						if (changeMask & UPDATE_ENTITY_REFERENCE_FRAME_EXTRA) *stream << referenceFrameExtra;
+						if (changeMask & UPDATE_ENTITY_POSITION) *stream << position;
+						if (changeMask & UPDATE_ENTITY_ORIENTATION) *stream << orientation;
 					}
+					
+					auto encoded = encodedEntityCache.Get(entity, iteration);
+					stream->WriteStream(encoded->entityData);
+					stream->WriteStream(encoded->transformData);
+					
+				stream->End();
+				{
+					auto lock = player->GetSubscriptionLock();
+					auto& subscription = player->entitySubscriptions[entity->GetID()];
+					subscription.iteration = iteration;
+					subscription.referenceFrame = referenceFrame;
+					subscription.referenceFrameExtra = referenceFrameExtra;
+					subscription.position = position;
+					subscription.orientation = orientation;
 				}
-				
-				// Dynamic entity?
-				auto lock = player->GetSubscriptionLock();
-				if (entity->IsDynamic()) {
-					player->dynamicEntitySubscriptions[entity->GetID()] = entity;
-				} else {
-					if (player->dynamicEntitySubscriptions.count(entity->GetID())) {
-						player->dynamicEntitySubscriptions.erase(entity->GetID());
-					}
+				{// The client's transform of this entity was overwritten by this action, its burst baselines are no longer valid
+					auto lock = baselines->GetLock();
+					baselines->Reset(entity->GetID());
 				}
-				
+			}
+			
+			// Dynamic entity?
+			auto lock = player->GetSubscriptionLock();
+			if (isDynamic) {
+				player->dynamicEntitySubscriptions[entity->GetID()] = entity;
 			} else {
-				auto lock = player->GetSubscriptionLock();
-				if (player->entitySubscriptions.count(entity->GetID())) {
-					v4d::data::WriteOnlyStream removeStream(8);
-						removeStream << REMOVE_ENTITY;
-						removeStream << entity->GetID();
-					EnqueueServerAction(client->id, removeStream);
-					player->entitySubscriptions.erase(entity->GetID());
-					if (player->dynamicEntitySubscriptions.count(entity->GetID())) {
-						player->dynamicEntitySubscriptions.erase(entity->GetID());
-					}
+				if (player->dynamicEntitySubscriptions.count(entity->GetID())) {
+					player->dynamicEntitySubscriptions.erase(entity->GetID());
 				}
 			}
-		});
+		}
 		
-		{// Remove subscriptions for destroyed entities
+		{// Remove subscriptions for entities that left the player's interest area, including the ones that were deactivated or destroyed
 			auto lock = player->GetSubscriptionLock();
 			for (auto it = player->entitySubscriptions.begin(); it != player->entitySubscriptions.end(); ) {
 				auto&[entityID, subscription] = *it;
-				if (subscription.entity.expired()) {
-					v4d::data::WriteOnlyStream removeStream(8);
-						removeStream << REMOVE_ENTITY;
-						removeStream << entityID;
-					EnqueueServerAction(client->id, removeStream);
+				if (nearbyEntityIds.count(entityID) == 0) {
+					auto removePacket = serverActionPool.Acquire();
+						*removePacket << REMOVE_ENTITY;
+						*removePacket << entityID;
+					EnqueueServerAction(client->id, removePacket);
+					player->dynamicEntitySubscriptions.erase(entityID);
+					{
+						auto baselinesLock = baselines->GetLock();
+						baselines->Reset(entityID);
+					}
 					it = player->entitySubscriptions.erase(it);
 				} else {
 					++it;
 				}
 			}
-			for (auto it = player->dynamicEntitySubscriptions.begin(); it != player->dynamicEntitySubscriptions.end(); ) {
-				auto&[entityID, weakEntity] = *it;
-				if (weakEntity.expired()) {
-					v4d::data::WriteOnlyStream removeStream(8);
-						removeStream << REMOVE_ENTITY;
-						removeStream << entityID;
-					EnqueueServerAction(client->id, removeStream);
-					it = player->dynamicEntitySubscriptions.erase(it);
-				} else {
-					++it;
-				}
-			}
 		}
 		
 		// Send queued action streams
-		std::lock_guard lock(serverActionQueueMutex);
-		auto& actionQueue = serverActionQueuePerClient[client->id];
-		while (actionQueue.size()) {
+		serverActionQueuePerClient.Drain(client->id, [&stream](v4d::data::WriteOnlyStream& packet){
 			// LOG_DEBUG("Server SendActionFromQueue for client " << client->id)
 			stream->Begin();
-				stream->EmplaceStream(actionQueue.front());
+				stream->EmplaceStream(packet);
 			stream->End();
-			actionQueue.pop();
-		}
+		});
 	}
 	
 	V4D_MODULE_FUNC(void, ServerSendBursts, v4d::io::SocketPtr stream, IncomingClientPtr client, uint64_t frame) {
 		ServerSidePlayer::Ptr player;
 		glm::dvec3 basePosition;
+		glm::dvec3 viewForward;
 		uint64_t referenceFrame;
 		if (player = ServerSidePlayer::Get(client->id); player) {
 			if (ServerSideEntity::Ptr playerEntity = player->GetServerSideEntity(); playerEntity) {
 				basePosition = playerEntity->position;
+				viewForward = playerEntity->orientation * PLAYER_VIEW_FORWARD;
 				referenceFrame = playerEntity->referenceFrame;
 				goto SendBursts;
 			}
@@ -267,72 +360,43 @@ V4D_MODULE_CLASS(V4D_Mod) {
 		
 		SendBursts:
 		
-			// Fill cache vector from subscribed entities and sort it by distance (closest first)
+			// Fill cache vector from subscribed entities, the order does not matter since they are picked by accumulated priority
 			std::vector<NearbyEntity> nearbyEntities {};
 			{
 				auto lock = player->GetSubscriptionLock();
 				nearbyEntities.reserve(player->dynamicEntitySubscriptions.size());
 				for (auto&[entityID, weakEntity] : player->dynamicEntitySubscriptions) {
 					if (auto entity = weakEntity.lock(); entity) {
+						if (entity->IsSleeping() && v4d::Timer::GetCurrentTimestamp() - entity->GetSleepTimestamp() > BURST_SYNC_SLEEPING_ENTITY_DURATION) continue;
 						if (entity->referenceFrame == referenceFrame) {
 							const double distance = glm::length(entity->position - basePosition);
 							nearbyEntities.emplace_back(
 								entityID,
+								entity->position,
 								entity->position - basePosition,
 								entity->orientation,
-								distance //TODO maybe take into account the bounding radius too so that when the player is inside a very big craft it can be considered to be closer than another object which the center is closer
+								distance, //TODO maybe take into account the bounding radius too so that when the player is inside a very big craft it can be considered to be closer than another object which the center is closer
+								distance > 0? glm::dot(viewForward, (entity->position - basePosition) / distance) : 1.0
 							);
 						}
 					}
 				}
 			}
-			std::sort(nearbyEntities.begin(), nearbyEntities.end(), [](const auto& a, const auto& b){return a.distance < b.distance;});
 			
-			{// Sync positions in groups of base N. First group of N is synced every frame, next group of N*2 is synced every 2 frames, next group of N*4 is synced every 4 frames, and so on...
-				int frameDivider = 1;
-				size_t start = 0;
-				size_t end = 0;
-				while (nearbyEntities.size() > end) {
-					start = end;
-					end = std::min(nearbyEntities.size(), start + BURST_SYNC_POSITIONS_GROUP_SIZE * frameDivider);
-					
+			{// Sync positions and rotations that changed since the baselines acknowledged by the client, highest accumulated priority first
+				auto baselines = GetDeltaBaselines(client->id);
+				auto priorities = GetBurstPriorities(client->id);
+				auto baselinesLock = baselines->GetLock();
+				const double timestamp = v4d::Timer::GetCurrentTimestamp();
+				snapshot::EncodeDeltaBursts(*baselines, *priorities, nearbyEntities, frame, timestamp, BURST_SYNC_PACKED_MAX_BYTES, size_t(std::max(0, GameConfig::burstBytesPerFrame)), [&stream, &basePosition, timestamp](uint32_t sequence, const std::vector<uint8_t>& packed){
 					stream->Begin();
-						*stream << SYNC_GROUPED_ENTITIES_POSITIONS;
-						
+						*stream << SYNC_GROUPED_ENTITIES_POSITIONS_ROTATIONS;
+						*stream << sequence;
 						*stream << glm::dvec3(basePosition);
-						for (size_t n = start; n < end; ++n) if (n % frameDivider == frame % frameDivider) {
-							*stream << nearbyEntities[n].id;
-							*stream << nearbyEntities[n].position;
-						}
-						*stream << (int32_t)-1;
-						
+						*stream << timestamp;
+						*stream << packed;
 					stream->End();
-					
-					frameDivider *= 2;
-				}
-			}
-			
-			{// Sync rotations in groups of base N, half as often as positions. First group of N*2 is synced every 2 frames, next group of N*4 is synced every 4 frames, next group of N*8 is synced every 8 frames, and so on...
-				int frameDivider = 2;
-				size_t start = 0;
-				size_t end = 0;
-				while (nearbyEntities.size() > end) {
-					start = end;
-					end = std::min(nearbyEntities.size(), start + BURST_SYNC_ROTATIONS_GROUP_SIZE * frameDivider);
-					
-					stream->Begin();
-						*stream << SYNC_GROUPED_ENTITIES_ROTATIONS;
-						
-						for (size_t n = start; n < end; ++n) if (n % frameDivider == frame % frameDivider) {
-							*stream << nearbyEntities[n].id;
-							*stream << nearbyEntities[n].orientation;
-						}
-						*stream << (int32_t)-1;
-						
-					stream->End();
-					
-					frameDivider *= 2;
-				}
+				});
 			}
 			
 		
@@ -360,6 +424,23 @@ V4D_MODULE_CLASS(V4D_Mod) {
 		// });
 	}
 	
+	V4D_MODULE_FUNC(void, ServerReceiveBurst, v4d::io::SocketPtr stream, IncomingClientPtr client) {
+		auto action = stream->Read<Action>();
+		switch (action) {
+			case SNAPSHOT_ACK:{
+				auto latest = stream->Read<uint32_t>();
+				auto mask = stream->Read<uint32_t>();
+				auto baselines = GetDeltaBaselines(client->id);
+				auto lock = baselines->GetLock();
+				baselines->Acknowledge(latest, mask);
+			}break;
+			
+			default: 
+				LOG_ERROR("Server ReceiveBurst UNRECOGNIZED MODULE ACTION " << std::to_string((int)action))
+			break;
+		}
+	}
+	
 	#pragma endregion
 	
 	#pragma region Client
@@ -399,12 +480,17 @@ V4D_MODULE_CLASS(V4D_Mod) {
 				}
 			}break;
 			case UPDATE_ENTITY:{
-				auto referenceFrame = stream->Read<Entity::ReferenceFrame>();
 				auto id = stream->Read<Entity::Id>();
-				auto referenceFrameExtra = stream->Read<Entity::ReferenceFrameExtra>();
 				auto iteration = stream->Read<Entity::Iteration>();
-				auto position = stream->Read<Entity::Position>();
-				auto orientation = stream->Read<Entity::Orientation>();
+				auto changeMask = stream->Read<uint8_t>();
+				Entity::ReferenceFrame referenceFrame {};
+				Entity::ReferenceFrameExtra referenceFrameExtra {};
+				Entity::Position position {};
+				Entity::Orientation orientation {};
+				if (changeMask & UPDATE_ENTITY_REFERENCE_FRAME) referenceFrame = stream->Read<Entity::ReferenceFrame>();
+				if (changeMask & UPDATE_ENTITY_REFERENCE_FRAME_EXTRA) referenceFrameExtra = stream->Read<Entity::ReferenceFrameExtra>();
+				if (changeMask & UPDATE_ENTITY_POSITION) position = stream->Read<Entity::Position>();
+				if (changeMask & UPDATE_ENTITY_ORIENTATION) orientation = stream->Read<Entity::Orientation>();
 				auto tmpStream1 = stream->ReadStream();
 				auto tmpStream2 = stream->ReadStream();
 				
@@ -412,11 +498,19 @@ V4D_MODULE_CLASS(V4D_Mod) {
 				
 				ClientSideEntity::Ptr entity = ClientSideEntity::Get(id);
 				if (entity) {
-					entity->referenceFrame = referenceFrame;
-					entity->referenceFrameExtra = referenceFrameExtra;
-					entity->iteration = iteration;
-					entity->targetPosition = position;
-					entity->targetOrientation = orientation;
+					{// Same lock as the burst thread pushing snapshots and the rendering thread sampling them
+						auto entitiesLock = ClientSideEntity::GetLock();
+						if (changeMask & UPDATE_ENTITY_REFERENCE_FRAME) entity->referenceFrame = referenceFrame;
+						if (changeMask & UPDATE_ENTITY_REFERENCE_FRAME_EXTRA) entity->referenceFrameExtra = referenceFrameExtra;
+						entity->iteration = iteration;
+						// The transform was changed by an action rather than by motion, it does not get interpolated
+						if (changeMask & (UPDATE_ENTITY_POSITION | UPDATE_ENTITY_ORIENTATION)) {
+							entity->snapshots.Reset(
+								(changeMask & UPDATE_ENTITY_POSITION)? position : entity->position,
+								(changeMask & UPDATE_ENTITY_ORIENTATION)? orientation : entity->orientation
+							);
+						}
+					}
 					
 					auto* mod = V4D_Mod::GetModule(entity->moduleID.String());
 					if (mod) {
@@ -466,41 +560,28 @@ V4D_MODULE_CLASS(V4D_Mod) {
 			// }break;
 			
 			case SYNC_GROUPED_ENTITIES_POSITIONS_ROTATIONS:{
+				auto sequence = stream->Read<uint32_t>();
 				glm::dvec3 basePosition = stream->Read<glm::dvec3>();
-				auto entitiesLock = ClientSideEntity::GetLock();
-				for (;;) {
-					auto id = Entity::Id(stream->Read<int32_t>());
-					if (id < 0) break;
-					auto position = Entity::Position(stream->Read<glm::vec3>());
-					auto orientation = Entity::Orientation(stream->Read<glm::quat>());
-					if (ClientSideEntity::Ptr entity = ClientSideEntity::Get(id); entity) {
-						entity->targetPosition = position + basePosition;
-						entity->targetOrientation = orientation;
-					}
-				}
-			}break;
-			
-			case SYNC_GROUPED_ENTITIES_POSITIONS:{
-				glm::dvec3 basePosition = stream->Read<glm::dvec3>();
-				auto entitiesLock = ClientSideEntity::GetLock();
-				for (;;) {
-					auto id = Entity::Id(stream->Read<int32_t>());
-					if (id < 0) break;
-					auto position = Entity::Position(stream->Read<glm::vec3>());
-					if (ClientSideEntity::Ptr entity = ClientSideEntity::Get(id); entity) {
-						entity->targetPosition = position + basePosition;
-					}
+				auto timestamp = stream->Read<double>();
+				auto packed = stream->Read<std::vector<uint8_t>>();
+				std::vector<snapshot::EntityTransform> group {};
+				if (!snapshot::DecodeTransforms(packed, group)) {
+					LOG_ERROR("Client ReceiveBurst SYNC_GROUPED_ENTITIES_POSITIONS_ROTATIONS : truncated burst")
+					break;
 				}
-			}break;
-			
-			case SYNC_GROUPED_ENTITIES_ROTATIONS:{
+				deltaAcks.Received(sequence);
+				burstClock.Received(timestamp, v4d::Timer::GetCurrentTimestamp());
 				auto entitiesLock = ClientSideEntity::GetLock();
-				for (;;) {
-					auto id = Entity::Id(stream->Read<int32_t>());
-					if (id < 0) break;
-					auto orientation = Entity::Orientation(stream->Read<glm::quat>());
-					if (ClientSideEntity::Ptr entity = ClientSideEntity::Get(id); entity) {
-						entity->targetOrientation = orientation;
+				for (const auto& transform : group) {
+					if (ClientSideEntity::Ptr entity = ClientSideEntity::Get(transform.id); entity) {
+						const Entity::Position position = Entity::Position(transform.position) + basePosition;
+						const glm::dvec3 velocity = glm::dvec3(transform.velocity);
+						const Entity::Orientation orientation = Entity::Orientation(transform.orientation);
+						entity->snapshots.Push(timestamp,
+							(transform.changeMask & SNAPSHOT_CHANGED_POSITION)? &position : nullptr,
+							(transform.changeMask & SNAPSHOT_CHANGED_VELOCITY)? &velocity : nullptr,
+							(transform.changeMask & SNAPSHOT_CHANGED_ROTATION)? &orientation : nullptr
+						);
 					}
 				}
 			}break;
@@ -511,6 +592,18 @@ V4D_MODULE_CLASS(V4D_Mod) {
 		}
 	}
 	
+	V4D_MODULE_FUNC(void, ClientSendBursts, v4d::io::SocketPtr stream) {
+		// Acknowledge the grouped bursts received from the server
+		uint32_t latest, mask;
+		if (deltaAcks.Get(latest, mask)) {
+			stream->Begin();
+				*stream << SNAPSHOT_ACK;
+				*stream << latest;
+				*stream << mask;
+			stream->End();
+		}
+	}
+	
 	#pragma endregion
 	
 };
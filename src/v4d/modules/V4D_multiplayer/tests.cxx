@@ -0,0 +1,561 @@
+#include <v4d.h>
+
+#include "utilities/io/Logger.h"
+
+#include "v4d/game/random.hh"
+#include "SnapshotCodec.hpp"
+#include "DeltaSnapshot.hpp"
+#include "v4d/game/PacketPool.hpp"
+#include "v4d/game/SnapshotInterpolation.hpp"
+
+#include <thread>
+
+namespace v4d::tests {
+
+	int MULTIPLAYER_BITPACKING() {
+		std::vector<uint8_t> buffer {};
+		{
+			networking::snapshot::BitWriter writer(buffer);
+			writer.Write(1, 1);
+			writer.Write(0x5, 3);
+			writer.Write(0xABCDE, 20);
+			writer.Write(0xFFFFFFFF, 32);
+			writer.Write(0, 7);
+			writer.Write(0x7F, 7);
+		}
+		if (buffer.size() != 9) { // 70 bits
+			LOG_ERROR("BitWriter wrote " << buffer.size() << " bytes instead of 9")
+			return 1;
+		}
+		networking::snapshot::BitReader reader(buffer);
+		if (reader.Read(1) != 1) return 2;
+		if (reader.Read(3) != 0x5) return 3;
+		if (reader.Read(20) != 0xABCDE) return 4;
+		if (reader.Read(32) != 0xFFFFFFFF) return 5;
+		if (reader.Read(7) != 0) return 6;
+		if (reader.Read(7) != 0x7F) return 7;
+		if (reader.HasOverflowed()) return 8;
+		reader.Read(8);
+		if (!reader.HasOverflowed()) return 9;
+		return 0;
+	}
+
+	int MULTIPLAYER_SNAPSHOT_POSITIONS() {
+		using networking::snapshot::EntityTransform;
+		uint seed = 1;
+		for (float range : {0.001f, 1.0f, 100.0f, 10'000.0f, 1e7f}) {
+			std::vector<EntityTransform> entities {};
+			for (int32_t i = 0; i < 40; ++i) {
+				entities.push_back({int32_t(RandomInt(seed) % 5000), SNAPSHOT_CHANGED_POSITION, RandomInUnitCube(seed) * range, glm::quat(1,0,0,0)});
+			}
+			std::vector<uint8_t> buffer {};
+			const size_t count = networking::snapshot::EncodeTransforms(entities.data(), entities.size(), 436, buffer);
+			if (count != entities.size()) {
+				LOG_ERROR("EncodeTransforms only fit " << count << " positions out of " << entities.size())
+				return 1;
+			}
+			if (buffer.size() > 436) return 2;
+			std::vector<EntityTransform> decoded {};
+			if (!networking::snapshot::DecodeTransforms(buffer, decoded) || decoded.size() != count) return 3;
+			float maxAbsValue = 0;
+			for (auto& e : entities) maxAbsValue = std::max({maxAbsValue, std::abs(e.position.x), std::abs(e.position.y), std::abs(e.position.z)});
+			const float maxError = networking::snapshot::GetPositionMaxError(networking::snapshot::GetPositionRangeExponent(maxAbsValue));
+			// The error bound must scale with the range of the group, within a factor of 2 since the range is a power of two
+			if (maxError > std::max(maxAbsValue, 1.0f/256) / 32767.0f) return 4;
+			for (size_t i = 0; i < count; ++i) {
+				if (decoded[i].id != entities[i].id || decoded[i].changeMask != SNAPSHOT_CHANGED_POSITION) return 5;
+				const glm::vec3 error = glm::abs(decoded[i].position - entities[i].position);
+				if (std::max({error.x, error.y, error.z}) > maxError * 1.001f) {
+					LOG_ERROR("Position error " << std::max({error.x, error.y, error.z}) << " exceeds " << maxError << " for range " << range)
+					return 6;
+				}
+			}
+		}
+		{// Groups that do not fit in one burst are split
+			std::vector<EntityTransform> entities(200, {123456, SNAPSHOT_CHANGED_POSITION | SNAPSHOT_CHANGED_ROTATION, glm::vec3(1), glm::quat(1,0,0,0)});
+			std::vector<uint8_t> buffer {};
+			const size_t count = networking::snapshot::EncodeTransforms(entities.data(), entities.size(), 436, buffer);
+			if (count == 0 || count >= entities.size() || buffer.size() > 436) return 7;
+		}
+		return 0;
+	}
+
+	int MULTIPLAYER_SNAPSHOT_ROTATIONS() {
+		using networking::snapshot::EntityTransform;
+		uint seed = 2;
+		std::vector<EntityTransform> entities {};
+		for (int32_t i = 0; i < 76; ++i) {
+			glm::quat q = glm::normalize(glm::quat(RandomFloat(seed)*2-1, RandomFloat(seed)*2-1, RandomFloat(seed)*2-1, RandomFloat(seed)*2-1));
+			entities.push_back({i, SNAPSHOT_CHANGED_ROTATION, glm::vec3(0), q});
+		}
+		// Edge cases: identity, negated identity, and two equal largest components
+		entities.push_back({76, SNAPSHOT_CHANGED_ROTATION, glm::vec3(0), glm::quat(1,0,0,0)});
+		entities.push_back({77, SNAPSHOT_CHANGED_ROTATION, glm::vec3(0), glm::quat(-1,0,0,0)});
+		entities.push_back({78, SNAPSHOT_CHANGED_ROTATION, glm::vec3(0), glm::normalize(glm::quat(1,1,0,0))});
+		// Mixed change masks in the same group
+		entities.push_back({79, SNAPSHOT_CHANGED_POSITION | SNAPSHOT_CHANGED_ROTATION | SNAPSHOT_CHANGED_VELOCITY, glm::vec3(1,2,3), glm::normalize(glm::quat(1,2,3,4)), glm::vec3(3,-4,5)});
+
+		std::vector<uint8_t> buffer {};
+		const size_t count = networking::snapshot::EncodeTransforms(entities.data(), entities.size(), 436, buffer);
+		if (count != entities.size()) {
+			LOG_ERROR("EncodeTransforms only fit " << count << " rotations out of " << entities.size())
+			return 1;
+		}
+		std::vector<EntityTransform> decoded {};
+		if (!networking::snapshot::DecodeTransforms(buffer, decoded) || decoded.size() != count) return 2;
+		for (size_t i = 0; i < count; ++i) {
+			if (decoded[i].id != entities[i].id || decoded[i].changeMask != entities[i].changeMask) return 3;
+			// q and -q are the same rotation
+			const float dot = std::abs(glm::dot(decoded[i].orientation, entities[i].orientation));
+			const float angle = 2.0f * std::acos(std::min(1.0f, dot));
+			if (angle > 0.005f) {
+				LOG_ERROR("Rotation error of " << angle << " radians for entity " << i)
+				return 4;
+			}
+		}
+		if (glm::length(decoded.back().position - glm::vec3(1,2,3)) > 0.001f) return 5;
+		const glm::vec3 velocityError = glm::abs(decoded.back().velocity - glm::vec3(3,-4,5));
+		if (std::max({velocityError.x, velocityError.y, velocityError.z}) > networking::snapshot::GetVelocityMaxError(networking::snapshot::GetVelocityRangeExponent(5)) * 1.001f) return 6;
+		return 0;
+	}
+
+	// Server and client exchanging delta bursts in memory, with some bursts and acknowledgements lost
+	int MULTIPLAYER_DELTA_SNAPSHOT_LOOPBACK() {
+		using namespace networking::snapshot;
+		struct LoopbackEntity {
+			int32_t id;
+			glm::dvec3 worldPosition;
+			glm::vec3 position;
+			glm::quat orientation;
+			double distance;
+			double viewDot;
+		};
+		const int entityCount = 1000;
+		const int movingEntityCount = 20;
+		const int framesPerSecond = 25;
+		const int movingFrames = framesPerSecond * 20;
+		const int idleFrames = framesPerSecond * 10;
+		const size_t burstOverheadBytes = 1/*action*/ + 4/*sequence*/ + 24/*base position*/ + 8/*timestamp*/ + 9/*packed size*/;
+
+		uint seed = 3;
+		std::vector<LoopbackEntity> serverEntities {};
+		for (int32_t i = 0; i < entityCount; ++i) {
+			const glm::dvec3 position = glm::dvec3(RandomInUnitCube(seed)) * 1000.0;
+			serverEntities.push_back({i, position, glm::vec3(position), glm::normalize(glm::quat(RandomFloat(seed)*2-1, RandomFloat(seed)*2-1, RandomFloat(seed)*2-1, RandomFloat(seed)*2-1)), glm::length(position), 1.0});
+		}
+		std::vector<LoopbackEntity> clientEntities = serverEntities;
+		for (auto& entity : clientEntities) {
+			entity.worldPosition = glm::dvec3(0);
+			entity.orientation = glm::quat(1,0,0,0);
+		}
+
+		DeltaBaselines deltaBaselines {};
+		DeltaBaselines fullBaselines {}; // never acknowledged, so it always sends everything that fits in the budget
+		BurstPriorityAccumulator deltaPriorities {};
+		BurstPriorityAccumulator fullPriorities {};
+		DeltaAcks acks {};
+		size_t deltaBytes = 0;
+		size_t fullBytes = 0;
+		size_t bursts = 0;
+
+		for (uint64_t frame = 0; frame < movingFrames + idleFrames; ++frame) {
+			if (frame < movingFrames) {
+				for (int i = 0; i < movingEntityCount; ++i) {
+					auto& entity = serverEntities[i * (entityCount / movingEntityCount)];
+					entity.worldPosition += glm::dvec3(0.1, 0.05, 0);
+					entity.position = glm::vec3(entity.worldPosition);
+					entity.distance = glm::length(entity.worldPosition);
+					entity.orientation = glm::normalize(entity.orientation * glm::quat(0.9999f, 0.01f, 0, 0));
+				}
+			}
+			const double timestamp = double(frame) / framesPerSecond;
+			EncodeDeltaBursts(deltaBaselines, deltaPriorities, serverEntities, frame, timestamp, 436, 1308, [&](uint32_t sequence, const std::vector<uint8_t>& packed){
+				if (frame < movingFrames) deltaBytes += packed.size() + burstOverheadBytes;
+				if (++bursts % 7 == 0) return; // lost
+				std::vector<EntityTransform> group {};
+				if (!DecodeTransforms(packed, group)) return;
+				acks.Received(sequence);
+				for (const auto& transform : group) {
+					if (transform.changeMask & SNAPSHOT_CHANGED_POSITION) clientEntities[transform.id].worldPosition = glm::dvec3(transform.position);
+					if (transform.changeMask & SNAPSHOT_CHANGED_ROTATION) clientEntities[transform.id].orientation = transform.orientation;
+				}
+			});
+			if (frame < movingFrames) {
+				EncodeDeltaBursts(fullBaselines, fullPriorities, serverEntities, frame, timestamp, 436, 1308, [&](uint32_t, const std::vector<uint8_t>& packed){
+					fullBytes += packed.size() + burstOverheadBytes;
+				});
+			}
+			uint32_t latest, mask;
+			if (frame % 5 != 0 && acks.Get(latest, mask)) { // every 5th acknowledgement is lost
+				deltaBaselines.Acknowledge(latest, mask);
+			}
+		}
+
+		const double seconds = double(movingFrames) / framesPerSecond;
+		LOG("Delta snapshots with " << entityCount << " entities of which " << movingEntityCount << " are moving: " << size_t(deltaBytes / seconds) << " bytes/s, instead of " << size_t(fullBytes / seconds) << " bytes/s without baselines")
+		if (deltaBytes * 4 > fullBytes) {
+			LOG_ERROR("Delta snapshots are not small enough")
+			return 1;
+		}
+
+		// Once everything is idle, the client must have converged to the server state, within quantization error
+		for (int i = 0; i < entityCount; ++i) {
+			const double positionError = glm::length(clientEntities[i].worldPosition - serverEntities[i].worldPosition);
+			const float dot = std::abs(glm::dot(clientEntities[i].orientation, serverEntities[i].orientation));
+			if (positionError > 0.05 || dot < 0.9999f) {
+				LOG_ERROR("Entity " << i << " did not converge, position error " << positionError << ", rotation dot " << dot)
+				return 2;
+			}
+		}
+		return 0;
+	}
+
+	// A fast entity far away must not starve behind many slow ones close to the player, and each frame must stay within its budget
+	int MULTIPLAYER_BURST_PRIORITY() {
+		using namespace networking::snapshot;
+		struct PriorityEntity {
+			int32_t id;
+			glm::dvec3 worldPosition;
+			glm::vec3 position;
+			glm::quat orientation;
+			double distance;
+			double viewDot;
+		};
+		const int nearEntityCount = 300;
+		const int frames = 100;
+		const double framesPerSecond = 25;
+		const size_t byteBudget = 436;
+		
+		uint seed = 4;
+		std::vector<PriorityEntity> entities {};
+		for (int32_t i = 0; i < nearEntityCount; ++i) {
+			const glm::dvec3 position = glm::dvec3(RandomInUnitCube(seed)) * 50.0;
+			entities.push_back({i, position, glm::vec3(position), glm::quat(1,0,0,0), glm::length(position), 1.0});
+		}
+		const int32_t farId = nearEntityCount;
+		entities.push_back({farId, glm::dvec3(3000,0,0), glm::vec3(3000,0,0), glm::quat(1,0,0,0), 3000.0, 1.0});
+		
+		DeltaBaselines baselines {};
+		BurstPriorityAccumulator priorities {};
+		std::vector<int> sentCount(entities.size(), 0);
+		int64_t lastFarFrame = -1;
+		int64_t maxFarGap = 0;
+		bool nearPositionErrors = false;
+		for (uint64_t frame = 0; frame < frames; ++frame) {
+			for (auto& entity : entities) {
+				// Near entities move at 1.25 m/s, the far one at 300 m/s
+				entity.worldPosition += (entity.id == farId)? glm::dvec3(0, 12, 0) : glm::dvec3(0.05, 0, 0);
+				entity.position = glm::vec3(entity.worldPosition);
+				entity.distance = glm::length(entity.worldPosition);
+			}
+			size_t frameBytes = 0;
+			EncodeDeltaBursts(baselines, priorities, entities, frame, frame / framesPerSecond, 436, byteBudget, [&](uint32_t sequence, const std::vector<uint8_t>& packed){
+				frameBytes += packed.size();
+				std::vector<EntityTransform> group {};
+				if (!DecodeTransforms(packed, group)) return;
+				for (const auto& transform : group) {
+					++sentCount[transform.id];
+					// Near entities are not packed with the far one, so their positions keep the precision of their own range
+					if (transform.id != farId && (transform.changeMask & SNAPSHOT_CHANGED_POSITION)) {
+						const float error = glm::length(transform.position - entities[transform.id].position);
+						if (error > GetPositionMaxError(GetPositionRangeExponent(64)) * std::sqrt(3.0f)) {
+							LOG_ERROR("Near entity " << transform.id << " was decoded with an error of " << error << " m")
+							nearPositionErrors = true;
+						}
+					}
+					if (transform.id == farId) {
+						maxFarGap = std::max(maxFarGap, int64_t(frame) - lastFarFrame);
+						lastFarFrame = int64_t(frame);
+					}
+				}
+				uint32_t mask = 0;
+				baselines.Acknowledge(sequence, mask);
+			});
+			if (frameBytes > byteBudget + 1) { // packed bursts are padded to the next byte
+				LOG_ERROR("Frame " << frame << " used " << frameBytes << " bytes out of a budget of " << byteBudget)
+				return 1;
+			}
+		}
+		maxFarGap = std::max(maxFarGap, int64_t(frames) - lastFarFrame);
+		
+		LOG("Burst priority with " << nearEntityCount << " near entities: the far fast entity was sent " << sentCount[farId] << " times, at most " << maxFarGap << " frames apart")
+		if (maxFarGap > 10) {
+			LOG_ERROR("The far fast entity was starved for " << maxFarGap << " frames")
+			return 2;
+		}
+		if (nearPositionErrors) return 4;
+		for (int i = 0; i < nearEntityCount; ++i) {
+			if (sentCount[i] < 5) {
+				LOG_ERROR("Near entity " << i << " was only sent " << sentCount[i] << " times")
+				return 3;
+			}
+		}
+		return 0;
+	}
+
+	// Packets are shared between clients without being copied, and a steady flow of them stops allocating once the pool has warmed up
+	int MULTIPLAYER_PACKET_POOL() {
+		// Same interface as the WriteOnlyStream used by the modules, without the sockets
+		struct TestPacket {
+			std::vector<uint8_t> data;
+			TestPacket(size_t capacity) {data.reserve(capacity);}
+			void ClearWriteBuffer() {data.clear();}
+		};
+		
+		const uint64_t clients = 32;
+		const int ticks = 200;
+		const int ticksPerSend = 8; // action streams are sent less often than the server ticks
+		PacketPool<TestPacket> pool(64, 16);
+		{
+			PacketQueues<TestPacket> queues {};
+			uint64_t sentPackets = 0;
+			uint64_t slabAllocationsAfterWarmup = 0;
+			for (int tick = 0; tick < ticks; ++tick) {
+				// One packet shared by all clients, and one for each of them
+				auto broadcast = pool.Acquire();
+				broadcast->data = {0, uint8_t(tick)};
+				for (uint64_t client = 1; client <= clients; ++client) {
+					queues.Push(client, broadcast);
+					auto packet = pool.Acquire();
+					packet->data = {1, uint8_t(client)};
+					queues.Push(client, packet);
+				}
+				if (broadcast.UseCount() != clients + 1) {
+					LOG_ERROR("Broadcast packet has " << broadcast.UseCount() << " references instead of " << (clients + 1))
+					return 1;
+				}
+				if (tick % ticksPerSend == ticksPerSend - 1) {
+					for (uint64_t client = 1; client <= clients; ++client) {
+						int expected = tick - ticksPerSend + 1;
+						bool inOrder = true, broadcastNext = true;
+						queues.Drain(client, [&](TestPacket& packet){
+							if (packet.data.size() != 2 || packet.data[0] != (broadcastNext? 0 : 1) || packet.data[1] != (broadcastNext? uint8_t(expected) : uint8_t(client))) inOrder = false;
+							if (!broadcastNext) ++expected;
+							broadcastNext = !broadcastNext;
+							++sentPackets;
+						});
+						if (!inOrder || expected != tick + 1 || queues.Size(client) != 0) {
+							LOG_ERROR("Client " << client << " did not receive the packets of tick " << tick << " in order")
+							return 2;
+						}
+					}
+				}
+				if (tick == ticksPerSend * 2) slabAllocationsAfterWarmup = pool.GetStats().slabAllocations;
+			}
+			
+			const auto& stats = pool.GetStats();
+			LOG("Packet pool: " << (double(stats.acquired) / ticks) << " packets per tick, " << stats.slabAllocations << " slab allocations for " << stats.packets << " packets, " << (double(stats.slabAllocations - slabAllocationsAfterWarmup) / (ticks - ticksPerSend * 2)) << " slab allocations per tick after warmup")
+			if (sentPackets != uint64_t(ticks) * clients * 2) return 3;
+			if (stats.slabAllocations != slabAllocationsAfterWarmup) {
+				LOG_ERROR("Packet pool kept allocating after warmup")
+				return 4;
+			}
+			
+			// Forgotten clients release their packets
+			auto pending = pool.Acquire();
+			queues.Push(1, pending);
+			queues.Push(2, pending);
+			queues.EraseIf([](uint64_t client){return client == 1;});
+			if (pending.UseCount() != 2 || queues.Size(1) != 0 || queues.Size(2) != 1) return 5;
+		}
+		{// Packets acquired on some threads and released on others, each thread queues packets for the next one and drains its own queue
+			const int threads = 4;
+			const int packetsPerThread = 20000;
+			PacketQueues<TestPacket> queues {};
+			std::atomic<int> corrupted = 0;
+			auto drain = [&queues, &corrupted](int client){
+				const uint8_t sender = uint8_t((client + threads - 1) % threads);
+				queues.Drain(client, [&corrupted, sender](TestPacket& packet){
+					if (packet.data.size() != 2 || packet.data[0] != sender) ++corrupted;
+				});
+			};
+			std::vector<std::thread> workers {};
+			for (int t = 0; t < threads; ++t) workers.emplace_back([&, t]{
+				for (int i = 0; i < packetsPerThread; ++i) {
+					auto packet = pool.Acquire();
+					// A packet handed out twice would already have data, or have it overwritten before it is drained
+					if (packet->data.size() != 0) ++corrupted;
+					packet->data = {uint8_t(t), uint8_t(i)};
+					queues.Push((t + 1) % threads, packet);
+					if (i % 16 == 15) drain(t);
+				}
+			});
+			for (auto& worker : workers) worker.join();
+			for (int t = 0; t < threads; ++t) drain(t);
+			if (corrupted != 0) {
+				LOG_ERROR("Packet pool handed out " << corrupted << " packets that were still in use")
+				return 7;
+			}
+		}
+		const auto& stats = pool.GetStats();
+		if (stats.acquired != stats.recycled) {
+			LOG_ERROR("Packet pool leaked " << (stats.acquired - stats.recycled) << " packets")
+			return 6;
+		}
+		return 0;
+	}
+
+
+	// An entity flying in circles, sent at a low burst rate over a jittery and lossy link, rendered at 60 fps from the interpolation buffer
+	int MULTIPLAYER_SNAPSHOT_INTERPOLATION() {
+		using namespace networking::snapshot;
+		struct MovingEntity {
+			int32_t id;
+			glm::dvec3 worldPosition;
+			glm::vec3 position;
+			glm::quat orientation;
+			double distance;
+			double viewDot;
+		};
+		struct InFlightBurst {
+			double arrival;
+			double timestamp;
+			std::vector<uint8_t> packed;
+		};
+		const double radius = 30;
+		const double angularSpeed = 0.5; // 15 m/s
+		const double moveDuration = 20;
+		const double idleDuration = 2;
+		const double blackoutStart = 8;
+		const double blackoutDuration = 1;
+		const double burstInterval = 0.1; // 10 bursts per second
+		const double latency = 0.05;
+		const double jitter = 0.04;
+		const double loss = 0.05;
+		const double clockOffset = 1000; // between the server's clock and the client's
+		const double renderInterval = 1.0 / 60;
+		const double interpolationDelay = burstInterval * 1.5 + jitter;
+		const double maxExtrapolation = 0.25;
+		
+		auto truePosition = [&](double t){
+			const double angle = std::min(t, moveDuration) * angularSpeed;
+			return glm::dvec3(std::cos(angle) * radius, 0, std::sin(angle) * radius);
+		};
+		auto trueOrientation = [&](double t){
+			const double angle = std::min(t, moveDuration) * angularSpeed;
+			return glm::quat(float(std::cos(-angle/2)), 0, float(std::sin(-angle/2)), 0);
+		};
+		
+		uint seed = 5;
+		DeltaBaselines baselines {};
+		BurstPriorityAccumulator priorities {};
+		DeltaAcks acks {};
+		std::vector<InFlightBurst> inFlight {};
+		SnapshotClock clock {};
+		SnapshotInterpolation buffer {};
+		buffer.Reset(truePosition(0), glm::dquat(trueOrientation(0)));
+		glm::dvec3 smoothed = truePosition(0); // previous approach, blending towards the latest transform received
+		glm::dvec3 latestReceived = truePosition(0);
+		
+		double maxError = 0, sumError = 0;
+		int errorSamples = 0;
+		double sumAccelerationError = 0, sumSmoothedAccelerationError = 0;
+		int accelerationSamples = 0;
+		int extrapolatedFrames = 0, limitedFrames = 0;
+		double maxBlackoutOvershoot = 0;
+		std::vector<glm::dvec3> rendered {}, smoothedRendered {}, expected {};
+		uint64_t frame = 0;
+		double nextBurst = 0;
+		for (double localTime = clockOffset; localTime < clockOffset + moveDuration + idleDuration; localTime += renderInterval) {
+			const double serverTime = localTime - clockOffset;
+			
+			// Server
+			while (nextBurst <= serverTime) {
+				MovingEntity entity {1, truePosition(nextBurst), glm::vec3(truePosition(nextBurst)), trueOrientation(nextBurst), 0, 1};
+				const double timestamp = nextBurst;
+				EncodeDeltaBursts(baselines, priorities, std::vector<MovingEntity>{entity}, frame++, timestamp, 428, 1308, [&](uint32_t sequence, const std::vector<uint8_t>& packed){
+					const bool blackout = timestamp >= blackoutStart && timestamp < blackoutStart + blackoutDuration;
+					if (blackout || RandomFloat(seed) < loss) return;
+					inFlight.push_back({timestamp + clockOffset + latency + RandomFloat(seed) * jitter, timestamp, packed});
+					acks.Received(sequence);
+				});
+				uint32_t latest, mask;
+				if (acks.Get(latest, mask)) baselines.Acknowledge(latest, mask);
+				nextBurst += burstInterval;
+			}
+			
+			// Client
+			for (auto it = inFlight.begin(); it != inFlight.end(); ) {
+				if (it->arrival > localTime) {++it; continue;}
+				std::vector<EntityTransform> group {};
+				if (DecodeTransforms(it->packed, group)) {
+					clock.Received(it->timestamp, localTime);
+					for (const auto& transform : group) {
+						const glm::dvec3 position {transform.position};
+						const glm::dvec3 velocity {transform.velocity};
+						const glm::dquat orientation {transform.orientation};
+						buffer.Push(it->timestamp,
+							(transform.changeMask & SNAPSHOT_CHANGED_POSITION)? &position : nullptr,
+							(transform.changeMask & SNAPSHOT_CHANGED_VELOCITY)? &velocity : nullptr,
+							(transform.changeMask & SNAPSHOT_CHANGED_ROTATION)? &orientation : nullptr
+						);
+						if (transform.changeMask & SNAPSHOT_CHANGED_POSITION) latestReceived = position;
+					}
+				}
+				it = inFlight.erase(it);
+			}
+			if (!clock.IsValid()) continue;
+			const double renderTime = clock.GetServerTime(localTime) - interpolationDelay;
+			glm::dvec3 position;
+			glm::dquat orientation;
+			const auto sampling = buffer.Sample(renderTime, maxExtrapolation, position, orientation);
+			smoothed = smoothed + (latestReceived - smoothed) * std::min(1.0, renderInterval * 15.0);
+			
+			if (sampling == SnapshotInterpolation::EXTRAPOLATED) ++extrapolatedFrames;
+			if (sampling == SnapshotInterpolation::EXTRAPOLATION_LIMIT) ++limitedFrames;
+			if (renderTime > blackoutStart && renderTime < blackoutStart + blackoutDuration) {
+				// Dead reckoning must stop after the extrapolation limit, the entity keeps going straight instead of following the circle
+				const double overshoot = glm::length(position - truePosition(renderTime));
+				maxBlackoutOvershoot = std::max(maxBlackoutOvershoot, overshoot);
+				rendered.clear(); smoothedRendered.clear(); expected.clear();
+				continue;
+			}
+			if (renderTime > 1) {
+				const double error = glm::length(position - truePosition(renderTime));
+				maxError = std::max(maxError, error);
+				sumError += error;
+				++errorSamples;
+				if (1.0 - std::abs(glm::dot(glm::quat(orientation), trueOrientation(renderTime))) > 1e-3) {
+					LOG_ERROR("Interpolated orientation is off at " << renderTime << " seconds")
+					return 1;
+				}
+				
+				// Smoothness, as the error of the acceleration between consecutive frames
+				rendered.push_back(position);
+				smoothedRendered.push_back(smoothed);
+				expected.push_back(truePosition(renderTime));
+				if (rendered.size() >= 3) {
+					auto acceleration = [renderInterval](const std::vector<glm::dvec3>& p){
+						const size_t n = p.size();
+						return (p[n-1] - p[n-2] * 2.0 + p[n-3]) * (1.0 / (renderInterval*renderInterval));
+					};
+					sumAccelerationError += glm::length(acceleration(rendered) - acceleration(expected));
+					sumSmoothedAccelerationError += glm::length(acceleration(smoothedRendered) - acceleration(expected));
+					++accelerationSamples;
+				}
+			}
+		}
+		
+		const double finalError = glm::length(rendered.back() - truePosition(moveDuration));
+		const double accelerationError = sumAccelerationError / accelerationSamples;
+		const double smoothedAccelerationError = sumSmoothedAccelerationError / accelerationSamples;
+		LOG("Snapshot interpolation at " << (1.0/burstInterval) << " bursts/s with " << int(latency*1000) << "+" << int(jitter*1000) << " ms latency and " << int(loss*100) << "% loss: position error " << (sumError / errorSamples) << " m on average, " << maxError << " m at most, acceleration error " << accelerationError << " m/s2 instead of " << smoothedAccelerationError << " m/s2 with the previous blending, " << extrapolatedFrames << " frames extrapolated, " << limitedFrames << " frames at the extrapolation limit, " << maxBlackoutOvershoot << " m off at most during a " << blackoutDuration << " s blackout")
+		if (maxError > 0.5 || sumError / errorSamples > 0.05) {
+			LOG_ERROR("Interpolated positions are too far from the server's")
+			return 2;
+		}
+		if (accelerationError * 10 > smoothedAccelerationError) {
+			LOG_ERROR("Interpolated motion is not smooth enough")
+			return 3;
+		}
+		// During the blackout, the entity goes straight for at most maxExtrapolation, then stays still while the real one keeps going
+		const double maxOvershoot = angularSpeed * radius * (blackoutDuration + interpolationDelay + jitter + burstInterval);
+		if (limitedFrames == 0 || maxBlackoutOvershoot > maxOvershoot) return 4;
+		if (finalError > 0.01) {
+			LOG_ERROR("Entity did not settle on its final position, " << finalError << " m away")
+			return 5;
+		}
+		return 0;
+	}
+
+}